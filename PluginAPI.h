@@ -7,6 +7,8 @@
 #include <mq/Plugin.h>
 #include <glm/vec3.hpp>
 
+#include <vector>
+
 // Exports functions that can be used by other plugins to interface with MQ2Nav
 
 #ifdef NAV_API_EXPORTS
@@ -142,6 +144,17 @@ public:
 
 	// Unregisters an observer that was registered with RegisterNavObserver
 	virtual void UnregisterNavObserver(int observerId) = 0;
+
+	//----------------------------------------------------------------------------
+
+	// Start loading the navmesh for a zone ahead of time, eg. when about to zone. The
+	// navmesh will be ready to use as soon as the zone is entered.
+	virtual void PrefetchZone(int zoneId) = 0;
+
+	// Calculate the lengths of the paths to each of the destinations, eg. to find the
+	// closest of several spawns. This costs about the same as a single GetPathLength.
+	// Lengths are -1 for destinations that can't be reached.
+	virtual std::vector<float> GetPathLengths(const std::vector<std::string_view>& destinations) = 0;
 };
 
 } // namespace nav
@@ -0,0 +1,584 @@
+//
+// Benchmarks.cpp
+//
+
+#include "Benchmarks.h"
+
+#include "common/Compression.h"
+#include "common/LandmarkTable.h"
+#include "common/NavMesh.h"
+#include "common/PolyGrid.h"
+
+#include <DetourCommon.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourNode.h>
+
+#include <fmt/format.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+//============================================================================
+
+static size_t GetCurrentMemoryUsage()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	size_t pages = 0, residentPages = 0;
+
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+
+	if (fscanf(file, "%zu %zu", &pages, &residentPages) != 2)
+		residentPages = 0;
+	fclose(file);
+
+	return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+static size_t GetPeakMemoryUsage()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+	return 0;
+#endif
+}
+
+// Polls the working set of the process on a background thread to find the peak
+// memory use while it is alive. The process peak can't be reset, so this lets us
+// measure each phase separately.
+class MemorySampler
+{
+public:
+	MemorySampler()
+		: m_peak(GetCurrentMemoryUsage())
+	{
+		m_thread = std::thread([this]()
+		{
+			while (!m_done)
+			{
+				size_t current = GetCurrentMemoryUsage();
+				if (current > m_peak)
+					m_peak = current;
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	~MemorySampler()
+	{
+		Stop();
+	}
+
+	size_t Stop()
+	{
+		if (m_thread.joinable())
+		{
+			m_done = true;
+			m_thread.join();
+		}
+
+		return m_peak;
+	}
+
+private:
+	std::thread m_thread;
+	std::atomic<bool> m_done = false;
+	std::atomic<size_t> m_peak;
+};
+
+static int CountTiles(const dtNavMesh* navMesh)
+{
+	int count = 0;
+
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (tile && tile->header && tile->dataSize)
+			++count;
+	}
+
+	return count;
+}
+
+struct LoadBenchmarkResult
+{
+	bool success = false;
+	std::chrono::duration<double, std::milli> bestTime = std::chrono::duration<double, std::milli>::max();
+	std::chrono::duration<double, std::milli> totalTime{ 0 };
+	size_t peakMemory = 0;
+	int tileCount = 0;
+};
+
+static LoadBenchmarkResult RunLoadPhase(const std::string& meshFile, int threads, int iterations)
+{
+	LoadBenchmarkResult result;
+	MemorySampler sampler;
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		NavMesh navmesh;
+		navmesh.SetLoadThreadCount(threads);
+
+		auto startTime = std::chrono::steady_clock::now();
+		NavMesh::LoadResult loadResult = navmesh.LoadNavMeshFile(meshFile);
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime);
+
+		if (loadResult != NavMesh::LoadResult::Success)
+		{
+			SPDLOG_ERROR("Failed to load navmesh: {}", meshFile);
+			return result;
+		}
+
+		result.bestTime = std::min(result.bestTime, elapsed);
+		result.totalTime += elapsed;
+		result.tileCount = CountTiles(navmesh.GetNavMesh().get());
+	}
+
+	result.peakMemory = sampler.Stop();
+	result.success = true;
+	return result;
+}
+
+static void PrintLoadResult(const char* name, int threads, int iterations, const LoadBenchmarkResult& result)
+{
+	fmt::print("{:<10} threads: {:>2}  avg: {:>9.2f} ms  best: {:>9.2f} ms  peak memory: {:>8.1f} MB\n",
+		name, threads, result.totalTime.count() / iterations, result.bestTime.count(),
+		result.peakMemory / (1024.0 * 1024.0));
+}
+
+int RunLoadBenchmark(const std::string& meshFile, int threads, int iterations)
+{
+	threads = std::max(threads, 1);
+	iterations = std::max(iterations, 1);
+
+	fmt::print("Benchmarking load of {} ({} iterations)\n", meshFile, iterations);
+
+	// Single threaded first, so the parallel run doesn't benefit from the file cache
+	// more than the serial run does.
+	LoadBenchmarkResult serial = RunLoadPhase(meshFile, 1, iterations);
+	if (!serial.success)
+		return 1;
+
+	fmt::print("Loaded {} tiles\n", serial.tileCount);
+	PrintLoadResult("serial", 1, iterations, serial);
+
+	LoadBenchmarkResult parallel = RunLoadPhase(meshFile, threads, iterations);
+	if (!parallel.success)
+		return 1;
+
+	PrintLoadResult("parallel", threads, iterations, parallel);
+
+	fmt::print("Speedup: {:.2f}x\n", serial.bestTime / parallel.bestTime);
+	fmt::print("Process peak memory: {:.1f} MB\n", GetPeakMemoryUsage() / (1024.0 * 1024.0));
+
+	return 0;
+}
+
+//============================================================================
+
+int RunCodecBenchmark(const std::string& meshFile, int iterations)
+{
+	using namespace std::chrono;
+
+	iterations = std::max(iterations, 1);
+
+	NavMesh navmesh;
+	if (navmesh.LoadNavMeshFile(meshFile) != NavMesh::LoadResult::Success || !navmesh.GetNavMesh())
+	{
+		SPDLOG_ERROR("Failed to load navmesh: {}", meshFile);
+		return 1;
+	}
+
+	const dtNavMesh* navMesh = navmesh.GetNavMesh().get();
+	std::vector<const dtMeshTile*> tiles;
+	size_t totalSize = 0;
+	int maxTileSize = 0;
+
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (tile && tile->header && tile->dataSize)
+		{
+			tiles.push_back(tile);
+			totalSize += tile->dataSize;
+			maxTileSize = std::max(maxTileSize, tile->dataSize);
+		}
+	}
+
+	if (tiles.empty())
+	{
+		SPDLOG_ERROR("Navmesh has no tiles: {}", meshFile);
+		return 1;
+	}
+
+	fmt::print("Benchmarking codecs with {} tiles, {:.2f} MB ({} iterations)\n", tiles.size(),
+		totalSize / (1024.0 * 1024.0), iterations);
+	fmt::print("{:<6} {:>12} {:>8} {:>16} {:>16}\n", "codec", "size", "ratio", "compress MB/s", "decompress MB/s");
+
+	std::vector<uint8_t> decompressed(maxTileSize);
+
+	for (uint32_t c = static_cast<uint32_t>(NavMeshCodec::Zlib); c <= static_cast<uint32_t>(NavMeshCodec::Last); ++c)
+	{
+		NavMeshCodec codec = static_cast<NavMeshCodec>(c);
+
+		// tiles are compressed individually, the same as they are stored in the file.
+		std::vector<std::vector<uint8_t>> compressed(tiles.size());
+		size_t compressedSize = 0;
+
+		auto startTime = steady_clock::now();
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			if (!CompressBuffer(codec, tiles[i]->data, tiles[i]->dataSize, compressed[i]))
+			{
+				SPDLOG_ERROR("Failed to compress tile with {}", GetCodecName(codec));
+				return 1;
+			}
+
+			compressedSize += compressed[i].size();
+		}
+		duration<double> compressTime = steady_clock::now() - startTime;
+
+		startTime = steady_clock::now();
+		for (int iter = 0; iter < iterations; ++iter)
+		{
+			for (size_t i = 0; i < tiles.size(); ++i)
+			{
+				if (!DecompressBuffer(codec, compressed[i].data(), compressed[i].size(),
+					decompressed.data(), tiles[i]->dataSize))
+				{
+					SPDLOG_ERROR("Failed to decompress tile with {}", GetCodecName(codec));
+					return 1;
+				}
+			}
+		}
+		duration<double> decompressTime = steady_clock::now() - startTime;
+
+		double megabytes = totalSize / (1024.0 * 1024.0);
+
+		fmt::print("{:<6} {:>12} {:>7.2f}x {:>16.1f} {:>16.1f}\n", GetCodecName(codec), compressedSize,
+			(double)totalSize / compressedSize, megabytes / compressTime.count(),
+			megabytes * iterations / decompressTime.count());
+	}
+
+	return 0;
+}
+
+//============================================================================
+
+static const int MAX_STRAIGHT_PATH_LENGTH = 1024;
+
+static std::mt19937 s_pathRandom;
+
+static float PathRandom()
+{
+	return std::uniform_real_distribution<float>(0.f, 1.f)(s_pathRandom);
+}
+
+struct PathBenchmarkResult
+{
+	std::chrono::duration<double, std::milli> totalTime{ 0 };
+	int64_t totalNodes = 0;
+	int maxNodes = 0;
+	double totalLength = 0.;
+	int found = 0;
+};
+
+static float GetStraightPathLength(const dtNavMeshQuery& query, const float* startPos, const float* endPos,
+	const dtPolyRef* path, int pathCount)
+{
+	float endOfPath[3];
+	dtVcopy(endOfPath, endPos);
+
+	// a partial path ends at the closest point to the end
+	if (!path[pathCount - 1] || dtStatusFailed(query.closestPointOnPoly(path[pathCount - 1], endPos, endOfPath, nullptr)))
+		return 0.f;
+
+	std::vector<float> straightPath(MAX_STRAIGHT_PATH_LENGTH * 3);
+	int straightCount = 0;
+	query.findStraightPath(startPos, endOfPath, path, pathCount, straightPath.data(), nullptr, nullptr,
+		&straightCount, MAX_STRAIGHT_PATH_LENGTH);
+
+	float length = 0.f;
+	for (int i = 1; i < straightCount; ++i)
+	{
+		length += dtVdist(&straightPath[(i - 1) * 3], &straightPath[i * 3]);
+	}
+
+	return length;
+}
+
+static void PrintPathResult(const char* name, int pairs, const PathBenchmarkResult& result)
+{
+	fmt::print("{:<10} avg nodes: {:>9.1f}  max nodes: {:>6}  avg time: {:>8.3f} ms  total length: {:>12.1f}\n",
+		name, (double)result.totalNodes / pairs, result.maxNodes, result.totalTime.count() / pairs,
+		result.totalLength);
+}
+
+int RunPathBenchmark(const std::string& meshFile, int pairs, int landmarks)
+{
+	using namespace std::chrono;
+
+	pairs = std::max(pairs, 1);
+
+	NavMesh navmesh;
+	if (navmesh.LoadNavMeshFile(meshFile) != NavMesh::LoadResult::Success || !navmesh.GetNavMesh())
+	{
+		SPDLOG_ERROR("Failed to load navmesh: {}", meshFile);
+		return 1;
+	}
+
+	const dtNavMesh* navMesh = navmesh.GetNavMesh().get();
+
+	dtQueryFilter filter;
+	filter.setIncludeFlags(+PolyFlags::All);
+	filter.setExcludeFlags(+PolyFlags::Disabled);
+	navmesh.FillFilterAreaCosts(filter);
+
+	std::shared_ptr<const LandmarkTable> table = navmesh.GetLandmarkTable();
+	if (!table || landmarks > 0)
+	{
+		auto newTable = std::make_shared<LandmarkTable>();
+
+		auto startTime = steady_clock::now();
+		newTable->Build(*navMesh, filter, landmarks > 0 ? landmarks : 8, navmesh.GetPolyConnectivity().get());
+		duration<double, std::milli> buildTime = steady_clock::now() - startTime;
+
+		fmt::print("Picked {} landmarks in {:.1f} ms\n", newTable->GetLandmarkCount(), buildTime.count());
+		table = std::move(newTable);
+	}
+
+	if (table->IsEmpty())
+	{
+		SPDLOG_ERROR("Navmesh has no landmarks: {}", meshFile);
+		return 1;
+	}
+
+	dtNavMeshQuery query;
+	if (dtStatusFailed(query.init(navMesh, NAVMESH_QUERY_MAX_NODES)))
+	{
+		SPDLOG_ERROR("Failed to create navmesh query");
+		return 1;
+	}
+
+	// same points for both heuristics, from a fixed seed so runs can be compared
+	s_pathRandom.seed(1);
+
+	struct PathEnds
+	{
+		dtPolyRef startRef, endRef;
+		float startPos[3], endPos[3];
+	};
+	std::vector<PathEnds> ends(pairs);
+
+	for (PathEnds& pathEnds : ends)
+	{
+		if (dtStatusFailed(query.findRandomPoint(&filter, PathRandom, &pathEnds.startRef, pathEnds.startPos))
+			|| dtStatusFailed(query.findRandomPoint(&filter, PathRandom, &pathEnds.endRef, pathEnds.endPos)))
+		{
+			SPDLOG_ERROR("Failed to pick points on navmesh: {}", meshFile);
+			return 1;
+		}
+	}
+
+	fmt::print("Benchmarking {} paths with {} landmarks\n", pairs, table->GetLandmarkCount());
+
+	LandmarkHeuristic heuristic;
+	heuristic.SetTable(navMesh, table);
+
+	std::vector<dtPolyRef> path(NAVMESH_QUERY_MAX_NODES);
+	PathBenchmarkResult results[2];
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		query.setHeuristic(pass == 0 ? nullptr : &heuristic);
+		PathBenchmarkResult& result = results[pass];
+
+		for (const PathEnds& pathEnds : ends)
+		{
+			int pathCount = 0;
+
+			auto startTime = steady_clock::now();
+			dtStatus status = query.findPath(pathEnds.startRef, pathEnds.endRef, pathEnds.startPos, pathEnds.endPos,
+				&filter, path.data(), &pathCount, static_cast<int>(path.size()));
+			result.totalTime += steady_clock::now() - startTime;
+
+			const int nodes = query.getNodePool()->getNodeCount();
+			result.totalNodes += nodes;
+			result.maxNodes = std::max(result.maxNodes, nodes);
+
+			if (dtStatusSucceed(status) && pathCount > 0)
+			{
+				result.totalLength += GetStraightPathLength(query, pathEnds.startPos, pathEnds.endPos, path.data(), pathCount);
+				++result.found;
+			}
+		}
+	}
+
+	PrintPathResult("straight", pairs, results[0]);
+	PrintPathResult("landmarks", pairs, results[1]);
+
+	fmt::print("Nodes: {:.2f}x fewer  Time: {:.2f}x faster  Length: {:+.2f}%\n",
+		(double)results[0].totalNodes / std::max<int64_t>(results[1].totalNodes, 1),
+		results[0].totalTime / results[1].totalTime,
+		results[0].totalLength > 0. ? (results[1].totalLength / results[0].totalLength - 1.) * 100. : 0.);
+
+	return 0;
+}
+
+//============================================================================
+
+int RunGridBenchmark(const std::string& meshFile, int points, float cellSize)
+{
+	using namespace std::chrono;
+
+	points = std::max(points, 1);
+
+	NavMesh navmesh;
+	if (navmesh.LoadNavMeshFile(meshFile) != NavMesh::LoadResult::Success || !navmesh.GetNavMesh())
+	{
+		SPDLOG_ERROR("Failed to load navmesh: {}", meshFile);
+		return 1;
+	}
+
+	const dtNavMesh* navMesh = navmesh.GetNavMesh().get();
+
+	auto startTime = steady_clock::now();
+	PolyGrid grid;
+	grid.Build(*navMesh, cellSize);
+	duration<double, std::milli> buildTime = steady_clock::now() - startTime;
+
+	if (grid.IsEmpty())
+	{
+		SPDLOG_ERROR("Navmesh has no polygons: {}", meshFile);
+		return 1;
+	}
+
+	fmt::print("Built {}x{} grid of {:.1f} unit cells with {} entries ({:.1f} MB) in {:.1f} ms\n",
+		grid.GetWidth(), grid.GetHeight(), grid.GetCellSize(), grid.GetEntryCount(),
+		grid.GetEntryCount() * sizeof(PolyGrid::Entry) / (1024.0 * 1024.0), buildTime.count());
+
+	dtNavMeshQuery query;
+	if (dtStatusFailed(query.init(navMesh, NAVMESH_QUERY_MAX_NODES)))
+	{
+		SPDLOG_ERROR("Failed to create navmesh query");
+		return 1;
+	}
+
+	dtQueryFilter filter;
+	filter.setIncludeFlags(+PolyFlags::All);
+	filter.setExcludeFlags(+PolyFlags::Disabled);
+
+	glm::vec3 boundsMin{ FLT_MAX }, boundsMax{ -FLT_MAX };
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (!tile->header) continue;
+
+		boundsMin = glm::min(boundsMin, glm::make_vec3(tile->header->bmin));
+		boundsMax = glm::max(boundsMax, glm::make_vec3(tile->header->bmax));
+	}
+
+	// Half of the points are near the navmesh, where lookups usually are, and the rest
+	// are anywhere in its bounds.
+	s_pathRandom.seed(1);
+
+	std::vector<glm::vec3> positions(points);
+	for (int i = 0; i < points; ++i)
+	{
+		glm::vec3& pos = positions[i];
+		dtPolyRef ref;
+
+		if (i % 2 == 0 && dtStatusSucceed(query.findRandomPoint(&filter, PathRandom, &ref, glm::value_ptr(pos))))
+		{
+			pos += glm::vec3{ PathRandom() * 6.f - 3.f, PathRandom() * 15.f - 5.f, PathRandom() * 6.f - 3.f };
+		}
+		else
+		{
+			pos = boundsMin + glm::vec3{ PathRandom(), PathRandom(), PathRandom() } * (boundsMax - boundsMin);
+		}
+	}
+
+	// heights, with the box that NavMesh::GetHeights searches
+	int sameHeights = 0, differentHeights = 0;
+	duration<double, std::milli> detourTime{ 0 }, gridTime{ 0 };
+
+	dtQueryFilter heightFilter;
+	std::vector<dtPolyRef> polys(128);
+	std::vector<float> detourHeights, gridHeights;
+	const float extents[3] = { 1.f, navmesh.GetNavMeshBoundsMax().y - navmesh.GetNavMeshBoundsMin().y, 1.f };
+
+	for (const glm::vec3& pos : positions)
+	{
+		int polyCount = 0;
+
+		detourHeights.clear();
+		gridHeights.clear();
+
+		startTime = steady_clock::now();
+		query.queryPolygons(glm::value_ptr(pos), extents, &heightFilter, polys.data(), &polyCount,
+			static_cast<int>(polys.size()));
+		for (int i = 0; i < polyCount; ++i)
+		{
+			float height;
+			if (dtStatusSucceed(query.getPolyHeight(polys[i], glm::value_ptr(pos), &height)))
+				detourHeights.push_back(height);
+		}
+		detourTime += steady_clock::now() - startTime;
+
+		startTime = steady_clock::now();
+		grid.GetHeights(query, glm::value_ptr(pos), extents, heightFilter, gridHeights);
+		gridTime += steady_clock::now() - startTime;
+
+		std::sort(detourHeights.begin(), detourHeights.end());
+		std::sort(gridHeights.begin(), gridHeights.end());
+
+		if (detourHeights == gridHeights)
+		{
+			++sameHeights;
+		}
+		else
+		{
+			++differentHeights;
+			SPDLOG_WARN("Heights differ at ({:.2f}, {:.2f}, {:.2f}): detour has {}, grid has {}",
+				pos.x, pos.y, pos.z, detourHeights.size(), gridHeights.size());
+		}
+	}
+
+	fmt::print("Heights at {} points: {} same, {} different\n", points, sameHeights, differentHeights);
+	fmt::print("detour     avg time: {:>8.4f} ms\ngrid       avg time: {:>8.4f} ms  ({:.2f}x faster)\n",
+		detourTime.count() / points, gridTime.count() / points, detourTime / gridTime);
+
+	return differentHeights ? 1 : 0;
+}
@@ -0,0 +1,27 @@
+//
+// Benchmarks.h
+//
+
+#pragma once
+
+#include <string>
+
+// Loads a navmesh repeatedly, first decompressing tiles on a single thread and then on
+// |threads| threads, and reports the load time and peak memory use of each.
+int RunLoadBenchmark(const std::string& meshFile, int threads, int iterations);
+
+// Compresses each tile of a navmesh with every codec and reports the compression ratio
+// and the compression and decompression speed of each.
+int RunCodecBenchmark(const std::string& meshFile, int iterations);
+
+// Finds paths between random points of a navmesh with the straight line heuristic and
+// with the landmark heuristic, and reports the nodes expanded, the search time and the
+// path lengths of each. Landmarks are picked if the navmesh doesn't have them, or if
+// |landmarks| is given.
+int RunPathBenchmark(const std::string& meshFile, int pairs, int landmarks);
+
+// Looks up the heights at random points of a navmesh, with the polygon grid and with
+// the tile searches of Detour, and reports where they disagree and the time taken by
+// each. Fails if they don't find the same heights. The grid picks its own cell size
+// unless |cellSize| is given.
+int RunGridBenchmark(const std::string& meshFile, int points, float cellSize);
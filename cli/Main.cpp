@@ -5,9 +5,12 @@
 #include <iostream>
 #include <args/args.hxx>
 
+#include "Benchmarks.h"
+#include "common/Compression.h"
 #include "common/NavMesh.h"
 
 #include <filesystem>
+#include <thread>
 #include <fmt/format.h>
 
 #include <spdlog/spdlog.h>
@@ -23,7 +26,23 @@ int main(int argc, char** argv)
 	args::Command convert(commands, "convert", "Convert mesh from one format to another");
 		args::Positional<std::string> inputMesh(convert, "input", "Input navmesh file to load", args::Options::Required);
 		args::Positional<std::string> outputMesh(convert, "output", "Output navmesh file to save");
-		args::ValueFlag<int> meshVersion(convert, "version", "Navmesh version to save (defaults to latest)", { "version" }, (int)NavMeshHeaderVersion::Latest);
+		args::ValueFlag<int> meshVersion(convert, "version", "Navmesh version to save: 4, 5 or 6 (defaults to latest)", { "version" }, (int)NavMeshHeaderVersion::Latest);
+		args::ValueFlag<std::string> tileCodec(convert, "codec", "Compress each tile separately with none, zlib, zstd or lz4 (version 6 only)", { "codec" });
+	args::Command benchCodec(commands, "bench-codec", "Compare compression ratio and speed of the tile codecs");
+		args::Positional<std::string> benchCodecMesh(benchCodec, "mesh", "Navmesh file to load", args::Options::Required);
+		args::ValueFlag<int> benchCodecIterations(benchCodec, "iterations", "Number of times to decompress the tiles (defaults to 10)", { "iterations" }, 10);
+	args::Command benchLoad(commands, "bench-load", "Measure navmesh load time and memory use");
+		args::Positional<std::string> benchMesh(benchLoad, "mesh", "Navmesh file to load", args::Options::Required);
+		args::ValueFlag<int> benchThreads(benchLoad, "threads", "Number of threads for the parallel load (defaults to hardware concurrency)", { "threads" }, (int)std::thread::hardware_concurrency());
+		args::ValueFlag<int> benchIterations(benchLoad, "iterations", "Number of times to load the navmesh (defaults to 5)", { "iterations" }, 5);
+	args::Command benchPath(commands, "bench-path", "Compare path searches with and without landmarks");
+		args::Positional<std::string> benchPathMesh(benchPath, "mesh", "Navmesh file to load", args::Options::Required);
+		args::ValueFlag<int> benchPathPairs(benchPath, "pairs", "Number of paths to find (defaults to 1000)", { "pairs" }, 1000);
+		args::ValueFlag<int> benchPathLandmarks(benchPath, "landmarks", "Number of landmarks to pick, instead of the ones in the navmesh", { "landmarks" }, 0);
+	args::Command benchGrid(commands, "bench-grid", "Check polygon grid height lookups against Detour and compare their speed");
+		args::Positional<std::string> benchGridMesh(benchGrid, "mesh", "Navmesh file to load", args::Options::Required);
+		args::ValueFlag<int> benchGridPoints(benchGrid, "points", "Number of points to look up (defaults to 10000)", { "points" }, 10000);
+		args::ValueFlag<float> benchGridCellSize(benchGrid, "size", "Size of the grid cells (defaults to half of a tile)", { "cell-size" }, 0.f);
 
 	args::Group arguments("arguments");
 	args::GlobalOptions globals(parser, arguments);
@@ -75,6 +94,20 @@ int main(int argc, char** argv)
 			return 1;
 		}
 
+		NavMeshHeaderVersion version = static_cast<NavMeshHeaderVersion>(meshVersion.Get());
+		if (version < NavMeshHeaderVersion::Version4 || version > NavMeshHeaderVersion::Latest)
+		{
+			SPDLOG_ERROR("Unsupported navmesh version: {}", meshVersion.Get());
+			return 1;
+		}
+
+		NavMeshCodec codec = NavMeshCodec::None;
+		if (tileCodec && !ParseCodecName(tileCodec.Get(), codec))
+		{
+			SPDLOG_ERROR("Unsupported codec: {}", tileCodec.Get());
+			return 1;
+		}
+
 		fmt::print("Converting {}...\n", inputMeshStr);
 
 		NavMesh navmesh;
@@ -106,7 +139,9 @@ int main(int argc, char** argv)
 			break;
 		}
 
-		NavMeshHeaderVersion version = static_cast<NavMeshHeaderVersion>(meshVersion.Get());
+		// keep the codec of the input file unless one was given
+		if (tileCodec)
+			navmesh.SetTileCodec(codec);
 
 		fmt::print("Saving to: {0}...", outputMeshStr);
 
@@ -117,8 +152,25 @@ int main(int argc, char** argv)
 		else
 		{
 			fmt::print("Failed!\n");
+			return 1;
 		}
 	}
+	else if (benchCodec)
+	{
+		return RunCodecBenchmark(benchCodecMesh.Get(), benchCodecIterations.Get());
+	}
+	else if (benchLoad)
+	{
+		return RunLoadBenchmark(benchMesh.Get(), benchThreads.Get(), benchIterations.Get());
+	}
+	else if (benchPath)
+	{
+		return RunPathBenchmark(benchPathMesh.Get(), benchPathPairs.Get(), benchPathLandmarks.Get());
+	}
+	else if (benchGrid)
+	{
+		return RunGridBenchmark(benchGridMesh.Get(), benchGridPoints.Get(), benchGridCellSize.Get());
+	}
 	else
 	{
 		std::cout << parser;
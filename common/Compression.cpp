@@ -0,0 +1,124 @@
+//
+// Compression.cpp
+//
+
+#include "Compression.h"
+#include "common/Utilities.h"
+
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zstd.h>
+
+#include <climits>
+#include <cstring>
+
+//============================================================================
+
+// Navmeshes are saved rarely and loaded often, so prefer better compression
+// where it doesn't cost anything to decompress.
+static const int ZSTD_COMPRESSION_LEVEL = 9;
+static const int LZ4_COMPRESSION_LEVEL = LZ4HC_CLEVEL_DEFAULT;
+
+const char* GetCodecName(NavMeshCodec codec)
+{
+	switch (codec)
+	{
+	case NavMeshCodec::None: return "none";
+	case NavMeshCodec::Zlib: return "zlib";
+	case NavMeshCodec::Zstd: return "zstd";
+	case NavMeshCodec::LZ4: return "lz4";
+	default: return "unknown";
+	}
+}
+
+bool ParseCodecName(std::string_view name, NavMeshCodec& codec)
+{
+	for (uint32_t i = 0; i <= static_cast<uint32_t>(NavMeshCodec::Last); ++i)
+	{
+		if (name == GetCodecName(static_cast<NavMeshCodec>(i)))
+		{
+			codec = static_cast<NavMeshCodec>(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool CompressBuffer(NavMeshCodec codec, const void* in_data, size_t in_data_size,
+	std::vector<uint8_t>& out_data)
+{
+	switch (codec)
+	{
+	case NavMeshCodec::None:
+		out_data.assign((const uint8_t*)in_data, (const uint8_t*)in_data + in_data_size);
+		return true;
+
+	case NavMeshCodec::Zlib:
+		return CompressMemory(const_cast<void*>(in_data), in_data_size, out_data);
+
+	case NavMeshCodec::Zstd: {
+		out_data.resize(ZSTD_compressBound(in_data_size));
+
+		size_t result = ZSTD_compress(out_data.data(), out_data.size(), in_data, in_data_size,
+			ZSTD_COMPRESSION_LEVEL);
+		if (ZSTD_isError(result))
+			return false;
+
+		out_data.resize(result);
+		return true;
+	}
+
+	case NavMeshCodec::LZ4: {
+		if (in_data_size > (size_t)LZ4_MAX_INPUT_SIZE)
+			return false;
+
+		out_data.resize(LZ4_compressBound((int)in_data_size));
+
+		int result = LZ4_compress_HC((const char*)in_data, (char*)out_data.data(), (int)in_data_size,
+			(int)out_data.size(), LZ4_COMPRESSION_LEVEL);
+		if (result <= 0)
+			return false;
+
+		out_data.resize(result);
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+bool DecompressBuffer(NavMeshCodec codec, const void* in_data, size_t in_data_size,
+	void* out_data, size_t out_data_size)
+{
+	switch (codec)
+	{
+	case NavMeshCodec::None:
+		if (in_data_size != out_data_size)
+			return false;
+
+		memcpy(out_data, in_data, out_data_size);
+		return true;
+
+	case NavMeshCodec::Zlib:
+		return DecompressMemory(in_data, in_data_size, out_data, out_data_size);
+
+	case NavMeshCodec::Zstd: {
+		size_t result = ZSTD_decompress(out_data, out_data_size, in_data, in_data_size);
+		return !ZSTD_isError(result) && result == out_data_size;
+	}
+
+	case NavMeshCodec::LZ4: {
+		if (in_data_size > INT_MAX || out_data_size > INT_MAX)
+			return false;
+
+		int result = LZ4_decompress_safe((const char*)in_data, (char*)out_data, (int)in_data_size,
+			(int)out_data_size);
+		return result >= 0 && (size_t)result == out_data_size;
+	}
+
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,26 @@
+//
+// Compression.h
+//
+
+#pragma once
+
+#include "common/NavMeshData.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Returns the name of the codec as used on the command line, eg "zstd".
+const char* GetCodecName(NavMeshCodec codec);
+
+// Looks up a codec by name. Returns false if the name is not recognized.
+bool ParseCodecName(std::string_view name, NavMeshCodec& codec);
+
+// Compresses a buffer with the given codec, replacing the contents of |out_data|.
+bool CompressBuffer(NavMeshCodec codec, const void* in_data, size_t in_data_size,
+	std::vector<uint8_t>& out_data);
+
+// Decompresses a buffer with the given codec. The decompressed size must be known
+// ahead of time and must match exactly.
+bool DecompressBuffer(NavMeshCodec codec, const void* in_data, size_t in_data_size,
+	void* out_data, size_t out_data_size);
@@ -0,0 +1,227 @@
+//
+// FileWatcher.cpp
+//
+
+#include "FileWatcher.h"
+
+#include <spdlog/spdlog.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace fs = std::filesystem;
+
+//============================================================================
+
+#if defined(_WIN32)
+
+// Change notifications for a directory. These don't say which file changed, so the
+// file's state still needs to be checked afterwards.
+struct FileWatcher::Notifier
+{
+	HANDLE handle = INVALID_HANDLE_VALUE;
+
+	bool Initialize(const fs::path& directory, const fs::path& /*filename*/)
+	{
+		handle = FindFirstChangeNotificationW(directory.c_str(), FALSE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+
+		return handle != INVALID_HANDLE_VALUE;
+	}
+
+	~Notifier()
+	{
+		if (handle != INVALID_HANDLE_VALUE)
+			FindCloseChangeNotification(handle);
+	}
+
+	bool HasChanged()
+	{
+		if (WaitForSingleObject(handle, 0) != WAIT_OBJECT_0)
+			return false;
+
+		FindNextChangeNotification(handle);
+		return true;
+	}
+};
+
+#elif defined(__linux__)
+
+struct FileWatcher::Notifier
+{
+	int fd = -1;
+	std::string name;
+
+	bool Initialize(const fs::path& directory, const fs::path& filename)
+	{
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd == -1)
+			return false;
+
+		// Only look at finished writes and files being moved into place, we don't want
+		// to hear about every write while the file is being saved.
+		if (inotify_add_watch(fd, directory.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE) == -1)
+		{
+			return false;
+		}
+
+		name = filename.string();
+		return true;
+	}
+
+	~Notifier()
+	{
+		if (fd != -1)
+			close(fd);
+	}
+
+	bool HasChanged()
+	{
+		alignas(inotify_event) char buffer[4096];
+		bool changed = false;
+
+		for (;;)
+		{
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			if (length <= 0)
+				break;
+
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+
+				if ((event->mask & IN_Q_OVERFLOW)
+					|| (event->len > 0 && name == event->name))
+				{
+					changed = true;
+				}
+
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+
+		return changed;
+	}
+};
+
+#else
+
+// no notifications on this platform, always poll.
+struct FileWatcher::Notifier
+{
+	bool Initialize(const fs::path&, const fs::path&) { return false; }
+	bool HasChanged() { return false; }
+};
+
+#endif
+
+//============================================================================
+
+FileWatcher::FileWatcher()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+void FileWatcher::Watch(const std::string& filename)
+{
+	// already watching it, just catch up with any changes.
+	if (filename == m_filename)
+	{
+		m_fileState = ReadFileState();
+		return;
+	}
+
+	Stop();
+
+	if (filename.empty())
+		return;
+
+	m_filename = filename;
+	m_fileState = ReadFileState();
+	m_lastPoll = clock::now();
+
+	fs::path path = fs::absolute(fs::path(filename));
+
+	auto notifier = std::make_unique<Notifier>();
+	if (notifier->Initialize(path.parent_path(), path.filename()))
+	{
+		m_notifier = std::move(notifier);
+	}
+	else
+	{
+		SPDLOG_DEBUG("FileWatcher: change notifications are not available for {}, polling instead", filename);
+	}
+}
+
+void FileWatcher::Stop()
+{
+	m_filename.clear();
+	m_notifier.reset();
+	m_fileState = FileState{};
+}
+
+bool FileWatcher::IsUsingNotifications() const
+{
+	return m_notifier != nullptr;
+}
+
+bool FileWatcher::Poll()
+{
+	if (m_filename.empty())
+		return false;
+
+	if (m_notifier)
+	{
+		if (!m_notifier->HasChanged())
+			return false;
+	}
+	else
+	{
+		clock::time_point now = clock::now();
+		if (now - m_lastPoll < m_pollInterval)
+			return false;
+
+		m_lastPoll = now;
+	}
+
+	// notifications can be for other files in the same directory
+	return CheckFileState();
+}
+
+FileWatcher::FileState FileWatcher::ReadFileState() const
+{
+	FileState state;
+	std::error_code ec;
+
+	state.writeTime = fs::last_write_time(m_filename, ec);
+	if (ec)
+		return FileState{};
+
+	state.size = fs::file_size(m_filename, ec);
+	if (ec)
+		return FileState{};
+
+	state.exists = true;
+	return state;
+}
+
+bool FileWatcher::CheckFileState()
+{
+	FileState state = ReadFileState();
+	if (state == m_fileState)
+		return false;
+
+	m_fileState = state;
+	return true;
+}
@@ -0,0 +1,73 @@
+//
+// FileWatcher.h
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Watches a single file for changes, using change notifications from the operating
+// system where they are available. The directory containing the file is watched
+// rather than the file itself, so that replacing the file is also noticed. If
+// notifications can't be set up, this falls back to checking the file's write time
+// and size at a fixed interval.
+//
+// Nothing happens in the background, changes are picked up by calling Poll.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Starts watching a file, replacing the previously watched file. The file doesn't
+	// need to exist yet, but its directory does for notifications to be used. If the
+	// file is already being watched, its current state is taken as unchanged.
+	void Watch(const std::string& filename);
+	void Stop();
+
+	const std::string& GetFileName() const { return m_filename; }
+	bool IsWatching() const { return !m_filename.empty(); }
+
+	// true if the operating system is notifying us of changes, false if polling.
+	bool IsUsingNotifications() const;
+
+	// Returns true if the file has changed since the last call. Never blocks.
+	bool Poll();
+
+	// how often the file is checked when notifications aren't available.
+	void SetPollInterval(std::chrono::milliseconds interval) { m_pollInterval = interval; }
+
+private:
+	struct FileState
+	{
+		std::filesystem::file_time_type writeTime;
+		uintmax_t size = 0;
+		bool exists = false;
+
+		bool operator==(const FileState& other) const
+		{
+			return exists == other.exists && size == other.size && writeTime == other.writeTime;
+		}
+		bool operator!=(const FileState& other) const { return !(*this == other); }
+	};
+
+	FileState ReadFileState() const;
+	bool CheckFileState();
+
+	struct Notifier;
+
+	std::string m_filename;
+	std::unique_ptr<Notifier> m_notifier;
+	FileState m_fileState;
+
+	using clock = std::chrono::steady_clock;
+	std::chrono::milliseconds m_pollInterval{ 1000 };
+	clock::time_point m_lastPoll;
+};
@@ -0,0 +1,324 @@
+//
+// FlowField.cpp
+//
+
+#include "FlowField.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// targets that moved further than this need a new field
+static const float FLOWFIELD_TARGET_TOLERANCE = 0.1f;
+
+// size of the box searched for the polygon under a target
+static const glm::vec3 FLOWFIELD_TARGET_EXTENTS = { 5, 10, 5 };
+
+//----------------------------------------------------------------------------
+
+static glm::vec3 GetPolyCenter(const dtMeshTile* tile, const dtPoly* poly)
+{
+	glm::vec3 center{ 0.f };
+
+	for (int i = 0; i < poly->vertCount; ++i)
+	{
+		center += glm::make_vec3(&tile->verts[poly->verts[i] * 3]);
+	}
+
+	return center / static_cast<float>(poly->vertCount);
+}
+
+static bool PassesFilter(const dtQueryFilter& filter, const dtPoly* poly)
+{
+	return (poly->flags & filter.getIncludeFlags()) != 0
+		&& (poly->flags & filter.getExcludeFlags()) == 0;
+}
+
+//----------------------------------------------------------------------------
+
+FlowField::FlowField()
+{
+}
+
+FlowField::~FlowField()
+{
+}
+
+bool FlowField::Build(const dtNavMesh& navMesh, const dtQueryFilter& filter, const FlowFieldTarget& target,
+	dtPolyRef targetRef, const std::atomic<bool>* cancel)
+{
+	Clear();
+
+	m_target = target;
+	m_targetRef = targetRef;
+	m_excludeFlags = filter.getExcludeFlags();
+
+	// The search runs backwards from the target, so it needs the links that lead into
+	// each polygon. Most links have one going back the other way, but one-way off-mesh
+	// connections don't. Each entry is the polygon that the link is from, and which of
+	// its links it is.
+	struct InLink
+	{
+		dtPolyRef from;
+		uint8_t link;
+	};
+	std::vector<std::vector<std::vector<InLink>>> inLinks(navMesh.getMaxTiles());
+
+	m_tiles.resize(navMesh.getMaxTiles());
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		m_tiles[i].tileRef = navMesh.getTileRef(tile);
+		m_tiles[i].next.assign(tile->header->polyCount, NO_LINK);
+		m_tiles[i].costs.assign(tile->header->polyCount, -1.f);
+		inLinks[i].resize(tile->header->polyCount);
+	}
+
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		const dtPolyRef base = navMesh.getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly* poly = &tile->polys[j];
+			if (!PassesFilter(filter, poly))
+				continue;
+
+			int index = 0;
+			for (auto k = poly->firstLink; k != DT_NULL_LINK && index < NO_LINK; k = tile->links[k].next, ++index)
+			{
+				const dtPolyRef ref = tile->links[k].ref;
+				if (ref)
+				{
+					inLinks[navMesh.decodePolyIdTile(ref)][navMesh.decodePolyIdPoly(ref)].push_back(
+						{ base | (dtPolyRef)j, static_cast<uint8_t>(index) });
+				}
+			}
+		}
+	}
+
+	const dtMeshTile* targetTile = nullptr;
+	const dtPoly* targetPoly = nullptr;
+	if (dtStatusFailed(navMesh.getTileAndPolyByRef(targetRef, &targetTile, &targetPoly))
+		|| !PassesFilter(filter, targetPoly))
+	{
+		return true;
+	}
+
+	m_tiles[navMesh.decodePolyIdTile(targetRef)].costs[navMesh.decodePolyIdPoly(targetRef)] = 0.f;
+
+	std::vector<std::pair<float, dtPolyRef>> open;
+	open.emplace_back(0.f, targetRef);
+
+	while (!open.empty())
+	{
+		if (cancel && *cancel)
+			return false;
+
+		std::pop_heap(open.begin(), open.end(), std::greater<>());
+		auto [cost, ref] = open.back();
+		open.pop_back();
+
+		const unsigned int tileIndex = navMesh.decodePolyIdTile(ref);
+		const unsigned int polyIndex = navMesh.decodePolyIdPoly(ref);
+		if (cost > m_tiles[tileIndex].costs[polyIndex])
+			continue;
+
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		navMesh.getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+
+		// paths end at the target itself, not at the centre of its polygon
+		const glm::vec3 pos = ref == targetRef ? target.pos : GetPolyCenter(tile, poly);
+		const float areaCost = filter.getAreaCost(poly->getArea());
+
+		for (const InLink& inLink : inLinks[tileIndex][polyIndex])
+		{
+			const dtMeshTile* fromTile = nullptr;
+			const dtPoly* fromPoly = nullptr;
+			navMesh.getTileAndPolyByRefUnsafe(inLink.from, &fromTile, &fromPoly);
+
+			// half of the way is in each polygon
+			const float fromCost = cost + glm::distance(GetPolyCenter(fromTile, fromPoly), pos)
+				* 0.5f * (areaCost + filter.getAreaCost(fromPoly->getArea()));
+
+			TileData& fromData = m_tiles[navMesh.decodePolyIdTile(inLink.from)];
+			const unsigned int fromIndex = navMesh.decodePolyIdPoly(inLink.from);
+
+			float& current = fromData.costs[fromIndex];
+			if (current < 0.f || fromCost < current)
+			{
+				current = fromCost;
+				fromData.next[fromIndex] = inLink.link;
+
+				open.emplace_back(fromCost, inLink.from);
+				std::push_heap(open.begin(), open.end(), std::greater<>());
+			}
+		}
+	}
+
+	return true;
+}
+
+void FlowField::SetTarget(const FlowFieldTarget& target, dtPolyRef targetRef)
+{
+	m_target = target;
+	m_targetRef = targetRef;
+}
+
+void FlowField::SetTile(const dtNavMesh& navMesh, dtTileRef tileRef, std::vector<uint8_t> next, std::vector<float> costs)
+{
+	const unsigned int tileIndex = navMesh.decodePolyIdTile(tileRef);
+	if (tileIndex >= m_tiles.size())
+	{
+		m_tiles.resize(std::max<size_t>(tileIndex + 1, navMesh.getMaxTiles()));
+	}
+
+	m_tiles[tileIndex].tileRef = tileRef;
+	m_tiles[tileIndex].next = std::move(next);
+	m_tiles[tileIndex].costs = std::move(costs);
+}
+
+void FlowField::Clear()
+{
+	m_target = FlowFieldTarget{};
+	m_targetRef = 0;
+	m_tiles.clear();
+	m_excludeFlags = 0;
+}
+
+const FlowField::TileData* FlowField::GetTileData(const dtNavMesh& navMesh, dtPolyRef ref, unsigned int& polyIndex) const
+{
+	if (!ref)
+		return nullptr;
+
+	unsigned int salt, tileIndex;
+	navMesh.decodePolyId(ref, salt, tileIndex, polyIndex);
+
+	if (tileIndex >= m_tiles.size())
+		return nullptr;
+
+	// the tile has been replaced since the field was worked out
+	const TileData& tile = m_tiles[tileIndex];
+	if (!tile.tileRef || navMesh.decodePolyIdSalt(tile.tileRef) != salt
+		|| polyIndex >= tile.next.size() || polyIndex >= tile.costs.size())
+	{
+		return nullptr;
+	}
+
+	return &tile;
+}
+
+float FlowField::GetCost(const dtNavMesh& navMesh, dtPolyRef ref) const
+{
+	unsigned int polyIndex;
+	const TileData* tile = GetTileData(navMesh, ref, polyIndex);
+
+	return tile ? tile->costs[polyIndex] : -1.f;
+}
+
+int FlowField::GetCorridor(const dtNavMesh& navMesh, dtPolyRef startRef, dtPolyRef* polys, int maxPolys) const
+{
+	dtPolyRef ref = startRef;
+	int count = 0;
+
+	while (count < maxPolys)
+	{
+		unsigned int polyIndex;
+		const TileData* data = GetTileData(navMesh, ref, polyIndex);
+		if (!data || data->costs[polyIndex] < 0.f)
+			return 0;
+
+		polys[count++] = ref;
+
+		if (ref == m_targetRef)
+			return count;
+
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		navMesh.getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+
+		// step along the polygon's links to the one that leads on
+		unsigned int link = poly->firstLink;
+		for (uint8_t i = 0; i < data->next[polyIndex] && link != DT_NULL_LINK; ++i)
+		{
+			link = tile->links[link].next;
+		}
+
+		if (data->next[polyIndex] == NO_LINK || link == DT_NULL_LINK)
+			return 0;
+
+		ref = tile->links[link].ref;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+
+FlowFieldSet::FlowFieldSet()
+{
+}
+
+FlowFieldSet::~FlowFieldSet()
+{
+}
+
+int FlowFieldSet::Update(const dtNavMesh& navMesh, const dtNavMeshQuery& query, const dtQueryFilter& filter,
+	const std::vector<FlowFieldTarget>& targets, const std::atomic<bool>* cancel)
+{
+	std::vector<FlowField> fields;
+	fields.reserve(targets.size());
+
+	int built = 0;
+
+	for (const FlowFieldTarget& target : targets)
+	{
+		auto iter = std::find_if(m_fields.begin(), m_fields.end(), [&](const FlowField& field)
+		{
+			return field.GetTarget().name == target.name
+				&& glm::distance(field.GetTarget().pos, target.pos) < FLOWFIELD_TARGET_TOLERANCE
+				&& field.GetExcludeFlags() == filter.getExcludeFlags();
+		});
+
+		if (iter != m_fields.end())
+		{
+			fields.push_back(std::move(*iter));
+			m_fields.erase(iter);
+			continue;
+		}
+
+		dtPolyRef targetRef = 0;
+		query.findNearestPoly(glm::value_ptr(target.pos), glm::value_ptr(FLOWFIELD_TARGET_EXTENTS),
+			&filter, &targetRef, nullptr);
+		if (!targetRef)
+			continue;
+
+		FlowField field;
+		if (!field.Build(navMesh, filter, target, targetRef, cancel))
+			return -1;
+
+		fields.push_back(std::move(field));
+		++built;
+	}
+
+	m_fields = std::move(fields);
+	return built;
+}
+
+const FlowField* FlowFieldSet::FindByTargetRef(dtPolyRef targetRef) const
+{
+	for (const FlowField& field : m_fields)
+	{
+		if (field.GetTargetRef() == targetRef)
+			return &field;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,112 @@
+//
+// FlowField.h
+//
+
+#pragma once
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A position that paths are worked out to ahead of time, eg. a waypoint.
+struct FlowFieldTarget
+{
+	std::string name;
+	glm::vec3 pos;            // in navmesh coordinates
+
+	bool operator==(const FlowFieldTarget& other) const { return name == other.name && pos == other.pos; }
+	bool operator!=(const FlowFieldTarget& other) const { return !(*this == other); }
+};
+
+// The cheapest way to one target from every polygon of the navmesh. Each polygon has
+// the link to follow towards the target and the cost of getting there, so the corridor
+// to the target can be read off without a search.
+//
+// Costs are worked out from polygon centres, the same as the other search data.
+class FlowField
+{
+public:
+	static constexpr uint8_t NO_LINK = 0xff;
+
+	struct TileData
+	{
+		dtTileRef tileRef = 0;
+		std::vector<uint8_t> next;    // which of the polygon's links leads on, or NO_LINK
+		std::vector<float> costs;     // cost to the target, negative if it can't be reached
+	};
+
+	FlowField();
+	~FlowField();
+
+	// Works out the way to the target from every polygon that can reach it. Polygons
+	// that don't pass the filter are left out, and the filter's area costs are used.
+	// Returns false if it was stopped by cancel, in which case the field is incomplete.
+	bool Build(const dtNavMesh& navMesh, const dtQueryFilter& filter, const FlowFieldTarget& target,
+		dtPolyRef targetRef, const std::atomic<bool>* cancel = nullptr);
+
+	// Sets a field that was worked out earlier, eg. by a build that was saved.
+	void SetTarget(const FlowFieldTarget& target, dtPolyRef targetRef);
+	void SetTile(const dtNavMesh& navMesh, dtTileRef tileRef, std::vector<uint8_t> next, std::vector<float> costs);
+
+	void Clear();
+
+	const FlowFieldTarget& GetTarget() const { return m_target; }
+	dtPolyRef GetTargetRef() const { return m_targetRef; }
+
+	// by tile index. Slots without a tile have a zero tile ref.
+	const std::vector<TileData>& GetTiles() const { return m_tiles; }
+
+	// The cost from a polygon to the target, or a negative value if the target can't be
+	// reached from it or its tile has been replaced since.
+	float GetCost(const dtNavMesh& navMesh, dtPolyRef ref) const;
+
+	// Follows the field from a polygon to the target and fills in the polygons along
+	// the way, starting with startRef. Returns the number of polygons, or 0 if the way
+	// is broken or doesn't fit in maxPolys.
+	int GetCorridor(const dtNavMesh& navMesh, dtPolyRef startRef, dtPolyRef* polys, int maxPolys) const;
+
+	uint16_t GetExcludeFlags() const { return m_excludeFlags; }
+	void SetExcludeFlags(uint16_t flags) { m_excludeFlags = flags; }
+
+private:
+	const TileData* GetTileData(const dtNavMesh& navMesh, dtPolyRef ref, unsigned int& polyIndex) const;
+
+	FlowFieldTarget m_target;
+	dtPolyRef m_targetRef = 0;
+	std::vector<TileData> m_tiles;
+	uint16_t m_excludeFlags = 0;
+};
+
+//----------------------------------------------------------------------------
+
+// The flow fields to a set of targets.
+class FlowFieldSet
+{
+public:
+	FlowFieldSet();
+	~FlowFieldSet();
+
+	// Builds the fields of targets that don't have one yet, and drops the fields of
+	// targets that are gone or have moved. The query finds the polygons of the targets.
+	// Returns the number of fields that were built, or -1 if it was stopped by cancel, in
+	// which case the set shouldn't be used.
+	int Update(const dtNavMesh& navMesh, const dtNavMeshQuery& query, const dtQueryFilter& filter,
+		const std::vector<FlowFieldTarget>& targets, const std::atomic<bool>* cancel = nullptr);
+
+	void AddField(FlowField field) { m_fields.push_back(std::move(field)); }
+	void Clear() { m_fields.clear(); }
+
+	bool IsEmpty() const { return m_fields.empty(); }
+	const std::vector<FlowField>& GetFields() const { return m_fields; }
+
+	// the field that leads to this polygon, or nullptr if there isn't one
+	const FlowField* FindByTargetRef(dtPolyRef targetRef) const;
+
+private:
+	std::vector<FlowField> m_fields;
+};
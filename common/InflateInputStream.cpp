@@ -0,0 +1,107 @@
+//
+// InflateInputStream.cpp
+//
+
+#include "InflateInputStream.h"
+
+#include <spdlog/spdlog.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+//============================================================================
+
+InflateInputStream::InflateInputStream(const void* data, size_t size, int bufferSize)
+	: m_stream(std::make_unique<z_stream_s>())
+	, m_buffer(std::make_unique<uint8_t[]>(bufferSize))
+	, m_bufferSize(bufferSize)
+{
+	memset(m_stream.get(), 0, sizeof(z_stream_s));
+
+	m_stream->next_in = (Bytef*)data;
+	m_stream->avail_in = (uInt)size;
+
+	m_status = inflateInit(m_stream.get());
+	if (m_status != Z_OK)
+	{
+		SPDLOG_ERROR("Failed to initialize zlib: {}", m_status);
+	}
+}
+
+InflateInputStream::~InflateInputStream()
+{
+	inflateEnd(m_stream.get());
+}
+
+bool InflateInputStream::Next(const void** data, int* size)
+{
+	// return anything that was backed up first.
+	if (m_backUpCount > 0)
+	{
+		*data = m_buffer.get() + m_outputSize - m_backUpCount;
+		*size = m_backUpCount;
+
+		m_byteCount += m_backUpCount;
+		m_backUpCount = 0;
+		return true;
+	}
+
+	while (m_status == Z_OK)
+	{
+		m_stream->next_out = m_buffer.get();
+		m_stream->avail_out = (uInt)m_bufferSize;
+
+		m_status = inflate(m_stream.get(), Z_NO_FLUSH);
+		if (m_status != Z_OK && m_status != Z_STREAM_END)
+		{
+			SPDLOG_ERROR("Failed to decompress data: {}", m_stream->msg ? m_stream->msg : "unknown error");
+			return false;
+		}
+
+		m_outputSize = m_bufferSize - (int)m_stream->avail_out;
+		if (m_outputSize > 0)
+		{
+			*data = m_buffer.get();
+			*size = m_outputSize;
+
+			m_byteCount += m_outputSize;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void InflateInputStream::BackUp(int count)
+{
+	m_backUpCount = std::min(count, m_outputSize);
+	m_byteCount -= m_backUpCount;
+}
+
+bool InflateInputStream::Skip(int count)
+{
+	const void* data;
+	int size;
+
+	while (count > 0)
+	{
+		if (!Next(&data, &size))
+			return false;
+
+		if (size > count)
+		{
+			BackUp(size - count);
+			return true;
+		}
+
+		count -= size;
+	}
+
+	return true;
+}
+
+bool InflateInputStream::Failed() const
+{
+	return m_status != Z_OK && m_status != Z_STREAM_END;
+}
@@ -0,0 +1,45 @@
+//
+// InflateInputStream.h
+//
+
+#pragma once
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <cstdint>
+#include <memory>
+
+struct z_stream_s;
+
+// A protobuf input stream that inflates zlib compressed data from memory as it
+// is read, so that large messages can be parsed without first decompressing
+// the whole thing into a temporary buffer.
+class InflateInputStream : public google::protobuf::io::ZeroCopyInputStream
+{
+public:
+	static constexpr int DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+	InflateInputStream(const void* data, size_t size, int bufferSize = DEFAULT_BUFFER_SIZE);
+	~InflateInputStream() override;
+
+	InflateInputStream(const InflateInputStream&) = delete;
+	InflateInputStream& operator=(const InflateInputStream&) = delete;
+
+	// ZeroCopyInputStream
+	bool Next(const void** data, int* size) override;
+	void BackUp(int count) override;
+	bool Skip(int count) override;
+	int64_t ByteCount() const override { return m_byteCount; }
+
+	// true if the compressed data was corrupt or ended before the end of the stream.
+	bool Failed() const;
+
+private:
+	std::unique_ptr<z_stream_s> m_stream;
+	std::unique_ptr<uint8_t[]> m_buffer;
+	int m_bufferSize;
+	int m_outputSize = 0;
+	int m_backUpCount = 0;
+	int64_t m_byteCount = 0;
+	int m_status;
+};
@@ -0,0 +1,604 @@
+//
+// LandmarkTable.cpp
+//
+
+#include "LandmarkTable.h"
+
+#include "common/PolyConnectivity.h"
+
+#include <DetourCommon.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+
+//----------------------------------------------------------------------------
+
+static bool PassesFilter(const dtQueryFilter& filter, const dtPoly* poly)
+{
+	return (poly->flags & filter.getIncludeFlags()) != 0
+		&& (poly->flags & filter.getExcludeFlags()) == 0;
+}
+
+// The middle of the edge that a link crosses, where detour's search puts the node of the
+// polygon it leads to. Same as dtNavMeshQuery::getEdgeMidPoint.
+static bool GetEdgeMidPoint(const dtMeshTile* fromTile, const dtPoly* fromPoly, dtPolyRef fromRef,
+	const dtLink& link, const dtMeshTile* toTile, const dtPoly* toPoly, glm::vec3& mid)
+{
+	if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		mid = glm::make_vec3(&fromTile->verts[fromPoly->verts[link.edge] * 3]);
+		return true;
+	}
+
+	if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		for (auto i = toPoly->firstLink; i != DT_NULL_LINK; i = toTile->links[i].next)
+		{
+			if (toTile->links[i].ref == fromRef)
+			{
+				mid = glm::make_vec3(&toTile->verts[toPoly->verts[toTile->links[i].edge] * 3]);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	const glm::vec3 v0 = glm::make_vec3(&fromTile->verts[fromPoly->verts[link.edge] * 3]);
+	const glm::vec3 v1 = glm::make_vec3(&fromTile->verts[fromPoly->verts[(link.edge + 1) % fromPoly->vertCount] * 3]);
+
+	// links across tile borders can cover part of the edge
+	float tmin = 0.f, tmax = 1.f;
+	if (link.side != 0xff && (link.bmin != 0 || link.bmax != 255))
+	{
+		tmin = link.bmin / 255.f;
+		tmax = link.bmax / 255.f;
+	}
+
+	mid = glm::mix(v0, v1, (tmin + tmax) * 0.5f);
+	return true;
+}
+
+// the furthest that any point of a polygon is from pos
+static float GetMaxDistance(const dtMeshTile* tile, const dtPoly* poly, const glm::vec3& pos)
+{
+	float maxDistance = 0.f;
+
+	for (int i = 0; i < poly->vertCount; ++i)
+	{
+		maxDistance = std::max(maxDistance, glm::distance(pos, glm::make_vec3(&tile->verts[poly->verts[i] * 3])));
+	}
+
+	return maxDistance;
+}
+
+static uint16_t QuantizeCost(float cost, float scale)
+{
+	// rounded down, so that the stored cost is never more than the real one
+	return static_cast<uint16_t>(std::min(std::floor(cost / scale), LandmarkTable::UNREACHED - 1.f));
+}
+
+//----------------------------------------------------------------------------
+
+LandmarkTable::LandmarkTable()
+{
+}
+
+LandmarkTable::~LandmarkTable()
+{
+}
+
+void LandmarkTable::Build(const dtNavMesh& navMesh, const dtQueryFilter& filter, int count,
+	const PolyConnectivity* connectivity)
+{
+	Clear();
+
+	m_excludeFlags = filter.getExcludeFlags();
+	m_areaCosts.resize(DT_MAX_AREAS);
+	for (int i = 0; i < DT_MAX_AREAS; ++i)
+	{
+		m_areaCosts[i] = filter.getAreaCost(i);
+	}
+
+	const float unreached = std::numeric_limits<float>::max();
+	const uint32_t noPoly = std::numeric_limits<uint32_t>::max();
+	const int maxTiles = navMesh.getMaxTiles();
+
+	// Polygons are numbered by tile and polygon. The search has a node for each link, that
+	// stands in the polygon the link leads to, at the middle of the edge it crosses. They
+	// are numbered by tile and link.
+	std::vector<uint32_t> polyBase(maxTiles + 1, 0);
+	std::vector<uint32_t> nodeBase(maxTiles + 1, 0);
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+
+		polyBase[i + 1] = polyBase[i] + (tile->header ? tile->header->polyCount : 0);
+		nodeBase[i + 1] = nodeBase[i] + (tile->header ? tile->header->maxLinkCount : 0);
+	}
+
+	const uint32_t polyCount = polyBase[maxTiles];
+	const uint32_t nodeCount = nodeBase[maxTiles];
+
+	auto getPolyIndex = [&](dtPolyRef ref)
+	{
+		return polyBase[navMesh.decodePolyIdTile(ref)] + navMesh.decodePolyIdPoly(ref);
+	};
+
+	std::vector<dtPolyRef> polyRefs(polyCount, 0);  // zero for polygons that are left out
+	std::vector<float> polyCosts(polyCount, 0.f);
+
+	dtPolyRef seed = 0;
+	std::map<uint32_t, int> regionSizes;
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		const dtPolyRef base = navMesh.getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			if (!PassesFilter(filter, &tile->polys[j]))
+				continue;
+
+			polyRefs[polyBase[i] + j] = base | (dtPolyRef)j;
+			polyCosts[polyBase[i] + j] = filter.getAreaCost(tile->polys[j].getArea());
+
+			if (!seed)
+			{
+				seed = base | (dtPolyRef)j;
+			}
+
+			if (connectivity)
+			{
+				++regionSizes[connectivity->GetComponent(navMesh, base | (dtPolyRef)j)];
+			}
+		}
+	}
+
+	if (!seed || count <= 0)
+		return;
+
+	std::vector<glm::vec3> nodePos(nodeCount);
+	std::vector<uint32_t> nodeFrom(nodeCount, noPoly);
+	std::vector<uint32_t> nodeTo(nodeCount, noPoly);
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const uint32_t poly = polyBase[i] + j;
+			if (!polyRefs[poly])
+				continue;
+
+			for (auto k = tile->polys[j].firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtPolyRef neiRef = tile->links[k].ref;
+				if (!neiRef || !polyRefs[getPolyIndex(neiRef)])
+					continue;
+
+				const dtMeshTile* neiTile = nullptr;
+				const dtPoly* neiPoly = nullptr;
+				navMesh.getTileAndPolyByRefUnsafe(neiRef, &neiTile, &neiPoly);
+
+				const uint32_t node = nodeBase[i] + k;
+				if (GetEdgeMidPoint(tile, &tile->polys[j], polyRefs[poly], tile->links[k], neiTile, neiPoly, nodePos[node]))
+				{
+					nodeFrom[node] = poly;
+					nodeTo[node] = getPolyIndex(neiRef);
+				}
+			}
+		}
+	}
+
+	// the nodes that stand in each polygon, and the nodes that leave it
+	auto groupNodes = [&](const std::vector<uint32_t>& nodePoly, std::vector<uint32_t>& start, std::vector<uint32_t>& nodes)
+	{
+		start.assign(polyCount + 1, 0);
+		for (uint32_t poly : nodePoly)
+		{
+			if (poly != noPoly)
+				++start[poly + 1];
+		}
+
+		for (uint32_t i = 0; i < polyCount; ++i)
+		{
+			start[i + 1] += start[i];
+		}
+
+		nodes.resize(start[polyCount]);
+		std::vector<uint32_t> next(start.begin(), start.end() - 1);
+		for (uint32_t node = 0; node < nodeCount; ++node)
+		{
+			if (nodePoly[node] != noPoly)
+				nodes[next[nodePoly[node]]++] = node;
+		}
+	};
+
+	std::vector<uint32_t> entryStart, entries, exitStart, exits;
+	groupNodes(nodeTo, entryStart, entries);
+	groupNodes(nodeFrom, exitStart, exits);
+
+	// start from the largest region
+	regionSizes.erase(0);
+	if (!regionSizes.empty())
+	{
+		uint32_t largest = std::max_element(regionSizes.begin(), regionSizes.end(),
+			[](const auto& a, const auto& b) { return a.second < b.second; })->first;
+
+		for (uint32_t poly = 0; poly < polyCount; ++poly)
+		{
+			if (polyRefs[poly] && connectivity->GetComponent(navMesh, polyRefs[poly]) == largest)
+			{
+				seed = polyRefs[poly];
+				break;
+			}
+		}
+	}
+
+	std::vector<float> fromCosts(nodeCount), toCosts(nodeCount);
+	std::vector<std::pair<float, uint32_t>> open;
+
+	auto relax = [&](std::vector<float>& costs, uint32_t node, float cost)
+	{
+		if (cost < costs[node])
+		{
+			costs[node] = cost;
+			open.emplace_back(cost, node);
+			std::push_heap(open.begin(), open.end(), std::greater<>());
+		}
+	};
+
+	// Costs from anywhere in the landmark, following links forwards.
+	auto searchFrom = [&](uint32_t landmark)
+	{
+		std::fill(fromCosts.begin(), fromCosts.end(), unreached);
+		open.clear();
+
+		for (uint32_t i = entryStart[landmark]; i < entryStart[landmark + 1]; ++i)
+			relax(fromCosts, entries[i], 0.f);
+		for (uint32_t i = exitStart[landmark]; i < exitStart[landmark + 1]; ++i)
+			relax(fromCosts, exits[i], 0.f);
+
+		while (!open.empty())
+		{
+			std::pop_heap(open.begin(), open.end(), std::greater<>());
+			auto [cost, node] = open.back();
+			open.pop_back();
+
+			if (cost > fromCosts[node])
+				continue;
+
+			const uint32_t poly = nodeTo[node];
+			for (uint32_t i = exitStart[poly]; i < exitStart[poly + 1]; ++i)
+			{
+				relax(fromCosts, exits[i], cost + glm::distance(nodePos[node], nodePos[exits[i]]) * polyCosts[poly]);
+			}
+		}
+	};
+
+	// Costs to anywhere in the landmark, following links backwards.
+	auto searchTo = [&](uint32_t landmark)
+	{
+		std::fill(toCosts.begin(), toCosts.end(), unreached);
+		open.clear();
+
+		for (uint32_t i = entryStart[landmark]; i < entryStart[landmark + 1]; ++i)
+			relax(toCosts, entries[i], 0.f);
+
+		while (!open.empty())
+		{
+			std::pop_heap(open.begin(), open.end(), std::greater<>());
+			auto [cost, node] = open.back();
+			open.pop_back();
+
+			if (cost > toCosts[node])
+				continue;
+
+			const uint32_t poly = nodeFrom[node];
+			for (uint32_t i = entryStart[poly]; i < entryStart[poly + 1]; ++i)
+			{
+				relax(toCosts, entries[i], cost + glm::distance(nodePos[entries[i]], nodePos[node]) * polyCosts[poly]);
+			}
+		}
+	};
+
+	// By polygon: the lowest and highest cost from the landmark to where it is entered, the
+	// lowest cost from there to the landmark, and the highest cost from any point in it to
+	// the landmark.
+	std::vector<float> fromLow(polyCount), fromHigh(polyCount), toLow(polyCount), toHigh(polyCount);
+
+	auto gatherCosts = [&](uint32_t landmark)
+	{
+		for (uint32_t poly = 0; poly < polyCount; ++poly)
+		{
+			fromLow[poly] = fromHigh[poly] = toLow[poly] = toHigh[poly] = unreached;
+
+			if (!polyRefs[poly])
+				continue;
+
+			if (poly == landmark)
+			{
+				fromLow[poly] = fromHigh[poly] = toLow[poly] = toHigh[poly] = 0.f;
+				continue;
+			}
+
+			float highest = 0.f;
+			for (uint32_t i = entryStart[poly]; i < entryStart[poly + 1]; ++i)
+			{
+				fromLow[poly] = std::min(fromLow[poly], fromCosts[entries[i]]);
+				highest = std::max(highest, fromCosts[entries[i]]);
+				toLow[poly] = std::min(toLow[poly], toCosts[entries[i]]);
+			}
+
+			if (fromLow[poly] != unreached)
+			{
+				fromHigh[poly] = highest;
+			}
+
+			const dtMeshTile* tile = nullptr;
+			const dtPoly* polyData = nullptr;
+			navMesh.getTileAndPolyByRefUnsafe(polyRefs[poly], &tile, &polyData);
+
+			for (uint32_t i = exitStart[poly]; i < exitStart[poly + 1]; ++i)
+			{
+				const uint32_t node = exits[i];
+				if (toCosts[node] != unreached)
+				{
+					toHigh[poly] = std::min(toHigh[poly],
+						toCosts[node] + GetMaxDistance(tile, polyData, nodePos[node]) * polyCosts[poly]);
+				}
+			}
+		}
+	};
+
+	// the reached polygon that is furthest from what was searched from, by the given costs
+	auto findFurthest = [&](const std::vector<float>& from)
+	{
+		uint32_t furthest = noPoly;
+		float furthestCost = -1.f;
+
+		for (uint32_t poly = 0; poly < polyCount; ++poly)
+		{
+			if (from[poly] != unreached && from[poly] > furthestCost)
+			{
+				furthestCost = from[poly];
+				furthest = poly;
+			}
+		}
+
+		return furthest;
+	};
+
+	const size_t stride = static_cast<size_t>(count) * 2;
+
+	m_tiles.resize(maxTiles);
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		m_tiles[i].tileRef = navMesh.getTileRef(tile);
+		m_tiles[i].costs.resize(tile->header->polyCount * stride);
+		m_tiles[i].slack.assign(tile->header->polyCount, 0.f);
+	}
+
+	// smallest cost from any landmark so far
+	std::vector<float> nearest(polyCount, unreached);
+
+	// Each landmark is the polygon furthest from the ones before it, starting with the
+	// one furthest from the seed. That puts them out at the dead ends.
+	searchFrom(getPolyIndex(seed));
+	searchTo(getPolyIndex(seed));
+	gatherCosts(getPolyIndex(seed));
+	uint32_t next = findFurthest(fromLow);
+
+	for (int k = 0; k < count && next != noPoly; ++k)
+	{
+		searchFrom(next);
+		searchTo(next);
+		gatherCosts(next);
+
+		float maxCost = 0.f;
+		for (uint32_t poly = 0; poly < polyCount; ++poly)
+		{
+			if (fromLow[poly] != unreached)
+				maxCost = std::max(maxCost, fromLow[poly]);
+			if (toLow[poly] != unreached)
+				maxCost = std::max(maxCost, toLow[poly]);
+		}
+
+		Landmark landmark;
+		landmark.ref = polyRefs[next];
+		landmark.scale = maxCost > 0.f ? maxCost / (UNREACHED - 1) : 1.f;
+		m_landmarks.push_back(landmark);
+
+		for (int i = 0; i < maxTiles; ++i)
+		{
+			TileCosts& tile = m_tiles[i];
+
+			for (size_t j = 0; j < tile.slack.size(); ++j)
+			{
+				const uint32_t poly = polyBase[i] + static_cast<uint32_t>(j);
+				uint16_t& from = tile.costs[j * stride + k];
+				uint16_t& to = tile.costs[j * stride + count + k];
+
+				// The cost from the landmark is used as a lower bound at the end of a search,
+				// and as an upper bound for the polygon searched from, so both have to be known.
+				from = UNREACHED;
+				if (fromHigh[poly] != unreached)
+				{
+					from = QuantizeCost(fromLow[poly], landmark.scale);
+					tile.slack[j] = std::max(tile.slack[j], fromHigh[poly] - fromLow[poly]);
+				}
+
+				// and the cost to it the other way around
+				to = UNREACHED;
+				if (toLow[poly] != unreached && toHigh[poly] != unreached)
+				{
+					to = QuantizeCost(toLow[poly], landmark.scale);
+					tile.slack[j] = std::max(tile.slack[j], toHigh[poly] - toLow[poly]);
+				}
+
+				nearest[poly] = std::min(nearest[poly], fromLow[poly]);
+			}
+		}
+
+		next = findFurthest(nearest);
+	}
+
+	// fewer landmarks were found than asked for, so the stride needs fixing
+	if (GetLandmarkCount() < count)
+	{
+		const size_t found = GetLandmarkCount();
+
+		for (TileCosts& tile : m_tiles)
+		{
+			for (size_t j = 0; j < tile.slack.size(); ++j)
+			{
+				std::copy_n(&tile.costs[j * stride], found, &tile.costs[j * found * 2]);
+				std::copy_n(&tile.costs[j * stride + count], found, &tile.costs[j * found * 2 + found]);
+			}
+
+			tile.costs.resize(tile.slack.size() * found * 2);
+		}
+	}
+}
+
+void LandmarkTable::SetTile(const dtNavMesh& navMesh, dtTileRef tileRef, std::vector<uint16_t> costs,
+	std::vector<float> slack)
+{
+	const unsigned int tileIndex = navMesh.decodePolyIdTile(tileRef);
+	if (tileIndex >= m_tiles.size())
+	{
+		m_tiles.resize(std::max<size_t>(tileIndex + 1, navMesh.getMaxTiles()));
+	}
+
+	m_tiles[tileIndex].tileRef = tileRef;
+	m_tiles[tileIndex].costs = std::move(costs);
+	m_tiles[tileIndex].slack = std::move(slack);
+}
+
+void LandmarkTable::Clear()
+{
+	m_landmarks.clear();
+	m_tiles.clear();
+	m_areaCosts.clear();
+	m_excludeFlags = 0;
+}
+
+bool LandmarkTable::GetCosts(const dtNavMesh& navMesh, dtPolyRef ref, PolyCosts& costs) const
+{
+	if (!ref || m_landmarks.empty())
+		return false;
+
+	unsigned int salt, tileIndex, polyIndex;
+	navMesh.decodePolyId(ref, salt, tileIndex, polyIndex);
+
+	if (tileIndex >= m_tiles.size())
+		return false;
+
+	// the tile has been replaced since the costs were worked out
+	const TileCosts& tile = m_tiles[tileIndex];
+	const size_t stride = m_landmarks.size() * 2;
+	const size_t offset = static_cast<size_t>(polyIndex) * stride;
+	if (!tile.tileRef || navMesh.decodePolyIdSalt(tile.tileRef) != salt
+		|| offset + stride > tile.costs.size() || polyIndex >= tile.slack.size())
+	{
+		return false;
+	}
+
+	costs.from = &tile.costs[offset];
+	costs.to = costs.from + m_landmarks.size();
+	costs.slack = tile.slack[polyIndex];
+	return true;
+}
+
+float LandmarkTable::GetLowerBound(const PolyCosts& poly, const PolyCosts& end) const
+{
+	float bound = 0.f;
+
+	for (size_t i = 0; i < m_landmarks.size(); ++i)
+	{
+		const float scale = m_landmarks[i].scale;
+
+		// Costs are rounded down, which can be off by a step in total. Where the polygon
+		// is entered can cost up to the slack more than its lowest cost from the landmark,
+		// and the end can cost up to its slack more to get to the landmark.
+		if (poly.from[i] != UNREACHED && end.from[i] != UNREACHED)
+		{
+			bound = std::max(bound, (static_cast<int>(end.from[i]) - poly.from[i] - 1) * scale - poly.slack);
+		}
+
+		if (poly.to[i] != UNREACHED && end.to[i] != UNREACHED)
+		{
+			bound = std::max(bound, (static_cast<int>(poly.to[i]) - end.to[i] - 1) * scale - end.slack);
+		}
+	}
+
+	return bound;
+}
+
+bool LandmarkTable::IsValidFor(const dtQueryFilter& filter) const
+{
+	if ((filter.getExcludeFlags() & m_excludeFlags) != m_excludeFlags)
+		return false;
+
+	for (size_t i = 0; i < m_areaCosts.size(); ++i)
+	{
+		if (filter.getAreaCost(static_cast<int>(i)) < m_areaCosts[i])
+			return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+LandmarkHeuristic::LandmarkHeuristic()
+{
+}
+
+LandmarkHeuristic::~LandmarkHeuristic()
+{
+}
+
+void LandmarkHeuristic::SetTable(const dtNavMesh* navMesh, const std::shared_ptr<const LandmarkTable>& table)
+{
+	m_navMesh = navMesh;
+	m_table = table;
+	m_endRef = 0;
+	m_hasEndCosts = false;
+}
+
+float LandmarkHeuristic::getCost(dtPolyRef ref, const float* pos, dtPolyRef endRef, const float* endPos) const
+{
+	float estimate = dtVdist(pos, endPos);
+
+	if (!m_table)
+		return estimate;
+
+	if (endRef != m_endRef)
+	{
+		m_endRef = endRef;
+		m_hasEndCosts = m_table->GetCosts(*m_navMesh, endRef, m_endCosts);
+	}
+
+	LandmarkTable::PolyCosts costs;
+	if (m_hasEndCosts && m_table->GetCosts(*m_navMesh, ref, costs))
+	{
+		estimate = std::max(estimate, m_table->GetLowerBound(costs, m_endCosts));
+	}
+
+	return estimate;
+}
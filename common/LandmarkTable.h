@@ -0,0 +1,128 @@
+//
+// LandmarkTable.h
+//
+
+#pragma once
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class PolyConnectivity;
+
+// Costs from and to a few landmark polygons for every polygon of the navmesh, for the ALT
+// search heuristic. By the triangle inequality, the cost from a polygon to the end of a
+// search is at least the difference between their costs from any landmark, and between
+// their costs to it. In dungeons that wind back and forth that is a much better estimate
+// than the straight line.
+//
+// Costs are measured the way detour's search measures them: between the midpoints of the
+// edges that polygons are entered through, at the area cost of the polygon in between.
+// Following links forwards for the costs from a landmark and backwards for the costs to
+// it keeps one-way connections from being used the wrong way. A polygon is entered at
+// different points depending on where from, so the lowest cost of its entry points is
+// stored, and the slack covers how much more any other point in it can cost.
+//
+// Costs are rounded down to 16 bits with a scale for each landmark.
+class LandmarkTable
+{
+public:
+	static constexpr uint16_t UNREACHED = 0xffff;
+
+	struct Landmark
+	{
+		dtPolyRef ref = 0;
+		float scale = 0.f;        // cost of one step of the stored values
+	};
+
+	struct TileCosts
+	{
+		dtTileRef tileRef = 0;
+		std::vector<uint16_t> costs;  // by polygon, the cost from each landmark and then to each landmark
+		std::vector<float> slack;     // by polygon
+	};
+
+	// the costs of one polygon
+	struct PolyCosts
+	{
+		const uint16_t* from = nullptr;
+		const uint16_t* to = nullptr;
+		float slack = 0.f;
+	};
+
+	LandmarkTable();
+	~LandmarkTable();
+
+	// Picks count landmarks and works out the costs of every polygon. Polygons that don't
+	// pass the filter are left out, and the filter's area costs are used. Landmarks are
+	// spread out from the largest connected region, if the regions are given.
+	void Build(const dtNavMesh& navMesh, const dtQueryFilter& filter, int count,
+		const PolyConnectivity* connectivity = nullptr);
+
+	// Adds costs that were worked out earlier, eg. by a build that was saved.
+	void SetLandmarks(std::vector<Landmark> landmarks) { m_landmarks = std::move(landmarks); }
+	void SetTile(const dtNavMesh& navMesh, dtTileRef tileRef, std::vector<uint16_t> costs,
+		std::vector<float> slack);
+
+	void Clear();
+
+	bool IsEmpty() const { return m_landmarks.empty(); }
+
+	int GetLandmarkCount() const { return static_cast<int>(m_landmarks.size()); }
+	const std::vector<Landmark>& GetLandmarks() const { return m_landmarks; }
+
+	// by tile index. Slots without a tile have a zero tile ref.
+	const std::vector<TileCosts>& GetTiles() const { return m_tiles; }
+
+	// False if the costs of the polygon aren't known, eg. because its tile has been
+	// replaced since.
+	bool GetCosts(const dtNavMesh& navMesh, dtPolyRef ref, PolyCosts& costs) const;
+
+	// Lower bound of the cost from where a polygon is entered to any point in the end
+	// polygon, from their costs.
+	float GetLowerBound(const PolyCosts& poly, const PolyCosts& end) const;
+
+	// The costs are only a lower bound for searches that leave out everything that the
+	// build did, and that cost at least as much in every area.
+	bool IsValidFor(const dtQueryFilter& filter) const;
+
+	uint16_t GetExcludeFlags() const { return m_excludeFlags; }
+	void SetExcludeFlags(uint16_t flags) { m_excludeFlags = flags; }
+
+	const std::vector<float>& GetAreaCosts() const { return m_areaCosts; }
+	void SetAreaCosts(std::vector<float> areaCosts) { m_areaCosts = std::move(areaCosts); }
+
+private:
+	std::vector<Landmark> m_landmarks;
+	std::vector<TileCosts> m_tiles;
+	std::vector<float> m_areaCosts;   // by area
+	uint16_t m_excludeFlags = 0;
+};
+
+//----------------------------------------------------------------------------
+
+// The search heuristic that uses a landmark table. Falls back to the straight line for
+// polygons that aren't in the table. Remembers the costs of the last end polygon, so
+// each query needs its own.
+class LandmarkHeuristic : public dtQueryHeuristic
+{
+public:
+	LandmarkHeuristic();
+	~LandmarkHeuristic() override;
+
+	void SetTable(const dtNavMesh* navMesh, const std::shared_ptr<const LandmarkTable>& table);
+	const LandmarkTable* GetTable() const { return m_table.get(); }
+
+	float getCost(dtPolyRef ref, const float* pos, dtPolyRef endRef, const float* endPos) const override;
+
+private:
+	const dtNavMesh* m_navMesh = nullptr;
+	std::shared_ptr<const LandmarkTable> m_table;
+
+	mutable dtPolyRef m_endRef = 0;
+	mutable bool m_hasEndCosts = false;
+	mutable LandmarkTable::PolyCosts m_endCosts;
+};
@@ -0,0 +1,129 @@
+//
+// MappedFile.cpp
+//
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+//============================================================================
+
+MappedFile::~MappedFile()
+{
+	Unmap();
+}
+
+#if defined(_WIN32)
+
+MappedFile::MapResult MappedFile::Map(const char* filename)
+{
+	Unmap();
+
+	// Allow the file to be replaced or renamed while we have it mapped, so that tools
+	// can save over a mesh that is currently in use.
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		DWORD error = GetLastError();
+		if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)
+			return MapResult::MissingFile;
+
+		return MapResult::Failed;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0
+		|| static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(hFile);
+		return MapResult::Failed;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(hFile);
+
+	if (!hMapping)
+		return MapResult::Failed;
+
+	// The view keeps the section alive, so we don't need to hold onto the handles.
+	void* view = MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(hMapping);
+
+	if (!view)
+		return MapResult::Failed;
+
+	m_data = static_cast<uint8_t*>(view);
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	return MapResult::Success;
+}
+
+void MappedFile::Unmap()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+#else
+
+MappedFile::MapResult MappedFile::Map(const char* filename)
+{
+	Unmap();
+
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1)
+	{
+		if (errno == ENOENT)
+			return MapResult::MissingFile;
+
+		return MapResult::Failed;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return MapResult::Failed;
+	}
+
+	// MAP_PRIVATE gives us copy-on-write pages.
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (view == MAP_FAILED)
+		return MapResult::Failed;
+
+	m_data = static_cast<uint8_t*>(view);
+	m_size = static_cast<size_t>(st.st_size);
+
+	return MapResult::Success;
+}
+
+void MappedFile::Unmap()
+{
+	if (m_data)
+	{
+		munmap(m_data, m_size);
+
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,39 @@
+//
+// MappedFile.h
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A read-only file mapped into memory with copy-on-write pages. Pages can be
+// written to without affecting the file on disk, which lets detour link tiles
+// that live directly inside of the mapping.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	enum struct MapResult {
+		Success,
+		MissingFile,
+		Failed,
+	};
+
+	MapResult Map(const char* filename);
+	void Unmap();
+
+	bool IsMapped() const { return m_data != nullptr; }
+
+	uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
@@ -4,17 +4,24 @@
 
 #include "NavMesh.h"
 
+#include "common/Compression.h"
 #include "common/Enum.h"
-#include "common/JsonProto.h"
+#include "common/FlowField.h"
+#include "common/InflateInputStream.h"
+#include "common/LandmarkTable.h"
+#include "common/MappedFile.h"
+#include "common/PolyConnectivity.h"
+#include "common/PolyGrid.h"
+#include "common/TileGraph.h"
 #include "common/Utilities.h"
 #include "common/proto/NavMeshFile.pb.h"
 
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/util/json_util.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <glm/gtc/type_ptr.hpp>
-#include <rapidjson/document.h>
-#include <rapidjson/filereadstream.h>
 #include <spdlog/spdlog.h>
 
 #include <DebugDraw.h>
@@ -24,13 +31,47 @@
 #include <DetourNavMeshBuilder.h>
 #include <Recast.h>
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <filesystem>
+#include <thread>
 
 namespace fs = std::filesystem;
 
 //============================================================================
 
+// Everything needed to bring the flow fields up to date, copied from the navmesh so
+// that the work can be done on another thread. The dtNavMesh is only read, and tiles
+// aren't added or removed until the build has been cancelled.
+struct NavMesh::FlowFieldBuild
+{
+	std::shared_ptr<dtNavMesh> navMesh;
+	NavMeshQueryPool::Query query;
+	dtQueryFilter filter;
+	std::vector<FlowFieldTarget> targets;
+	std::string fileName;
+	uint64_t contentHash = 0;
+	std::shared_ptr<FlowFieldSet> flowFields;
+	bool loadFile = false;
+
+	std::atomic<bool> cancelled = false;
+	std::atomic<bool> complete = false;
+	std::thread thread;
+
+	~FlowFieldBuild()
+	{
+		cancelled = true;
+
+		if (thread.joinable())
+			thread.join();
+	}
+
+	void Run();
+};
+
+//============================================================================
+
 NavMesh::NavMesh(const std::string& dataFolder, const std::string& zoneName)
 	: m_navMeshDirectory(dataFolder)
 	, m_zoneName(zoneName)
@@ -43,6 +84,16 @@ NavMesh::~NavMesh()
 {
 }
 
+void NavMesh::OnPulse()
+{
+	m_queryPool.Trim();
+
+	if (m_flowFieldBuild && m_flowFieldBuild->complete)
+	{
+		FinishFlowFieldBuild();
+	}
+}
+
 //----------------------------------------------------------------------------
 
 void NavMesh::SetZoneName(const std::string& zoneShortName)
@@ -52,6 +103,9 @@ void NavMesh::SetZoneName(const std::string& zoneShortName)
 
 	ResetNavMesh();
 
+	// the targets belong to the old zone
+	m_flowFieldTargets.clear();
+
 	if (zoneShortName.empty() || zoneShortName == "UNKNOWN_ZONE")
 	{
 		m_zoneName.clear();
@@ -103,9 +157,20 @@ void NavMesh::SetNavMesh(const std::shared_ptr<dtNavMesh>& navMesh, bool reset)
 		ResetSavedData();
 	}
 
+	ClearPendingTiles();
+	CancelFlowFieldBuild();
+
 	m_navMesh = navMesh;
 	m_navMeshQuery.reset();
+	m_polyConnectivity.reset();
+	m_tileGraph.reset();
+	m_landmarkTable.reset();
+	m_flowFields.reset();
+	m_polyGrid.reset();
 	m_lastLoadResult = LoadResult::None;
+	m_contentHash = 0;
+	m_tileHashes.clear();
+	m_partialLoad = false;
 }
 
 void NavMesh::ResetSavedData(PersistedDataFields fields)
@@ -118,8 +183,17 @@ void NavMesh::ResetSavedData(PersistedDataFields fields)
 
 	if (+(fields & PersistedDataFields::MeshTiles))
 	{
+		ClearPendingTiles();
+		CancelFlowFieldBuild();
+
 		m_navMesh.reset();
 		m_navMeshQuery.reset();
+		m_polyConnectivity.reset();
+		m_tileGraph.reset();
+		m_landmarkTable.reset();
+		m_flowFields.reset();
+		m_polyGrid.reset();
+		m_tileCodec = NAVMESH_DEFAULT_TILE_CODEC;
 	}
 
 	if (+(fields & PersistedDataFields::AreaTypes))
@@ -146,6 +220,7 @@ void NavMesh::ResetNavMesh()
 {
 	SetNavMesh(nullptr, true);
 
+	++m_generation;
 	OnNavMeshChanged();
 }
 
@@ -253,6 +328,177 @@ static void ToProto(google::protobuf::RepeatedPtrField<nav::NavMeshTile>& tiles,
 	}
 }
 
+static void ToProto(nav::PolyComponents& out_proto, const PolyConnectivity& connectivity)
+{
+	out_proto.set_component_count(connectivity.GetComponentCount());
+	out_proto.set_exclude_flags(connectivity.GetExcludeFlags());
+
+	for (const PolyConnectivity::TileComponents& tile : connectivity.GetTiles())
+	{
+		if (!tile.tileRef) continue;
+
+		nav::PolyComponents::Tile* ptile = out_proto.add_tiles();
+		ptile->set_tile_ref(tile.tileRef);
+		ptile->mutable_components()->Add(tile.components.begin(), tile.components.end());
+	}
+}
+
+static std::shared_ptr<const PolyConnectivity> FromProto(const nav::PolyComponents& proto, const dtNavMesh& navMesh)
+{
+	auto connectivity = std::make_shared<PolyConnectivity>();
+	connectivity->SetComponentCount(proto.component_count());
+	connectivity->SetExcludeFlags(static_cast<uint16_t>(proto.exclude_flags()));
+
+	for (const nav::PolyComponents::Tile& tile : proto.tiles())
+	{
+		connectivity->SetTile(navMesh, tile.tile_ref(),
+			std::vector<uint32_t>(tile.components().begin(), tile.components().end()));
+	}
+
+	return connectivity;
+}
+
+static void ToProto(nav::TileGraph& out_proto, const TileGraph& graph)
+{
+	out_proto.set_exclude_flags(graph.GetExcludeFlags());
+
+	const std::vector<TileGraph::Edge>& edges = graph.GetEdges();
+	for (const TileGraph::Portal& portal : graph.GetPortals())
+	{
+		nav::TileGraph::Portal* pportal = out_proto.add_portals();
+		pportal->set_tile_ref(portal.tileRef);
+		pportal->set_poly(portal.poly);
+		ToProto(*pportal->mutable_pos(), portal.pos);
+
+		for (uint32_t i = portal.firstEdge; i < portal.firstEdge + portal.edgeCount; ++i)
+		{
+			nav::TileGraph::Edge* pedge = pportal->add_edges();
+			pedge->set_target(edges[i].target);
+			pedge->set_cost(edges[i].cost);
+		}
+	}
+}
+
+static std::shared_ptr<const TileGraph> FromProto(const nav::TileGraph& proto, const dtNavMesh& navMesh)
+{
+	auto graph = std::make_shared<TileGraph>();
+	graph->SetExcludeFlags(static_cast<uint16_t>(proto.exclude_flags()));
+
+	for (const nav::TileGraph::Portal& pportal : proto.portals())
+	{
+		TileGraph::Portal portal;
+		portal.tileRef = pportal.tile_ref();
+		portal.poly = pportal.poly();
+		portal.pos = FromProto(pportal.pos());
+		graph->AddPortal(navMesh, portal);
+
+		for (const nav::TileGraph::Edge& pedge : pportal.edges())
+		{
+			// a damaged file could point anywhere
+			if (pedge.target() < static_cast<uint32_t>(proto.portals_size()))
+			{
+				graph->AddEdge({ pedge.target(), pedge.cost() });
+			}
+		}
+	}
+
+	return graph;
+}
+
+static void ToProto(nav::LandmarkTable& out_proto, const LandmarkTable& table)
+{
+	out_proto.set_exclude_flags(table.GetExcludeFlags());
+	*out_proto.mutable_area_costs() = { table.GetAreaCosts().begin(), table.GetAreaCosts().end() };
+
+	for (const LandmarkTable::Landmark& landmark : table.GetLandmarks())
+	{
+		nav::LandmarkTable::Landmark* plandmark = out_proto.add_landmarks();
+		plandmark->set_poly_ref(landmark.ref);
+		plandmark->set_scale(landmark.scale);
+	}
+
+	for (const LandmarkTable::TileCosts& tile : table.GetTiles())
+	{
+		if (!tile.tileRef) continue;
+
+		std::string costs(tile.costs.size() * 2, '\0');
+		for (size_t i = 0; i < tile.costs.size(); ++i)
+		{
+			costs[i * 2] = static_cast<char>(tile.costs[i] & 0xff);
+			costs[i * 2 + 1] = static_cast<char>(tile.costs[i] >> 8);
+		}
+
+		nav::LandmarkTable::Tile* ptile = out_proto.add_tiles();
+		ptile->set_tile_ref(tile.tileRef);
+		ptile->set_costs(std::move(costs));
+		*ptile->mutable_slack() = { tile.slack.begin(), tile.slack.end() };
+	}
+}
+
+static std::shared_ptr<const LandmarkTable> FromProto(const nav::LandmarkTable& proto, const dtNavMesh& navMesh)
+{
+	auto table = std::make_shared<LandmarkTable>();
+	table->SetExcludeFlags(static_cast<uint16_t>(proto.exclude_flags()));
+	table->SetAreaCosts({ proto.area_costs().begin(), proto.area_costs().end() });
+
+	std::vector<LandmarkTable::Landmark> landmarks;
+	for (const nav::LandmarkTable::Landmark& plandmark : proto.landmarks())
+	{
+		landmarks.push_back({ plandmark.poly_ref(), plandmark.scale() });
+	}
+	table->SetLandmarks(std::move(landmarks));
+
+	for (const nav::LandmarkTable::Tile& ptile : proto.tiles())
+	{
+		const std::string& bytes = ptile.costs();
+
+		std::vector<uint16_t> costs(bytes.size() / 2);
+		for (size_t i = 0; i < costs.size(); ++i)
+		{
+			costs[i] = static_cast<uint16_t>(static_cast<uint8_t>(bytes[i * 2])
+				| (static_cast<uint8_t>(bytes[i * 2 + 1]) << 8));
+		}
+
+		table->SetTile(navMesh, ptile.tile_ref(), std::move(costs), { ptile.slack().begin(), ptile.slack().end() });
+	}
+
+	return table;
+}
+
+static void ToProto(nav::FlowField& out_proto, const FlowField& field)
+{
+	out_proto.set_name(field.GetTarget().name);
+	ToProto(*out_proto.mutable_target_pos(), field.GetTarget().pos);
+	out_proto.set_target_ref(field.GetTargetRef());
+	out_proto.set_exclude_flags(field.GetExcludeFlags());
+
+	for (const FlowField::TileData& tile : field.GetTiles())
+	{
+		if (!tile.tileRef) continue;
+
+		nav::FlowField::Tile* ptile = out_proto.add_tiles();
+		ptile->set_tile_ref(tile.tileRef);
+		ptile->set_next(std::string(tile.next.begin(), tile.next.end()));
+		ptile->mutable_costs()->Add(tile.costs.begin(), tile.costs.end());
+	}
+}
+
+static FlowField FromProto(const nav::FlowField& proto, const dtNavMesh& navMesh)
+{
+	FlowField field;
+	field.SetTarget({ proto.name(), FromProto(proto.target_pos()) }, proto.target_ref());
+	field.SetExcludeFlags(static_cast<uint16_t>(proto.exclude_flags()));
+
+	for (const nav::FlowField::Tile& ptile : proto.tiles())
+	{
+		field.SetTile(navMesh, ptile.tile_ref(),
+			std::vector<uint8_t>(ptile.next().begin(), ptile.next().end()),
+			std::vector<float>(ptile.costs().begin(), ptile.costs().end()));
+	}
+
+	return field;
+}
+
 static void ToProto(nav::BuildSettings& out_proto, const NavMeshConfig& config)
 {
 	out_proto.set_config_version(config.configVersion);
@@ -271,6 +517,7 @@ static void ToProto(nav::BuildSettings& out_proto, const NavMeshConfig& config)
 	out_proto.set_detail_sample_dist(config.detailSampleDist);
 	out_proto.set_detail_sample_max_error(config.detailSampleMaxError);
 	out_proto.set_partition_type(static_cast<int>(config.partitionType));
+	out_proto.set_landmark_count(config.landmarkCount);
 }
 
 static void FromProto(const nav::BuildSettings& proto, NavMeshConfig& config)
@@ -293,6 +540,7 @@ static void FromProto(const nav::BuildSettings& proto, NavMeshConfig& config)
 	config.detailSampleDist = proto.detail_sample_dist();
 	config.detailSampleMaxError = proto.detail_sample_max_error();
 	config.partitionType = static_cast<PartitionType>(proto.partition_type());
+	config.landmarkCount = proto.landmark_count();
 }
 
 static void ToProto(nav::ConvexVolume& out_proto, const ConvexVolume& volume)
@@ -373,62 +621,251 @@ static void FromProto(const nav::PolyAreaType& in_proto, PolyAreaType& area)
 	area.valid = true;
 }
 
-void NavMesh::LoadFromProto(const nav::NavMeshFile& proto, PersistedDataFields fields)
+// Creates and initializes an empty navmesh from the tileset parameters in the proto
+template <typename Deleter>
+static std::shared_ptr<dtNavMesh> CreateNavMesh(const nav::NavMeshFile& proto, Deleter deleter)
 {
-	if (+(fields & PersistedDataFields::MeshTiles))
+	const nav::NavMeshTileSet& tileset = proto.tile_set();
+
+	if (tileset.compatibility_version() != NAVMESH_TILE_COMPAT_VERSION)
 	{
-		// read the tileset
-		const nav::NavMeshTileSet& tileset = proto.tile_set();
+		SPDLOG_ERROR("loadMesh: navmesh has incompatible structure, will continue loading without tiles.");
+		return nullptr;
+	}
+
+	dtNavMeshParams params;
+	FromProto(params, tileset.mesh_params());
+
+	std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(), std::move(deleter));
+
+	// would prefer to have proper origin, but this can fix it up too.
+	params.orig[0] = proto.build_settings().bounds_min().x();
+	params.orig[1] = proto.build_settings().bounds_min().y();
+	params.orig[2] = proto.build_settings().bounds_min().z();
+
+	dtStatus status = navMesh->init(&params);
+	if (status != DT_SUCCESS)
+	{
+		SPDLOG_ERROR("loadMesh: failed to initialize navmesh, will continue loading without tiles.");
+		return nullptr;
+	}
+
+	return navMesh;
+}
+
+// Tile data read out of a mesh file, allocated with dtAlloc.
+struct MeshFileTileData
+{
+	dtTileRef ref = 0;
+	uint8_t* data = nullptr;
+	int dataSize = 0;
+};
+
+// Reads a NavMeshTile message, placing the tile data directly into a dtAlloc'd buffer.
+static NavMesh::LoadResult ReadMeshTile(google::protobuf::io::CodedInputStream& input,
+	std::vector<MeshFileTileData>& out_tiles)
+{
+	using google::protobuf::internal::WireFormatLite;
+
+	MeshFileTileData tile;
 
-		if (tileset.compatibility_version() == NAVMESH_TILE_COMPAT_VERSION)
+	while (uint32_t tag = input.ReadTag())
+	{
+		switch (tag)
 		{
-			dtNavMeshParams params;
-			FromProto(params, tileset.mesh_params());
+		case WireFormatLite::MakeTag(nav::NavMeshTile::kTileRefFieldNumber, WireFormatLite::WIRETYPE_VARINT): {
+			uint64_t ref;
+			if (!input.ReadVarint64(&ref))
+			{
+				dtFree(tile.data);
+				return NavMesh::LoadResult::Corrupt;
+			}
+
+			tile.ref = ref;
+			break;
+		}
+
+		case WireFormatLite::MakeTag(nav::NavMeshTile::kTileDataFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED): {
+			uint32_t length;
+			if (!input.ReadVarint32(&length) || length > (uint32_t)input.BytesUntilLimit())
+			{
+				dtFree(tile.data);
+				return NavMesh::LoadResult::Corrupt;
+			}
+
+			dtFree(tile.data);
+			tile.data = nullptr;
+			tile.dataSize = 0;
+
+			if (length == 0)
+				break;
 
-			std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
-				[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+			tile.data = (uint8_t*)dtAlloc((int)length, DT_ALLOC_PERM);
+			if (!tile.data)
+				return NavMesh::LoadResult::OutOfMemory;
 
-			// would prefer to have proper origin, but this can fix it up too.
-			params.orig[0] = proto.build_settings().bounds_min().x();
-			params.orig[1] = proto.build_settings().bounds_min().y();
-			params.orig[2] = proto.build_settings().bounds_min().z();
+			tile.dataSize = (int)length;
 
-			dtStatus status = navMesh->init(&params);
-			if (status == DT_SUCCESS)
+			if (!input.ReadRaw(tile.data, (int)length))
 			{
-				// read the mesh tiles and add them to the navmesh one by one.
-				for (const nav::NavMeshTile& tile : tileset.tiles())
-				{
-					dtTileRef ref = tile.tile_ref();
-					const std::string& tiledata = tile.tile_data();
+				dtFree(tile.data);
+				return NavMesh::LoadResult::Corrupt;
+			}
+			break;
+		}
+
+		default:
+			if (!WireFormatLite::SkipField(&input, tag))
+			{
+				dtFree(tile.data);
+				return NavMesh::LoadResult::Corrupt;
+			}
+			break;
+		}
+	}
+
+	if (tile.ref == 0 || tile.dataSize == 0)
+	{
+		dtFree(tile.data);
+		return NavMesh::LoadResult::Success;
+	}
+
+	out_tiles.push_back(tile);
+	return NavMesh::LoadResult::Success;
+}
+
+// Reads a NavMeshFile from a stream without holding the whole message in memory. Tile
+// data is read straight into dtAlloc'd buffers and returned in |out_tiles|, everything else
+// is parsed into |out_proto|. The caller owns the tile data, even if reading fails.
+static NavMesh::LoadResult ReadMeshFile(google::protobuf::io::ZeroCopyInputStream* stream,
+	nav::NavMeshFile& out_proto, std::vector<MeshFileTileData>& out_tiles)
+{
+	using google::protobuf::internal::WireFormatLite;
+
+	google::protobuf::io::CodedInputStream input(stream);
+
+	// everything that isn't in the tile set is small, so we collect those fields and
+	// parse them all at once.
+	std::string metadata;
+	google::protobuf::io::StringOutputStream metadataStream(&metadata);
+	google::protobuf::io::CodedOutputStream metadataOutput(&metadataStream);
+
+	while (uint32_t tag = input.ReadTag())
+	{
+		if (tag != WireFormatLite::MakeTag(nav::NavMeshFile::kTileSetFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+		{
+			if (!WireFormatLite::SkipField(&input, tag, &metadataOutput))
+				return NavMesh::LoadResult::Corrupt;
+			continue;
+		}
+
+		uint32_t length;
+		if (!input.ReadVarint32(&length))
+			return NavMesh::LoadResult::Corrupt;
 
-					if (ref == 0 || tiledata.length() == 0)
-						continue;
+		auto limit = input.PushLimit((int)length);
+		nav::NavMeshTileSet* tileset = out_proto.mutable_tile_set();
 
-					// allocate buffer for the data
-					uint8_t* data = (uint8_t*)dtAlloc((int)tiledata.length(), DT_ALLOC_PERM);
-					memcpy(data, &tiledata[0], tiledata.length());
+		while (uint32_t tilesetTag = input.ReadTag())
+		{
+			switch (tilesetTag)
+			{
+			case WireFormatLite::MakeTag(nav::NavMeshTileSet::kCompatibilityVersionFieldNumber, WireFormatLite::WIRETYPE_VARINT): {
+				uint32_t version;
+				if (!input.ReadVarint32(&version))
+					return NavMesh::LoadResult::Corrupt;
 
-					dtMeshHeader* tileheader = (dtMeshHeader*)data;
+				tileset->set_compatibility_version((int32_t)version);
+				break;
+			}
 
-					dtStatus status = navMesh->addTile(data, (int)tiledata.length(), DT_TILE_FREE_DATA, ref, nullptr);
-					if (status != DT_SUCCESS)
-					{
-						SPDLOG_WARN("Failed to read tile: {}, {} ({}) = {}",
-							tileheader->x, tileheader->y, tileheader->layer, status);
-					}
+			case WireFormatLite::MakeTag(nav::NavMeshTileSet::kMeshParamsFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED): {
+				std::string params;
+				if (!WireFormatLite::ReadBytes(&input, &params)
+					|| !tileset->mutable_mesh_params()->MergeFromString(params))
+				{
+					return NavMesh::LoadResult::Corrupt;
 				}
+				break;
+			}
+
+			case WireFormatLite::MakeTag(nav::NavMeshTileSet::kTilesFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED): {
+				uint32_t tileLength;
+				if (!input.ReadVarint32(&tileLength))
+					return NavMesh::LoadResult::Corrupt;
 
-				m_navMesh = std::move(navMesh);
+				auto tileLimit = input.PushLimit((int)tileLength);
+
+				NavMesh::LoadResult result = ReadMeshTile(input, out_tiles);
+				if (result != NavMesh::LoadResult::Success)
+					return result;
+
+				if (!input.ConsumedEntireMessage())
+					return NavMesh::LoadResult::Corrupt;
+
+				input.PopLimit(tileLimit);
+				break;
 			}
-			else
-			{
-				SPDLOG_ERROR("loadMesh: failed to initialize navmesh, will continue loading without tiles.");
+
+			default:
+				if (!WireFormatLite::SkipField(&input, tilesetTag))
+					return NavMesh::LoadResult::Corrupt;
+				break;
 			}
 		}
-		else
+
+		if (!input.ConsumedEntireMessage())
+			return NavMesh::LoadResult::Corrupt;
+
+		input.PopLimit(limit);
+	}
+
+	// ReadTag returns 0 at the end of the stream, or on a bad tag.
+	if (!input.ConsumedEntireMessage())
+		return NavMesh::LoadResult::Corrupt;
+
+	metadataOutput.Trim();
+	if (!out_proto.MergeFromString(metadata))
+		return NavMesh::LoadResult::Corrupt;
+
+	return NavMesh::LoadResult::Success;
+}
+
+void NavMesh::LoadFromProto(const nav::NavMeshFile& proto, PersistedDataFields fields)
+{
+	if (+(fields & PersistedDataFields::MeshTiles))
+	{
+		// read the tileset
+		const nav::NavMeshTileSet& tileset = proto.tile_set();
+
+		std::shared_ptr<dtNavMesh> navMesh = CreateNavMesh(proto,
+			[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+		if (navMesh)
 		{
-			SPDLOG_ERROR("loadMesh: navmesh has incompatible structure, will continue loading without tiles.");
+			// read the mesh tiles and add them to the navmesh one by one.
+			for (const nav::NavMeshTile& tile : tileset.tiles())
+			{
+				dtTileRef ref = tile.tile_ref();
+				const std::string& tiledata = tile.tile_data();
+
+				if (ref == 0 || tiledata.length() == 0)
+					continue;
+
+				// allocate buffer for the data
+				uint8_t* data = (uint8_t*)dtAlloc((int)tiledata.length(), DT_ALLOC_PERM);
+				memcpy(data, &tiledata[0], tiledata.length());
+
+				dtMeshHeader* tileheader = (dtMeshHeader*)data;
+
+				dtStatus status = navMesh->addTile(data, (int)tiledata.length(), DT_TILE_FREE_DATA, ref, nullptr);
+				if (status != DT_SUCCESS)
+				{
+					SPDLOG_WARN("Failed to read tile: {}, {} ({}) = {}",
+						tileheader->x, tileheader->y, tileheader->layer, status);
+				}
+			}
+
+			m_navMesh = std::move(navMesh);
 		}
 	}
 
@@ -565,6 +1002,10 @@ NavMesh::LoadResult NavMesh::LoadNavMeshFile()
 	}
 
 	m_lastLoadResult = LoadMesh(m_dataFile.c_str());
+	UpdateSearchGraphs();
+	StartFlowFieldBuild();
+
+	++m_generation;
 	OnNavMeshChanged();
 
 	return m_lastLoadResult;
@@ -573,49 +1014,208 @@ NavMesh::LoadResult NavMesh::LoadNavMeshFile()
 NavMesh::LoadResult NavMesh::LoadNavMeshFile(const std::string& filename)
 {
 	m_lastLoadResult = LoadMesh(filename.c_str());
+	UpdateSearchGraphs();
+	StartFlowFieldBuild();
+
+	++m_generation;
 	OnNavMeshChanged();
 
 	return m_lastLoadResult;
 }
 
-NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
+void NavMesh::TakeLoadedMesh(NavMesh& loaded)
 {
-	// cache the filename of the file we tried to load
-	m_dataFile = filename;
+	// Both sides change. The loaded instance can be in use too, eg. when the current
+	// navmesh is moved into the cache.
+	++m_generation;
+	OnNavMeshChanging();
+	++loaded.m_generation;
+	loaded.OnNavMeshChanging();
+
+	SetNavMesh(loaded.m_navMesh, true);
+
+	m_pendingMapping = std::move(loaded.m_pendingMapping);
+	m_pendingTiles = std::move(loaded.m_pendingTiles);
+	m_pendingCodec = loaded.m_pendingCodec;
+
+	TakeLoadedData(loaded);
+	UpdateSearchGraphs();
 
-	FILE* file = _fsopen(filename, "rb", _SH_DENYNO);
-	if (!file)
+	// The flow fields were built along with the loaded navmesh. One that was still
+	// being built is started again here.
+	bool wasBuilding = loaded.m_flowFieldBuild != nullptr;
+	loaded.CancelFlowFieldBuild();
+
+	m_flowFieldTargets = std::move(loaded.m_flowFieldTargets);
+	m_flowFields = std::move(loaded.m_flowFields);
+	loaded.m_flowFieldTargets.clear();
+
+	if (wasBuilding)
 	{
-		if (errno == ENOENT)
-			return LoadResult::MissingFile;
+		StartFlowFieldBuild();
+	}
 
-		return LoadResult::Corrupt;
+	loaded.SetNavMesh(nullptr, true);
+
+	++loaded.m_generation;
+	loaded.OnNavMeshChanged();
+	++m_generation;
+	OnNavMeshChanged();
+}
+
+void NavMesh::TakeLoadedData(NavMesh& loaded)
+{
+	m_zoneName = loaded.m_zoneName;
+	m_dataFile = loaded.m_dataFile;
+	m_lastLoadResult = loaded.m_lastLoadResult;
+	m_version = loaded.m_version;
+	m_contentHash = loaded.m_contentHash;
+	m_tileHashes = std::move(loaded.m_tileHashes);
+	m_tileCodec = loaded.m_tileCodec;
+
+	// a partial load has the components and portals of the whole file
+	m_polyConnectivity = std::move(loaded.m_polyConnectivity);
+	m_tileGraph = std::move(loaded.m_tileGraph);
+	m_landmarkTable = std::move(loaded.m_landmarkTable);
+
+	// a partial load doesn't have a grid, so it is built once the tiles are merged
+	m_polyGrid = m_polyGridEnabled ? std::move(loaded.m_polyGrid) : nullptr;
+
+	m_boundsMin = loaded.m_boundsMin;
+	m_boundsMax = loaded.m_boundsMax;
+	m_config = loaded.m_config;
+
+	m_volumes = std::move(loaded.m_volumes);
+	m_volumesById = std::move(loaded.m_volumesById);
+	m_nextVolumeId = loaded.m_nextVolumeId;
+
+	m_connections = std::move(loaded.m_connections);
+	m_connectionsById = std::move(loaded.m_connectionsById);
+	m_nextConnectionId = loaded.m_nextConnectionId;
+
+	// the area list points into the area array, so it needs to be rebuilt.
+	m_polyAreas = loaded.m_polyAreas;
+	m_polyAreaList.clear();
+
+	for (const PolyAreaType* area : loaded.m_polyAreaList)
+	{
+		m_polyAreaList.push_back(&m_polyAreas[area->id]);
+	}
+}
+
+void NavMesh::SetReloadBase(const NavMesh& base)
+{
+	m_reloadBaseHashes.clear();
+
+	// deferred tiles would still be read from the old file, so they can't be mixed
+	// with tiles from the new one.
+	if (!base.m_navMesh || base.HasPendingTiles() || base.m_tileHashes.empty())
+		return;
+
+	m_reloadBaseParams = *base.m_navMesh->getParams();
+	m_reloadBaseHashes = base.m_tileHashes;
+}
+
+bool NavMesh::MergeChangedTiles(NavMesh& loaded)
+{
+	if (!loaded.m_partialLoad || !loaded.m_navMesh || !m_navMesh || HasPendingTiles()
+		|| m_tileHashes != loaded.m_reloadBaseHashes
+		|| memcmp(m_navMesh->getParams(), loaded.m_navMesh->getParams(), sizeof(dtNavMeshParams)) != 0)
+	{
+		return false;
 	}
 
-	scope_guard g = [file]() { fclose(file); };
+	++m_generation;
+	OnNavMeshChanging();
+	CancelFlowFieldBuild();
 
-	// read the whole file
-	size_t filesize = 0;
-	fseek(file, 0, SEEK_END);
-	filesize = ftell(file);
-	rewind(file);
+	// remove tiles that were changed or deleted
+	int removed = 0;
+	for (const auto& [tileRef, hash] : m_tileHashes)
+	{
+		auto iter = loaded.m_tileHashes.find(tileRef);
+		if (iter == loaded.m_tileHashes.end() || iter->second != hash)
+		{
+			m_navMesh->removeTile(tileRef, nullptr, nullptr);
+			++removed;
+		}
+	}
 
-	if (filesize <= sizeof(MeshFileHeader))
+	// The loaded navmesh only has the tiles that changed. Their data is copied, because it
+	// belongs to the loaded navmesh, or to its mapping of the file.
+	int added = 0;
+	const dtNavMesh* source = loaded.m_navMesh.get();
+
+	for (int i = 0; i < source->getMaxTiles(); ++i)
 	{
-		SPDLOG_ERROR("loadMesh: mesh file is not a valid mesh file");
-		return LoadResult::Corrupt;
+		const dtMeshTile* tile = source->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize) continue;
+
+		uint8_t* data = (uint8_t*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+		if (!data)
+		{
+			SPDLOG_ERROR("Out of memory copying tile: {}, {} ({})", tile->header->x, tile->header->y, tile->header->layer);
+			continue;
+		}
+
+		memcpy(data, tile->data, tile->dataSize);
+
+		dtStatus status = m_navMesh->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, source->getTileRef(tile), nullptr);
+		if (status != DT_SUCCESS)
+		{
+			SPDLOG_WARN("Failed to replace tile: {}, {} ({}) = {}",
+				tile->header->x, tile->header->y, tile->header->layer, status);
+
+			dtFree(data);
+			continue;
+		}
+
+		++added;
 	}
 
-	std::unique_ptr<char[]> buffer(new char[filesize]);
-	size_t result = fread(buffer.get(), filesize, 1, file);
-	if (result != 1)
+	SPDLOG_DEBUG("Reloaded navmesh tiles: {} removed, {} added", removed, added);
+
+	TakeLoadedData(loaded);
+	UpdateSearchGraphs();
+
+	// the flow fields are for the tiles that were replaced
+	m_flowFields.reset();
+	StartFlowFieldBuild();
+
+	loaded.SetNavMesh(nullptr, true);
+
+	++m_generation;
+	OnNavMeshChanged();
+	return true;
+}
+
+NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
+{
+	// cache the filename of the file we tried to load
+	m_dataFile = filename;
+	m_contentHash = 0;
+	m_tileHashes.clear();
+	m_partialLoad = false;
+
+	auto mapping = std::make_shared<MappedFile>();
+
+	MappedFile::MapResult mapResult = mapping->Map(filename);
+	if (mapResult == MappedFile::MapResult::MissingFile)
+		return LoadResult::MissingFile;
+	if (mapResult != MappedFile::MapResult::Success)
 	{
 		SPDLOG_ERROR("loadMesh: failed to read contents of mesh file");
 		return LoadResult::Corrupt;
 	}
 
-	char* data_ptr = buffer.get();
-	size_t data_size = filesize;
+	char* data_ptr = reinterpret_cast<char*>(mapping->GetData());
+	size_t data_size = mapping->GetSize();
+
+	if (data_size <= sizeof(MeshFileHeader))
+	{
+		SPDLOG_ERROR("loadMesh: mesh file is not a valid mesh file");
+		return LoadResult::Corrupt;
+	}
 
 	// read header
 	MeshFileHeader* fileHeader = (MeshFileHeader*)data_ptr;
@@ -630,11 +1230,16 @@ NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
 		return LoadResult::Corrupt;
 	}
 
+	if (headerVersion == (uint16_t)NavMeshHeaderVersion::Version6)
+	{
+		return LoadMeshV6(mapping);
+	}
+
 	if (headerVersion == (uint16_t)NavMeshHeaderVersion::Version4)
 	{
 		headerSize = sizeof(MeshFileHeader);
 	}
-	else if (headerVersion >= (uint16_t)NavMeshHeaderVersion::Version5)
+	else if (headerVersion == (uint16_t)NavMeshHeaderVersion::Version5)
 	{
 		MeshFileHeaderV5* fileHeaderV5 = (MeshFileHeaderV5*)data_ptr;
 
@@ -647,60 +1252,754 @@ NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
 		return LoadResult::VersionMismatch;
 	}
 
+	if (headerSize >= data_size)
+	{
+		SPDLOG_ERROR("loadMesh: mesh file is not a valid mesh file");
+		return LoadResult::Corrupt;
+	}
+
 	data_ptr += headerSize; data_size -= headerSize;
 
-	bool compressed = +(fileHeader->flags & NavMeshFileFlags::COMPRESSED) != 0;
-	nav::NavMeshFile file_proto;
+	bool compressed = +(fileHeader->flags & NavMeshFileFlags::COMPRESSED) != 0;
+
+	// Parse the file as a stream so that tile data goes directly into its final allocation,
+	// instead of through a decompressed copy of the file and a copy in the parsed message.
+	std::unique_ptr<google::protobuf::io::ZeroCopyInputStream> stream;
+	if (compressed)
+		stream = std::make_unique<InflateInputStream>(data_ptr, data_size);
+	else
+		stream = std::make_unique<google::protobuf::io::ArrayInputStream>(data_ptr, (int)data_size);
+
+	nav::NavMeshFile file_proto;
+	std::vector<MeshFileTileData> tiles;
+
+	scope_guard freeTiles([&tiles]()
+	{
+		for (const MeshFileTileData& tile : tiles)
+			dtFree(tile.data);
+	});
+
+	LoadResult result = ReadMeshFile(stream.get(), file_proto, tiles);
+	if (compressed && static_cast<InflateInputStream*>(stream.get())->Failed())
+		result = LoadResult::Corrupt;
+
+	if (result != LoadResult::Success)
+	{
+		if (result == LoadResult::OutOfMemory)
+			SPDLOG_ERROR("loadMesh: out of memory while reading mesh file");
+		else
+			SPDLOG_ERROR("loadMesh: failed to parse mesh file");
+		return result;
+	}
+
+	if (uncompressedSize != 0 && stream->ByteCount() != uncompressedSize)
+	{
+		SPDLOG_ERROR("loadMesh: mesh file has the wrong size");
+		return LoadResult::Corrupt;
+	}
+
+	stream.reset();
+	mapping.reset();
+
+	if (m_zoneName.empty())
+	{
+		m_zoneName = file_proto.zone_short_name();
+	}
+	else if (file_proto.zone_short_name() != m_zoneName)
+	{
+		SPDLOG_ERROR("loadMesh: zone name mismatch! mesh is for '{}'", file_proto.zone_short_name());
+		return LoadResult::ZoneMismatch;
+	}
+
+	m_version = static_cast<NavMeshHeaderVersion>(headerVersion);
+
+	ResetSavedData(PersistedDataFields::All);
+	LoadFromProto(file_proto, PersistedDataFields::All & ~PersistedDataFields::MeshTiles);
+
+	std::shared_ptr<dtNavMesh> navMesh = CreateNavMesh(file_proto,
+		[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+	if (navMesh)
+	{
+		// the navmesh takes ownership of the tile data once it has been added.
+		for (MeshFileTileData& tile : tiles)
+		{
+			dtStatus status = navMesh->addTile(tile.data, tile.dataSize, DT_TILE_FREE_DATA, tile.ref, nullptr);
+			if (status != DT_SUCCESS)
+			{
+				const dtMeshHeader* tileheader = (const dtMeshHeader*)tile.data;
+
+				SPDLOG_WARN("Failed to read tile: {}, {} ({}) = {}",
+					tileheader->x, tileheader->y, tileheader->layer, status);
+				continue;
+			}
+
+			tile.data = nullptr;
+		}
+
+		m_navMesh = std::move(navMesh);
+	}
+
+	return LoadResult::Success;
+}
+
+NavMesh::LoadResult NavMesh::LoadMeshV6(const std::shared_ptr<MappedFile>& mapping)
+{
+	const uint8_t* file_ptr = mapping->GetData();
+	size_t file_size = mapping->GetSize();
+
+	if (file_size < sizeof(MeshFileHeaderV6))
+	{
+		SPDLOG_ERROR("loadMesh: mesh file is not a valid mesh file");
+		return LoadResult::Corrupt;
+	}
+
+	const MeshFileHeaderV6* fileHeader = (const MeshFileHeaderV6*)file_ptr;
+
+	// headerSize and tileEntrySize allow for these structures to grow, but they may never shrink.
+	if (fileHeader->headerSize < sizeof(MeshFileHeaderV6)
+		|| fileHeader->headerSize > file_size
+		|| fileHeader->tileEntrySize < sizeof(MeshFileTileEntry))
+	{
+		SPDLOG_ERROR("loadMesh: mesh file has an invalid header");
+		return LoadResult::Corrupt;
+	}
+
+	uint64_t directorySize = (uint64_t)fileHeader->tileCount * fileHeader->tileEntrySize;
+	if (fileHeader->tileDirectoryOffset > file_size
+		|| directorySize > file_size - fileHeader->tileDirectoryOffset
+		|| fileHeader->metadataOffset > file_size
+		|| fileHeader->metadataSize > file_size - fileHeader->metadataOffset)
+	{
+		SPDLOG_ERROR("loadMesh: mesh file is truncated");
+		return LoadResult::Corrupt;
+	}
+
+	// the metadata contains everything except for the tile data.
+	nav::NavMeshFile file_proto;
+	if (!file_proto.ParseFromArray(file_ptr + fileHeader->metadataOffset, (int)fileHeader->metadataSize))
+	{
+		SPDLOG_ERROR("loadMesh: failed to parse mesh file");
+		return LoadResult::Corrupt;
+	}
+
+	if (m_zoneName.empty())
+	{
+		m_zoneName = file_proto.zone_short_name();
+	}
+	else if (file_proto.zone_short_name() != m_zoneName)
+	{
+		SPDLOG_ERROR("loadMesh: zone name mismatch! mesh is for '{}'", file_proto.zone_short_name());
+		return LoadResult::ZoneMismatch;
+	}
+
+	m_version = NavMeshHeaderVersion::Version6;
+	m_contentHash = fileHeader->contentHash;
+
+	ResetSavedData(PersistedDataFields::All);
+	LoadFromProto(file_proto, PersistedDataFields::All & ~PersistedDataFields::MeshTiles);
+
+	NavMeshCodec codec = NavMeshCodec::None;
+	if (+(fileHeader->flags & NavMeshFileFlags::COMPRESSED))
+	{
+		codec = fileHeader->codec;
+
+		if (codec == NavMeshCodec::None || codec > NavMeshCodec::Last)
+		{
+			SPDLOG_ERROR("loadMesh: mesh file uses an unsupported codec: {}", static_cast<uint32_t>(codec));
+			return LoadResult::VersionMismatch;
+		}
+	}
+
+	bool compressed = codec != NavMeshCodec::None;
+	m_tileCodec = codec;
+
+	// Uncompressed tiles reference memory inside of the mapping, so it needs to stay alive for
+	// as long as the navmesh does. Compressed tiles are copied out of the mapping, so we only
+	// need it until all of the tiles have been loaded.
+	std::shared_ptr<dtNavMesh> navMesh;
+	if (compressed)
+		navMesh = CreateNavMesh(file_proto, [](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+	else
+		navMesh = CreateNavMesh(file_proto, [mapping](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+
+	if (!navMesh)
+	{
+		// continue loading without tiles, same as older versions.
+		return LoadResult::Success;
+	}
+
+	m_navMesh = std::move(navMesh);
+
+	if (file_proto.has_components())
+	{
+		m_polyConnectivity = FromProto(file_proto.components(), *m_navMesh);
+	}
+
+	if (file_proto.has_tile_graph())
+	{
+		m_tileGraph = FromProto(file_proto.tile_graph(), *m_navMesh);
+	}
+
+	if (file_proto.has_landmarks())
+	{
+		m_landmarkTable = FromProto(file_proto.landmarks(), *m_navMesh);
+	}
+
+	// distance from the load focus to the bounds of a tile, in the xz plane.
+	const dtNavMeshParams* params = m_navMesh->getParams();
+	auto distanceToTile = [&](const MeshFileTileEntry& entry)
+	{
+		float minx = params->orig[0] + entry.x * params->tileWidth;
+		float minz = params->orig[2] + entry.y * params->tileHeight;
+
+		float dx = std::max({ minx - m_loadFocus.x, m_loadFocus.x - (minx + params->tileWidth), 0.0f });
+		float dz = std::max({ minz - m_loadFocus.z, m_loadFocus.z - (minz + params->tileHeight), 0.0f });
+
+		return sqrtf(dx * dx + dz * dz);
+	};
+
+	// When reloading a file that is already loaded somewhere else, only the tiles that are
+	// different from the loaded ones need to be read.
+	m_partialLoad = !m_reloadBaseHashes.empty()
+		&& memcmp(params, &m_reloadBaseParams, sizeof(dtNavMeshParams)) == 0;
+
+	std::vector<MeshFileTileEntry> tiles;
+	std::vector<MeshFileTileEntry> deferredTiles;
+	size_t unchangedTiles = 0;
+
+	for (uint32_t i = 0; i < fileHeader->tileCount; ++i)
+	{
+		MeshFileTileEntry entry;
+		memcpy(&entry, file_ptr + fileHeader->tileDirectoryOffset + (uint64_t)i * fileHeader->tileEntrySize,
+			sizeof(MeshFileTileEntry));
+
+		if (entry.tileRef == 0 || entry.dataSize == 0)
+			continue;
+
+		if (entry.offset > file_size
+			|| entry.storedSize > file_size - entry.offset
+			|| (!compressed && entry.storedSize != entry.dataSize)
+			|| (!compressed && entry.offset % NAVMESH_TILE_ALIGNMENT != 0))
+		{
+			SPDLOG_WARN("Skipping tile with invalid location: {}, {} ({})", entry.x, entry.y, entry.layer);
+			continue;
+		}
+
+		m_tileHashes[entry.tileRef] = entry.dataHash;
+
+		if (m_partialLoad)
+		{
+			auto iter = m_reloadBaseHashes.find(entry.tileRef);
+			if (iter != m_reloadBaseHashes.end() && iter->second == entry.dataHash)
+			{
+				++unchangedTiles;
+				continue;
+			}
+		}
+
+		// changed tiles are loaded right away, there shouldn't be many of them.
+		if (!m_partialLoad && m_loadFocusRadius > 0.0f && distanceToTile(entry) > m_loadFocusRadius)
+		{
+			deferredTiles.push_back(entry);
+			continue;
+		}
+
+		tiles.push_back(entry);
+	}
+
+	if (m_partialLoad)
+	{
+		SPDLOG_DEBUG("loadMesh: {} tiles changed, {} tiles unchanged", tiles.size(), unchangedTiles);
+	}
+
+	AddTilesFromFile(*mapping, tiles, codec);
+
+	if (!deferredTiles.empty())
+	{
+		SPDLOG_DEBUG("loadMesh: deferring {} of {} tiles", deferredTiles.size(), fileHeader->tileCount);
+
+		// sort furthest first, so that the nearest tiles can be popped off of the end.
+		std::sort(deferredTiles.begin(), deferredTiles.end(),
+			[&](const MeshFileTileEntry& a, const MeshFileTileEntry& b)
+			{
+				return distanceToTile(a) > distanceToTile(b);
+			});
+
+		m_pendingTiles = std::move(deferredTiles);
+		m_pendingMapping = mapping;
+		m_pendingCodec = codec;
+	}
+
+	return LoadResult::Success;
+}
+
+// Reads the data for a tile out of the file, decompressing it if necessary. Compressed tiles
+// are decompressed into a new buffer that must be freed with dtFree. Safe to call from any thread.
+static uint8_t* DecodeTile(const MappedFile& mapping, const MeshFileTileEntry& entry, NavMeshCodec codec)
+{
+	uint8_t* data = mapping.GetData() + entry.offset;
+	bool compressed = codec != NavMeshCodec::None;
+
+	if (compressed)
+	{
+		uint8_t* fileData = data;
+
+		data = (uint8_t*)dtAlloc((int)entry.dataSize, DT_ALLOC_PERM);
+		if (!data)
+		{
+			SPDLOG_ERROR("Out of memory reading tile: {}, {} ({})", entry.x, entry.y, entry.layer);
+			return nullptr;
+		}
+
+		if (!DecompressBuffer(codec, fileData, entry.storedSize, data, entry.dataSize))
+		{
+			SPDLOG_WARN("Failed to decompress tile: {}, {} ({})", entry.x, entry.y, entry.layer);
+			dtFree(data);
+			return nullptr;
+		}
+	}
+
+	const dtMeshHeader* tileHeader = (const dtMeshHeader*)data;
+	if (entry.dataSize < sizeof(dtMeshHeader)
+		|| tileHeader->magic != DT_NAVMESH_MAGIC
+		|| tileHeader->version != DT_NAVMESH_VERSION)
+	{
+		SPDLOG_WARN("Tile has an invalid header: {}, {} ({})", entry.x, entry.y, entry.layer);
+
+		if (compressed)
+			dtFree(data);
+		return nullptr;
+	}
+
+	return data;
+}
+
+bool NavMesh::AddTileData(const MeshFileTileEntry& entry, uint8_t* data, NavMeshCodec codec)
+{
+	bool compressed = codec != NavMeshCodec::None;
+
+	// Uncompressed tile data is added without DT_TILE_FREE_DATA. Detour writes link data into
+	// the tile, which lands in copy-on-write pages of the mapping.
+	int flags = compressed ? DT_TILE_FREE_DATA : 0;
+
+	dtStatus status = m_navMesh->addTile(data, (int)entry.dataSize, flags, entry.tileRef, nullptr);
+	if (status != DT_SUCCESS)
+	{
+		SPDLOG_WARN("Failed to read tile: {}, {} ({}) = {}",
+			entry.x, entry.y, entry.layer, status);
+
+		if (compressed)
+			dtFree(data);
+		return false;
+	}
+
+	return true;
+}
+
+bool NavMesh::AddTileFromFile(const MappedFile& mapping, const MeshFileTileEntry& entry, NavMeshCodec codec)
+{
+	uint8_t* data = DecodeTile(mapping, entry, codec);
+	if (!data)
+		return false;
+
+	return AddTileData(entry, data, codec);
+}
+
+void NavMesh::AddTilesFromFile(const MappedFile& mapping, const std::vector<MeshFileTileEntry>& entries,
+	NavMeshCodec codec)
+{
+	// Only decompression benefits from extra threads, uncompressed tiles are just page faults.
+	int threadCount = std::min(m_loadThreadCount, (int)entries.size());
+	if (codec == NavMeshCodec::None || threadCount <= 1)
+	{
+		for (const MeshFileTileEntry& entry : entries)
+		{
+			AddTileFromFile(mapping, entry, codec);
+		}
+
+		return;
+	}
+
+	// Decompress and validate tiles on worker threads. Linking tiles into the navmesh is not
+	// thread safe, so they are added once all of the work is done.
+	std::vector<uint8_t*> tileData(entries.size(), nullptr);
+	std::atomic<size_t> nextTile = 0;
+
+	auto decodeTiles = [&]()
+	{
+		for (size_t i = nextTile++; i < entries.size(); i = nextTile++)
+		{
+			tileData[i] = DecodeTile(mapping, entries[i], codec);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount - 1);
+
+	for (int i = 1; i < threadCount; ++i)
+	{
+		workers.emplace_back(decodeTiles);
+	}
+
+	decodeTiles();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (tileData[i])
+		{
+			AddTileData(entries[i], tileData[i], codec);
+		}
+	}
+}
+
+void NavMesh::SetLoadThreadCount(int threadCount)
+{
+	m_loadThreadCount = std::max(threadCount, 1);
+}
+
+void NavMesh::SetLoadFocus(const glm::vec3& pos, float radius)
+{
+	m_loadFocus = pos;
+	m_loadFocusRadius = radius;
+}
+
+void NavMesh::ClearLoadFocus()
+{
+	m_loadFocus = glm::vec3();
+	m_loadFocusRadius = 0.0f;
+}
+
+int NavMesh::LoadPendingTiles(std::chrono::microseconds budget)
+{
+	if (m_pendingTiles.empty())
+		return 0;
+
+	auto startTime = std::chrono::steady_clock::now();
+	int loaded = 0;
+
+	++m_generation;
+	OnNavMeshChanging();
+
+	do
+	{
+		AddTileFromFile(*m_pendingMapping, m_pendingTiles.back(), m_pendingCodec);
+		m_pendingTiles.pop_back();
+		++loaded;
+	} while (!m_pendingTiles.empty() && std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - startTime) < budget);
+
+	if (m_pendingTiles.empty())
+	{
+		ClearPendingTiles();
+		UpdateSearchGraphs();
+		StartFlowFieldBuild();
+
+		SPDLOG_DEBUG("Finished loading deferred tiles");
+		++m_generation;
+		OnNavMeshChanged();
+	}
+
+	return loaded;
+}
+
+void NavMesh::UpdateSearchGraphs()
+{
+	// Regions that are joined by tiles that haven't been loaded yet would look like
+	// they are separate, so this waits until everything is there.
+	if (!m_navMesh || m_partialLoad || !m_pendingTiles.empty())
+		return;
+
+	if (!m_polyConnectivity)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+
+		auto connectivity = std::make_shared<PolyConnectivity>();
+		connectivity->Build(*m_navMesh, +PolyFlags::Disabled);
+
+		SPDLOG_DEBUG("Found {} connected regions in {}ms", connectivity->GetComponentCount(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+		m_polyConnectivity = std::move(connectivity);
+	}
+
+	if (!m_tileGraph)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+
+		auto graph = std::make_shared<TileGraph>();
+		graph->Build(*m_navMesh, MakeSearchGraphFilter());
+
+		SPDLOG_DEBUG("Found {} tile portals in {}ms", graph->GetPortals().size(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+		m_tileGraph = std::move(graph);
+	}
+
+	if (!m_polyGrid)
+	{
+		UpdatePolyGrid();
+	}
+}
+
+dtQueryFilter NavMesh::MakeSearchGraphFilter()
+{
+	dtQueryFilter filter;
+	filter.setIncludeFlags(+PolyFlags::All);
+	filter.setExcludeFlags(+PolyFlags::Disabled);
+	FillFilterAreaCosts(filter);
+
+	return filter;
+}
+
+void NavMesh::SetPolyGridEnabled(bool enabled)
+{
+	if (m_polyGridEnabled == enabled)
+		return;
+
+	m_polyGridEnabled = enabled;
+	m_polyGrid.reset();
+	UpdateSearchGraphs();
+
+	OnNavMeshChanged();
+}
+
+void NavMesh::UpdatePolyGrid()
+{
+	if (!m_polyGridEnabled || !m_navMesh)
+	{
+		m_polyGrid.reset();
+		return;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	auto grid = std::make_shared<PolyGrid>();
+	grid->Build(*m_navMesh);
+
+	SPDLOG_DEBUG("Built {}x{} polygon grid with {} entries in {}ms", grid->GetWidth(), grid->GetHeight(),
+		grid->GetEntryCount(),
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+	m_polyGrid = std::move(grid);
+}
+
+//----------------------------------------------------------------------------
+
+static bool LoadFlowFieldFile(const std::string& filename, uint64_t contentHash, const dtNavMesh& navMesh,
+	FlowFieldSet& flowFields)
+{
+	if (filename.empty())
+		return false;
+
+	std::ifstream infile(filename, std::ios::binary);
+	if (!infile.is_open())
+		return false;
+
+	nav::FlowFieldFile file_proto;
+	if (!file_proto.ParseFromIstream(&infile))
+	{
+		SPDLOG_WARN("Flow field file is corrupt: {}", filename);
+		return false;
+	}
+
+	// built for a different version of the navmesh
+	if (file_proto.content_hash() != contentHash)
+		return false;
+
+	for (const nav::FlowField& field : file_proto.fields())
+	{
+		flowFields.AddField(FromProto(field, navMesh));
+	}
+
+	SPDLOG_DEBUG("Loaded {} flow fields from {}", file_proto.fields_size(), filename);
+	return true;
+}
+
+static bool SaveFlowFieldFile(const std::string& filename, uint64_t contentHash, const FlowFieldSet& flowFields)
+{
+	if (filename.empty())
+		return false;
+
+	nav::FlowFieldFile file_proto;
+	file_proto.set_content_hash(contentHash);
 
-	if (compressed)
+	for (const FlowField& field : flowFields.GetFields())
 	{
-		try
-		{
-			std::vector<uint8_t> data;
-			if (!DecompressMemory(data_ptr, data_size, data, uncompressedSize))
-			{
-				SPDLOG_ERROR("loadMesh: failed to decompress mesh file");
-				return LoadResult::Corrupt;
-			}
+		ToProto(*file_proto.add_fields(), field);
+	}
 
-			buffer.reset();
+	std::ofstream outfile(filename, std::ios::binary | std::ios::trunc);
+	if (!outfile.is_open() || !file_proto.SerializeToOstream(&outfile))
+	{
+		SPDLOG_WARN("Failed to save flow fields: {}", filename);
+		return false;
+	}
 
-			if (!file_proto.ParseFromArray(&data[0], (int)data.size()))
-			{
-				SPDLOG_ERROR("loadMesh: failed to parse mesh file");
-				return LoadResult::Corrupt;
-			}
-		}
-		catch (const std::bad_alloc&)
-		{
-			return LoadResult::OutOfMemory;
-		}
+	return true;
+}
+
+void NavMesh::FlowFieldBuild::Run()
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	if (loadFile)
+	{
+		LoadFlowFieldFile(fileName, contentHash, *navMesh, *flowFields);
 	}
-	else
+
+	int built = flowFields->Update(*navMesh, *query.get(), filter, targets, &cancelled);
+	if (built > 0)
+	{
+		SPDLOG_DEBUG("Built {} flow fields in {}ms", built,
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+		SaveFlowFieldFile(fileName, contentHash, *flowFields);
+	}
+
+	// the pool is shared with the game thread, so give the query back right away
+	query.Release();
+	complete = true;
+}
+
+void NavMesh::SetFlowFieldTargets(std::vector<FlowFieldTarget> targets)
+{
+	if (targets == m_flowFieldTargets)
+		return;
+
+	m_flowFieldTargets = std::move(targets);
+
+	if (m_flowFieldTargets.empty())
 	{
-		if (!file_proto.ParseFromArray(data_ptr, (int)data_size))
+		CancelFlowFieldBuild();
+
+		if (m_flowFields)
 		{
-			SPDLOG_ERROR("loadMesh: failed to parse mesh file");
-			return LoadResult::Corrupt;
+			m_flowFields.reset();
+			OnNavMeshChanged();
 		}
+
+		return;
 	}
 
-	if (m_zoneName.empty())
+	StartFlowFieldBuild();
+}
+
+void NavMesh::BuildFlowFields(std::vector<FlowFieldTarget> targets)
+{
+	CancelFlowFieldBuild();
+
+	bool hadFlowFields = m_flowFields != nullptr;
+	m_flowFieldTargets = std::move(targets);
+
+	if (std::unique_ptr<FlowFieldBuild> build = CreateFlowFieldBuild())
 	{
-		m_zoneName = file_proto.zone_short_name();
+		build->Run();
+		m_flowFields = std::move(build->flowFields);
 	}
-	else if (file_proto.zone_short_name() != m_zoneName)
+	else if (m_flowFieldTargets.empty())
 	{
-		SPDLOG_ERROR("loadMesh: zone name mismatch! mesh is for '{}'", file_proto.zone_short_name());
-		return LoadResult::ZoneMismatch;
+		m_flowFields.reset();
 	}
 
-	m_version = static_cast<NavMeshHeaderVersion>(headerVersion);
+	if (hadFlowFields || m_flowFields)
+	{
+		OnNavMeshChanged();
+	}
+}
 
-	ResetSavedData(PersistedDataFields::All);
-	LoadFromProto(file_proto, PersistedDataFields::All);
+void NavMesh::WaitForFlowFields()
+{
+	if (m_flowFieldBuild)
+	{
+		FinishFlowFieldBuild();
+	}
+}
 
-	return LoadResult::Success;
+std::unique_ptr<NavMesh::FlowFieldBuild> NavMesh::CreateFlowFieldBuild()
+{
+	// a field only covers the tiles that were there when it was built
+	if (m_flowFieldTargets.empty() || !m_navMesh || m_partialLoad || !m_pendingTiles.empty())
+		return nullptr;
+
+	auto build = std::make_unique<FlowFieldBuild>();
+	build->query = AcquireNavMeshQuery();
+	if (!build->query)
+		return nullptr;
+
+	build->navMesh = m_navMesh;
+	build->filter = MakeSearchGraphFilter();
+	build->targets = m_flowFieldTargets;
+	build->fileName = GetFlowFieldFileName();
+	build->contentHash = m_contentHash;
+
+	// fields that are already there are kept if their targets haven't moved
+	if (m_flowFields)
+	{
+		build->flowFields = std::make_shared<FlowFieldSet>(*m_flowFields);
+	}
+	else
+	{
+		build->flowFields = std::make_shared<FlowFieldSet>();
+		build->loadFile = true;
+	}
+
+	return build;
+}
+
+void NavMesh::StartFlowFieldBuild()
+{
+	CancelFlowFieldBuild();
+
+	m_flowFieldBuild = CreateFlowFieldBuild();
+	if (m_flowFieldBuild)
+	{
+		FlowFieldBuild* build = m_flowFieldBuild.get();
+		m_flowFieldBuild->thread = std::thread([build]() { build->Run(); });
+	}
+}
+
+void NavMesh::CancelFlowFieldBuild()
+{
+	// waits for the build to notice
+	m_flowFieldBuild.reset();
+}
+
+void NavMesh::FinishFlowFieldBuild()
+{
+	std::unique_ptr<FlowFieldBuild> build = std::move(m_flowFieldBuild);
+	build->thread.join();
+
+	m_flowFields = std::move(build->flowFields);
+	OnNavMeshChanged();
+}
+
+std::string NavMesh::GetFlowFieldFileName() const
+{
+	// the content hash is what tells us that the fields still match the navmesh
+	if (m_dataFile.empty() || m_contentHash == 0)
+		return std::string();
+
+	fs::path path = m_dataFile;
+	path.replace_extension(FLOWFIELD_FILE_EXTENSION);
+
+	return path.string();
+}
+
+void NavMesh::LoadAllPendingTiles()
+{
+	LoadPendingTiles(std::chrono::microseconds::max());
+}
+
+void NavMesh::ClearPendingTiles()
+{
+	m_pendingTiles.clear();
+	m_pendingTiles.shrink_to_fit();
+	m_pendingMapping.reset();
 }
 
 bool NavMesh::SaveNavMeshFile()
@@ -729,7 +2028,8 @@ bool NavMesh::SaveMeshV4(const char* filename)
 	if (!outfile.is_open())
 		return false;
 
-	// todo: Configuration
+	// version 4 and 5 files are always compressed with zlib. Other codecs are only
+	// supported by version 6.
 	bool compress = true;
 
 	// Build the NavMeshFile proto
@@ -744,9 +2044,9 @@ bool NavMesh::SaveMeshV4(const char* filename)
 	header.magic = NAVMESH_FILE_MAGIC;
 	header.version = (uint16_t)NavMeshHeaderVersion::Version4;
 	header.flags = NavMeshFileFlags{};
-	outfile.write((const char*)&header, sizeof(header));
 
 	if (compress) header.flags |= NavMeshFileFlags::COMPRESSED;
+	outfile.write((const char*)&header, sizeof(header));
 
 	if (compress)
 	{
@@ -764,6 +2064,8 @@ bool NavMesh::SaveMeshV4(const char* filename)
 	}
 
 	m_version = NavMeshHeaderVersion::Version4;
+	m_contentHash = 0;
+	m_tileHashes.clear();
 	outfile.close();
 	return true;
 }
@@ -779,7 +2081,8 @@ bool NavMesh::SaveMeshV5(const char* filename)
 	if (!outfile.is_open())
 		return false;
 
-	// todo: Configuration
+	// version 4 and 5 files are always compressed with zlib. Other codecs are only
+	// supported by version 6.
 	bool compress = true;
 
 	// Build the NavMeshFile proto
@@ -820,18 +2123,329 @@ bool NavMesh::SaveMeshV5(const char* filename)
 	}
 
 	m_version = NavMeshHeaderVersion::Version5;
+	m_contentHash = 0;
+	m_tileHashes.clear();
+	outfile.close();
+	return true;
+}
+
+// Hashes the parts of a tile's data that describe its geometry. Detour fills in the links when
+// a tile is added to a navmesh, and they depend on which neighbors were loaded at the time, so
+// they are left out.
+static uint64_t HashTileData(const uint8_t* data, int dataSize)
+{
+	const dtMeshHeader* header = reinterpret_cast<const dtMeshHeader*>(data);
+	if (dataSize < (int)sizeof(dtMeshHeader))
+		return fnv1a64(data, dataSize);
+
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(sizeof(float) * 3 * header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly) * header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink) * header->maxLinkCount);
+
+	const int polysOffset = headerSize + vertsSize;
+	const int linksOffset = polysOffset + polysSize;
+	if (header->vertCount < 0 || header->polyCount < 0 || header->maxLinkCount < 0
+		|| linksOffset + linksSize > dataSize)
+	{
+		return fnv1a64(data, dataSize);
+	}
+
+	// header and vertices
+	uint64_t hash = fnv1a64(data, polysOffset);
+
+	// polygons, except for their first link
+	const dtPoly* polys = reinterpret_cast<const dtPoly*>(data + polysOffset);
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		hash = fnv1a64(polys[i].verts, sizeof(dtPoly) - offsetof(dtPoly, verts), hash);
+	}
+
+	// detail meshes, bv tree and off-mesh connections
+	return fnv1a64(data + linksOffset + linksSize, dataSize - (linksOffset + linksSize), hash);
+}
+
+bool NavMesh::SaveMeshV6(const char* filename)
+{
+	if (!m_navMesh)
+	{
+		return false;
+	}
+
+	std::ofstream outfile(filename, std::ios::binary | std::ios::trunc);
+	if (!outfile.is_open())
+		return false;
+
+	// Build the metadata proto. This is everything except for the tiles, which are
+	// written out separately.
+
+	nav::NavMeshFile file_proto;
+	file_proto.set_zone_short_name(m_zoneName);
+
+	SaveToProto(file_proto, PersistedDataFields::All & ~PersistedDataFields::MeshTiles);
+
+	nav::NavMeshTileSet* tileset = file_proto.mutable_tile_set();
+	tileset->set_compatibility_version(NAVMESH_TILE_COMPAT_VERSION);
+	ToProto(*tileset->mutable_mesh_params(), m_navMesh->getParams());
+
+	// worked out from the tiles that are saved, they may have been changed directly
+	auto connectivity = std::make_shared<PolyConnectivity>();
+	connectivity->Build(*m_navMesh, +PolyFlags::Disabled);
+	ToProto(*file_proto.mutable_components(), *connectivity);
+
+	auto tileGraph = std::make_shared<TileGraph>();
+	tileGraph->Build(*m_navMesh, MakeSearchGraphFilter());
+	ToProto(*file_proto.mutable_tile_graph(), *tileGraph);
+
+	std::shared_ptr<LandmarkTable> landmarkTable;
+	if (m_config.landmarkCount > 0)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+
+		landmarkTable = std::make_shared<LandmarkTable>();
+		landmarkTable->Build(*m_navMesh, MakeSearchGraphFilter(), m_config.landmarkCount, connectivity.get());
+		ToProto(*file_proto.mutable_landmarks(), *landmarkTable);
+
+		SPDLOG_DEBUG("Built search costs for {} landmarks in {}ms", landmarkTable->GetLandmarkCount(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+	}
+
+	std::string metadata;
+	file_proto.SerializeToString(&metadata);
+
+	// collect the tiles that will be written
+	const dtNavMesh* navMesh = m_navMesh.get();
+	std::vector<const dtMeshTile*> tiles;
+
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize) continue;
+
+		tiles.push_back(tile);
+	}
+
+	auto alignOffset = [](uint64_t offset)
+	{
+		return (offset + (NAVMESH_TILE_ALIGNMENT - 1)) & ~(uint64_t)(NAVMESH_TILE_ALIGNMENT - 1);
+	};
+
+	// Store header.
+	MeshFileHeaderV6 header;
+	memset(&header, 0, sizeof(header));
+	header.magic = NAVMESH_FILE_MAGIC;
+	header.version = (uint16_t)NavMeshHeaderVersion::Version6;
+	header.flags = NavMeshFileFlags{};
+	header.headerSize = sizeof(MeshFileHeaderV6);
+	header.tileCount = (uint32_t)tiles.size();
+	header.tileEntrySize = sizeof(MeshFileTileEntry);
+	header.tileDirectoryOffset = sizeof(MeshFileHeaderV6);
+	header.metadataOffset = header.tileDirectoryOffset + (uint64_t)tiles.size() * sizeof(MeshFileTileEntry);
+	header.metadataSize = (uint32_t)metadata.length();
+	header.codec = m_tileCodec;
+
+	// compress each tile on its own, so that they can be loaded individually.
+	bool compressed = m_tileCodec != NavMeshCodec::None;
+	std::vector<std::vector<uint8_t>> compressedTiles;
+
+	if (compressed)
+	{
+		header.flags |= NavMeshFileFlags::COMPRESSED;
+		compressedTiles.resize(tiles.size());
+
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			if (!CompressBuffer(m_tileCodec, tiles[i]->data, tiles[i]->dataSize, compressedTiles[i]))
+			{
+				SPDLOG_ERROR("saveMesh: failed to compress tile with {}", GetCodecName(m_tileCodec));
+				return false;
+			}
+		}
+	}
+
+	// build the tile directory
+	std::vector<MeshFileTileEntry> directory(tiles.size());
+	uint64_t offset = alignOffset(header.metadataOffset + header.metadataSize);
+
+	for (size_t i = 0; i < tiles.size(); ++i)
+	{
+		const dtMeshTile* tile = tiles[i];
+		MeshFileTileEntry& entry = directory[i];
+
+		memset(&entry, 0, sizeof(entry));
+		entry.tileRef = navMesh->getTileRef(tile);
+		entry.offset = offset;
+		entry.dataSize = (uint32_t)tile->dataSize;
+		entry.storedSize = compressed ? (uint32_t)compressedTiles[i].size() : entry.dataSize;
+		entry.x = tile->header->x;
+		entry.y = tile->header->y;
+		entry.layer = tile->header->layer;
+		entry.dataHash = HashTileData(tile->data, tile->dataSize);
+
+		offset = alignOffset(offset + entry.storedSize);
+	}
+
+	// hash everything but the padding, so that reloads can be skipped when the file
+	// is replaced with an identical copy.
+	uint64_t contentHash = FNV1A_64_OFFSET_BASIS;
+	if (!directory.empty())
+		contentHash = fnv1a64(&directory[0], directory.size() * sizeof(MeshFileTileEntry), contentHash);
+	contentHash = fnv1a64(metadata.data(), metadata.length(), contentHash);
+
+	for (size_t i = 0; i < tiles.size(); ++i)
+	{
+		if (compressed)
+			contentHash = fnv1a64(compressedTiles[i].data(), compressedTiles[i].size(), contentHash);
+		else
+			contentHash = fnv1a64(tiles[i]->data, tiles[i]->dataSize, contentHash);
+	}
+
+	header.contentHash = contentHash;
+
+	outfile.write((const char*)&header, sizeof(header));
+	if (!directory.empty())
+		outfile.write((const char*)&directory[0], directory.size() * sizeof(MeshFileTileEntry));
+	outfile.write(metadata.data(), metadata.length());
+
+	// write out the tiles with padding between them.
+	static const char padding[NAVMESH_TILE_ALIGNMENT] = { 0 };
+	uint64_t written = header.metadataOffset + header.metadataSize;
+
+	for (size_t i = 0; i < tiles.size(); ++i)
+	{
+		outfile.write(padding, directory[i].offset - written);
+
+		if (compressed)
+			outfile.write((const char*)compressedTiles[i].data(), compressedTiles[i].size());
+		else
+			outfile.write((const char*)tiles[i]->data, tiles[i]->dataSize);
+
+		written = directory[i].offset + directory[i].storedSize;
+	}
+
+	if (!outfile.good())
+		return false;
+
+	m_version = NavMeshHeaderVersion::Version6;
+	m_contentHash = header.contentHash;
+	m_polyConnectivity = std::move(connectivity);
+	m_tileGraph = std::move(tileGraph);
+	m_landmarkTable = std::move(landmarkTable);
+
+	// tiles may have been changed directly since the grid was built
+	UpdatePolyGrid();
+
+	m_tileHashes.clear();
+	for (const MeshFileTileEntry& entry : directory)
+	{
+		m_tileHashes[entry.tileRef] = entry.dataHash;
+	}
+
 	outfile.close();
 	return true;
 }
 
+// A saved file that can't be replaced because it is still mapped is moved aside to
+// "<file>.old.<n>". These are removed by a later save, once nothing has them mapped.
+static void RemoveOldMeshFiles(const fs::path& filePath)
+{
+	const std::string prefix = filePath.filename().string() + ".old.";
+	fs::path folder = filePath.parent_path();
+	if (folder.empty())
+		folder = ".";
+
+	std::error_code ec;
+	std::vector<fs::path> oldFiles;
+
+	for (fs::directory_iterator iter(folder, ec), end; !ec && iter != end; iter.increment(ec))
+	{
+		if (iter->path().filename().string().compare(0, prefix.size(), prefix) == 0)
+			oldFiles.push_back(iter->path());
+	}
+
+	for (const fs::path& oldFile : oldFiles)
+	{
+		// fails if it is still mapped
+		fs::remove(oldFile, ec);
+	}
+}
+
+static fs::path GetOldMeshFileName(const fs::path& filePath)
+{
+	std::error_code ec;
+
+	for (int i = 0; ; ++i)
+	{
+		fs::path oldPath = filePath;
+		oldPath += ".old." + std::to_string(i);
+
+		if (!fs::exists(oldPath, ec))
+			return oldPath;
+	}
+}
+
 bool NavMesh::SaveMesh(const char* filename, NavMeshHeaderVersion version /*= NavMeshHeaderVersion::Latest*/)
 {
+	// make sure that deferred tiles don't get dropped from the file.
+	LoadAllPendingTiles();
+
+	// Write to a temporary file and then move it into place. The existing file may be
+	// memory mapped by this process or another one, so it can't be overwritten in place.
+	fs::path filePath = filename;
+	fs::path tempPath = filePath;
+	tempPath += ".tmp";
+
+	bool result = false;
+
 	if (version == NavMeshHeaderVersion::Version4)
-		return SaveMeshV4(filename);
-	if (version == NavMeshHeaderVersion::Version5)
-		return SaveMeshV5(filename);
+		result = SaveMeshV4(tempPath.string().c_str());
+	else if (version == NavMeshHeaderVersion::Version5)
+		result = SaveMeshV5(tempPath.string().c_str());
+	else if (version == NavMeshHeaderVersion::Version6)
+		result = SaveMeshV6(tempPath.string().c_str());
 
-	return false;
+	std::error_code ec;
+
+	if (!result)
+	{
+		fs::remove(tempPath, ec);
+		return false;
+	}
+
+	RemoveOldMeshFiles(filePath);
+
+	fs::rename(tempPath, filePath, ec);
+	if (ec)
+	{
+		// A mapped file can't be replaced on windows, but it can be renamed. Move it out
+		// of the way and clean it up if we can.
+		fs::path oldPath = GetOldMeshFileName(filePath);
+
+		fs::rename(filePath, oldPath, ec);
+		if (ec)
+		{
+			SPDLOG_ERROR("saveMesh: failed to move {} to {}: {}", filePath.string(), oldPath.string(), ec.message());
+			fs::remove(tempPath, ec);
+			return false;
+		}
+
+		fs::rename(tempPath, filePath, ec);
+		if (ec)
+		{
+			SPDLOG_ERROR("saveMesh: failed to replace {}: {}", filePath.string(), ec.message());
+
+			// put the old file back where it was
+			std::error_code restoreEc;
+			fs::rename(oldPath, filePath, restoreEc);
+			fs::remove(tempPath, ec);
+			return false;
+		}
+
+		// fails if it is still mapped, in which case the next save gets it
+		fs::remove(oldPath, ec);
+	}
+
+	return true;
 }
 
 //----------------------------------------------------------------------------
@@ -1024,6 +2638,52 @@ void NavMesh::InitializeAreas()
 	}
 }
 
+uint64_t NavMesh::ReadContentHash(const std::string& filename)
+{
+	std::ifstream infile(filename, std::ios::binary);
+	if (!infile.is_open())
+		return 0;
+
+	MeshFileHeaderV6 header;
+	memset(&header, 0, sizeof(header));
+	infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!infile
+		|| header.magic != NAVMESH_FILE_MAGIC
+		|| header.version != (uint16_t)NavMeshHeaderVersion::Version6
+		|| header.headerSize < sizeof(MeshFileHeaderV6))
+	{
+		return 0;
+	}
+
+	return header.contentHash;
+}
+
+size_t NavMesh::GetMemoryUsage() const
+{
+	size_t usage = 0;
+
+	if (m_navMesh)
+	{
+		const dtNavMesh* navMesh = m_navMesh.get();
+		usage += navMesh->getMaxTiles() * sizeof(dtMeshTile);
+
+		for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (tile && tile->header)
+				usage += tile->dataSize;
+		}
+	}
+
+	for (const MeshFileTileEntry& entry : m_pendingTiles)
+	{
+		usage += entry.dataSize;
+	}
+
+	return usage;
+}
+
 std::vector<dtTileRef> NavMesh::GetTileRefsForPoint(const glm::vec3& pos)
 {
 	std::vector<dtTileRef> refs;
@@ -1131,6 +2791,9 @@ bool NavMesh::ExportJson(const std::string& filename, PersistedDataFields fields
 	if (m_zoneName.empty())
 		return false;
 
+	if (+(fields & PersistedDataFields::MeshTiles))
+		LoadAllPendingTiles();
+
 	nav::NavMeshFile proto;
 	SaveToProto(proto, fields);
 
@@ -1185,6 +2848,7 @@ bool NavMesh::ImportJson(const std::string& filename, PersistedDataFields fields
 		return false;
 
 	LoadFromProto(proto, fields);
+	++m_generation;
 	OnNavMeshChanged();
 
 	return true;
@@ -1200,12 +2864,21 @@ std::vector<float> NavMesh::GetHeights(const glm::vec3& pos)
 	dtPolyRef polys[128];
 	int polyCount;
 
-	// we will still get success on 0 polys, but it won't matter
 	auto query = GetNavMeshQuery();
-	if (IsNavMeshLoaded()
+	if (m_polyGrid && query)
+	{
+		m_polyGrid->GetHeights(*query, center, extents, filter, heights);
+	}
+	// we will still get success on 0 polys, but it won't matter
+	else if (IsNavMeshLoaded()
 		&& query
 		&& !(query->queryPolygons(center, extents, &filter, polys, &polyCount, 128) & DT_FAILURE))
 	{
+		// the unused nodes at the end of a tile's tree look like leaves of its first polygon,
+		// so that one can be found twice
+		std::sort(polys, polys + polyCount);
+		polyCount = static_cast<int>(std::unique(polys, polys + polyCount) - polys);
+
 		for (int idx_poly = 0; idx_poly < polyCount; ++idx_poly)
 		{
 			dtPolyRef poly = polys[idx_poly];
@@ -1217,6 +2890,8 @@ std::vector<float> NavMesh::GetHeights(const glm::vec3& pos)
 		}
 	}
 
+	// the grid finds them in a different order
+	std::sort(heights.begin(), heights.end());
 	return heights;
 }
 
@@ -5,13 +5,16 @@
 #pragma once
 
 #include "common/Enum.h"
+#include "common/FlowField.h"
 #include "common/NavMeshData.h"
+#include "common/NavMeshQueryPool.h"
 #include "common/NavModule.h"
 
 #include <DetourNavMesh.h>
 #include <mq/base/Signal.h>
 
 #include <array>
+#include <chrono>
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -20,6 +23,11 @@ class dtNavMesh;
 class dtNavMeshQuery;
 class dtQueryFilter;
 class Context;
+class MappedFile;
+class PolyConnectivity;
+class TileGraph;
+class LandmarkTable;
+class PolyGrid;
 struct OffMeshConnectionBuffer;
 
 namespace nav {
@@ -53,6 +61,9 @@ public:
 	NavMesh(const NavMesh&) = delete;
 	NavMesh& operator=(const NavMesh&) = delete;
 
+	// shrinks idle queries whose node pools grew during a big search
+	virtual void OnPulse() override;
+
 	// update the current zone. This will trigger a reload of the navmesh file if
 	// the zone has changed, if autoload is enabled.
 	void SetZoneName(const std::string& zoneShortName);
@@ -79,6 +90,57 @@ public:
 	// get the nav mesh query object
 	std::shared_ptr<dtNavMeshQuery> GetNavMeshQuery();
 
+	// borrow a query for the current navmesh from the query pool. Returns an empty
+	// query if there is no navmesh.
+	NavMeshQueryPool::Query AcquireNavMeshQuery() { return m_queryPool.Acquire(m_navMesh.get()); }
+	NavMeshQueryPool& GetQueryPool() { return m_queryPool; }
+
+	// changes whenever tiles are added or removed, or the navmesh is replaced.
+	uint32_t GetGeneration() const { return m_generation; }
+
+	// The connected regions of the navmesh, or nullptr if they aren't known. They are
+	// read from the file, or worked out once all of the tiles have been loaded. Tiles
+	// that are changed directly on the dtNavMesh aren't picked up until it is saved.
+	std::shared_ptr<const PolyConnectivity> GetPolyConnectivity() const { return m_polyConnectivity; }
+
+	// The portals between tiles, for planning long paths, or nullptr if they aren't
+	// known. These come and go along with the connected regions.
+	std::shared_ptr<const TileGraph> GetTileGraph() const { return m_tileGraph; }
+
+	// Search costs from landmark polygons, or nullptr if the file doesn't have them. They
+	// are only made when the mesh is saved, if the config asks for them.
+	std::shared_ptr<const LandmarkTable> GetLandmarkTable() const { return m_landmarkTable; }
+
+	// Sets the positions that paths are worked out to ahead of time. The flow fields
+	// are kept in a file next to the navmesh, and are only built again when the content
+	// of the navmesh changes. Fields are built on a background thread and picked up in
+	// OnPulse, which raises OnNavMeshChanged. The targets are cleared when the zone
+	// changes.
+	void SetFlowFieldTargets(std::vector<FlowFieldTarget> targets);
+	const std::vector<FlowFieldTarget>& GetFlowFieldTargets() const { return m_flowFieldTargets; }
+
+	// Sets the targets and builds their flow fields on the calling thread, eg. on the
+	// thread that loaded the navmesh, so that they are taken along by TakeLoadedMesh.
+	void BuildFlowFields(std::vector<FlowFieldTarget> targets);
+
+	// true while flow fields are being built in the background.
+	bool IsBuildingFlowFields() const { return m_flowFieldBuild != nullptr; }
+
+	// Waits for the flow fields that are being built in the background, and picks them
+	// up without waiting for OnPulse.
+	void WaitForFlowFields();
+
+	// The flow fields to the targets, or nullptr if there aren't any. Like the connected
+	// regions, they are only made once all of the tiles have been loaded.
+	std::shared_ptr<const FlowFieldSet> GetFlowFields() const { return m_flowFields; }
+
+	// A grid of the polygons under each spot of the navmesh, for finding the heights at
+	// a position without walking the tiles. It is built once all of the tiles have been
+	// loaded, or nullptr if it is turned off (the default).
+	void SetPolyGridEnabled(bool enabled);
+	bool IsPolyGridEnabled() const { return m_polyGridEnabled; }
+	std::shared_ptr<const PolyGrid> GetPolyGrid() const { return m_polyGrid; }
+
 	// build area costs for filter
 	void FillFilterAreaCosts(dtQueryFilter& filter);
 
@@ -114,6 +176,37 @@ public:
 	// Load a specific file into this instance
 	LoadResult LoadNavMeshFile(const std::string& filename);
 
+	// Replaces everything in this instance with the contents of another one, leaving
+	// the other one empty. This lets a navmesh be loaded into a separate instance on
+	// another thread, and then published all at once. Both instances raise
+	// OnNavMeshChanging before anything is moved, and OnNavMeshChanged after.
+	void TakeLoadedMesh(NavMesh& loaded);
+
+	//------------------------------------------------------------------------
+	// partial reloading
+
+	using TileHashMap = std::unordered_map<dtTileRef, uint64_t>;
+
+	// hashes of the tiles in the file that the navmesh was loaded from or last saved
+	// to, by tile ref. Only version 6 files store tile hashes.
+	const TileHashMap& GetTileHashes() const { return m_tileHashes; }
+
+	// Prepares this instance to load a newer version of the file that is loaded in
+	// base. Tiles that are the same as they are in base are skipped, and the result
+	// can be applied to base with MergeChangedTiles. Does nothing if base can't be
+	// reloaded this way.
+	void SetReloadBase(const NavMesh& base);
+
+	// true if the last load skipped unchanged tiles.
+	bool IsPartialLoad() const { return m_partialLoad; }
+
+	// Applies a partial load to the navmesh that it was based on. Tiles that changed
+	// are replaced in place, so the dtNavMesh and the polygon refs in unchanged tiles
+	// stay valid. Everything else is taken from the loaded instance like with
+	// TakeLoadedMesh. Returns false if this navmesh no longer matches the base
+	// that was loaded against, in which case nothing is changed.
+	bool MergeChangedTiles(NavMesh& loaded);
+
 	// save the currently loaded mesh to a file
 	bool SaveNavMeshFile();
 
@@ -134,6 +227,47 @@ public:
 
 	int GetHeaderVersion() const { return static_cast<int>(m_version); }
 
+	// Hash of the contents of the file that the navmesh was loaded from or last saved
+	// to. Only version 6 files store a hash, this is zero for anything else.
+	uint64_t GetContentHash() const { return m_contentHash; }
+
+	// reads the content hash from the header of a navmesh file without loading it.
+	// Returns zero if the file can't be read or doesn't have a hash.
+	static uint64_t ReadContentHash(const std::string& filename);
+
+	// rough estimate of the memory held by the navmesh tiles, including tiles that
+	// are still waiting to be loaded.
+	size_t GetMemoryUsage() const;
+
+	// codec used to compress each tile separately when saving version 6 files.
+	// This is picked up from the file when a version 6 mesh is loaded, and goes back
+	// to the default when the tiles are reset or an older version is loaded.
+	void SetTileCodec(NavMeshCodec codec) { m_tileCodec = codec; }
+	NavMeshCodec GetTileCodec() const { return m_tileCodec; }
+
+	//------------------------------------------------------------------------
+	// partial loading
+
+	// Sets the area to load first. When a version 6 file is loaded, only the tiles
+	// within radius of pos are added right away, and the rest are deferred until
+	// LoadPendingTiles is called. A radius of zero loads all tiles immediately.
+	void SetLoadFocus(const glm::vec3& pos, float radius);
+	void ClearLoadFocus();
+
+	bool HasPendingTiles() const { return !m_pendingTiles.empty(); }
+	size_t GetPendingTileCount() const { return m_pendingTiles.size(); }
+
+	// Loads deferred tiles, nearest to the focus first, until the time budget is
+	// spent. OnNavMeshChanged is raised once the last tile has been added. Returns
+	// the number of tiles that were loaded.
+	int LoadPendingTiles(std::chrono::microseconds budget);
+	void LoadAllPendingTiles();
+
+	// number of threads used to decompress tiles while loading. Adding tiles to
+	// the navmesh always happens on the calling thread.
+	void SetLoadThreadCount(int threadCount);
+	int GetLoadThreadCount() const { return m_loadThreadCount; }
+
 	//------------------------------------------------------------------------
 	// area types
 
@@ -200,11 +334,18 @@ public:
 
 	mq::Signal<> OnNavMeshChanged;
 
+	// Raised right before tiles are added to or removed from the current dtNavMesh,
+	// so that anything reading it on another thread can stop first. OnNavMeshChanged
+	// is raised once the changes are finished.
+	mq::Signal<> OnNavMeshChanging;
+
 private:
 	LoadResult LoadMesh(const char* filename);
+	LoadResult LoadMeshV6(const std::shared_ptr<MappedFile>& mapping);
 
 	bool SaveMeshV4(const char* filename);
 	bool SaveMeshV5(const char* filename);
+	bool SaveMeshV6(const char* filename);
 
 	bool SaveMesh(const char* filename, NavMeshHeaderVersion version = NavMeshHeaderVersion::Latest);
 
@@ -214,6 +355,22 @@ private:
 	void ResetSavedData(PersistedDataFields fields = PersistedDataFields::All);
 
 	void LoadFromProto(const nav::NavMeshFile& proto, PersistedDataFields fields);
+
+	bool AddTileFromFile(const MappedFile& mapping, const MeshFileTileEntry& entry, NavMeshCodec codec);
+	void AddTilesFromFile(const MappedFile& mapping, const std::vector<MeshFileTileEntry>& entries,
+		NavMeshCodec codec);
+	bool AddTileData(const MeshFileTileEntry& entry, uint8_t* data, NavMeshCodec codec);
+	void ClearPendingTiles();
+	void UpdateSearchGraphs();
+	dtQueryFilter MakeSearchGraphFilter();
+	void UpdatePolyGrid();
+	struct FlowFieldBuild;
+	std::unique_ptr<FlowFieldBuild> CreateFlowFieldBuild();
+	void StartFlowFieldBuild();
+	void CancelFlowFieldBuild();
+	void FinishFlowFieldBuild();
+	std::string GetFlowFieldFileName() const;
+	void TakeLoadedData(NavMesh& loaded);
 	void SaveToProto(nav::NavMeshFile& proto, PersistedDataFields fields);
 
 private:
@@ -223,12 +380,38 @@ private:
 	std::string m_dataFile;
 	LoadResult m_lastLoadResult = LoadResult::None;
 	NavMeshHeaderVersion m_version = {};
+	uint64_t m_contentHash = 0;
+	TileHashMap m_tileHashes;
 
 	std::shared_ptr<dtNavMesh> m_navMesh;
 	std::shared_ptr<dtNavMeshQuery> m_navMeshQuery;
+	NavMeshQueryPool m_queryPool;
+	uint32_t m_generation = 0;
+	std::shared_ptr<const PolyConnectivity> m_polyConnectivity;
+	std::shared_ptr<const TileGraph> m_tileGraph;
+	std::shared_ptr<const LandmarkTable> m_landmarkTable;
+	std::vector<FlowFieldTarget> m_flowFieldTargets;
+	std::shared_ptr<const FlowFieldSet> m_flowFields;
+	std::unique_ptr<FlowFieldBuild> m_flowFieldBuild;
+	bool m_polyGridEnabled = false;
+	std::shared_ptr<const PolyGrid> m_polyGrid;
 	glm::vec3 m_boundsMin = { 0, 0, 0 };
 	glm::vec3 m_boundsMax = { 0, 0, 0 };
 	NavMeshConfig m_config;
+	NavMeshCodec m_tileCodec = NAVMESH_DEFAULT_TILE_CODEC;
+
+	// partial loading
+	glm::vec3 m_loadFocus = { 0, 0, 0 };
+	float m_loadFocusRadius = 0.0f;
+	std::shared_ptr<MappedFile> m_pendingMapping;
+	std::vector<MeshFileTileEntry> m_pendingTiles; // furthest first
+	NavMeshCodec m_pendingCodec = NavMeshCodec::None;
+	int m_loadThreadCount = 1;
+
+	// partial reloading
+	dtNavMeshParams m_reloadBaseParams = {};
+	TileHashMap m_reloadBaseHashes;
+	bool m_partialLoad = false;
 
 	// volumes
 	std::vector<std::unique_ptr<ConvexVolume>> m_volumes;
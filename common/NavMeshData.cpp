@@ -4,9 +4,9 @@
 
 #include "NavMeshData.h"
 
-constexpr unsigned long RGBA(uint8_t iR, uint8_t iG, uint8_t iB, uint8_t iA)
+constexpr uint32_t RGBA(uint8_t iR, uint8_t iG, uint8_t iB, uint8_t iA)
 {
-	return (iA << 24) | (iB << 16) | (iG << 8) | iR;
+	return ((uint32_t)iA << 24) | ((uint32_t)iB << 16) | ((uint32_t)iG << 8) | (uint32_t)iR;
 }
 
 const std::vector<PolyAreaType> DefaultPolyAreas =
@@ -86,6 +86,7 @@ struct NavMeshConfig
 	float detailSampleDist = 6.0f;
 	float detailSampleMaxError = 1.0f;
 	PartitionType partitionType = PartitionType::WATERSHED;
+	int landmarkCount = 0;
 };
 
 //----------------------------------------------------------------------------
@@ -94,14 +95,18 @@ struct NavMeshConfig
 // extension used for navmesh files
 const char* const NAVMESH_FILE_EXTENSION = ".navmesh";
 
+// extension used for the flow fields that are kept next to a navmesh file
+const char* const FLOWFIELD_FILE_EXTENSION = ".flowfields";
+
 // header constants
 const int NAVMESH_FILE_MAGIC = 'MSET';
 
 enum struct NavMeshHeaderVersion : uint16_t {
 	Version4 = 4,                // base version
 	Version5 = 5,                // version 5 introduced headerSize and uncompressedSize
+	Version6 = 6,                // version 6 stores raw tiles in a directory for memory mapping
 
-	Latest = Version5,
+	Latest = Version6,
 };
 
 enum struct NavMeshFileFlags : uint16_t {
@@ -109,6 +114,22 @@ enum struct NavMeshFileFlags : uint16_t {
 };
 constexpr bool has_bitwise_operations(NavMeshFileFlags) { return true; }
 
+// compression used for the tiles of version 6 files. Version 4 and 5 files
+// are always compressed with zlib.
+enum struct NavMeshCodec : uint32_t {
+	None = 0,
+	Zlib = 1,
+	Zstd = 2,
+	LZ4 = 3,
+
+	Last = LZ4,
+};
+
+// codec used for the tiles of new version 6 files. Uncompressed tiles can be used straight
+// from a mapped file, the others are opted into with MeshTool convert --codec or the
+// tile compression setting of MeshGenerator.
+const NavMeshCodec NAVMESH_DEFAULT_TILE_CODEC = NavMeshCodec::None;
+
 struct MeshFileHeader
 {
 	uint32_t magic;
@@ -122,12 +143,55 @@ struct MeshFileHeaderV5 : MeshFileHeader
 	uint32_t headerSize;
 };
 
+// Version 6 layout:
+//   MeshFileHeaderV6
+//   MeshFileTileEntry[tileCount]  (tile directory)
+//   serialized nav::NavMeshFile   (metadata, without tile data)
+//   tile data, each tile aligned to NAVMESH_TILE_ALIGNMENT
+//
+// Tile data is stored exactly as detour expects it, so tiles can be added to
+// the navmesh directly from a memory mapping of the file. If the COMPRESSED
+// flag is set, each tile is compressed separately with the header's codec so
+// that individual tiles can be loaded without reading the rest of the file.
+struct MeshFileHeaderV6 : MeshFileHeader
+{
+	uint32_t headerSize;             // sizeof(MeshFileHeaderV6) when written
+	uint32_t tileCount;              // number of entries in the tile directory
+	uint32_t tileEntrySize;          // sizeof(MeshFileTileEntry) when written
+	uint32_t metadataSize;           // size of the serialized metadata
+	uint64_t tileDirectoryOffset;    // file offset of the tile directory
+	uint64_t metadataOffset;         // file offset of the serialized metadata
+	NavMeshCodec codec;              // compression of the tile data, if COMPRESSED is set
+	uint32_t reserved;
+	uint64_t contentHash;            // hash of the directory, metadata and tile data
+};
+
+struct MeshFileTileEntry
+{
+	uint64_t tileRef;
+	uint64_t offset;                 // file offset of the tile data
+	uint32_t dataSize;               // size of the tile data
+	uint32_t storedSize;             // size of the tile data in the file
+	int32_t x;
+	int32_t y;
+	int32_t layer;
+	uint32_t reserved;
+	uint64_t dataHash;               // hash of the tile data, excluding links
+};
+
+// alignment of tile data in version 6 files
+const int NAVMESH_TILE_ALIGNMENT = 16;
+
 // compatibility version of the navmesh data
 const int NAVMESH_TILE_COMPAT_VERSION = 1;
 
 // Maximum number of nodes in navigation query
 const int NAVMESH_QUERY_MAX_NODES = 16384;
 
+// Searches can grow the node pool of a query up to this many nodes. The zone is
+// insanely large if this gets hit.
+const int NAVMESH_QUERY_NODE_POOL_LIMIT = 1024 * 1024;
+
 //----------------------------------------------------------------------------
 
 // Convex Volumes
@@ -0,0 +1,192 @@
+//
+// NavMeshQueryPool.cpp
+//
+
+#include "NavMeshQueryPool.h"
+
+#include "common/NavMeshData.h"
+
+#include <DetourNavMeshQuery.h>
+#include <DetourNode.h>
+#include <spdlog/spdlog.h>
+
+// queries beyond this are freed when they are released instead of being kept.
+const size_t MAX_IDLE_QUERIES = 8;
+
+//----------------------------------------------------------------------------
+
+NavMeshQueryPool::Query::Query(const std::shared_ptr<State>& state, dtNavMeshQuery* query)
+	: m_state(state)
+	, m_query(query)
+{
+}
+
+NavMeshQueryPool::Query::Query(Query&& other) noexcept
+	: m_state(std::move(other.m_state))
+	, m_query(other.m_query)
+{
+	other.m_query = nullptr;
+}
+
+NavMeshQueryPool::Query& NavMeshQueryPool::Query::operator=(Query&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+
+		m_state = std::move(other.m_state);
+		m_query = other.m_query;
+		other.m_query = nullptr;
+	}
+
+	return *this;
+}
+
+void NavMeshQueryPool::Query::Release()
+{
+	if (!m_query)
+		return;
+
+	if (std::shared_ptr<State> state = m_state.lock())
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+
+		if (state->idle.size() < MAX_IDLE_QUERIES)
+		{
+			state->idle.push_back({ m_query, clock::now() });
+			m_query = nullptr;
+		}
+	}
+
+	if (m_query)
+	{
+		dtFreeNavMeshQuery(m_query);
+		m_query = nullptr;
+	}
+
+	m_state.reset();
+}
+
+//----------------------------------------------------------------------------
+
+NavMeshQueryPool::State::~State()
+{
+	for (const IdleQuery& entry : idle)
+	{
+		dtFreeNavMeshQuery(entry.query);
+	}
+}
+
+NavMeshQueryPool::NavMeshQueryPool()
+	: m_state(std::make_shared<State>())
+{
+	m_state->idle.reserve(MAX_IDLE_QUERIES);
+}
+
+NavMeshQueryPool::~NavMeshQueryPool()
+{
+}
+
+NavMeshQueryPool::Query NavMeshQueryPool::Acquire(const dtNavMesh* navMesh)
+{
+	if (!navMesh)
+		return {};
+
+	dtNavMeshQuery* query = nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+
+		if (!m_state->idle.empty())
+		{
+			query = m_state->idle.back().query;
+			m_state->idle.pop_back();
+		}
+	}
+
+	if (query)
+	{
+		// The query might have been used with a different navmesh. Initializing it
+		// again only allocates if the node pool needs to get bigger, so this keeps
+		// any growth from earlier searches.
+		if (query->getAttachedNavMesh() != navMesh)
+		{
+			int maxNodes = query->getNodePool() ? query->getNodePool()->getMaxNodes() : NAVMESH_QUERY_MAX_NODES;
+			query->init(navMesh, maxNodes);
+		}
+
+		// the last user's heuristic belongs to them
+		query->setNodePoolLimit(NAVMESH_QUERY_NODE_POOL_LIMIT);
+		query->setHeuristic(nullptr);
+		return Query(m_state, query);
+	}
+
+	query = dtAllocNavMeshQuery();
+	if (!query)
+		return {};
+
+	if (dtStatusFailed(query->init(navMesh, NAVMESH_QUERY_MAX_NODES)))
+	{
+		SPDLOG_ERROR("NavMeshQueryPool: Could not init detour nav mesh query");
+
+		dtFreeNavMeshQuery(query);
+		return {};
+	}
+
+	query->setNodePoolLimit(NAVMESH_QUERY_NODE_POOL_LIMIT);
+	return Query(m_state, query);
+}
+
+void NavMeshQueryPool::Clear()
+{
+	std::vector<IdleQuery> idle;
+
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		std::swap(idle, m_state->idle);
+		m_state->idle.reserve(MAX_IDLE_QUERIES);
+	}
+
+	for (const IdleQuery& entry : idle)
+	{
+		dtFreeNavMeshQuery(entry.query);
+	}
+}
+
+void NavMeshQueryPool::Trim()
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+
+	clock::time_point now = clock::now();
+
+	for (const IdleQuery& entry : m_state->idle)
+	{
+		dtNodePool* nodePool = entry.query->getNodePool();
+
+		if (nodePool && nodePool->getMaxNodes() > NAVMESH_QUERY_MAX_NODES
+			&& now - entry.releaseTime >= m_state->shrinkDelay)
+		{
+			SPDLOG_DEBUG("NavMeshQueryPool: Shrinking idle node pool from {} nodes", nodePool->getMaxNodes());
+
+			entry.query->shrinkNodePool(NAVMESH_QUERY_MAX_NODES);
+		}
+	}
+}
+
+void NavMeshQueryPool::SetShrinkDelay(std::chrono::milliseconds delay)
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->shrinkDelay = delay;
+}
+
+std::chrono::milliseconds NavMeshQueryPool::GetShrinkDelay() const
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	return m_state->shrinkDelay;
+}
+
+size_t NavMeshQueryPool::GetIdleCount() const
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	return m_state->idle.size();
+}
@@ -0,0 +1,93 @@
+//
+// NavMeshQueryPool.h
+//
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class dtNavMesh;
+class dtNavMeshQuery;
+
+// Keeps navmesh queries around after they are used, so that searches don't need to
+// allocate and initialize a new query each time. Queries hold on to their node pools,
+// including any growth from earlier searches, until they have been idle for a while.
+// Queries can be taken from any thread.
+class NavMeshQueryPool
+{
+	struct State;
+
+public:
+	// A query on loan from the pool. Goes back to the pool when destroyed. It is safe
+	// for this to outlive the pool.
+	class Query
+	{
+	public:
+		Query() = default;
+		~Query() { Release(); }
+
+		Query(Query&& other) noexcept;
+		Query& operator=(Query&& other) noexcept;
+
+		Query(const Query&) = delete;
+		Query& operator=(const Query&) = delete;
+
+		dtNavMeshQuery* get() const { return m_query; }
+		dtNavMeshQuery* operator->() const { return m_query; }
+		explicit operator bool() const { return m_query != nullptr; }
+
+		void Release();
+
+	private:
+		friend class NavMeshQueryPool;
+		Query(const std::shared_ptr<State>& state, dtNavMeshQuery* query);
+
+		std::weak_ptr<State> m_state;
+		dtNavMeshQuery* m_query = nullptr;
+	};
+
+	NavMeshQueryPool();
+	~NavMeshQueryPool();
+
+	NavMeshQueryPool(const NavMeshQueryPool&) = delete;
+	NavMeshQueryPool& operator=(const NavMeshQueryPool&) = delete;
+
+	// Takes a query attached to the given navmesh. Returns an empty query if one
+	// couldn't be initialized.
+	Query Acquire(const dtNavMesh* navMesh);
+
+	// frees all queries that aren't in use.
+	void Clear();
+
+	// Shrinks the node pools of queries that grew during a search and have been idle
+	// for longer than the shrink delay.
+	void Trim();
+
+	void SetShrinkDelay(std::chrono::milliseconds delay);
+	std::chrono::milliseconds GetShrinkDelay() const;
+
+	size_t GetIdleCount() const;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct IdleQuery
+	{
+		dtNavMeshQuery* query;
+		clock::time_point releaseTime;
+	};
+
+	struct State
+	{
+		~State();
+
+		mutable std::mutex mutex;
+		std::vector<IdleQuery> idle;
+		std::chrono::milliseconds shrinkDelay{ 30000 };
+	};
+
+	std::shared_ptr<State> m_state;
+};
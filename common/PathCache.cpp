@@ -0,0 +1,145 @@
+//
+// PathCache.cpp
+//
+
+#include "PathCache.h"
+
+#include <DetourNavMeshQuery.h>
+
+#include <iterator>
+
+//----------------------------------------------------------------------------
+
+// FNV-1a
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static const uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+//----------------------------------------------------------------------------
+
+PathCache::PathCache(size_t capacity)
+	: m_capacity(capacity)
+{
+}
+
+PathCache::~PathCache()
+{
+}
+
+size_t PathCache::KeyHash::operator()(const Key& key) const
+{
+	uint64_t hash = HASH_SEED;
+	hash = HashBytes(hash, &key.startRef, sizeof(key.startRef));
+	hash = HashBytes(hash, &key.endRef, sizeof(key.endRef));
+	hash = HashBytes(hash, &key.filterHash, sizeof(key.filterHash));
+	hash = HashBytes(hash, &key.generation, sizeof(key.generation));
+
+	return static_cast<size_t>(hash);
+}
+
+uint64_t PathCache::HashFilter(const dtQueryFilter& filter)
+{
+	uint64_t hash = HASH_SEED;
+
+	unsigned short includeFlags = filter.getIncludeFlags();
+	unsigned short excludeFlags = filter.getExcludeFlags();
+	hash = HashBytes(hash, &includeFlags, sizeof(includeFlags));
+	hash = HashBytes(hash, &excludeFlags, sizeof(excludeFlags));
+
+	for (int i = 0; i < DT_MAX_AREAS; ++i)
+	{
+		float cost = filter.getAreaCost(i);
+		hash = HashBytes(hash, &cost, sizeof(cost));
+	}
+
+	return hash;
+}
+
+const PathCache::Entry* PathCache::Find(const Key& key)
+{
+	auto iter = m_index.find(key);
+	if (iter == m_index.end())
+	{
+		++m_stats.misses;
+		return nullptr;
+	}
+
+	++m_stats.hits;
+
+	m_entries.splice(m_entries.begin(), m_entries, iter->second);
+	return &iter->second->second;
+}
+
+void PathCache::Insert(const Key& key, PathResult result, const dtPolyRef* polys, int numPolys)
+{
+	if (m_capacity == 0)
+		return;
+
+	auto iter = m_index.find(key);
+	if (iter != m_index.end())
+	{
+		m_entries.splice(m_entries.begin(), m_entries, iter->second);
+	}
+	else if (m_entries.size() >= m_capacity)
+	{
+		// reuse the least recently used entry, along with its corridor buffer
+		m_index.erase(m_entries.back().first);
+		m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+		m_entries.front().first = key;
+		m_index.emplace(key, m_entries.begin());
+
+		++m_stats.evictions;
+	}
+	else
+	{
+		m_entries.emplace_front(key, Entry{});
+		m_index.emplace(key, m_entries.begin());
+	}
+
+	Entry& entry = m_entries.front().second;
+	entry.result = result;
+
+	if (result == PathResult::Success)
+		entry.corridor.assign(polys, polys + numPolys);
+	else
+		entry.corridor.clear();
+}
+
+void PathCache::Clear()
+{
+	if (!m_entries.empty())
+	{
+		++m_stats.invalidations;
+	}
+
+	m_entries.clear();
+	m_index.clear();
+}
+
+void PathCache::SetCapacity(size_t capacity)
+{
+	m_capacity = capacity;
+	Evict(capacity);
+}
+
+void PathCache::Evict(size_t size)
+{
+	while (m_entries.size() > size)
+	{
+		m_index.erase(m_entries.back().first);
+		m_entries.pop_back();
+
+		++m_stats.evictions;
+	}
+}
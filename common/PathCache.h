@@ -0,0 +1,93 @@
+//
+// PathCache.h
+//
+
+#pragma once
+
+#include "common/PathPlanner.h"
+
+#include <DetourNavMesh.h>
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Remembers the polygon corridors of recent searches, so that asking for the same path
+// again doesn't need another search. Searches are identified by the polygons they start
+// and end on, the filter they used and the generation of the navmesh. The corridor is
+// kept rather than the path, so that the path can be rebuilt for the exact start and
+// end positions. The least recently used entries are dropped when it is full.
+class PathCache
+{
+public:
+	struct Key
+	{
+		dtPolyRef startRef = 0;
+		dtPolyRef endRef = 0;
+		uint64_t filterHash = 0;
+		uint32_t generation = 0;
+
+		bool operator==(const Key& other) const
+		{
+			return startRef == other.startRef && endRef == other.endRef
+				&& filterHash == other.filterHash && generation == other.generation;
+		}
+	};
+
+	struct Entry
+	{
+		PathResult result = PathResult::Failed;
+		std::vector<dtPolyRef> corridor;
+	};
+
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t invalidations = 0;
+	};
+
+	PathCache(size_t capacity = 128);
+	~PathCache();
+
+	PathCache(const PathCache&) = delete;
+	PathCache& operator=(const PathCache&) = delete;
+
+	// Looks up a search. Returns nullptr if it isn't cached. The entry is valid until
+	// the next change to the cache.
+	const Entry* Find(const Key& key);
+
+	// remember the result of a search. The corridor is only needed on success.
+	void Insert(const Key& key, PathResult result, const dtPolyRef* polys, int numPolys);
+
+	// forget everything, because the navmesh has changed.
+	void Clear();
+
+	void SetCapacity(size_t capacity);
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetSize() const { return m_entries.size(); }
+
+	const Stats& GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = Stats{}; }
+
+	// hash of the flags and area costs of a filter, for use in keys
+	static uint64_t HashFilter(const dtQueryFilter& filter);
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	using EntryList = std::list<std::pair<Key, Entry>>;
+
+	void Evict(size_t size);
+
+	// most recently used at the front
+	EntryList m_entries;
+	std::unordered_map<Key, EntryList::iterator, KeyHash> m_index;
+	size_t m_capacity;
+	Stats m_stats;
+};
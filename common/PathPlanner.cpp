@@ -0,0 +1,1043 @@
+//
+// PathPlanner.cpp
+//
+
+#include "PathPlanner.h"
+
+#include "common/FlowField.h"
+#include "common/LandmarkTable.h"
+#include "common/Logging.h"
+#include "common/NavMesh.h"
+#include "common/NavMeshData.h"
+#include "common/PathCache.h"
+#include "common/PolyConnectivity.h"
+#include "common/TileGraph.h"
+
+#include <DetourCommon.h>
+#include <DetourNode.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+// constants
+
+const int MAX_STRAIGHT_PATH_LENGTH = 16384;
+
+const float POLYS_GROWTH_FACTOR = 1.5f;
+const int POLYS_MAX_SIZE = 1024 * 1024; // the zone is insanely large if this gets hit
+
+// how many times a search is restarted after growing the polys buffer. The node pool
+// grows during the search instead.
+const int MAX_SEARCH_RETRIES = 100;
+
+// how far ahead corridor polygons are checked for being removed or disabled
+const int CORRIDOR_VALID_LOOKAHEAD = 32;
+
+// how far ahead of the position the corridor is shortcut with raycasts
+const float CORRIDOR_OPTIMIZE_RANGE = 60.0f;
+
+// how far the position or target can drift from the corridor before replanning
+const float CORRIDOR_MAX_DRIFT = 1.0f;
+
+// polygons remembered from the front of the corridor, to detect a corridor that has
+// only been trimmed as the position moved along it.
+const int CORRIDOR_HEAD_SIZE = 16;
+
+// The start polygon is followed along the surface from the last known position, as long
+// as the position hasn't moved further than this. Anything further is a teleport.
+const float START_TRACKING_MAX_MOVE = 50.0f;
+
+// polygons that can be crossed while following the start polygon
+const int START_TRACKING_MAX_VISITED = 32;
+
+// Paths are only planned through the tile graph if the start and end are at least this
+// many tiles apart. Anything closer is searched directly.
+const int TILE_GRAPH_MIN_TILES = 6;
+
+// how many portals of the route each window of the search covers
+const int TILE_GRAPH_WINDOW_PORTALS = 8;
+
+//----------------------------------------------------------------------------
+
+void StraightPath::Reset(int size_)
+{
+	cursor = 0;
+	length = 0;
+
+	if (alloc == size_)
+		return;
+
+	alloc = size_;
+
+	if (alloc == 0)
+	{
+		verts.reset();
+		flags.reset();
+		polys.reset();
+	}
+	else
+	{
+		verts = std::make_unique<glm::vec3[]>(alloc);
+		flags = std::make_unique<uint8_t[]>(alloc);
+		polys = std::make_unique<dtPolyRef[]>(alloc);
+	}
+}
+
+float StraightPath::GetLength() const
+{
+	float result = 0.f;
+
+	for (int i = 0; i < length - 1; ++i)
+	{
+		result += glm::distance(verts[i], verts[i + 1]);
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------------
+
+PathPlanner::PathPlanner()
+	: m_heuristic(std::make_unique<LandmarkHeuristic>())
+	, m_routeSearch(std::make_unique<TileGraphSearch>())
+{
+	SetNavMesh(nullptr);
+}
+
+PathPlanner::~PathPlanner()
+{
+}
+
+void PathPlanner::SetNavMesh(NavMesh* navMesh)
+{
+	m_source = navMesh;
+	m_navMesh = navMesh ? navMesh->GetNavMesh() : nullptr;
+
+	m_query.Release();
+	m_slicedQuery.Release();
+	m_sliced.active = false;
+	m_hasCorridor = false;
+	m_startRef = 0;
+
+	m_filter = dtQueryFilter{};
+	m_filter.setIncludeFlags(+PolyFlags::All);
+	m_filter.setExcludeFlags(+PolyFlags::Disabled);
+	if (navMesh)
+	{
+		navMesh->FillFilterAreaCosts(m_filter);
+	}
+
+	m_filterHash = PathCache::HashFilter(m_filter);
+
+	// The components can only rule paths out if everything they left out is excluded
+	// by the filter too.
+	m_connectivity = navMesh ? navMesh->GetPolyConnectivity() : nullptr;
+	if (m_connectivity && (m_filter.getExcludeFlags() & m_connectivity->GetExcludeFlags()) != m_connectivity->GetExcludeFlags())
+	{
+		m_connectivity.reset();
+	}
+
+	// The landmark costs are only a lower bound if the filter costs at least as much as
+	// the one they were built with.
+	std::shared_ptr<const LandmarkTable> landmarks = navMesh ? navMesh->GetLandmarkTable() : nullptr;
+	if (landmarks && !landmarks->IsValidFor(m_filter))
+	{
+		landmarks.reset();
+	}
+	m_heuristic->SetTable(m_navMesh.get(), landmarks);
+
+	// same for the portals of the tile graph
+	m_tileGraph = navMesh ? navMesh->GetTileGraph() : nullptr;
+	if (m_tileGraph && (m_filter.getExcludeFlags() & m_tileGraph->GetExcludeFlags()) != m_tileGraph->GetExcludeFlags())
+	{
+		m_tileGraph.reset();
+	}
+
+	// the flow fields are checked one at a time when they are used
+	m_flowFields = navMesh ? navMesh->GetFlowFields() : nullptr;
+}
+
+void PathPlanner::ReleaseQuery()
+{
+	m_query.Release();
+
+	if (!m_sliced.active)
+	{
+		m_slicedQuery.Release();
+	}
+}
+
+bool PathPlanner::InitQuery()
+{
+	if (!m_navMesh)
+		return false;
+
+	if (!m_query)
+	{
+		m_query = m_source->GetQueryPool().Acquire(m_navMesh.get());
+		SetQueryHeuristic(m_query.get());
+	}
+
+	return static_cast<bool>(m_query);
+}
+
+void PathPlanner::SetQueryHeuristic(dtNavMeshQuery* query)
+{
+	if (query)
+	{
+		query->setHeuristic(m_heuristic->GetTable() ? m_heuristic.get() : nullptr);
+	}
+}
+
+dtPolyRef PathPlanner::FindNearestPoly(const glm::vec3& pos, glm::vec3* nearestPos)
+{
+	if (!InitQuery())
+		return 0;
+
+	dtPolyRef ref = 0;
+	glm::vec3 nearest;
+
+	m_query->findNearestPoly(
+		glm::value_ptr(pos),
+		glm::value_ptr(m_extents),
+		&m_filter, &ref, glm::value_ptr(nearest));
+
+	if (ref && nearestPos)
+	{
+		*nearestPos = nearest;
+	}
+
+	return ref;
+}
+
+dtPolyRef PathPlanner::FindStartPoly(const glm::vec3& pos, glm::vec3* nearestPos)
+{
+	if (!InitQuery())
+		return 0;
+
+	dtPolyRef ref = TrackStartPoly(pos);
+	if (!ref)
+	{
+		// teleported, or left the mesh
+		ref = FindNearestPoly(pos, &m_startPos);
+	}
+
+	m_startRef = ref;
+
+	if (ref && nearestPos)
+	{
+		*nearestPos = m_startPos;
+	}
+
+	return ref;
+}
+
+dtPolyRef PathPlanner::TrackStartPoly(const glm::vec3& pos)
+{
+	if (!m_startRef || !m_navMesh->isValidPolyRef(m_startRef) || !m_query->isValidPolyRef(m_startRef, &m_filter))
+		return 0;
+
+	if (glm::distance(m_startPos, pos) > START_TRACKING_MAX_MOVE)
+		return 0;
+
+	glm::vec3 resultPos;
+	dtPolyRef visited[START_TRACKING_MAX_VISITED];
+	int numVisited = 0;
+
+	dtStatus status = m_query->moveAlongSurface(m_startRef, glm::value_ptr(m_startPos), glm::value_ptr(pos),
+		&m_filter, glm::value_ptr(resultPos), visited, &numVisited, START_TRACKING_MAX_VISITED);
+	if (dtStatusFailed(status) || dtStatusDetail(status, DT_BUFFER_TOO_SMALL) || numVisited == 0)
+		return 0;
+
+	// If the surface doesn't lead to the position, we were moved some other way. The
+	// position can still be a bit off the edge of the mesh.
+	if (glm::distance(glm::vec2(resultPos.x, resultPos.z), glm::vec2(pos.x, pos.z)) > CORRIDOR_MAX_DRIFT)
+		return 0;
+
+	dtPolyRef ref = visited[numVisited - 1];
+
+	// the surface keeps the height it started at, so find the height of the polygon we
+	// ended up on. A different level means we dropped or were ported to it.
+	float height = resultPos.y;
+	m_query->getPolyHeight(ref, glm::value_ptr(resultPos), &height);
+	if (std::abs(height - pos.y) > m_extents.y)
+		return 0;
+
+	resultPos.y = height;
+	m_startPos = resultPos;
+
+	return ref;
+}
+
+PathResult PathPlanner::FindPath(const glm::vec3& startPos, const glm::vec3& endPos, StraightPath& path)
+{
+	// this search replaces whatever the sliced search was going to find
+	CancelPath();
+
+	glm::vec3 spos;
+	dtPolyRef startRef = FindStartPoly(startPos, &spos);
+	if (!startRef)
+		return PathResult::NoStartPoly;
+
+	glm::vec3 epos;
+	dtPolyRef endRef = FindNearestPoly(endPos, &epos);
+	if (!endRef)
+		return PathResult::NoEndPoly;
+
+	if (IsDisconnected(startRef, endRef))
+	{
+		SPDLOG_DEBUG("findPath from {} to {}: end is not connected to the start.", startPos, endPos);
+		return PathResult::Partial;
+	}
+
+	int numFieldPolys = 0;
+	if (FollowFlowField(startRef, endRef, numFieldPolys))
+	{
+		SetCorridor(startRef, spos, epos, m_polys.data(), numFieldPolys);
+		m_corridorEnd = endPos;
+		ExtractStraightPath(path);
+
+		return PathResult::Success;
+	}
+
+	PathCache::Key cacheKey;
+	if (m_cache)
+	{
+		cacheKey = { startRef, endRef, m_filterHash, m_source->GetGeneration() };
+
+		if (const PathCache::Entry* entry = m_cache->Find(cacheKey))
+		{
+			if (entry->result != PathResult::Success)
+				return entry->result;
+
+			// the path is rebuilt from the corridor for these exact positions
+			SetCorridor(startRef, spos, epos, entry->corridor.data(), static_cast<int>(entry->corridor.size()));
+			m_corridorEnd = endPos;
+			ExtractStraightPath(path);
+
+			return PathResult::Success;
+		}
+	}
+
+	const dtPolyRef* polys = nullptr;
+	int numPolys = 0;
+	PathResult result;
+
+	if (PlanRoute(startRef, endRef, epos) && SearchRoute(startRef, spos))
+	{
+		polys = m_routePolys.data();
+		numPolys = static_cast<int>(m_routePolys.size());
+		result = PathResult::Success;
+	}
+	else
+	{
+		dtStatus status = SearchCorridor(startRef, endRef, spos, epos, numPolys);
+		result = CheckSearchResult(status, endRef, numPolys, startPos, endPos);
+		polys = m_polys.data();
+	}
+
+	if (m_cache)
+	{
+		m_cache->Insert(cacheKey, result, polys, numPolys);
+	}
+
+	if (result != PathResult::Success)
+		return result;
+
+	SetCorridor(startRef, spos, epos, polys, numPolys);
+	m_corridorEnd = endPos;
+	ExtractStraightPath(path);
+
+	return PathResult::Success;
+}
+
+dtStatus PathPlanner::SearchCorridor(dtPolyRef startRef, dtPolyRef endRef, const glm::vec3& spos,
+	const glm::vec3& epos, int& numPolys)
+{
+	if (m_polys.size() < MAX_STRAIGHT_PATH_LENGTH)
+	{
+		m_polys.resize(MAX_STRAIGHT_PATH_LENGTH);
+	}
+
+	numPolys = 0;
+	int iters = 0;
+	dtStatus status = 0;
+
+	while (iters < MAX_SEARCH_RETRIES)
+	{
+		status = m_query->findPath(
+			startRef, endRef,
+			glm::value_ptr(spos),
+			glm::value_ptr(epos), &m_filter, m_polys.data(), &numPolys, static_cast<int>(m_polys.size()));
+
+		if (!GrowSearchSpace(m_query.get(), status))
+		{
+			break;
+		}
+
+		iters++;
+	}
+
+	NoteNodePoolUse(m_query.get());
+	return status;
+}
+
+bool PathPlanner::FollowFlowField(dtPolyRef startRef, dtPolyRef endRef, int& numPolys)
+{
+	numPolys = 0;
+
+	if (!m_flowFields)
+		return false;
+
+	const FlowField* field = m_flowFields->FindByTargetRef(endRef);
+	if (!field || (m_filter.getExcludeFlags() & field->GetExcludeFlags()) != field->GetExcludeFlags())
+		return false;
+
+	if (m_polys.size() < MAX_STRAIGHT_PATH_LENGTH)
+	{
+		m_polys.resize(MAX_STRAIGHT_PATH_LENGTH);
+	}
+
+	// polygons that were disabled since the field was built are left for the search
+	numPolys = field->GetCorridor(*m_navMesh, startRef, m_polys.data(), static_cast<int>(m_polys.size()));
+	for (int i = 0; i < numPolys; ++i)
+	{
+		if (!m_query->isValidPolyRef(m_polys[i], &m_filter))
+		{
+			numPolys = 0;
+			break;
+		}
+	}
+
+	return numPolys > 0;
+}
+
+bool PathPlanner::HasFlowFieldTo(const glm::vec3& endPos)
+{
+	if (!m_flowFields || m_flowFields->IsEmpty())
+		return false;
+
+	dtPolyRef endRef = FindNearestPoly(endPos);
+	return endRef && m_flowFields->FindByTargetRef(endRef);
+}
+
+bool PathPlanner::PlanRoute(dtPolyRef startRef, dtPolyRef endRef, const glm::vec3& epos)
+{
+	m_waypointRefs.clear();
+	m_waypointPos.clear();
+
+	if (!m_tileGraph)
+		return false;
+
+	const dtMeshTile* startTile = nullptr;
+	const dtMeshTile* endTile = nullptr;
+	const dtPoly* poly = nullptr;
+	m_navMesh->getTileAndPolyByRefUnsafe(startRef, &startTile, &poly);
+	m_navMesh->getTileAndPolyByRefUnsafe(endRef, &endTile, &poly);
+
+	if (std::max(std::abs(startTile->header->x - endTile->header->x),
+		std::abs(startTile->header->y - endTile->header->y)) < TILE_GRAPH_MIN_TILES)
+	{
+		return false;
+	}
+
+	if (!m_routeSearch->FindRoute(*m_tileGraph, *m_navMesh, m_filter, startRef, endRef, epos, m_route))
+	{
+		SPDLOG_DEBUG("No route through the tile graph, visited {} portals", m_routeSearch->GetVisitedCount());
+		return false;
+	}
+
+	// A window ends every few portals, and the last one at the end. The last window is
+	// kept from being too short.
+	const std::vector<TileGraph::Portal>& portals = m_tileGraph->GetPortals();
+	for (size_t i = TILE_GRAPH_WINDOW_PORTALS; i + TILE_GRAPH_WINDOW_PORTALS / 2 < m_route.size();
+		i += TILE_GRAPH_WINDOW_PORTALS)
+	{
+		const TileGraph::Portal& portal = portals[m_route[i]];
+
+		m_waypointRefs.push_back(portal.tileRef | static_cast<dtPolyRef>(portal.poly));
+		m_waypointPos.push_back(portal.pos);
+	}
+
+	m_waypointRefs.push_back(endRef);
+	m_waypointPos.push_back(epos);
+
+	SPDLOG_DEBUG("Route through the tile graph: {} portals, {} windows, visited {} portals",
+		m_route.size(), m_waypointRefs.size(), m_routeSearch->GetVisitedCount());
+	return true;
+}
+
+bool PathPlanner::SearchRoute(dtPolyRef startRef, const glm::vec3& spos)
+{
+	m_routePolys.clear();
+
+	dtPolyRef fromRef = startRef;
+	glm::vec3 fromPos = spos;
+
+	for (size_t i = 0; i < m_waypointRefs.size(); ++i)
+	{
+		int numPolys = 0;
+		dtStatus status = SearchCorridor(fromRef, m_waypointRefs[i], fromPos, m_waypointPos[i], numPolys);
+
+		if (dtStatusFailed(status)
+			|| dtStatusDetail(status, DT_PARTIAL_RESULT | DT_OUT_OF_NODES | DT_BUFFER_TOO_SMALL)
+			|| numPolys == 0 || m_polys[numPolys - 1] != m_waypointRefs[i])
+		{
+			SPDLOG_DEBUG("Couldn't follow the route through the tile graph, searching directly");
+			return false;
+		}
+
+		AppendToRoute(numPolys);
+
+		fromRef = m_waypointRefs[i];
+		fromPos = m_waypointPos[i];
+	}
+
+	RemoveRouteLoops();
+	return true;
+}
+
+void PathPlanner::AppendToRoute(int numPolys)
+{
+	// each window starts on the polygon that the last one ended on
+	int first = !m_routePolys.empty() && numPolys > 0 && m_polys[0] == m_routePolys.back() ? 1 : 0;
+
+	m_routePolys.insert(m_routePolys.end(), m_polys.begin() + first, m_polys.begin() + numPolys);
+}
+
+void PathPlanner::RemoveRouteLoops()
+{
+	// The windows can double back where they join up. Anything between two visits to
+	// the same polygon is cut out.
+	m_routeSeen.clear();
+	size_t count = 0;
+
+	for (size_t i = 0; i < m_routePolys.size(); ++i)
+	{
+		const dtPolyRef ref = m_routePolys[i];
+		auto [iter, inserted] = m_routeSeen.emplace(ref, count);
+
+		if (!inserted)
+		{
+			for (size_t j = iter->second + 1; j < count; ++j)
+			{
+				m_routeSeen.erase(m_routePolys[j]);
+			}
+
+			count = iter->second + 1;
+			continue;
+		}
+
+		m_routePolys[count++] = ref;
+	}
+
+	m_routePolys.resize(count);
+}
+
+PathResult PathPlanner::FindPathLengths(const glm::vec3& startPos, const glm::vec3* endPos, int count,
+	float* lengths, float maxCost)
+{
+	std::fill(lengths, lengths + count, -1.f);
+
+	glm::vec3 spos;
+	dtPolyRef startRef = FindStartPoly(startPos, &spos);
+	if (!startRef)
+		return PathResult::NoStartPoly;
+
+	m_targetRefs.resize(count);
+	m_targetPos.resize(count);
+	m_targetCosts.resize(count);
+
+	// Ends that aren't on the mesh, or can't be reached at all, are left out of the
+	// search. Otherwise it wouldn't stop until it had run out of polygons.
+	for (int i = 0; i < count; ++i)
+	{
+		m_targetRefs[i] = FindNearestPoly(endPos[i], &m_targetPos[i]);
+
+		if (IsDisconnected(startRef, m_targetRefs[i]))
+		{
+			m_targetRefs[i] = 0;
+		}
+	}
+
+	dtStatus status = m_query->findCostsToPolys(startRef, glm::value_ptr(spos),
+		m_targetRefs.data(), count, maxCost > 0.f ? maxCost : FLT_MAX, &m_filter, m_targetCosts.data());
+
+	NoteNodePoolUse(m_query.get());
+
+	if (dtStatusFailed(status))
+	{
+		SPDLOG_DEBUG("findCostsToPolys from {} failed.", startPos);
+		return PathResult::Failed;
+	}
+
+	if (dtStatusDetail(status, DT_OUT_OF_NODES))
+	{
+		SPDLOG_WARN("Couldn't increase size of node pool. existing: {}, limit: {}",
+			m_query->getNodePool()->getMaxNodes(), m_query->getNodePoolLimit());
+	}
+
+	if (m_polys.size() < MAX_STRAIGHT_PATH_LENGTH)
+	{
+		m_polys.resize(MAX_STRAIGHT_PATH_LENGTH);
+	}
+
+	m_lengthPath.Reset(MAX_STRAIGHT_PATH_LENGTH);
+
+	// The search leaves the way back to every polygon it reached, so each length only
+	// needs the straight path along its corridor.
+	for (int i = 0; i < count; ++i)
+	{
+		if (m_targetCosts[i] < 0.f)
+			continue;
+
+		int numPolys = 0;
+		status = m_query->getPathFromDijkstraSearch(m_targetRefs[i], m_polys.data(), &numPolys,
+			static_cast<int>(m_polys.size()));
+		if (dtStatusFailed(status) || dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+			continue;
+
+		status = m_query->findStraightPath(
+			glm::value_ptr(spos),
+			glm::value_ptr(m_targetPos[i]),
+			m_polys.data(),
+			numPolys,
+			glm::value_ptr(m_lengthPath.verts[0]),
+			m_lengthPath.flags.get(),
+			m_lengthPath.polys.get(),
+			&m_lengthPath.length,
+			MAX_STRAIGHT_PATH_LENGTH);
+		if (dtStatusFailed(status))
+			continue;
+
+		lengths[i] = m_lengthPath.GetLength();
+	}
+
+	return PathResult::Success;
+}
+
+PathResult PathPlanner::BeginPath(const glm::vec3& startPos, const glm::vec3& endPos)
+{
+	CancelPath();
+
+	glm::vec3 spos;
+	dtPolyRef startRef = FindStartPoly(startPos, &spos);
+	if (!startRef)
+		return PathResult::NoStartPoly;
+
+	glm::vec3 epos;
+	dtPolyRef endRef = FindNearestPoly(endPos, &epos);
+	if (!endRef)
+		return PathResult::NoEndPoly;
+
+	if (IsDisconnected(startRef, endRef))
+	{
+		SPDLOG_DEBUG("findPath from {} to {}: end is not connected to the start.", startPos, endPos);
+		return PathResult::Partial;
+	}
+
+	// a separate query, so that the corridor can still be repaired while this runs
+	if (!m_slicedQuery)
+	{
+		m_slicedQuery = m_source->GetQueryPool().Acquire(m_navMesh.get());
+		if (!m_slicedQuery)
+			return PathResult::Failed;
+
+		SetQueryHeuristic(m_slicedQuery.get());
+	}
+
+	if (m_polys.size() < MAX_STRAIGHT_PATH_LENGTH)
+	{
+		m_polys.resize(MAX_STRAIGHT_PATH_LENGTH);
+	}
+
+	m_sliced.startRef = startRef;
+	m_sliced.endRef = endRef;
+	m_sliced.startPos = startPos;
+	m_sliced.endPos = endPos;
+	m_sliced.meshStartPos = spos;
+	m_sliced.meshEndPos = epos;
+	m_sliced.restarts = 0;
+	m_sliced.window = 0;
+	m_sliced.route = PlanRoute(startRef, endRef, epos);
+	m_routePolys.clear();
+
+	return StartSlicedSearch();
+}
+
+PathResult PathPlanner::StartSlicedSearch()
+{
+	dtPolyRef startRef = m_sliced.startRef;
+	dtPolyRef endRef = m_sliced.endRef;
+	glm::vec3 spos = m_sliced.meshStartPos;
+	glm::vec3 epos = m_sliced.meshEndPos;
+
+	// following a route searches one window at a time
+	if (m_sliced.route)
+	{
+		if (m_sliced.window > 0)
+		{
+			startRef = m_waypointRefs[m_sliced.window - 1];
+			spos = m_waypointPos[m_sliced.window - 1];
+		}
+
+		endRef = m_waypointRefs[m_sliced.window];
+		epos = m_waypointPos[m_sliced.window];
+	}
+
+	dtStatus status = m_slicedQuery->initSlicedFindPath(
+		startRef, endRef,
+		glm::value_ptr(spos),
+		glm::value_ptr(epos), &m_filter);
+
+	if (dtStatusFailed(status))
+	{
+		SPDLOG_DEBUG("initSlicedFindPath from {} to {} failed.", m_sliced.startPos, m_sliced.endPos);
+		return PathResult::Failed;
+	}
+
+	m_sliced.active = true;
+	return PathResult::InProgress;
+}
+
+PathResult PathPlanner::ContinuePath(int maxIterations, StraightPath& path)
+{
+	if (!m_sliced.active)
+		return PathResult::Failed;
+
+	dtStatus status = m_slicedQuery->updateSlicedFindPath(std::max(maxIterations, 1), nullptr);
+	if (dtStatusInProgress(status))
+		return PathResult::InProgress;
+
+	m_sliced.active = false;
+	NoteNodePoolUse(m_slicedQuery.get());
+
+	int numPolys = 0;
+	if (dtStatusSucceed(status))
+	{
+		status = m_slicedQuery->finalizeSlicedFindPath(m_polys.data(), &numPolys, static_cast<int>(m_polys.size()));
+	}
+
+	// if it ran out of space, make more room and search again on the next call.
+	if (m_sliced.restarts < MAX_SEARCH_RETRIES && GrowSearchSpace(m_slicedQuery.get(), status))
+	{
+		m_sliced.restarts++;
+		return StartSlicedSearch();
+	}
+
+	const dtPolyRef* polys = m_polys.data();
+
+	if (m_sliced.route)
+	{
+		const dtPolyRef windowEnd = m_waypointRefs[m_sliced.window];
+
+		if (dtStatusFailed(status)
+			|| dtStatusDetail(status, DT_PARTIAL_RESULT | DT_OUT_OF_NODES | DT_BUFFER_TOO_SMALL)
+			|| numPolys == 0 || m_polys[numPolys - 1] != windowEnd)
+		{
+			SPDLOG_DEBUG("Couldn't follow the route through the tile graph, searching directly");
+
+			m_sliced.route = false;
+			m_sliced.restarts = 0;
+			return StartSlicedSearch();
+		}
+
+		AppendToRoute(numPolys);
+
+		if (++m_sliced.window < static_cast<int>(m_waypointRefs.size()))
+		{
+			m_sliced.restarts = 0;
+			return StartSlicedSearch();
+		}
+
+		RemoveRouteLoops();
+		polys = m_routePolys.data();
+		numPolys = static_cast<int>(m_routePolys.size());
+	}
+	else
+	{
+		PathResult result = CheckSearchResult(status, m_sliced.endRef, numPolys, m_sliced.startPos, m_sliced.endPos);
+		if (result != PathResult::Success)
+			return result;
+	}
+
+	if (!InitQuery())
+		return PathResult::Failed;
+
+	SetCorridor(m_sliced.startRef, m_sliced.meshStartPos, m_sliced.meshEndPos, polys, numPolys);
+	m_corridorEnd = m_sliced.endPos;
+	ExtractStraightPath(path);
+
+	return PathResult::Success;
+}
+
+void PathPlanner::CancelPath()
+{
+	m_sliced.active = false;
+}
+
+bool PathPlanner::GrowSearchSpace(dtNavMeshQuery* query, dtStatus status)
+{
+	bool retry = false;
+
+	// The node pool grows during the search, so running out of nodes means it has hit
+	// its limit and searching again won't help.
+	if (dtStatusDetail(status, DT_OUT_OF_NODES))
+	{
+		SPDLOG_WARN("Couldn't increase size of node pool. existing: {}, limit: {}",
+			query->getNodePool()->getMaxNodes(), query->getNodePoolLimit());
+	}
+
+	if (dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+	{
+		// need to expand polys buffer
+		int polysSize = static_cast<int>(m_polys.size());
+		int newPolysSize = static_cast<int>(polysSize * POLYS_GROWTH_FACTOR);
+		if (newPolysSize < POLYS_MAX_SIZE)
+		{
+			SPDLOG_DEBUG("Growing polys buffer: {}", newPolysSize);
+
+			m_polys.resize(newPolysSize);
+			retry = true;
+		}
+		else
+		{
+			SPDLOG_WARN("Couldn't increase size of polys buffer. size: {}", newPolysSize);
+		}
+	}
+
+	return retry;
+}
+
+void PathPlanner::NoteNodePoolUse(dtNavMeshQuery* query)
+{
+	if (query->getNodePool()->getNodeCount() > NAVMESH_QUERY_MAX_NODES)
+	{
+		m_lastLargeSearch = clock::now();
+	}
+}
+
+void PathPlanner::Trim()
+{
+	if (clock::now() - m_lastLargeSearch < m_shrinkDelay)
+		return;
+
+	auto shrink = [](dtNavMeshQuery* query)
+	{
+		if (query && query->getNodePool()->getMaxNodes() > NAVMESH_QUERY_MAX_NODES)
+		{
+			SPDLOG_DEBUG("Shrinking node pool from {} nodes", query->getNodePool()->getMaxNodes());
+
+			query->shrinkNodePool(NAVMESH_QUERY_MAX_NODES);
+		}
+	};
+
+	shrink(m_query.get());
+
+	// the sliced query holds the state of the search in progress
+	if (!m_sliced.active)
+	{
+		shrink(m_slicedQuery.get());
+	}
+}
+
+PathResult PathPlanner::CheckSearchResult(dtStatus status, dtPolyRef endRef, int numPolys,
+	const glm::vec3& startPos, const glm::vec3& endPos) const
+{
+	if (dtStatusFailed(status))
+	{
+		SPDLOG_DEBUG("findPath from {} to {} failed.", startPos, endPos);
+		return PathResult::Failed;
+	}
+
+	if (dtStatusDetail(status, DT_OUT_OF_NODES)
+		|| dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+	{
+		SPDLOG_DEBUG("findPath from {} to {} failed: incomplete result ({:#x})",
+			startPos, endPos, (status & DT_STATUS_DETAIL_MASK));
+		return PathResult::Incomplete;
+	}
+
+	if ((numPolys > 0 && (m_polys[numPolys - 1] != endRef))
+		|| dtStatusDetail(status, DT_PARTIAL_RESULT))
+	{
+		// Partial path, did not find path to target
+		SPDLOG_DEBUG("findPath from {} to {} returned a partial result.", startPos, endPos);
+		return PathResult::Partial;
+	}
+
+	return PathResult::Success;
+}
+
+bool PathPlanner::IsDisconnected(dtPolyRef startRef, dtPolyRef endRef) const
+{
+	return m_connectivity && startRef && endRef
+		&& !m_connectivity->MayBeConnected(*m_navMesh, startRef, endRef);
+}
+
+PathResult PathPlanner::UpdatePath(const glm::vec3& pos, const glm::vec3& endPos, StraightPath& path)
+{
+	// keep following the old path until the new one is ready
+	if (m_sliced.active)
+		return PathResult::InProgress;
+
+	if (!m_hasCorridor || !InitQuery())
+		return Replan(pos, endPos, path);
+
+	// tiles along the path may have been reloaded or disabled
+	if (!m_corridor.isValid(CORRIDOR_VALID_LOOKAHEAD, m_query.get(), &m_filter))
+	{
+		SPDLOG_DEBUG("Path corridor is no longer valid, replanning");
+		return Replan(pos, endPos, path);
+	}
+
+	// remember the front of the corridor, so we can tell if it was only trimmed
+	int oldCount = m_corridor.getPathCount();
+	dtPolyRef oldLast = m_corridor.getLastPoly();
+	dtPolyRef oldHead[CORRIDOR_HEAD_SIZE];
+	int headSize = std::min(oldCount, CORRIDOR_HEAD_SIZE);
+	std::copy(m_corridor.getPath(), m_corridor.getPath() + headSize, oldHead);
+
+	bool changed = false;
+
+	if (endPos != m_corridorEnd)
+	{
+		// the end is snapped to the mesh the same way a full search would do it
+		glm::vec3 meshEnd;
+		if (!FindNearestPoly(endPos, &meshEnd))
+			return PathResult::NoEndPoly;
+
+		if (!m_corridor.moveTargetPosition(glm::value_ptr(meshEnd), m_query.get(), &m_filter)
+			|| glm::distance(glm::make_vec3(m_corridor.getTarget()), meshEnd) > CORRIDOR_MAX_DRIFT)
+		{
+			return Replan(pos, endPos, path);
+		}
+
+		m_corridorEnd = endPos;
+		changed = true;
+	}
+
+	if (!m_corridor.movePosition(glm::value_ptr(pos), m_query.get(), &m_filter))
+		return Replan(pos, endPos, path);
+
+	// The corridor only moves along the surface of the mesh, so it gets left behind if
+	// we were moved some other way, like falling, knockback or an off-mesh link.
+	// Standing just off the edge of the mesh is fine though.
+	glm::vec3 corridorPos = glm::make_vec3(m_corridor.getPos());
+	auto drifted = [&](const glm::vec3& p)
+	{
+		return glm::distance(glm::vec2(corridorPos.x, corridorPos.z), glm::vec2(p.x, p.z)) > CORRIDOR_MAX_DRIFT
+			|| std::abs(corridorPos.y - p.y) > m_extents.y;
+	};
+
+	glm::vec3 meshPos;
+	if (drifted(pos) && (!FindNearestPoly(pos, &meshPos) || drifted(meshPos)))
+	{
+		SPDLOG_DEBUG("Left the path corridor at {}, replanning", pos);
+		return Replan(pos, endPos, path);
+	}
+
+	// the corridor has followed the polygon we're on
+	m_startRef = m_corridor.getFirstPoly();
+	m_startPos = corridorPos;
+
+	// shortcut the corridor towards the next corner, and look for a better route locally
+	float corners[2 * 3];
+	uint8_t cornerFlags[2];
+	dtPolyRef cornerPolys[2];
+	int numCorners = m_corridor.findCorners(corners, cornerFlags, cornerPolys, 2, m_query.get(), &m_filter);
+	if (numCorners > 0 && !(cornerFlags[numCorners - 1] & DT_STRAIGHTPATH_OFFMESH_CONNECTION))
+	{
+		m_corridor.optimizePathVisibility(&corners[(numCorners - 1) * 3], CORRIDOR_OPTIMIZE_RANGE,
+			m_query.get(), &m_filter);
+	}
+
+	m_corridor.optimizePathTopology(m_query.get(), &m_filter);
+
+	// If we've just moved along the corridor, the front of it was removed and the rest
+	// is the same, so the straight path that is being followed is still good.
+	int newCount = m_corridor.getPathCount();
+	int trimmed = oldCount - newCount;
+	if (trimmed < 0
+		|| trimmed >= headSize
+		|| m_corridor.getPath()[0] != oldHead[trimmed]
+		|| m_corridor.getLastPoly() != oldLast)
+	{
+		changed = true;
+	}
+
+	if (!changed)
+		return PathResult::Unchanged;
+
+	ExtractStraightPath(path);
+	return PathResult::Success;
+}
+
+PathResult PathPlanner::Replan(const glm::vec3& pos, const glm::vec3& endPos, StraightPath& path)
+{
+	// reading the path off a flow field is quicker than handing the search off
+	if (HasFlowFieldTo(endPos))
+		return FindPath(pos, endPos, path);
+
+	if (m_deferSearches)
+		return PathResult::Deferred;
+
+	if (m_sliceIterations > 0)
+		return BeginPath(pos, endPos);
+
+	return FindPath(pos, endPos, path);
+}
+
+void PathPlanner::SetCorridor(dtPolyRef startRef, const glm::vec3& startPos, const glm::vec3& targetPos,
+	const dtPolyRef* polys, int numPolys)
+{
+	if (numPolys == 0)
+	{
+		m_hasCorridor = false;
+		return;
+	}
+
+	// The corridor only allocates when a longer path comes along. It needs room for one
+	// more polygon than the path.
+	if (numPolys >= m_corridorMaxPath)
+	{
+		m_corridorMaxPath = std::max(numPolys + 1, MAX_STRAIGHT_PATH_LENGTH);
+		m_corridor.init(m_corridorMaxPath);
+	}
+
+	m_corridor.reset(startRef, glm::value_ptr(startPos));
+	m_corridor.setCorridor(glm::value_ptr(targetPos), polys, numPolys);
+	m_hasCorridor = true;
+}
+
+void PathPlanner::SetCorridor(const dtPolyRef* polys, int numPolys, const glm::vec3& startPos,
+	const glm::vec3& targetPos, const glm::vec3& endPos)
+{
+	SetCorridor(numPolys > 0 ? polys[0] : 0, startPos, targetPos, polys, numPolys);
+	m_corridorEnd = endPos;
+}
+
+void PathPlanner::ExtractStraightPath(StraightPath& path)
+{
+	// doesn't reallocate if the path was used before
+	path.Reset(MAX_STRAIGHT_PATH_LENGTH);
+
+	if (m_hasCorridor)
+	{
+		m_query->findStraightPath(
+			m_corridor.getPos(),
+			m_corridor.getTarget(),
+			m_corridor.getPath(),
+			m_corridor.getPathCount(),
+			glm::value_ptr(path.verts[0]),
+			path.flags.get(),
+			path.polys.get(),
+			&path.length,
+			MAX_STRAIGHT_PATH_LENGTH,
+			DT_STRAIGHTPATH_AREA_CROSSINGS);
+	}
+}
@@ -0,0 +1,288 @@
+//
+// PathPlanner.h
+//
+
+#pragma once
+
+#include "common/NavMeshQueryPool.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourPathCorridor.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <chrono>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+class FlowFieldSet;
+class LandmarkHeuristic;
+class NavMesh;
+class PathCache;
+class PolyConnectivity;
+class TileGraph;
+class TileGraphSearch;
+
+//----------------------------------------------------------------------------
+
+struct StraightPath
+{
+	StraightPath() = default;
+	StraightPath(int size) { Reset(size); }
+
+	std::unique_ptr<glm::vec3[]> verts;
+	std::unique_ptr<uint8_t[]> flags;
+	std::unique_ptr<dtPolyRef[]> polys;
+	int length = 0;
+	int cursor = 0;
+
+	void Reset(int size);
+	int GetAllocatedSize() { return alloc; }
+
+	// empties the path but keeps the buffers
+	void Clear() { length = 0; cursor = 0; }
+
+	// total distance along the path
+	float GetLength() const;
+
+	using Node = std::tuple<glm::vec3, uint8_t, dtPolyRef>;
+
+	inline Node GetNode(int pos) const
+	{
+		if (pos >= length)
+			return { {}, 0, 0 };
+
+		return { verts[pos], flags[pos], polys[pos] };
+	}
+
+private:
+	int alloc = 0;
+};
+
+//----------------------------------------------------------------------------
+
+enum struct PathResult
+{
+	Success,
+	NoStartPoly,          // nothing on the navmesh near the start position
+	NoEndPoly,            // nothing on the navmesh near the end position
+	Failed,               // the search failed
+	Incomplete,           // ran out of search nodes or path space before reaching the end
+	Partial,              // the end can't be reached from the start
+	Unchanged,            // the previous path can still be followed
+	InProgress,           // a sliced search hasn't finished yet
+	Deferred,             // a full search is needed, and was left to the caller
+};
+
+// Plans paths across a navmesh. This only depends on detour and the navmesh, so it
+// can be used outside of the game. Positions are in navmesh coordinates. Not
+// thread-safe, each thread needs its own planner.
+//
+// The query comes from the navmesh's query pool and the search buffers are kept
+// between searches, so reusing a planner doesn't allocate once it has warmed up.
+class PathPlanner
+{
+public:
+	PathPlanner();
+	~PathPlanner();
+
+	PathPlanner(const PathPlanner&) = delete;
+	PathPlanner& operator=(const PathPlanner&) = delete;
+
+	// Picks up the navmesh and area costs to plan with. This needs to be called
+	// again when the navmesh changes.
+	void SetNavMesh(NavMesh* navMesh);
+
+	dtNavMesh* GetNavMesh() const { return m_navMesh.get(); }
+
+	// the query used for planning. nullptr until the first search.
+	dtNavMeshQuery* GetNavMeshQuery() const { return m_query.get(); }
+
+	// Gives the queries back to the pool. The next search takes another one. A sliced
+	// search in progress keeps its query.
+	void ReleaseQuery();
+
+	const dtQueryFilter& GetFilter() const { return m_filter; }
+
+	// size of the box that is searched for the polygons under the start and end
+	void SetExtents(const glm::vec3& extents) { m_extents = extents; }
+	const glm::vec3& GetExtents() const { return m_extents; }
+
+	// Finds the polygon nearest to pos, and the nearest point on it. Returns 0 if
+	// there is nothing within the extents.
+	dtPolyRef FindNearestPoly(const glm::vec3& pos, glm::vec3* nearestPos = nullptr);
+
+	// Finds the polygon under a position that searches start from. The polygon is followed
+	// along the surface from the last start position, so the extents are only searched
+	// after teleporting or leaving the mesh. This also keeps to the right level where
+	// levels are stacked within the extents.
+	dtPolyRef FindStartPoly(const glm::vec3& pos, glm::vec3* nearestPos = nullptr);
+
+	// Finds a path from startPos to endPos. The node pool is grown and the search is
+	// retried if it runs out of space. The path is only filled in on success, and
+	// its buffers are reused if they are already big enough.
+	//
+	// Paths to the target of one of the navmesh's flow fields are read off the field
+	// without a search. Long paths are planned through the navmesh's tile graph first,
+	// and then searched a few tiles at a time along the way it picked. The direct search
+	// is used if that doesn't work out.
+	PathResult FindPath(const glm::vec3& startPos, const glm::vec3& endPos, StraightPath& path);
+
+	// Finds the lengths of the paths from startPos to each of count end positions, with
+	// one search out from the start instead of a search per end. The search stops once
+	// it has reached every end, or once the search cost passes maxCost (0 for no limit).
+	// Lengths are -1 for ends that weren't reached.
+	PathResult FindPathLengths(const glm::vec3& startPos, const glm::vec3* endPos, int count,
+		float* lengths, float maxCost = 0.f);
+
+	// Remember the searches done by FindPath in a cache, and reuse them when a search
+	// between the same polygons comes up again. The cache can be shared by planners on
+	// the same thread.
+	void SetPathCache(PathCache* cache) { m_cache = cache; }
+	PathCache* GetPathCache() const { return m_cache; }
+
+	// Follows the last path found by FindPath from a new position. The polygon corridor
+	// of that path is moved along with the position and repaired locally, and a full
+	// search is only done if the corridor can't be repaired. Returns Unchanged if the
+	// previous path can still be followed, in which case path isn't touched.
+	//
+	// If slicing is enabled, the full search is started as a sliced search and this
+	// returns InProgress until ContinuePath finishes it. If searches are deferred, this
+	// returns Deferred instead, and the search is left to the caller.
+	PathResult UpdatePath(const glm::vec3& pos, const glm::vec3& endPos, StraightPath& path);
+
+	// Starts a search that is run a bit at a time by ContinuePath, so that a long
+	// search doesn't hold everything else up. Returns InProgress if it was started.
+	PathResult BeginPath(const glm::vec3& startPos, const glm::vec3& endPos);
+
+	// Runs the sliced search for up to maxIterations. Returns InProgress until it
+	// finishes, and then the same results as FindPath.
+	PathResult ContinuePath(int maxIterations, StraightPath& path);
+	void CancelPath();
+	bool IsPathInProgress() const { return m_sliced.active; }
+
+	// number of search iterations per call to ContinuePath when UpdatePath needs
+	// to search again. 0 searches all at once.
+	void SetSliceIterations(int iterations) { m_sliceIterations = iterations; }
+	int GetSliceIterations() const { return m_sliceIterations; }
+
+	// have UpdatePath return Deferred when it needs a full search, so that the search
+	// can be done somewhere else. The result is handed back with SetCorridor.
+	void SetDeferSearches(bool defer) { m_deferSearches = defer; }
+	bool GetDeferSearches() const { return m_deferSearches; }
+
+	// Node pools grow during searches that need a lot of nodes. Trim shrinks them back
+	// once no search has needed the extra nodes for the shrink delay. This should be
+	// called every so often by whoever owns the planner.
+	void Trim();
+	void SetShrinkDelay(std::chrono::milliseconds delay) { m_shrinkDelay = delay; }
+	std::chrono::milliseconds GetShrinkDelay() const { return m_shrinkDelay; }
+
+	// forget the corridor, so the next update does a full search.
+	void ResetCorridor() { m_hasCorridor = false; }
+	bool HasCorridor() const { return m_hasCorridor; }
+
+	// polygons of the path being followed
+	const dtPolyRef* GetCorridorPath() const { return m_corridor.getPath(); }
+	int GetCorridorPathCount() const { return m_hasCorridor ? m_corridor.getPathCount() : 0; }
+	glm::vec3 GetCorridorPos() const { return glm::make_vec3(m_corridor.getPos()); }
+	glm::vec3 GetCorridorTarget() const { return glm::make_vec3(m_corridor.getTarget()); }
+
+	// Follow a path that was found by another planner. startPos and targetPos are the
+	// ends of the corridor on the mesh, endPos is the end position that was asked for.
+	// The corridor is checked on the next update, so it's fine if the navmesh has
+	// changed since.
+	void SetCorridor(const dtPolyRef* polys, int numPolys, const glm::vec3& startPos,
+		const glm::vec3& targetPos, const glm::vec3& endPos);
+
+private:
+	bool InitQuery();
+	void SetQueryHeuristic(dtNavMeshQuery* query);
+	dtPolyRef TrackStartPoly(const glm::vec3& pos);
+	PathResult Replan(const glm::vec3& pos, const glm::vec3& endPos, StraightPath& path);
+	PathResult StartSlicedSearch();
+	bool GrowSearchSpace(dtNavMeshQuery* query, dtStatus status);
+	void NoteNodePoolUse(dtNavMeshQuery* query);
+	PathResult CheckSearchResult(dtStatus status, dtPolyRef endRef, int numPolys,
+		const glm::vec3& startPos, const glm::vec3& endPos) const;
+	bool IsDisconnected(dtPolyRef startRef, dtPolyRef endRef) const;
+	bool FollowFlowField(dtPolyRef startRef, dtPolyRef endRef, int& numPolys);
+	bool HasFlowFieldTo(const glm::vec3& endPos);
+	dtStatus SearchCorridor(dtPolyRef startRef, dtPolyRef endRef, const glm::vec3& spos,
+		const glm::vec3& epos, int& numPolys);
+
+	bool PlanRoute(dtPolyRef startRef, dtPolyRef endRef, const glm::vec3& epos);
+	bool SearchRoute(dtPolyRef startRef, const glm::vec3& spos);
+	void AppendToRoute(int numPolys);
+	void RemoveRouteLoops();
+
+	void SetCorridor(dtPolyRef startRef, const glm::vec3& startPos, const glm::vec3& targetPos,
+		const dtPolyRef* polys, int numPolys);
+	void ExtractStraightPath(StraightPath& path);
+
+	NavMesh* m_source = nullptr;
+	std::shared_ptr<dtNavMesh> m_navMesh;
+	std::shared_ptr<const PolyConnectivity> m_connectivity;
+	std::shared_ptr<const TileGraph> m_tileGraph;
+	std::shared_ptr<const FlowFieldSet> m_flowFields;
+	std::unique_ptr<LandmarkHeuristic> m_heuristic;
+	NavMeshQueryPool::Query m_query;
+	dtQueryFilter m_filter;
+	uint64_t m_filterHash = 0;
+	PathCache* m_cache = nullptr;
+
+	// scratch space for the polygon corridor
+	std::vector<dtPolyRef> m_polys;
+
+	// scratch space for FindPathLengths
+	std::vector<dtPolyRef> m_targetRefs;
+	std::vector<glm::vec3> m_targetPos;
+	std::vector<float> m_targetCosts;
+	StraightPath m_lengthPath;
+
+	// The route through the tile graph. It is searched in windows that end at each of
+	// the waypoints, and the corridors of the windows are joined up in m_routePolys.
+	std::unique_ptr<TileGraphSearch> m_routeSearch;
+	std::vector<uint32_t> m_route;
+	std::vector<dtPolyRef> m_waypointRefs;
+	std::vector<glm::vec3> m_waypointPos;
+	std::vector<dtPolyRef> m_routePolys;
+	std::unordered_map<dtPolyRef, size_t> m_routeSeen;
+
+	// the polygon that the last search started from
+	dtPolyRef m_startRef = 0;
+	glm::vec3 m_startPos;
+
+	// the path being followed
+	dtPathCorridor m_corridor;
+	int m_corridorMaxPath = 0;
+	glm::vec3 m_corridorEnd;          // the end position that was asked for
+	bool m_hasCorridor = false;
+
+	// the sliced search, which has its own query
+	struct SlicedSearch
+	{
+		dtPolyRef startRef = 0;
+		dtPolyRef endRef = 0;
+		glm::vec3 startPos;
+		glm::vec3 endPos;
+		glm::vec3 meshStartPos;
+		glm::vec3 meshEndPos;
+		int restarts = 0;
+		int window = 0;           // the window being searched, if following a route
+		bool route = false;
+		bool active = false;
+	};
+	SlicedSearch m_sliced;
+	NavMeshQueryPool::Query m_slicedQuery;
+	int m_sliceIterations = 0;
+	bool m_deferSearches = false;
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point m_lastLargeSearch;
+	std::chrono::milliseconds m_shrinkDelay{ 30000 };
+	glm::vec3 m_extents = { 5, 10, 5 }; // note: X, Z, Y
+};
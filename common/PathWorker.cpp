@@ -0,0 +1,231 @@
+//
+// PathWorker.cpp
+//
+
+#include "PathWorker.h"
+
+#include "common/NavMesh.h"
+
+//----------------------------------------------------------------------------
+// constants
+
+// Searches that haven't been handed back yet. Both queues are this big, so
+// results always fit.
+const int MAX_OUTSTANDING_REQUESTS = 16;
+
+// how many search iterations are run between checks for cancellation
+const int WORKER_SLICE_ITERATIONS = 512;
+
+//----------------------------------------------------------------------------
+
+PathWorker::PathWorker(NavMesh* navMesh)
+	: m_navMesh(navMesh)
+	, m_requests(MAX_OUTSTANDING_REQUESTS)
+	, m_results(MAX_OUTSTANDING_REQUESTS)
+{
+}
+
+PathWorker::~PathWorker()
+{
+	Shutdown();
+}
+
+void PathWorker::Initialize()
+{
+	if (m_thread.joinable())
+		return;
+
+	// tiles are about to be added or removed, stop reading them.
+	m_meshChangingConn = m_navMesh->OnNavMeshChanging.Connect(
+		[this]() { Pause(); });
+
+	// the navmesh might have been replaced, so pick it up again while paused.
+	m_meshChangedConn = m_navMesh->OnNavMeshChanged.Connect(
+		[this]()
+	{
+		Pause();
+		m_planner.SetNavMesh(m_navMesh);
+		Resume();
+	});
+
+	m_planner.SetNavMesh(m_navMesh);
+
+	m_stop = false;
+	m_paused = false;
+	m_thread = std::thread([this]() { Run(); });
+}
+
+void PathWorker::Shutdown()
+{
+	m_meshChangingConn.Disconnect();
+	m_meshChangedConn.Disconnect();
+
+	if (m_thread.joinable())
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	// nothing else is using the queues now
+	std::shared_ptr<PathRequest> request;
+	while (m_requests.Pop(request)) {}
+	while (m_results.Pop(request)) {}
+
+	m_current.reset();
+	m_outstanding = 0;
+
+	m_planner.SetNavMesh(nullptr);
+}
+
+void PathWorker::OnPulse()
+{
+	// Tiles that are loaded over several pulses only raise OnNavMeshChanged at the
+	// end, but nothing is touching them in between pulses.
+	if (m_paused)
+	{
+		Resume();
+	}
+
+	std::shared_ptr<PathRequest> request;
+	while (m_results.Pop(request))
+	{
+		--m_outstanding;
+
+		if (!request->IsCancelled() && request->onComplete)
+		{
+			request->onComplete(*request);
+		}
+	}
+}
+
+bool PathWorker::Submit(const std::shared_ptr<PathRequest>& request)
+{
+	if (!m_thread.joinable() || m_outstanding >= MAX_OUTSTANDING_REQUESTS)
+		return false;
+
+	std::shared_ptr<PathRequest> queued = request;
+	if (!m_requests.Push(std::move(queued)))
+		return false;
+
+	++m_outstanding;
+
+	// the lock makes sure the worker is either waiting or will see the request
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+	}
+	m_wake.notify_one();
+
+	return true;
+}
+
+void PathWorker::Pause()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_paused = true;
+
+	m_idle.wait(lock, [this]() { return !m_busy; });
+}
+
+void PathWorker::Resume()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_paused = false;
+	}
+
+	m_wake.notify_one();
+}
+
+//----------------------------------------------------------------------------
+// worker thread
+
+void PathWorker::Run()
+{
+	while (WaitForWork())
+	{
+		if (!m_current)
+		{
+			m_requests.Pop(m_current);
+		}
+
+		// an interrupted search is kept and started again once we are resumed.
+		if (m_current && Search(*m_current))
+		{
+			m_results.Push(std::move(m_current));
+			m_current.reset();
+
+			// Nothing else to do, so hand the queries back to the pool. It shrinks
+			// them if a big search grew them and they aren't needed again.
+			if (m_requests.IsEmpty())
+			{
+				m_planner.ReleaseQuery();
+			}
+		}
+
+		FinishWork();
+	}
+}
+
+bool PathWorker::WaitForWork()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_wake.wait(lock, [this]()
+	{
+		return m_stop || (!m_paused && (m_current || !m_requests.IsEmpty()));
+	});
+
+	if (m_stop)
+		return false;
+
+	m_busy = true;
+	return true;
+}
+
+void PathWorker::FinishWork()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_busy = false;
+	}
+
+	m_idle.notify_all();
+}
+
+bool PathWorker::Search(PathRequest& request)
+{
+	// superseded before we got to it
+	if (request.IsCancelled())
+		return true;
+
+	m_planner.SetExtents(request.extents);
+
+	PathResult result = m_planner.BeginPath(request.startPos, request.endPos);
+	while (result == PathResult::InProgress)
+	{
+		if (m_paused || m_stop || request.IsCancelled())
+		{
+			m_planner.CancelPath();
+			return request.IsCancelled();
+		}
+
+		result = m_planner.ContinuePath(WORKER_SLICE_ITERATIONS, request.path);
+	}
+
+	request.result = result;
+
+	if (result == PathResult::Success)
+	{
+		const dtPolyRef* polys = m_planner.GetCorridorPath();
+		request.corridor.assign(polys, polys + m_planner.GetCorridorPathCount());
+		request.meshStartPos = m_planner.GetCorridorPos();
+		request.meshEndPos = m_planner.GetCorridorTarget();
+	}
+
+	return true;
+}
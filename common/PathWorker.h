@@ -0,0 +1,115 @@
+//
+// PathWorker.h
+//
+
+#pragma once
+
+#include "common/NavModule.h"
+#include "common/PathPlanner.h"
+#include "common/SpscQueue.h"
+
+#include <glm/glm.hpp>
+#include <mq/base/Signal.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class NavMesh;
+
+//----------------------------------------------------------------------------
+
+// A path search to be run by the PathWorker. The owner keeps hold of the request
+// so that it can cancel it when it is superseded.
+struct PathRequest
+{
+	// filled in by the owner
+	glm::vec3 startPos;
+	glm::vec3 endPos;
+	glm::vec3 extents = { 5, 10, 5 }; // note: X, Z, Y
+
+	// called on the game thread once the search has finished, unless it was cancelled.
+	std::function<void(PathRequest&)> onComplete;
+
+	// filled in by the worker
+	PathResult result = PathResult::InProgress;
+	StraightPath path;
+	std::vector<dtPolyRef> corridor;
+	glm::vec3 meshStartPos;
+	glm::vec3 meshEndPos;
+
+	// can be called from any thread. onComplete won't be called after this.
+	void Cancel() { m_cancelled = true; }
+	bool IsCancelled() const { return m_cancelled; }
+
+private:
+	std::atomic<bool> m_cancelled{ false };
+};
+
+//----------------------------------------------------------------------------
+
+// Runs path searches on a background thread, so that long searches don't stall the
+// game. The worker has its own planner and queries over the shared navmesh, and only
+// reads from it. Requests and results are passed through lock-free queues, and the
+// results are handed back in OnPulse, so the game thread only ever sees finished
+// paths.
+//
+// Searches are stopped while the navmesh is being changed, and started again
+// afterwards.
+class PathWorker : public NavModule
+{
+public:
+	PathWorker(NavMesh* navMesh);
+	virtual ~PathWorker();
+
+	virtual void Initialize() override;
+	virtual void Shutdown() override;
+
+	// hands back finished searches
+	virtual void OnPulse() override;
+
+	// Queues a search. Returns false if the worker isn't running or has too many
+	// searches outstanding, in which case the caller should search itself.
+	bool Submit(const std::shared_ptr<PathRequest>& request);
+
+	bool IsRunning() const { return m_thread.joinable(); }
+
+	// number of searches that haven't been handed back yet
+	int GetOutstandingCount() const { return m_outstanding; }
+
+	// Stops the worker from touching the navmesh until Resume is called. Blocks until
+	// the search in progress has stopped. That search is started again on resume.
+	void Pause();
+	void Resume();
+
+private:
+	void Run();
+	bool WaitForWork();
+	void FinishWork();
+	bool Search(PathRequest& request);
+
+	NavMesh* m_navMesh;
+
+	// only used by the worker thread, or while it is paused
+	PathPlanner m_planner;
+	std::shared_ptr<PathRequest> m_current;
+
+	SpscQueue<std::shared_ptr<PathRequest>> m_requests;
+	SpscQueue<std::shared_ptr<PathRequest>> m_results;
+	int m_outstanding = 0;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::atomic<bool> m_stop{ false };
+	std::atomic<bool> m_paused{ false };
+	bool m_busy = false;
+
+	mq::Signal<>::ScopedConnection m_meshChangingConn;
+	mq::Signal<>::ScopedConnection m_meshChangedConn;
+};
@@ -0,0 +1,156 @@
+//
+// PolyConnectivity.cpp
+//
+
+#include "PolyConnectivity.h"
+
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+
+PolyConnectivity::PolyConnectivity()
+{
+}
+
+PolyConnectivity::~PolyConnectivity()
+{
+}
+
+void PolyConnectivity::Build(const dtNavMesh& navMesh, uint16_t excludeFlags)
+{
+	Clear();
+
+	m_excludeFlags = excludeFlags;
+	m_tiles.resize(navMesh.getMaxTiles());
+
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		m_tiles[i].tileRef = navMesh.getTileRef(tile);
+		m_tiles[i].components.assign(tile->header->polyCount, 0);
+	}
+
+	// Floods only follow links forwards, so a flood that crosses a one-way connection
+	// can run into a component that was flooded earlier. The two are joined afterwards.
+	std::vector<uint32_t> parent(1, 0);
+	auto findRoot = [&parent](uint32_t component)
+	{
+		while (parent[component] != component)
+		{
+			parent[component] = parent[parent[component]];
+			component = parent[component];
+		}
+
+		return component;
+	};
+
+	std::vector<dtPolyRef> openList;
+
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		const dtPolyRef base = navMesh.getPolyRefBase(tile);
+
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			if (m_tiles[i].components[j] != 0 || (tile->polys[j].flags & excludeFlags))
+				continue;
+
+			const uint32_t component = static_cast<uint32_t>(parent.size());
+			parent.push_back(component);
+
+			FloodNavMesh(&navMesh, base | (dtPolyRef)j, openList, [&](dtPolyRef ref)
+			{
+				const dtMeshTile* neiTile = nullptr;
+				const dtPoly* neiPoly = nullptr;
+				navMesh.getTileAndPolyByRefUnsafe(ref, &neiTile, &neiPoly);
+
+				if (neiPoly->flags & excludeFlags)
+					return false;
+
+				uint32_t& current = m_tiles[navMesh.decodePolyIdTile(ref)].components[navMesh.decodePolyIdPoly(ref)];
+				if (current == component)
+					return false;
+
+				if (current != 0)
+				{
+					parent[findRoot(current)] = findRoot(component);
+					return false;
+				}
+
+				current = component;
+				return true;
+			});
+		}
+	}
+
+	// renumber the joined components so that the ids have no gaps
+	std::vector<uint32_t> ids(parent.size(), 0);
+
+	for (TileComponents& tile : m_tiles)
+	{
+		for (uint32_t& component : tile.components)
+		{
+			if (component == 0)
+				continue;
+
+			uint32_t& id = ids[findRoot(component)];
+			if (id == 0)
+			{
+				id = ++m_componentCount;
+			}
+
+			component = id;
+		}
+	}
+}
+
+void PolyConnectivity::SetTile(const dtNavMesh& navMesh, dtTileRef tileRef, std::vector<uint32_t> components)
+{
+	const unsigned int tileIndex = navMesh.decodePolyIdTile(tileRef);
+	if (tileIndex >= m_tiles.size())
+	{
+		m_tiles.resize(std::max<size_t>(tileIndex + 1, navMesh.getMaxTiles()));
+	}
+
+	m_tiles[tileIndex].tileRef = tileRef;
+	m_tiles[tileIndex].components = std::move(components);
+}
+
+void PolyConnectivity::Clear()
+{
+	m_tiles.clear();
+	m_componentCount = 0;
+	m_excludeFlags = 0;
+}
+
+uint32_t PolyConnectivity::GetComponent(const dtNavMesh& navMesh, dtPolyRef ref) const
+{
+	if (!ref)
+		return 0;
+
+	unsigned int salt, tileIndex, polyIndex;
+	navMesh.decodePolyId(ref, salt, tileIndex, polyIndex);
+
+	if (tileIndex >= m_tiles.size())
+		return 0;
+
+	// the tile has been replaced since the components were worked out
+	const TileComponents& tile = m_tiles[tileIndex];
+	if (!tile.tileRef || navMesh.decodePolyIdSalt(tile.tileRef) != salt || polyIndex >= tile.components.size())
+		return 0;
+
+	return tile.components[polyIndex];
+}
+
+bool PolyConnectivity::MayBeConnected(const dtNavMesh& navMesh, dtPolyRef from, dtPolyRef to) const
+{
+	uint32_t fromComponent = GetComponent(navMesh, from);
+	uint32_t toComponent = GetComponent(navMesh, to);
+
+	return fromComponent == 0 || toComponent == 0 || fromComponent == toComponent;
+}
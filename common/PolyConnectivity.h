@@ -0,0 +1,102 @@
+//
+// PolyConnectivity.h
+//
+
+#pragma once
+
+#include <DetourNavMesh.h>
+
+#include <cstdint>
+#include <vector>
+
+// Visits the polygons that can be reached from start by following links, including
+// off-mesh connections. visit is called with each polygon as it is reached, starting
+// with start, and returns false if the polygon shouldn't be entered.
+template <typename Visit>
+void FloodNavMesh(const dtNavMesh* navMesh, dtPolyRef start, std::vector<dtPolyRef>& openList, Visit&& visit)
+{
+	openList.clear();
+
+	if (!visit(start))
+		return;
+
+	openList.push_back(start);
+
+	while (!openList.empty())
+	{
+		const dtPolyRef ref = openList.back();
+		openList.pop_back();
+
+		// Get current poly and tile.
+		// The API input has been checked already, skip checking internal data.
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+
+		// Visit linked polygons.
+		for (auto i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtPolyRef neiRef = tile->links[i].ref;
+
+			if (neiRef && visit(neiRef))
+			{
+				openList.push_back(neiRef);
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// Splits the polygons of a navmesh into components, the regions that are connected
+// to each other by links and off-mesh connections. Polygons in different components
+// can't reach each other, which can be answered without a search. One-way connections
+// join components too, so being in the same component doesn't mean there is a path.
+//
+// Component ids start at 1. Polygons that were left out or that are in tiles that
+// have changed since have no component.
+class PolyConnectivity
+{
+public:
+	struct TileComponents
+	{
+		dtTileRef tileRef = 0;
+		std::vector<uint32_t> components; // by polygon index
+	};
+
+	PolyConnectivity();
+	~PolyConnectivity();
+
+	// Works out the components of every tile in the navmesh. Polygons with any of
+	// excludeFlags set are left out, and don't join anything together.
+	void Build(const dtNavMesh& navMesh, uint16_t excludeFlags);
+
+	// Adds the components of a tile that were worked out earlier, eg. by a build
+	// that was saved.
+	void SetTile(const dtNavMesh& navMesh, dtTileRef tileRef, std::vector<uint32_t> components);
+
+	void Clear();
+
+	bool IsEmpty() const { return m_componentCount == 0; }
+
+	// returns 0 if the component of the polygon isn't known
+	uint32_t GetComponent(const dtNavMesh& navMesh, dtPolyRef ref) const;
+
+	// False if there is no way from one polygon to the other. True if there might be,
+	// or if either one isn't known.
+	bool MayBeConnected(const dtNavMesh& navMesh, dtPolyRef from, dtPolyRef to) const;
+
+	uint32_t GetComponentCount() const { return m_componentCount; }
+	void SetComponentCount(uint32_t count) { m_componentCount = count; }
+
+	uint16_t GetExcludeFlags() const { return m_excludeFlags; }
+	void SetExcludeFlags(uint16_t flags) { m_excludeFlags = flags; }
+
+	// by tile index. Slots without a tile have a zero tile ref.
+	const std::vector<TileComponents>& GetTiles() const { return m_tiles; }
+
+private:
+	std::vector<TileComponents> m_tiles;
+	uint32_t m_componentCount = 0;
+	uint16_t m_excludeFlags = 0;
+};
@@ -0,0 +1,359 @@
+//
+// PolyGrid.cpp
+//
+
+#include "PolyGrid.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// cells per tile side when the cell size isn't given
+static const int POLYGRID_CELLS_PER_TILE = 2;
+
+// the cell size grows until the grid has no more cells than this
+static const size_t POLYGRID_MAX_CELLS = 4 * 1024 * 1024;
+
+//----------------------------------------------------------------------------
+
+static bool PassesFilter(const dtQueryFilter& filter, const dtPoly* poly)
+{
+	return (poly->flags & filter.getIncludeFlags()) != 0
+		&& (poly->flags & filter.getExcludeFlags()) == 0;
+}
+
+// Quantized bounds of a polygon in a tile without a bounding volume tree, worked out the
+// way that the tree would have them.
+static void GetPolyBounds(const dtMeshTile* tile, int polyIndex, uint16_t* bmin, uint16_t* bmax)
+{
+	const dtPoly* poly = &tile->polys[polyIndex];
+	const glm::vec3 tbmin = glm::make_vec3(tile->header->bmin);
+	const float qfac = tile->header->bvQuantFactor;
+
+	glm::vec3 vmin = glm::make_vec3(&tile->verts[poly->verts[0] * 3]);
+	glm::vec3 vmax = vmin;
+	for (int i = 1; i < poly->vertCount; ++i)
+	{
+		const glm::vec3 v = glm::make_vec3(&tile->verts[poly->verts[i] * 3]);
+		vmin = glm::min(vmin, v);
+		vmax = glm::max(vmax, v);
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		bmin[i] = static_cast<uint16_t>(std::clamp(static_cast<int>((vmin[i] - tbmin[i]) * qfac), 0, 0xffff));
+		bmax[i] = static_cast<uint16_t>(std::clamp(static_cast<int>(std::ceil((vmax[i] - tbmin[i]) * qfac)), 0, 0xffff));
+	}
+}
+
+// The search box in the quantized space of a tile, the same as queryPolygonsInTile has it.
+static void QuantizeBox(const dtMeshTile* tile, const glm::vec3& qmin, const glm::vec3& qmax,
+	uint16_t* bmin, uint16_t* bmax)
+{
+	const glm::vec3 tbmin = glm::make_vec3(tile->header->bmin);
+	const glm::vec3 tbmax = glm::make_vec3(tile->header->bmax);
+	const float qfac = tile->header->bvQuantFactor;
+
+	const glm::vec3 minPos = glm::clamp(qmin, tbmin, tbmax) - tbmin;
+	const glm::vec3 maxPos = glm::clamp(qmax, tbmin, tbmax) - tbmin;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		bmin[i] = static_cast<uint16_t>(qfac * minPos[i]) & 0xfffe;
+		bmax[i] = static_cast<uint16_t>(qfac * maxPos[i] + 1) | 1;
+	}
+}
+
+static bool OverlapQuantBounds(const uint16_t* amin, const uint16_t* amax, const uint16_t* bmin, const uint16_t* bmax)
+{
+	return amin[0] <= bmax[0] && amax[0] >= bmin[0]
+		&& amin[1] <= bmax[1] && amax[1] >= bmin[1]
+		&& amin[2] <= bmax[2] && amax[2] >= bmin[2];
+}
+
+// Whether the box overlaps the bounds of a polygon in a tile without a bounding volume
+// tree. Detour tests the bounds of its vertices then, without quantizing them.
+static bool OverlapPolyBounds(const dtMeshTile* tile, const dtPoly* poly, const glm::vec3& qmin, const glm::vec3& qmax)
+{
+	glm::vec3 vmin = glm::make_vec3(&tile->verts[poly->verts[0] * 3]);
+	glm::vec3 vmax = vmin;
+	for (int i = 1; i < poly->vertCount; ++i)
+	{
+		const glm::vec3 v = glm::make_vec3(&tile->verts[poly->verts[i] * 3]);
+		vmin = glm::min(vmin, v);
+		vmax = glm::max(vmax, v);
+	}
+
+	return qmin.x <= vmax.x && qmax.x >= vmin.x
+		&& qmin.y <= vmax.y && qmax.y >= vmin.y
+		&& qmin.z <= vmax.z && qmax.z >= vmin.z;
+}
+
+//----------------------------------------------------------------------------
+
+PolyGrid::PolyGrid()
+{
+}
+
+PolyGrid::~PolyGrid()
+{
+}
+
+void PolyGrid::Build(const dtNavMesh& navMesh, float cellSize)
+{
+	Clear();
+
+	glm::vec3 bmin{ FLT_MAX };
+	glm::vec3 bmax{ -FLT_MAX };
+	bool hasTiles = false;
+
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		bmin = glm::min(bmin, glm::make_vec3(tile->header->bmin));
+		bmax = glm::max(bmax, glm::make_vec3(tile->header->bmax));
+		hasTiles = true;
+	}
+
+	if (!hasTiles)
+		return;
+
+	if (cellSize <= 0.f)
+	{
+		cellSize = navMesh.getParams()->tileWidth / POLYGRID_CELLS_PER_TILE;
+	}
+	cellSize = std::max(cellSize, 1.f);
+
+	auto cellCount = [&](float size, int& width, int& height)
+	{
+		width = std::max(1, static_cast<int>(std::ceil((bmax.x - bmin.x) / size)));
+		height = std::max(1, static_cast<int>(std::ceil((bmax.z - bmin.z) / size)));
+		return static_cast<size_t>(width) * height;
+	};
+
+	while (cellCount(cellSize, m_width, m_height) > POLYGRID_MAX_CELLS
+		|| m_width > 0xffff || m_height > 0xffff)
+	{
+		cellSize *= 2.f;
+	}
+
+	m_origin = bmin;
+	m_cellSize = cellSize;
+
+	// Counts the entries of each cell first, so they can all go in one array.
+	auto forEachPoly = [&](auto&& callback)
+	{
+		for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = navMesh.getTile(i);
+			if (!tile->header) continue;
+
+			const dtPolyRef base = navMesh.getPolyRefBase(tile);
+			const glm::vec3 tbmin = glm::make_vec3(tile->header->bmin);
+			const float qfac = tile->header->bvQuantFactor;
+
+			// getPolyHeight takes points a little outside of the triangles of the detail
+			// mesh, by up to 1e-4 of their size past each edge
+			const glm::vec3 tileSize = glm::make_vec3(tile->header->bmax) - tbmin;
+			const float slack = 1.f / qfac + std::max(tileSize.x, tileSize.z) * 0.001f;
+
+			// The polygon is inside of bmin and bmax, which are usually the same as qmin
+			// and qmax that searches test.
+			auto addPoly = [&](int polyIndex, const uint16_t* qmin, const uint16_t* qmax,
+				const uint16_t* bmin, const uint16_t* bmax)
+			{
+				Entry entry;
+				entry.ref = base | (dtPolyRef)polyIndex;
+				std::copy_n(qmin, 3, entry.qmin);
+				std::copy_n(qmax, 3, entry.qmax);
+
+				// The quantized bounds are rounded towards the corner of the tile, so the
+				// polygon can be up to a step past them. They are also cut off at the bottom
+				// of the tile, which the detail mesh can dip below.
+				entry.bmin = tbmin + glm::vec3{ bmin[0], bmin[1], bmin[2] } / qfac - slack;
+				entry.bmax = tbmin + glm::vec3{ bmax[0], bmax[1], bmax[2] } / qfac + slack;
+				if (bmin[1] == 0)
+				{
+					entry.bmin.y = -FLT_MAX;
+				}
+
+				int x0, z0, x1, z1;
+				GetCell(entry.bmin.x, entry.bmin.z, x0, z0);
+				GetCell(entry.bmax.x, entry.bmax.z, x1, z1);
+
+				for (int z = z0; z <= z1; ++z)
+				{
+					for (int x = x0; x <= x1; ++x)
+					{
+						callback(z * m_width + x, entry);
+					}
+				}
+			};
+
+			if (tile->bvTree)
+			{
+				// The tree has room for twice as many nodes as polygons, and the ones that
+				// aren't used are zeroed, so they look like leaves of the first polygon at
+				// the corner of the tile. Detour finds it by them, so one of them is kept too.
+				// Searches find it where their box overlaps that corner, but it only has a
+				// height where it really is.
+				bool addedUnused = false;
+
+				for (int j = 0; j < tile->header->bvNodeCount; ++j)
+				{
+					const dtBVNode& node = tile->bvTree[j];
+					if (node.i < 0)
+						continue;
+
+					const uint16_t zero[3] = { 0, 0, 0 };
+					if (node.i == 0 && std::equal(node.bmin, node.bmin + 3, zero) && std::equal(node.bmax, node.bmax + 3, zero))
+					{
+						if (addedUnused || tile->header->polyCount == 0)
+							continue;
+						addedUnused = true;
+
+						uint16_t bmin[3], bmax[3];
+						GetPolyBounds(tile, 0, bmin, bmax);
+						addPoly(0, node.bmin, node.bmax, bmin, bmax);
+						continue;
+					}
+
+					addPoly(node.i, node.bmin, node.bmax, node.bmin, node.bmax);
+				}
+			}
+			else
+			{
+				for (int j = 0; j < tile->header->polyCount; ++j)
+				{
+					if (tile->polys[j].getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+						continue;
+
+					uint16_t qmin[3], qmax[3];
+					GetPolyBounds(tile, j, qmin, qmax);
+					addPoly(j, qmin, qmax, qmin, qmax);
+				}
+			}
+		}
+	};
+
+	m_cellStart.assign(static_cast<size_t>(m_width) * m_height + 1, 0);
+	forEachPoly([&](int cell, const Entry&) { ++m_cellStart[cell + 1]; });
+
+	for (size_t i = 1; i < m_cellStart.size(); ++i)
+	{
+		m_cellStart[i] += m_cellStart[i - 1];
+	}
+
+	std::vector<uint32_t> next(m_cellStart.begin(), m_cellStart.end() - 1);
+	m_entries.resize(m_cellStart.back());
+	forEachPoly([&](int cell, const Entry& entry) { m_entries[next[cell]++] = entry; });
+}
+
+void PolyGrid::Clear()
+{
+	m_origin = glm::vec3{ 0.f };
+	m_cellSize = 0.f;
+	m_width = 0;
+	m_height = 0;
+	m_cellStart.clear();
+	m_entries.clear();
+}
+
+bool PolyGrid::GetCell(float x, float z, int& cx, int& cz) const
+{
+	cx = static_cast<int>(std::floor((x - m_origin.x) / m_cellSize));
+	cz = static_cast<int>(std::floor((z - m_origin.z) / m_cellSize));
+
+	// the far edges of the grid belong to the last cells
+	const bool inside = cx >= 0 && cz >= 0
+		&& x <= m_origin.x + m_width * m_cellSize && z <= m_origin.z + m_height * m_cellSize;
+
+	cx = std::clamp(cx, 0, m_width - 1);
+	cz = std::clamp(cz, 0, m_height - 1);
+	return inside;
+}
+
+void PolyGrid::GetHeights(const dtNavMeshQuery& query, const float* pos, const float* halfExtents,
+	const dtQueryFilter& filter, std::vector<float>& heights) const
+{
+	if (IsEmpty())
+		return;
+
+	// a polygon only has a height at pos if pos is inside of its bounds, so the cell of
+	// pos has all of them
+	int x, z;
+	if (!GetCell(pos[0], pos[2], x, z))
+		return;
+
+	const glm::vec3 qmin = glm::make_vec3(pos) - glm::make_vec3(halfExtents);
+	const glm::vec3 qmax = glm::make_vec3(pos) + glm::make_vec3(halfExtents);
+
+	const dtNavMesh* navMesh = query.getAttachedNavMesh();
+
+	// only the tiles under the box are searched
+	int tileX0, tileZ0, tileX1, tileZ1;
+	navMesh->calcTileLoc(glm::value_ptr(qmin), &tileX0, &tileZ0);
+	navMesh->calcTileLoc(glm::value_ptr(qmax), &tileX1, &tileZ1);
+
+	const dtMeshTile* lastTile = nullptr;
+	uint16_t tileMin[3], tileMax[3];
+
+	// the first polygon of a tile can have two entries, and is only counted once
+	std::vector<dtPolyRef> refs;
+
+	const int cell = z * m_width + x;
+	for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i)
+	{
+		const Entry& entry = m_entries[i];
+
+		if (pos[0] < entry.bmin.x || pos[0] > entry.bmax.x || pos[2] < entry.bmin.z || pos[2] > entry.bmax.z)
+			continue;
+
+		// the tile may have been replaced since the grid was built
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		if (dtStatusFailed(navMesh->getTileAndPolyByRef(entry.ref, &tile, &poly))
+			|| tile->header->x < tileX0 || tile->header->x > tileX1
+			|| tile->header->y < tileZ0 || tile->header->y > tileZ1)
+		{
+			continue;
+		}
+
+		if (tile->bvTree)
+		{
+			if (tile != lastTile)
+			{
+				lastTile = tile;
+				QuantizeBox(tile, qmin, qmax, tileMin, tileMax);
+			}
+
+			if (!OverlapQuantBounds(tileMin, tileMax, entry.qmin, entry.qmax))
+				continue;
+		}
+		else if (!OverlapPolyBounds(tile, poly, qmin, qmax))
+		{
+			continue;
+		}
+
+		if (PassesFilter(filter, poly))
+		{
+			refs.push_back(entry.ref);
+		}
+	}
+
+	std::sort(refs.begin(), refs.end());
+	refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+
+	for (dtPolyRef ref : refs)
+	{
+		float height;
+		if (dtStatusSucceed(query.getPolyHeight(ref, pos, &height)))
+		{
+			heights.push_back(height);
+		}
+	}
+}
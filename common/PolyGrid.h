@@ -0,0 +1,68 @@
+//
+// PolyGrid.h
+//
+
+#pragma once
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// A uniform 2D grid over the navmesh that lists the polygons overlapping each cell.
+// Finding the polygons under a position is then a lookup of one cell, instead of walking
+// the bounding volume tree of every tile in the way with a box as tall as the navmesh.
+//
+// Each polygon keeps the bounds from its tile's bounding volume tree, and searches test
+// them the same way dtNavMeshQuery::queryPolygons does, so both find the same polygons.
+// Off-mesh connections aren't in the grid, the same as they aren't in the trees.
+//
+// Finding the nearest polygon is left to Detour. Its box is small, and the trees find
+// the polygons in it faster than the grid does.
+class PolyGrid
+{
+public:
+	struct Entry
+	{
+		dtPolyRef ref = 0;
+		glm::vec3 bmin;               // bounds that the polygon is certainly inside
+		glm::vec3 bmax;
+		uint16_t qmin[3];             // bounds in the quantized space of the tile
+		uint16_t qmax[3];
+	};
+
+	PolyGrid();
+	~PolyGrid();
+
+	// Builds the grid from the tiles of the navmesh. A cell size of zero picks one
+	// from the tile size.
+	void Build(const dtNavMesh& navMesh, float cellSize = 0.f);
+
+	void Clear();
+
+	bool IsEmpty() const { return m_entries.empty(); }
+
+	float GetCellSize() const { return m_cellSize; }
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	size_t GetEntryCount() const { return m_entries.size(); }
+
+	// Adds the height at pos of each polygon that pos is over or under, out of the ones
+	// that dtNavMeshQuery::queryPolygons finds in the box given by halfExtents.
+	void GetHeights(const dtNavMeshQuery& query, const float* pos, const float* halfExtents,
+		const dtQueryFilter& filter, std::vector<float>& heights) const;
+
+private:
+	bool GetCell(float x, float z, int& cx, int& cz) const;
+
+	glm::vec3 m_origin;
+	float m_cellSize = 0.f;
+	int m_width = 0;
+	int m_height = 0;
+
+	// the entries of cell i are m_entries[m_cellStart[i]] up to m_entries[m_cellStart[i + 1]]
+	std::vector<uint32_t> m_cellStart;
+	std::vector<Entry> m_entries;
+};
@@ -0,0 +1,72 @@
+//
+// SpscQueue.h
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Fixed size lock-free queue with a single producer thread and a single consumer
+// thread. Push only ever touches the tail and Pop only ever touches the head, so
+// neither side waits on the other. One slot is kept free to tell a full queue from
+// an empty one.
+template <typename T>
+class SpscQueue
+{
+public:
+	explicit SpscQueue(size_t capacity)
+		: m_size(capacity + 1)
+		, m_slots(std::make_unique<T[]>(capacity + 1))
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// producer only. Returns false and leaves value alone if the queue is full.
+	bool Push(T&& value)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t next = Next(tail);
+
+		if (next == m_head.load(std::memory_order_acquire))
+			return false;
+
+		m_slots[tail] = std::move(value);
+		m_tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only. Returns false if the queue is empty.
+	bool Pop(T& value)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+
+		value = std::move(m_slots[head]);
+		m_slots[head] = T{};
+		m_head.store(Next(head), std::memory_order_release);
+		return true;
+	}
+
+	// only a hint when called from the producer
+	bool IsEmpty() const
+	{
+		return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+	}
+
+private:
+	size_t Next(size_t index) const { return index + 1 == m_size ? 0 : index + 1; }
+
+	const size_t m_size;
+	std::unique_ptr<T[]> m_slots;
+
+	// kept on separate cache lines so the two threads don't fight over them
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+};
@@ -0,0 +1,489 @@
+//
+// TileGraph.cpp
+//
+
+#include "TileGraph.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <tuple>
+
+//----------------------------------------------------------------------------
+
+using OpenList = std::vector<std::pair<float, uint32_t>>;
+
+static glm::vec3 GetPolyCenter(const dtMeshTile* tile, const dtPoly* poly)
+{
+	glm::vec3 center{ 0.f };
+
+	for (int i = 0; i < poly->vertCount; ++i)
+	{
+		center += glm::make_vec3(&tile->verts[poly->verts[i] * 3]);
+	}
+
+	return center / static_cast<float>(poly->vertCount);
+}
+
+// the same as dtQueryFilter::passFilter, which is only defined inside detour's query
+static bool PassesFilter(const dtQueryFilter& filter, const dtPoly* poly)
+{
+	return (poly->flags & filter.getIncludeFlags()) != 0
+		&& (poly->flags & filter.getExcludeFlags()) == 0;
+}
+
+static bool PassesFilter(const dtNavMesh& navMesh, dtPolyRef ref, const dtQueryFilter& filter)
+{
+	const dtMeshTile* tile = nullptr;
+	const dtPoly* poly = nullptr;
+	navMesh.getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+
+	return PassesFilter(filter, poly);
+}
+
+// Cheapest costs from the source polygons to every polygon of a tile, without leaving the
+// tile. Costs are negative for polygons that weren't reached.
+static void FindCostsInTile(const dtNavMesh& navMesh, const dtMeshTile* tile, const dtQueryFilter& filter,
+	const uint32_t* sources, int numSources, std::vector<float>& costs, OpenList& open)
+{
+	const dtPolyRef base = navMesh.getPolyRefBase(tile);
+	const unsigned int tileIndex = navMesh.decodePolyIdTile(base);
+
+	costs.assign(tile->header->polyCount, -1.f);
+	open.clear();
+
+	for (int i = 0; i < numSources; ++i)
+	{
+		costs[sources[i]] = 0.f;
+		open.emplace_back(0.f, sources[i]);
+	}
+
+	std::make_heap(open.begin(), open.end(), std::greater<>());
+
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<>());
+		auto [cost, index] = open.back();
+		open.pop_back();
+
+		if (cost > costs[index])
+			continue;
+
+		const dtPoly* poly = &tile->polys[index];
+		const glm::vec3 center = GetPolyCenter(tile, poly);
+		const float areaCost = filter.getAreaCost(poly->getArea());
+
+		for (auto i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtPolyRef neiRef = tile->links[i].ref;
+			if (!neiRef || navMesh.decodePolyIdTile(neiRef) != tileIndex)
+				continue;
+
+			const unsigned int neiIndex = navMesh.decodePolyIdPoly(neiRef);
+			const dtPoly* neiPoly = &tile->polys[neiIndex];
+			if (!PassesFilter(filter, neiPoly))
+				continue;
+
+			// half of the way is in each polygon
+			const float neiCost = cost + glm::distance(center, GetPolyCenter(tile, neiPoly))
+				* 0.5f * (areaCost + filter.getAreaCost(neiPoly->getArea()));
+
+			if (costs[neiIndex] < 0.f || neiCost < costs[neiIndex])
+			{
+				costs[neiIndex] = neiCost;
+				open.emplace_back(neiCost, neiIndex);
+				std::push_heap(open.begin(), open.end(), std::greater<>());
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+TileGraph::TileGraph()
+{
+}
+
+TileGraph::~TileGraph()
+{
+}
+
+void TileGraph::Build(const dtNavMesh& navMesh, const dtQueryFilter& filter)
+{
+	Clear();
+
+	m_excludeFlags = filter.getExcludeFlags();
+
+	// A polygon is on the border with another tile if it has a link over to it, or if
+	// something over there has a link to it. Both sides get a portal even if the links
+	// only go one way.
+	struct BorderPoly
+	{
+		uint32_t tile;
+		uint32_t neighbour;
+		uint32_t poly;
+		uint32_t portal;
+
+		bool operator<(const BorderPoly& other) const
+		{
+			return std::tie(tile, neighbour, poly) < std::tie(other.tile, other.neighbour, other.poly);
+		}
+
+		bool operator==(const BorderPoly& other) const
+		{
+			return tile == other.tile && neighbour == other.neighbour && poly == other.poly;
+		}
+	};
+
+	std::vector<BorderPoly> borders;
+
+	auto forEachCrossing = [&](auto&& callback)
+	{
+		for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = navMesh.getTile(i);
+			if (!tile->header) continue;
+
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				const dtPoly* poly = &tile->polys[j];
+				if (!PassesFilter(filter, poly))
+					continue;
+
+				for (auto k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+				{
+					const dtPolyRef neiRef = tile->links[k].ref;
+					if (!neiRef || navMesh.decodePolyIdTile(neiRef) == static_cast<unsigned int>(i))
+						continue;
+
+					if (!PassesFilter(navMesh, neiRef, filter))
+						continue;
+
+					callback(static_cast<uint32_t>(i), static_cast<uint32_t>(j),
+						navMesh.decodePolyIdTile(neiRef), navMesh.decodePolyIdPoly(neiRef));
+				}
+			}
+		}
+	};
+
+	forEachCrossing([&](uint32_t tile, uint32_t poly, uint32_t neiTile, uint32_t neiPoly)
+	{
+		borders.push_back({ tile, neiTile, poly, 0 });
+		borders.push_back({ neiTile, tile, neiPoly, 0 });
+	});
+
+	std::sort(borders.begin(), borders.end());
+	borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+
+	const uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+	for (BorderPoly& border : borders)
+	{
+		border.portal = unassigned;
+	}
+
+	auto findBorder = [&](uint32_t tile, uint32_t neighbour, uint32_t poly) -> BorderPoly*
+	{
+		BorderPoly key{ tile, neighbour, poly, 0 };
+		auto iter = std::lower_bound(borders.begin(), borders.end(), key);
+
+		return iter != borders.end() && *iter == key ? &*iter : nullptr;
+	};
+
+	// The border polygons facing the same tile are split into portals by the links
+	// between them, so that each stretch of the border gets its own portal.
+	m_tilePortals.resize(navMesh.getMaxTiles());
+	std::vector<BorderPoly*> stack;
+
+	for (BorderPoly& first : borders)
+	{
+		if (first.portal != unassigned)
+			continue;
+
+		const dtMeshTile* tile = navMesh.getTile(first.tile);
+		const dtPolyRef base = navMesh.getPolyRefBase(tile);
+		const uint32_t portal = static_cast<uint32_t>(m_portals.size());
+
+		first.portal = portal;
+		stack.push_back(&first);
+
+		glm::vec3 center{ 0.f };
+		std::vector<uint32_t> polys;
+
+		while (!stack.empty())
+		{
+			BorderPoly* border = stack.back();
+			stack.pop_back();
+
+			const dtPoly* poly = &tile->polys[border->poly];
+			polys.push_back(border->poly);
+			center += GetPolyCenter(tile, poly);
+
+			for (auto k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtPolyRef neiRef = tile->links[k].ref;
+				if (!neiRef || navMesh.decodePolyIdTile(neiRef) != first.tile)
+					continue;
+
+				BorderPoly* nei = findBorder(first.tile, first.neighbour, navMesh.decodePolyIdPoly(neiRef));
+				if (nei && nei->portal == unassigned)
+				{
+					nei->portal = portal;
+					stack.push_back(nei);
+				}
+			}
+		}
+
+		// searches aim for the polygon nearest the middle of the portal
+		center /= static_cast<float>(polys.size());
+
+		Portal result;
+		result.tileRef = base;
+
+		float bestDist = std::numeric_limits<float>::max();
+		for (uint32_t poly : polys)
+		{
+			glm::vec3 pos = GetPolyCenter(tile, &tile->polys[poly]);
+			float dist = glm::distance(pos, center);
+
+			if (dist < bestDist)
+			{
+				bestDist = dist;
+				result.poly = poly;
+				result.pos = pos;
+			}
+		}
+
+		m_portals.push_back(result);
+		m_tilePortals[first.tile].push_back(portal);
+	}
+
+	// edges by the portal that they start from
+	std::vector<std::pair<uint32_t, Edge>> edges;
+
+	// between portals on either side of a border
+	forEachCrossing([&](uint32_t tile, uint32_t poly, uint32_t neiTile, uint32_t neiPoly)
+	{
+		const uint32_t from = findBorder(tile, neiTile, poly)->portal;
+		const uint32_t to = findBorder(neiTile, tile, neiPoly)->portal;
+
+		edges.emplace_back(from, Edge{ to, glm::distance(m_portals[from].pos, m_portals[to].pos) });
+	});
+
+	// between portals of the same tile
+	std::vector<float> costs;
+	OpenList open;
+
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header) continue;
+
+		for (uint32_t from : m_tilePortals[i])
+		{
+			FindCostsInTile(navMesh, tile, filter, &m_portals[from].poly, 1, costs, open);
+
+			for (uint32_t to : m_tilePortals[i])
+			{
+				if (to != from && costs[m_portals[to].poly] >= 0.f)
+				{
+					edges.emplace_back(from, Edge{ to, costs[m_portals[to].poly] });
+				}
+			}
+		}
+	}
+
+	// keep the cheapest of each edge
+	std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b)
+	{
+		return std::tie(a.first, a.second.target, a.second.cost) < std::tie(b.first, b.second.target, b.second.cost);
+	});
+
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		if (i > 0 && edges[i].first == edges[i - 1].first && edges[i].second.target == edges[i - 1].second.target)
+			continue;
+
+		Portal& portal = m_portals[edges[i].first];
+		if (portal.edgeCount == 0)
+		{
+			portal.firstEdge = static_cast<uint32_t>(m_edges.size());
+		}
+
+		m_edges.push_back(edges[i].second);
+		++portal.edgeCount;
+	}
+}
+
+void TileGraph::AddPortal(const dtNavMesh& navMesh, const Portal& portal)
+{
+	const unsigned int tileIndex = navMesh.decodePolyIdTile(portal.tileRef);
+	if (tileIndex >= m_tilePortals.size())
+	{
+		m_tilePortals.resize(std::max<size_t>(tileIndex + 1, navMesh.getMaxTiles()));
+	}
+
+	m_tilePortals[tileIndex].push_back(static_cast<uint32_t>(m_portals.size()));
+
+	m_portals.push_back(portal);
+	m_portals.back().firstEdge = static_cast<uint32_t>(m_edges.size());
+	m_portals.back().edgeCount = 0;
+}
+
+void TileGraph::AddEdge(const Edge& edge)
+{
+	if (m_portals.empty())
+		return;
+
+	m_edges.push_back(edge);
+	++m_portals.back().edgeCount;
+}
+
+void TileGraph::Clear()
+{
+	m_portals.clear();
+	m_edges.clear();
+	m_tilePortals.clear();
+	m_excludeFlags = 0;
+}
+
+const std::vector<uint32_t>& TileGraph::GetTilePortals(unsigned int tileIndex) const
+{
+	static const std::vector<uint32_t> s_empty;
+
+	return tileIndex < m_tilePortals.size() ? m_tilePortals[tileIndex] : s_empty;
+}
+
+bool TileGraph::IsPortalValid(const dtNavMesh& navMesh, uint32_t portal) const
+{
+	return portal < m_portals.size() && navMesh.getTileByRef(m_portals[portal].tileRef) != nullptr;
+}
+
+//----------------------------------------------------------------------------
+
+TileGraphSearch::TileGraphSearch()
+{
+}
+
+TileGraphSearch::~TileGraphSearch()
+{
+}
+
+bool TileGraphSearch::FindRoute(const TileGraph& graph, const dtNavMesh& navMesh, const dtQueryFilter& filter,
+	dtPolyRef startRef, dtPolyRef endRef, const glm::vec3& endPos, std::vector<uint32_t>& route)
+{
+	route.clear();
+	m_visited = 0;
+
+	const dtMeshTile* startTile = nullptr;
+	const dtMeshTile* endTile = nullptr;
+	const dtPoly* poly = nullptr;
+	if (dtStatusFailed(navMesh.getTileAndPolyByRef(startRef, &startTile, &poly))
+		|| dtStatusFailed(navMesh.getTileAndPolyByRef(endRef, &endTile, &poly)))
+	{
+		return false;
+	}
+
+	const std::vector<uint32_t>& startPortals = graph.GetTilePortals(navMesh.decodePolyIdTile(startRef));
+	const std::vector<uint32_t>& endPortals = graph.GetTilePortals(navMesh.decodePolyIdTile(endRef));
+	if (startPortals.empty() || endPortals.empty()
+		|| !graph.IsPortalValid(navMesh, startPortals[0]) || !graph.IsPortalValid(navMesh, endPortals[0]))
+	{
+		return false;
+	}
+
+	// Costs from the start out to the portals of its tile, and from the portals of the
+	// end tile in to the end. The end costs are searched outwards from the end, so they
+	// are off where links only go one way.
+	const uint32_t startPoly = navMesh.decodePolyIdPoly(startRef);
+	const uint32_t endPoly = navMesh.decodePolyIdPoly(endRef);
+	FindCostsInTile(navMesh, startTile, filter, &startPoly, 1, m_startCosts, m_tileOpen);
+	FindCostsInTile(navMesh, endTile, filter, &endPoly, 1, m_endCosts, m_tileOpen);
+
+	const std::vector<TileGraph::Portal>& portals = graph.GetPortals();
+	const std::vector<TileGraph::Edge>& edges = graph.GetEdges();
+	const uint32_t goal = static_cast<uint32_t>(portals.size());
+	const uint32_t noParent = std::numeric_limits<uint32_t>::max();
+	const unsigned int endTileIndex = navMesh.decodePolyIdTile(endRef);
+
+	// nodes are reset lazily, by marking the ones that belong to this search
+	if (m_nodes.size() != portals.size() + 1 || ++m_stamp == 0)
+	{
+		m_nodes.assign(portals.size() + 1, Node{});
+		m_stamp = 1;
+	}
+
+	m_open.clear();
+
+	auto relax = [&](uint32_t index, float cost, uint32_t parent)
+	{
+		Node& node = m_nodes[index];
+		if (node.stamp != m_stamp)
+		{
+			node = Node{};
+			node.stamp = m_stamp;
+			node.cost = std::numeric_limits<float>::max();
+		}
+
+		if (node.closed || cost >= node.cost)
+			return;
+
+		node.cost = cost;
+		node.parent = parent;
+
+		float heuristic = index == goal ? 0.f : glm::distance(portals[index].pos, endPos);
+		m_open.emplace_back(cost + heuristic, index);
+		std::push_heap(m_open.begin(), m_open.end(), std::greater<>());
+	};
+
+	for (uint32_t portal : startPortals)
+	{
+		float cost = m_startCosts[portals[portal].poly];
+		if (cost >= 0.f)
+		{
+			relax(portal, cost, noParent);
+		}
+	}
+
+	while (!m_open.empty())
+	{
+		std::pop_heap(m_open.begin(), m_open.end(), std::greater<>());
+		uint32_t index = m_open.back().second;
+		m_open.pop_back();
+
+		Node& node = m_nodes[index];
+		if (node.closed)
+			continue;
+
+		node.closed = true;
+		++m_visited;
+
+		if (index == goal)
+		{
+			for (uint32_t portal = node.parent; portal != noParent; portal = m_nodes[portal].parent)
+			{
+				route.push_back(portal);
+			}
+
+			std::reverse(route.begin(), route.end());
+			return true;
+		}
+
+		const TileGraph::Portal& portal = portals[index];
+		if (navMesh.decodePolyIdTile(portal.tileRef) == endTileIndex && m_endCosts[portal.poly] >= 0.f)
+		{
+			relax(goal, node.cost + m_endCosts[portal.poly], index);
+		}
+
+		for (uint32_t i = portal.firstEdge; i < portal.firstEdge + portal.edgeCount; ++i)
+		{
+			if (graph.IsPortalValid(navMesh, edges[i].target))
+			{
+				relax(edges[i].target, node.cost + edges[i].cost, index);
+			}
+		}
+	}
+
+	return false;
+}
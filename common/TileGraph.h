@@ -0,0 +1,115 @@
+//
+// TileGraph.h
+//
+
+#pragma once
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// An abstract graph over the tiles of a navmesh, for planning long paths. Where a tile
+// borders another, the polygons that cross over are grouped into portals. Each portal
+// is joined to the portals of its own tile by the cost of crossing the tile, and to the
+// portals on the other side of the border. Searching this graph picks out the tiles
+// that a long path goes through without expanding any of their polygons.
+//
+// Costs are worked out from polygon centres, so they are only an estimate of the cost
+// of the real path.
+class TileGraph
+{
+public:
+	struct Edge
+	{
+		uint32_t target = 0;
+		float cost = 0.f;
+	};
+
+	struct Portal
+	{
+		dtTileRef tileRef = 0;
+		uint32_t poly = 0;        // index of the polygon in the tile that searches aim for
+		glm::vec3 pos;            // centre of that polygon
+		uint32_t firstEdge = 0;
+		uint32_t edgeCount = 0;
+	};
+
+	TileGraph();
+	~TileGraph();
+
+	// Finds the portals of every tile and the costs between them. Polygons that don't
+	// pass the filter are left out, and the filter's area costs are used for the costs.
+	void Build(const dtNavMesh& navMesh, const dtQueryFilter& filter);
+
+	// Adds a portal that was worked out earlier, eg. by a build that was saved. Portals
+	// are numbered in the order they are added, and edges can only be added to the last
+	// portal.
+	void AddPortal(const dtNavMesh& navMesh, const Portal& portal);
+	void AddEdge(const Edge& edge);
+
+	void Clear();
+
+	bool IsEmpty() const { return m_portals.empty(); }
+
+	const std::vector<Portal>& GetPortals() const { return m_portals; }
+	const std::vector<Edge>& GetEdges() const { return m_edges; }
+
+	// portals of the tile with this index. Only valid if the tile hasn't been replaced.
+	const std::vector<uint32_t>& GetTilePortals(unsigned int tileIndex) const;
+
+	// false if the tile of the portal has been replaced since the graph was built
+	bool IsPortalValid(const dtNavMesh& navMesh, uint32_t portal) const;
+
+	uint16_t GetExcludeFlags() const { return m_excludeFlags; }
+	void SetExcludeFlags(uint16_t flags) { m_excludeFlags = flags; }
+
+private:
+	std::vector<Portal> m_portals;
+	std::vector<Edge> m_edges;
+	std::vector<std::vector<uint32_t>> m_tilePortals;
+	uint16_t m_excludeFlags = 0;
+};
+
+//----------------------------------------------------------------------------
+
+// Searches a tile graph for the portals that a path goes through. Each thread needs its
+// own search, the graph can be shared.
+class TileGraphSearch
+{
+public:
+	TileGraphSearch();
+	~TileGraphSearch();
+
+	// Finds the route from a polygon to another through the graph. The route is the list
+	// of portals that are passed through, in order. Returns false if there is no route,
+	// or the start or end are in tiles that have been replaced since the graph was built.
+	bool FindRoute(const TileGraph& graph, const dtNavMesh& navMesh, const dtQueryFilter& filter,
+		dtPolyRef startRef, dtPolyRef endRef, const glm::vec3& endPos, std::vector<uint32_t>& route);
+
+	// portals that were looked at by the last search
+	int GetVisitedCount() const { return m_visited; }
+
+private:
+	struct Node
+	{
+		float cost = 0.f;
+		uint32_t parent = 0;
+		uint32_t stamp = 0;
+		bool closed = false;
+	};
+
+	// open lists of the search and of the searches within the start and end tiles, as
+	// heaps of cost and node
+	std::vector<std::pair<float, uint32_t>> m_open;
+	std::vector<std::pair<float, uint32_t>> m_tileOpen;
+
+	std::vector<Node> m_nodes;
+	std::vector<float> m_startCosts;
+	std::vector<float> m_endCosts;
+	uint32_t m_stamp = 0;
+	int m_visited = 0;
+};
@@ -7,6 +7,9 @@
 #include <zlib.h>
 #include <cstdio>
 
+// Only the compression helpers are built outside of Windows (see CMakeLists.txt).
+#if defined(_WIN32)
+
 #if !defined(WIN32_LEAN_AND_MEAN)
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -16,6 +19,8 @@
 #include <imgui.h>
 #include <imgui_internal.h>
 
+#endif // defined(_WIN32)
+
 //============================================================================
 
 bool CompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>& out_data)
@@ -123,8 +128,30 @@ bool DecompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>&
 	return true;
 }
 
+bool DecompressMemory(const void* in_data, size_t in_data_size, void* out_data, size_t out_data_size)
+{
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+
+	if (inflateInit(&zs) != Z_OK)
+		return false;
+
+	zs.next_in = (Bytef*)in_data;
+	zs.avail_in = (uInt)in_data_size;
+	zs.next_out = (Bytef*)out_data;
+	zs.avail_out = (uInt)out_data_size;
+
+	int ret = inflate(&zs, Z_FINISH);
+	size_t totalOut = zs.total_out;
+	inflateEnd(&zs);
+
+	return ret == Z_STREAM_END && totalOut == out_data_size;
+}
+
 //----------------------------------------------------------------------------
 
+#if defined(_WIN32)
+
 EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
 inline HINSTANCE GetComponentInstance()
@@ -262,3 +289,5 @@ bool ImGuiEx::ColoredButton(const char* text, const ImVec2& size, float hue)
 	ImGui::PopStyleColor(3);
 	return clicked;
 }
+
+#endif // defined(_WIN32)
@@ -80,6 +80,27 @@ inline float distSqr(const glm::vec3& v1, const glm::vec3& v2)
 	return glm::dot(temp, temp);
 }
 
+//----------------------------------------------------------------------------
+// hashing
+
+const uint64_t FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325ull;
+const uint64_t FNV1A_64_PRIME = 0x100000001b3ull;
+
+// 64-bit FNV-1a hash. Data can be hashed in pieces by passing the previous result
+// as the starting hash.
+inline uint64_t fnv1a64(const void* data, size_t length, uint64_t hash = FNV1A_64_OFFSET_BASIS)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= FNV1A_64_PRIME;
+	}
+
+	return hash;
+}
+
 //----------------------------------------------------------------------------
 
 bool CompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>& out_data);
@@ -89,6 +110,10 @@ bool CompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>& ou
 bool DecompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>& out_data,
 	size_t decompressedSize = 0);
 
+// Decompress memory into a caller provided buffer. The decompressed data must fill the
+// buffer exactly.
+bool DecompressMemory(const void* in_data, size_t in_data_size, void* out_data, size_t out_data_size);
+
 
 //----------------------------------------------------------------------------
 
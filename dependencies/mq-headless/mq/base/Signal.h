@@ -0,0 +1,120 @@
+//
+// Signal.h
+//
+// Stand-in for MacroQuest's mq/base/Signal.h, used when the common library is
+// built without MacroQuest (see CMakeLists.txt). Only the parts used by
+// common/ are provided.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mq {
+
+template <typename... Args>
+class Signal
+{
+	struct Slots
+	{
+		std::mutex mutex;
+		std::map<uint64_t, std::function<void(Args...)>> callbacks;
+		uint64_t nextId = 0;
+	};
+
+public:
+	class ScopedConnection
+	{
+	public:
+		ScopedConnection() = default;
+		ScopedConnection(const ScopedConnection&) = delete;
+		ScopedConnection& operator=(const ScopedConnection&) = delete;
+
+		ScopedConnection(ScopedConnection&& other) noexcept
+			: m_slots(std::move(other.m_slots))
+			, m_id(other.m_id)
+		{
+			other.m_slots.reset();
+		}
+
+		ScopedConnection& operator=(ScopedConnection&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Disconnect();
+
+				m_slots = std::move(other.m_slots);
+				m_id = other.m_id;
+				other.m_slots.reset();
+			}
+
+			return *this;
+		}
+
+		~ScopedConnection() { Disconnect(); }
+
+		void Disconnect()
+		{
+			if (auto slots = m_slots.lock())
+			{
+				std::lock_guard<std::mutex> lock(slots->mutex);
+				slots->callbacks.erase(m_id);
+			}
+
+			m_slots.reset();
+		}
+
+	private:
+		friend class Signal;
+
+		ScopedConnection(const std::shared_ptr<Slots>& slots, uint64_t id)
+			: m_slots(slots)
+			, m_id(id)
+		{
+		}
+
+		std::weak_ptr<Slots> m_slots;
+		uint64_t m_id = 0;
+	};
+
+	Signal() = default;
+	Signal(const Signal&) = delete;
+	Signal& operator=(const Signal&) = delete;
+
+	template <typename Callback>
+	[[nodiscard]] ScopedConnection Connect(Callback&& callback)
+	{
+		std::lock_guard<std::mutex> lock(m_slots->mutex);
+
+		uint64_t id = ++m_slots->nextId;
+		m_slots->callbacks.emplace(id, std::forward<Callback>(callback));
+
+		return ScopedConnection(m_slots, id);
+	}
+
+	void operator()(Args... args) const
+	{
+		// callbacks may connect or disconnect while being invoked
+		std::vector<std::function<void(Args...)>> callbacks;
+		{
+			std::lock_guard<std::mutex> lock(m_slots->mutex);
+
+			callbacks.reserve(m_slots->callbacks.size());
+			for (const auto& [id, callback] : m_slots->callbacks)
+				callbacks.push_back(callback);
+		}
+
+		for (const auto& callback : callbacks)
+			callback(args...);
+	}
+
+private:
+	std::shared_ptr<Slots> m_slots = std::make_shared<Slots>();
+};
+
+} // namespace mq
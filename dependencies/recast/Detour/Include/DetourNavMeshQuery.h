@@ -161,6 +161,23 @@ public:
 	virtual void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count) = 0;
 };
 
+/// Estimates the cost that is left to the end of a path search, in place of the
+/// straight line distance.
+/// @ingroup detour
+class dtQueryHeuristic
+{
+public:
+	virtual ~dtQueryHeuristic() { }
+
+	/// Returns the estimated cost from a position on a polygon to the end of the search.
+	/// The search finds the cheapest path as long as this doesn't overestimate.
+	///  @param[in]		ref			The reference id of the polygon.
+	///  @param[in]		pos			The position on the polygon. [(x, y, z)]
+	///  @param[in]		endRef		The reference id of the polygon at the end of the search.
+	///  @param[in]		endPos		The end position. [(x, y, z)]
+	virtual float getCost(dtPolyRef ref, const float* pos, dtPolyRef endRef, const float* endPos) const = 0;
+};
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -175,6 +192,32 @@ public:
 	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= 65535]
 	/// @returns The status flags for the query.
 	dtStatus init(const dtNavMesh* nav, const int maxNodes);
+
+	/// Lets searches grow the node pool instead of running out of nodes. The pool is grown
+	/// in place, so the search carries on where it was. Used by findPath and the sliced
+	/// path functions.
+	///  @param[in]		maxNodes	The most nodes the pool can grow to. Growth is disabled
+	///  							if this isn't bigger than the current pool. [Default: 0]
+	void setNodePoolLimit(const int maxNodes) { m_nodePoolLimit = maxNodes; }
+	int getNodePoolLimit() const { return m_nodePoolLimit; }
+
+	/// Sets the heuristic used by findPath and the sliced path functions. The heuristic
+	/// must outlive its use by the query.
+	///  @param[in]		heuristic	The heuristic, or null for the straight line distance
+	///  							to the end. [Default: null]
+	void setHeuristic(const dtQueryHeuristic* heuristic) { m_heuristic = heuristic; }
+	const dtQueryHeuristic* getHeuristic() const { return m_heuristic; }
+
+	/// Grows the node pool and open list to hold maxNodes, keeping any search that is
+	/// in progress.
+	/// @returns The status flags for the operation.
+	dtStatus growNodePool(const int maxNodes);
+
+	/// Reallocates the node pool and open list to hold maxNodes, if they have grown past
+	/// that. Clears the state of any search in progress, so this is only for use between
+	/// searches.
+	/// @returns The status flags for the operation.
+	dtStatus shrinkNodePool(const int maxNodes);
 	
 	/// @name Standard Pathfinding Functions
 	// /@{
@@ -296,6 +339,22 @@ public:
 								  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
 								  int* resultCount, const int maxResult) const;
 	
+	/// Finds the cost of reaching each of the target polygons from the start polygon,
+	/// with a single Dijkstra search.
+	///  @param[in]		startRef		The reference id of the polygon where the search starts.
+	///  @param[in]		startPos		A position within the start polygon. [(x, y, z)]
+	///  @param[in]		targetRefs		The reference ids of the target polygons. Zero ids are skipped.
+	///  								[(polyRef) * @p ntargets]
+	///  @param[in]		ntargets		The number of target polygons.
+	///  @param[in]		maxCost			The search stops at polygons that cost more than this to reach.
+	///  @param[in]		filter			The polygon filter to apply to the query.
+	///  @param[out]	targetCosts		The search cost from @p startPos to each target polygon, or -1
+	///  								if it wasn't reached. [(cost) * @p ntargets]
+	/// @returns The status flags for the query. DT_PARTIAL_RESULT is set if any target wasn't reached.
+	dtStatus findCostsToPolys(dtPolyRef startRef, const float* startPos,
+							  const dtPolyRef* targetRefs, const int ntargets, const float maxCost,
+							  const dtQueryFilter* filter, float* targetCosts) const;
+
 	/// Gets a path from the explored nodes in the previous search.
 	///  @param[in]		endRef		The reference id of the end polygon.
 	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.)
@@ -307,7 +366,8 @@ public:
 	///  				if @p path cannot contain the entire path. In this case it is filled to capacity with a partial path.
 	///  				Otherwise returns DT_SUCCESS.
 	///  @remarks		The result of this function depends on the state of the query object. For that reason it should only
-	///  				be used immediately after one of the two Dijkstra searches, findPolysAroundCircle or findPolysAroundShape.
+	///  				be used immediately after one of the Dijkstra searches, findPolysAroundCircle, findPolysAroundShape
+	///  				or findCostsToPolys.
 	dtStatus getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const;
 
 	/// @}
@@ -541,6 +601,17 @@ private:
 
 	// Gets the path leading to the specified end node.
 	dtStatus getPathToNode(struct dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const;
+
+	// Returns the size to grow the node pool to if it is close to full and allowed to
+	// grow, or 0.
+	int getNodePoolGrowth() const;
+
+	// Returns the estimated cost from a position to the end of a path search.
+	float estimateCost(dtPolyRef ref, const float* pos, dtPolyRef endRef, const float* endPos) const;
+
+	// Grows the node pool and open list. Node pointers outside of the open list need
+	// to be refetched by index.
+	dtStatus growNodes(const int maxNodes) const;
 	
 	const dtNavMesh* m_nav;				///< Pointer to navmesh data.
 
@@ -560,6 +631,8 @@ private:
 	class dtNodePool* m_tinyNodePool;	///< Pointer to small node pool.
 	class dtNodePool* m_nodePool;		///< Pointer to node pool.
 	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
+	int m_nodePoolLimit;				///< Size the node pool may grow to during a search.
+	const dtQueryHeuristic* m_heuristic;	///< Estimates the cost left in path searches. [opt]
 };
 
 /// Allocates a query object using the Detour allocator.
@@ -53,6 +53,12 @@ public:
 	~dtNodePool();
 	void clear();
 
+	// Grows the pool to maxNodes, keeping the nodes that are in use and their indices.
+	// Pointers to nodes are invalidated. Returns the old node array, which is still valid
+	// so that pointers can be moved over, and must be freed with dtFree. Returns 0 if the
+	// memory couldn't be allocated, in which case nothing has changed.
+	dtNode* grow(int maxNodes);
+
 	// Get a dtNode by ref and extra state information. If there is none then - allocate
 	// There can be more than one node for the same polyRef but with different extra state information
 	dtNode* getNode(dtPolyRef id, unsigned char state=0);	
@@ -100,8 +106,8 @@ private:
 	dtNode* m_nodes;
 	dtNodeIndex* m_first;
 	dtNodeIndex* m_next;
-	const int m_maxNodes;
-	const int m_hashSize;
+	int m_maxNodes;
+	int m_hashSize;
 	int m_nodeCount;
 };
 
@@ -150,6 +156,14 @@ public:
 	}
 	
 	inline int getCapacity() const { return m_capacity; }
+
+	// Grows the queue to hold n nodes, keeping its contents. Returns false if the memory
+	// couldn't be allocated.
+	bool reserve(int n);
+
+	// Moves the queued node pointers from one node array to another, after the node
+	// pool has grown.
+	void rebase(const dtNode* oldNodes, dtNode* newNodes);
 	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
@@ -160,7 +174,7 @@ private:
 	void trickleDown(int i, dtNode* node);
 	
 	dtNode** m_heap;
-	const int m_capacity;
+	int m_capacity;
 	int m_size;
 };		
 
@@ -139,7 +139,9 @@ dtNavMeshQuery::dtNavMeshQuery() :
 	m_nav(0),
 	m_tinyNodePool(0),
 	m_nodePool(0),
-	m_openList(0)
+	m_openList(0),
+	m_nodePoolLimit(0),
+	m_heuristic(0)
 {
 	memset(&m_query, 0, sizeof(dtQueryData));
 }
@@ -218,6 +220,100 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 	return DT_SUCCESS;
 }
 
+dtStatus dtNavMeshQuery::growNodePool(const int maxNodes)
+{
+	if (!m_nodePool || !m_openList)
+		return DT_FAILURE;
+	if (maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxNodes <= m_nodePool->getMaxNodes())
+		return DT_SUCCESS;
+
+	// indices don't change when the pool grows
+	const unsigned int lastBestIdx = m_nodePool->getNodeIdx(m_query.lastBestNode);
+
+	dtStatus status = growNodes(maxNodes);
+	m_query.lastBestNode = m_nodePool->getNodeAtIdx(lastBestIdx);
+
+	return status;
+}
+
+dtStatus dtNavMeshQuery::growNodes(const int maxNodes) const
+{
+	if (!m_openList->reserve(maxNodes))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	dtNode* oldNodes = m_nodePool->grow(maxNodes);
+	if (!oldNodes)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	m_openList->rebase(oldNodes, m_nodePool->getNodeAtIdx(1));
+	dtFree(oldNodes);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::shrinkNodePool(const int maxNodes)
+{
+	if (maxNodes <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const bool shrinkPool = m_nodePool && m_nodePool->getMaxNodes() > maxNodes;
+	const bool shrinkList = m_openList && m_openList->getCapacity() > maxNodes;
+
+	// Allocate the new pools before freeing the old ones, so that the query can
+	// still be used if this runs out of memory.
+	void* poolMem = shrinkPool ? dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM) : 0;
+	void* listMem = shrinkList ? dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM) : 0;
+	if ((shrinkPool && !poolMem) || (shrinkList && !listMem))
+	{
+		dtFree(poolMem);
+		dtFree(listMem);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (shrinkPool)
+	{
+		dtNodePool* nodePool = new (poolMem) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool->~dtNodePool();
+		dtFree(m_nodePool);
+		m_nodePool = nodePool;
+	}
+
+	if (shrinkList)
+	{
+		dtNodeQueue* openList = new (listMem) dtNodeQueue(maxNodes);
+		m_openList->~dtNodeQueue();
+		dtFree(m_openList);
+		m_openList = openList;
+	}
+
+	memset(&m_query, 0, sizeof(dtQueryData));
+	return DT_SUCCESS;
+}
+
+int dtNavMeshQuery::getNodePoolGrowth() const
+{
+	// Leave enough room to expand the next node without running out. A polygon can
+	// have more neighbours than this, but then the search just skips some of them,
+	// the same as it would without growth.
+	static const int GROWTH_HEADROOM = 256;
+
+	const int maxNodes = m_nodePool->getMaxNodes();
+	if (m_nodePoolLimit <= maxNodes || maxNodes - m_nodePool->getNodeCount() > GROWTH_HEADROOM)
+		return 0;
+
+	return dtMin(dtMax(maxNodes * 2, GROWTH_HEADROOM * 2), m_nodePoolLimit);
+}
+
+float dtNavMeshQuery::estimateCost(dtPolyRef ref, const float* pos, dtPolyRef endRef, const float* endPos) const
+{
+	if (m_heuristic)
+		return m_heuristic->getCost(ref, pos, endRef, endPos) * H_SCALE;
+
+	return dtVdist(pos, endPos) * H_SCALE;
+}
+
 dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*frand)(),
 										 dtPolyRef* randomRef, float* randomPt) const
 {
@@ -1044,7 +1140,7 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 	dtVcopy(startNode->pos, startPos);
 	startNode->pidx = 0;
 	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	startNode->total = estimateCost(startRef, startPos, endRef, endPos);
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
@@ -1056,6 +1152,21 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 	
 	while (!m_openList->empty())
 	{
+		// Make room before taking the next node, if the pool is allowed to grow.
+		if (const int growth = getNodePoolGrowth())
+		{
+			const unsigned int lastBestIdx = m_nodePool->getNodeIdx(lastBestNode);
+			const dtStatus growStatus = growNodes(growth);
+			lastBestNode = m_nodePool->getNodeAtIdx(lastBestIdx);
+
+			// Out of memory, return the path to the best node so far.
+			if (dtStatusFailed(growStatus))
+			{
+				outOfNodes = true;
+				break;
+			}
+		}
+
 		// Remove node from open list and put it in closed list.
 		dtNode* bestNode = m_openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
@@ -1150,7 +1261,7 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 													  bestRef, bestTile, bestPoly,
 													  neighbourRef, neighbourTile, neighbourPoly);
 				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
+				heuristic = estimateCost(neighbourRef, neighbourNode->pos, endRef, endPos);
 			}
 
 			const float total = cost + heuristic;
@@ -1299,7 +1410,7 @@ dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef
 	dtVcopy(startNode->pos, startPos);
 	startNode->pidx = 0;
 	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	startNode->total = estimateCost(startRef, startPos, endRef, endPos);
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
@@ -1330,6 +1441,20 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 	while (iter < maxIter && !m_openList->empty())
 	{
 		iter++;
+
+		// Make room before taking the next node, if the pool is allowed to grow.
+		if (const int growth = getNodePoolGrowth())
+		{
+			// Out of memory, finish with the best node so far.
+			if (dtStatusFailed(growNodePool(growth)))
+			{
+				const dtStatus details = m_query.status & DT_STATUS_DETAIL_MASK;
+				m_query.status = DT_SUCCESS | DT_OUT_OF_NODES | details;
+				if (doneIters)
+					*doneIters = iter;
+				return m_query.status;
+			}
+		}
 		
 		// Remove node from open list and put it in closed list.
 		dtNode* bestNode = m_openList->pop();
@@ -1473,7 +1598,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			}
 			else
 			{
-				heuristic = dtVdist(neighbourNode->pos, m_query.endPos)*H_SCALE;
+				heuristic = estimateCost(neighbourRef, neighbourNode->pos, m_query.endRef, m_query.endPos);
 			}
 			
 			const float total = cost + heuristic;
@@ -3044,6 +3169,175 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 	return status;
 }
 
+/// @par
+///
+/// The search expands out from the start polygon in order of cost, and stops once
+/// every target polygon has been reached, or once everything left to expand costs
+/// more than @p maxCost. This is much cheaper than a findPath per target when there
+/// are many targets. The path to a target that was reached can be retrieved with
+/// getPathFromDijkstraSearch().
+///
+/// The costs are to the edge where the target polygon is entered, not to any
+/// particular position within it.
+///
+/// The pool is grown during the search when allowed, see setNodePoolLimit().
+///
+dtStatus dtNavMeshQuery::findCostsToPolys(dtPolyRef startRef, const float* startPos,
+										  const dtPolyRef* targetRefs, const int ntargets, const float maxCost,
+										  const dtQueryFilter* filter, float* targetCosts) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	// Validate input
+	if (!m_nav->isValidPolyRef(startRef) || !startPos || ntargets < 0 ||
+		(ntargets > 0 && (!targetRefs || !targetCosts)) || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	int remaining = 0;
+	for (int i = 0; i < ntargets; ++i)
+	{
+		targetCosts[i] = -1.0f;
+		if (targetRefs[i])
+			remaining++;
+	}
+
+	m_nodePool->clear();
+	m_openList->clear();
+
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, startPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = 0;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+
+	dtStatus status = DT_SUCCESS;
+
+	while (remaining > 0 && !m_openList->empty())
+	{
+		// Make room before taking the next node, if the pool is allowed to grow.
+		if (const int growth = getNodePoolGrowth())
+		{
+			// Out of memory, the targets that haven't been reached are left at -1.
+			if (dtStatusFailed(growNodes(growth)))
+			{
+				status |= DT_PARTIAL_RESULT | DT_OUT_OF_NODES;
+				break;
+			}
+		}
+
+		// Everything left costs at least this much.
+		if (m_openList->top()->total > maxCost)
+			break;
+
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+
+		const dtPolyRef bestRef = bestNode->id;
+
+		// Settle the targets on this polygon.
+		for (int i = 0; i < ntargets; ++i)
+		{
+			if (targetRefs[i] == bestRef && targetCosts[i] < 0.0f)
+			{
+				targetCosts[i] = bestNode->total;
+				remaining--;
+			}
+		}
+
+		if (remaining == 0)
+			break;
+
+		// Get poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef)
+			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			dtPolyRef neighbourRef = bestTile->links[i].ref;
+
+			// Skip invalid neighbours and do not follow back to parent.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+
+			// Expand to neighbour
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+
+			// Do not advance if the polygon is excluded by the filter.
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+			{
+				status |= DT_OUT_OF_NODES;
+				continue;
+			}
+
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				continue;
+
+			// If the node is visited the first time, calculate node position.
+			if (neighbourNode->flags == 0)
+			{
+				getEdgeMidPoint(bestRef, bestPoly, bestTile,
+								neighbourRef, neighbourPoly, neighbourTile,
+								neighbourNode->pos);
+			}
+
+			// Cost
+			const float cost = filter->getCost(bestNode->pos, neighbourNode->pos,
+											   parentRef, parentTile, parentPoly,
+											   bestRef, bestTile, bestPoly,
+											   neighbourRef, neighbourTile, neighbourPoly);
+
+			const float total = bestNode->total + cost;
+
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+
+			neighbourNode->id = neighbourRef;
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->cost = total;
+			neighbourNode->total = total;
+
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags = DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
+			}
+		}
+	}
+
+	if (remaining > 0)
+		status |= DT_PARTIAL_RESULT;
+
+	return status;
+}
+
 dtStatus dtNavMeshQuery::getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const
 {
 	if (!m_nav->isValidPolyRef(endRef) || !path || !pathCount || maxPath < 0)
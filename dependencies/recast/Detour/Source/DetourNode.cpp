@@ -86,6 +86,51 @@ void dtNodePool::clear()
 	m_nodeCount = 0;
 }
 
+dtNode* dtNodePool::grow(int maxNodes)
+{
+	dtAssert(maxNodes > m_maxNodes && maxNodes <= DT_NULL_IDX && maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
+
+	const int hashSize = dtMax((int)dtNextPow2(maxNodes/4), m_hashSize);
+
+	dtNode* nodes = (dtNode*)dtAlloc(sizeof(dtNode)*maxNodes, DT_ALLOC_PERM);
+	dtNodeIndex* next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*maxNodes, DT_ALLOC_PERM);
+	dtNodeIndex* first = hashSize != m_hashSize ? (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM) : m_first;
+	if (!nodes || !next || !first)
+	{
+		dtFree(nodes);
+		dtFree(next);
+		if (first != m_first)
+			dtFree(first);
+		return 0;
+	}
+
+	// Nodes keep their indices, so parent links stay valid. The hash chains are rebuilt
+	// since the buckets change with the hash size.
+	memcpy(nodes, m_nodes, sizeof(dtNode)*m_nodeCount);
+	memset(first, 0xff, sizeof(dtNodeIndex)*hashSize);
+	memset(next, 0xff, sizeof(dtNodeIndex)*maxNodes);
+
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		unsigned int bucket = dtHashRef(nodes[i].id) & (hashSize-1);
+		next[i] = first[bucket];
+		first[bucket] = (dtNodeIndex)i;
+	}
+
+	dtNode* oldNodes = m_nodes;
+	dtFree(m_next);
+	if (first != m_first)
+		dtFree(m_first);
+
+	m_nodes = nodes;
+	m_next = next;
+	m_first = first;
+	m_maxNodes = maxNodes;
+	m_hashSize = hashSize;
+
+	return oldNodes;
+}
+
 unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes)
 {
 	int n = 0;
@@ -169,6 +214,29 @@ dtNodeQueue::~dtNodeQueue()
 	dtFree(m_heap);
 }
 
+bool dtNodeQueue::reserve(int n)
+{
+	if (n <= m_capacity)
+		return true;
+
+	dtNode** heap = (dtNode**)dtAlloc(sizeof(dtNode*)*(n+1), DT_ALLOC_PERM);
+	if (!heap)
+		return false;
+
+	memcpy(heap, m_heap, sizeof(dtNode*)*m_size);
+	dtFree(m_heap);
+
+	m_heap = heap;
+	m_capacity = n;
+	return true;
+}
+
+void dtNodeQueue::rebase(const dtNode* oldNodes, dtNode* newNodes)
+{
+	for (int i = 0; i < m_size; ++i)
+		m_heap[i] = newNodes + (m_heap[i] - oldNodes);
+}
+
 void dtNodeQueue::bubbleUp(int i, dtNode* node)
 {
 	int parent = (i-1)/2;
@@ -211,10 +211,13 @@ dtPathCorridor::~dtPathCorridor()
 
 /// @par
 ///
-/// @warning Cannot be called more than once.
+/// Calling this again replaces the path buffer, and the corridor is emptied.
 bool dtPathCorridor::init(const int maxPath)
 {
-	dtAssert(!m_path);
+	dtFree(m_path);
+	m_path = 0;
+	m_npath = 0;
+	m_maxPath = 0;
 	m_path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*maxPath, DT_ALLOC_PERM);
 	if (!m_path)
 		return false;
@@ -12,6 +12,7 @@
 #include "meshgen/resource.h"
 #include "meshgen/imgui/imgui_impl_opengl2.h"
 #include "meshgen/imgui/imgui_impl_sdl.h"
+#include "common/Compression.h"
 #include "common/Utilities.h"
 
 #include "imgui/ImGuiUtils.h"
@@ -892,6 +893,7 @@ void Application::SaveMesh()
 	if (m_meshTool->isBuildingTiles() || !m_navMesh->IsNavMeshLoaded())
 		return;
 
+	m_navMesh->SetTileCodec(m_eqConfig.GetTileCodec());
 	m_meshTool->SaveNavMesh();
 }
 
@@ -945,6 +947,29 @@ void Application::ShowSettingsDialog()
 				"The zone will need to be reloaded to apply this change");
 			ImGui::EndTooltip();
 		}
+
+		NavMeshCodec tileCodec = m_eqConfig.GetTileCodec();
+		ImGui::PushItemWidth(125);
+		if (ImGui::BeginCombo("Tile compression", GetCodecName(tileCodec)))
+		{
+			for (uint32_t i = 0; i <= static_cast<uint32_t>(NavMeshCodec::Last); ++i)
+			{
+				NavMeshCodec codec = static_cast<NavMeshCodec>(i);
+				if (ImGui::Selectable(GetCodecName(codec), codec == tileCodec))
+					m_eqConfig.SetTileCodec(codec);
+			}
+
+			ImGui::EndCombo();
+		}
+		ImGui::PopItemWidth();
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::BeginTooltip();
+			ImGui::Text("Compression used for the tiles of saved navmeshes. zstd makes\n"
+				"the smallest files that are still quick to load, lz4 loads the\n"
+				"fastest, and none lets tiles be used straight from the file.");
+			ImGui::EndTooltip();
+		}
 		ImGui::Separator();
 
 		if (ImGui::Button("Close", ImVec2(120, 0)))
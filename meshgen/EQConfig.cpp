@@ -3,6 +3,7 @@
 //
 
 #include "meshgen/EQConfig.h"
+#include "common/Compression.h"
 
 #include <windows.h>
 #include <ShObjIdl.h>
@@ -170,6 +171,10 @@ void EQConfig::LoadConfigFromIni()
 	GetPrivateProfileString("General", "ZoneMaxExtents", m_useMaxExtents ? "true" : "false",
 		szTemp, 10, fullPath);
 	m_useMaxExtents = !_stricmp(szTemp, "true");
+
+	GetPrivateProfileString("General", "TileCodec", GetCodecName(m_tileCodec),
+		szTemp, 10, fullPath);
+	ParseCodecName(szTemp, m_tileCodec);
 }
 
 void EQConfig::SaveConfigToIni()
@@ -183,6 +188,7 @@ void EQConfig::SaveConfigToIni()
 	WritePrivateProfileString("General", "EverQuest Path", m_everquestPath.c_str(), fullPath);
 	WritePrivateProfileString("General", "Output Path", m_mq2Path.c_str(), fullPath);
 	WritePrivateProfileString("General", "ZoneMaxExtents", m_useMaxExtents ? "true" : "false", fullPath);
+	WritePrivateProfileString("General", "TileCodec", GetCodecName(m_tileCodec), fullPath);
 }
 
 void EQConfig::LoadZones()
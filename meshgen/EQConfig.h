@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include "common/NavMeshData.h"
+
 #include <map>
 #include <string>
 #include <set>
@@ -29,6 +31,10 @@ public:
 	bool GetUseMaxExtents() const { return m_useMaxExtents; }
 	void SetUseMaxExtents(bool use) { m_useMaxExtents = use; SaveConfigToIni(); }
 
+	// codec used to compress the tiles of saved navmeshes
+	NavMeshCodec GetTileCodec() const { return m_tileCodec; }
+	void SetTileCodec(NavMeshCodec codec) { m_tileCodec = codec; SaveConfigToIni(); }
+
 	// loaded maps, keyed by their expansion group. Data is loaded from Zones.ini
 	typedef std::pair<std::string /*shortName*/, std::string /*longName*/> ZoneNamePair;
 
@@ -55,6 +61,7 @@ private:
 	std::string m_mq2Path;
 	std::string m_outputPath;
 	bool m_useMaxExtents = true;
+	NavMeshCodec m_tileCodec = NAVMESH_DEFAULT_TILE_CODEC;
 
 	MapList m_loadedMaps;
 
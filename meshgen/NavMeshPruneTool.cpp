@@ -6,6 +6,7 @@
 #include "meshgen/InputGeom.h"
 #include "meshgen/NavMeshTool.h"
 #include "common/NavMeshData.h"
+#include "common/PolyConnectivity.h"
 
 #include <DetourNavMesh.h>
 #include <DetourCommon.h>
@@ -113,40 +114,18 @@ public:
 
 static void floodNavmesh(dtNavMesh* nav, NavmeshFlags* flags, dtPolyRef start, uint8_t flag)
 {
-	// If already visited, skip.
-	if (flags->getFlags(start))
-		return;
-
 	std::vector<dtPolyRef> openList;
-	openList.push_back(start);
 
-	while (!openList.empty())
+	FloodNavMesh(nav, start, openList, [&](dtPolyRef ref)
 	{
-		const dtPolyRef ref = openList.back();
-		openList.pop_back();
-
-		// Get current poly and tile.
-		// The API input has been checked already, skip checking internal data.
-		const dtMeshTile* tile = nullptr;
-		const dtPoly* poly = nullptr;
-		nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
-
-		// Visit linked polygons.
-		for (auto i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
-		{
-			const dtPolyRef neiRef = tile->links[i].ref;
-
-			// Skip invalid and already visited.
-			if (!neiRef || flags->getFlags(neiRef))
-				continue;
-
-			// Mark as visited
-			flags->setFlags(neiRef, flag);
+		// Skip already visited.
+		if (flags->getFlags(ref))
+			return false;
 
-			// Visit neighbors
-			openList.push_back(neiRef);
-		}
-	}
+		// Mark as visited
+		flags->setFlags(ref, flag);
+		return true;
+	});
 }
 
 static void disableUnvisitedPolys(dtNavMesh* nav, NavmeshFlags* flags)
@@ -403,6 +403,19 @@ void NavMeshTool::handleTools()
 
 			ImGui::SliderFloat("Sample Distance", &m_config.detailSampleDist, 0.0f, 0.9f, "%.2f");
 			ImGui::SliderFloat("Max Sample Error", &m_config.detailSampleMaxError, 0.0f, 100.0f, "%.1f");
+
+			// Search
+			ImGui::Text("Search");
+			ImGui::SameLine();
+			static const char* SearchHelp =
+				"Landmarks:\n"
+				"  - The number of landmark polygons to save search costs for. Path searches\n"
+				"    use them to estimate how far they are from the end, which is much better\n"
+				"    than the straight line in winding zones like dungeons.\n"
+				"  - Each landmark adds 2 bytes per polygon to the file. 0 to leave them out.\n";
+			mq::imgui::HelpMarker(SearchHelp, 600.0f, mq::imgui::ConsoleFont);
+
+			ImGui::SliderInt("Landmarks", &m_config.landmarkCount, 0, 16);
 		}
 	}
 }
@@ -7,6 +7,7 @@
 
 #include "common/Logging.h"
 #include "common/NavMesh.h"
+#include "common/PathWorker.h"
 #include "plugin/KeybindHandler.h"
 #include "plugin/ModelLoader.h"
 #include "plugin/PluginSettings.h"
@@ -31,8 +32,11 @@
 #include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/msvc_sink.h>
+#include <algorithm>
 #include <chrono>
+#include <mutex>
 #include <set>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -196,12 +200,35 @@ float GetMyVelocity()
 	return 0.0f;
 }
 
-class WriteChatSink : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+// Writes log messages to chat. Chat can only be written from the main thread, so messages
+// logged from other threads (eg. while loading a navmesh) are held until the next pulse.
+class WriteChatSink : public spdlog::sinks::base_sink<std::mutex>
 {
 public:
+	WriteChatSink()
+		: mainThreadId_(std::this_thread::get_id())
+	{
+	}
+
 	void set_enabled(bool enabled) { enabled_ = enabled; }
 	bool enabled() const { return enabled_; }
 
+	// write out messages that were logged from other threads
+	void write_deferred()
+	{
+		std::vector<std::string> messages;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			messages.swap(deferred_);
+		}
+
+		for (const std::string& message : messages)
+		{
+			WriteChatf("%s", message.c_str());
+		}
+	}
+
 protected:
 	void sink_it_(const spdlog::details::log_msg& msg) override
 	{
@@ -233,12 +260,20 @@ protected:
 			break;
 		}
 
+		if (std::this_thread::get_id() != mainThreadId_)
+		{
+			deferred_.push_back(fmt::to_string(formatted));
+			return;
+		}
+
 		WriteChatf("%s", fmt::to_string(formatted).c_str());
 	}
 
 	void flush_() override {}
 
 	bool enabled_ = true;
+	std::thread::id mainThreadId_;
+	std::vector<std::string> deferred_;
 };
 
 spdlog::level::level_enum ExtractLogLevel(std::string_view input,
@@ -352,6 +387,19 @@ public:
 			observerRecords.end());
 	}
 
+	virtual void PrefetchZone(int zoneId) override
+	{
+		if (m_plugin->IsInitialized())
+			m_plugin->PrefetchZone(zoneId);
+	}
+
+	virtual std::vector<float> GetPathLengths(const std::vector<std::string_view>& destinations) override
+	{
+		if (m_plugin->IsInitialized())
+			return m_plugin->GetNavigationPathLengths(destinations);
+		return std::vector<float>(destinations.size(), -1.0f);
+	}
+
 	//============================================================================
 
 	void DispatchObserverEvent(nav::NavObserverEvent event, nav::NavCommandState* state)
@@ -435,6 +483,22 @@ void MQ2NavigationPlugin::Plugin_OnPulse()
 		m.second->OnPulse();
 	}
 
+	m_queryPlanner.Trim();
+
+	static_cast<WriteChatSink*>(m_chatSink.get())->write_deferred();
+
+	// run commands that were waiting for the navmesh to load
+	if (!m_queuedCommands.empty() && !Get<NavMeshLoader>()->IsLoading())
+	{
+		std::vector<std::string> commands;
+		commands.swap(m_queuedCommands);
+
+		for (const std::string& command : commands)
+		{
+			Command_Navigate(command);
+		}
+	}
+
 	if (m_initialized && nav::ValidIngame(true))
 	{
 		AttemptMovement();
@@ -449,6 +513,7 @@ void MQ2NavigationPlugin::Plugin_OnBeginZone()
 
 	// stop active path if one exists
 	ResetPath();
+	m_queuedCommands.clear();
 
 	UpdateCurrentZone();
 
@@ -556,7 +621,11 @@ void MQ2NavigationPlugin::Plugin_Initialize()
 	AddModule<KeybindHandler>();
 
 	NavMesh* mesh = AddModule<NavMesh>(GetDataDirectory());
+	mesh->GetQueryPool().SetShrinkDelay(
+		std::chrono::seconds(std::max(nav::GetSettings().node_pool_shrink_delay, 0)));
+	mesh->SetPolyGridEnabled(nav::GetSettings().use_poly_grid);
 	AddModule<NavMeshLoader>(mesh);
+	AddModule<PathWorker>(mesh);
 
 	AddModule<ModelLoader>();
 	AddModule<NavMeshRenderer>();
@@ -573,6 +642,16 @@ void MQ2NavigationPlugin::Plugin_Initialize()
 	m_keypressConn = keybindHandler->OnMovementKeyPressed.Connect(
 		[this]() { OnMovementKeyPressed(); });
 
+	m_pathCache.SetCapacity(std::max(nav::GetSettings().path_cache_size, 0));
+	m_queryPlanner.SetPathCache(&m_pathCache);
+	m_queryPlanner.SetNavMesh(mesh);
+	m_navMeshConn = mesh->OnNavMeshChanged.Connect(
+		[this, mesh]()
+	{
+		m_pathCache.Clear();
+		m_queryPlanner.SetNavMesh(mesh);
+	});
+
 	// initialize mesh loader's settings
 	auto meshLoader = Get<NavMeshLoader>();
 	meshLoader->SetAutoReload(nav::GetSettings().autoreload);
@@ -656,6 +735,10 @@ void MQ2NavigationPlugin::Plugin_Shutdown()
 
 	Stop(false);
 
+	m_navMeshConn.Disconnect();
+	m_queryPlanner.SetNavMesh(nullptr);
+	m_pathCache.Clear();
+
 	// shut down all of the modules
 	for (const auto& m : m_modules)
 	{
@@ -712,6 +795,8 @@ static void DoHelp()
 	WriteChatf(PLUGIN_MSG "\ag/nav setopt [options | reset]\ax - Set the default value for options used for navigation. See \agOptions\ax below. Pass \"reset\" instead to reset them to their default values.");
 	WriteChatf(PLUGIN_MSG "\ag/nav spawn <spawn search> | [options]\ax - navigate to spawn via spawn search query. If you want to provide options to navigate, like distance, you need to separate them by a | (pipe)");
 	WriteChatf(PLUGIN_MSG "\ag/nav waypoint|wp <waypoint>\ax - navigate to waypoint");
+	WriteChatf(PLUGIN_MSG "\ag/nav nearest spawn <spawn search> | [options]\ax - navigate to the matching spawn with the shortest path");
+	WriteChatf(PLUGIN_MSG "\ag/nav nearest [door | item | wp] [name] [click]\ax - navigate to the door, item or waypoint starting with name that has the shortest path");
 	WriteChatf(PLUGIN_MSG "\ag/nav stop\ax - stop navigation");
 	WriteChatf(PLUGIN_MSG "\ag/nav pause\ax - pause navigation");
 	WriteChatf(PLUGIN_MSG "\ag/nav ini <key> <value>\ax - Write a setting to the ini and reload settings");
@@ -770,7 +855,12 @@ void MQ2NavigationPlugin::Command_Navigate(std::string_view line)
 	// parse /nav stop
 	if (!_stricmp(buffer, "stop"))
 	{
-		if (m_isActive)
+		if (!m_queuedCommands.empty())
+		{
+			m_queuedCommands.clear();
+			SPDLOG_INFO("Cancelled navigation that was waiting for the navmesh to load");
+		}
+		else if (m_isActive)
 		{
 			Stop(false);
 		}
@@ -887,6 +977,14 @@ void MQ2NavigationPlugin::Command_Navigate(std::string_view line)
 
 	scopedLevel.Release();
 
+	// navigation needs the navmesh, so hold onto the command until it finishes loading.
+	if (Get<NavMeshLoader>()->IsLoading())
+	{
+		SPDLOG_INFO("Navmesh is still loading, navigation will begin when it is ready");
+		m_queuedCommands.emplace_back(line);
+		return;
+	}
+
 	// all thats left is a navigation command. leave if it isn't a valid one.
 	auto destination = ParseDestination(mutableLine, requestedLevel);
 	if (!destination->valid)
@@ -897,7 +995,7 @@ void MQ2NavigationPlugin::Command_Navigate(std::string_view line)
 
 //----------------------------------------------------------------------------
 
-void MQ2NavigationPlugin::UpdateCurrentZone()
+int MQ2NavigationPlugin::GetCharacterZoneId() const
 {
 	int zoneId = -1;
 
@@ -910,7 +1008,20 @@ void MQ2NavigationPlugin::UpdateCurrentZone()
 			zoneId = -1;
 	}
 
-	SetCurrentZone(zoneId);
+	return zoneId;
+}
+
+void MQ2NavigationPlugin::UpdateCurrentZone()
+{
+	SetCurrentZone(GetCharacterZoneId());
+}
+
+void MQ2NavigationPlugin::PrefetchZone(int zoneId)
+{
+	if (zoneId != -1 && zoneId != m_zoneId)
+	{
+		Get<NavMeshLoader>()->PrefetchZone(zoneId);
+	}
 }
 
 void MQ2NavigationPlugin::SetCurrentZone(int zoneId)
@@ -930,7 +1041,28 @@ void MQ2NavigationPlugin::SetCurrentZone(int zoneId)
 		{
 			m.second->SetZoneId(m_zoneId);
 		}
+
+		UpdateFlowFieldTargets();
+	}
+}
+
+void MQ2NavigationPlugin::UpdateFlowFieldTargets()
+{
+	std::vector<FlowFieldTarget> targets;
+
+	if (nav::GetSettings().waypoint_flow_fields)
+	{
+		for (const nav::Waypoint& wp : nav::g_waypoints)
+		{
+			// waypoints are in the same coordinates as eqDestinationPos
+			if (wp.flowField)
+			{
+				targets.push_back({ wp.name, wp.location.xzy() });
+			}
+		}
 	}
+
+	Get<NavMesh>()->SetFlowFieldTargets(std::move(targets));
 }
 
 void MQ2NavigationPlugin::BeginNavigation(const std::shared_ptr<DestinationInfo>& destInfo)
@@ -1187,6 +1319,9 @@ void MQ2NavigationPlugin::AttemptMovement()
 	{
 		clock::time_point now = clock::now();
 
+		// a replan that is too long for one frame is spread over several
+		m_activePath->ContinueSearch();
+
 		if (now - m_pathfindTimer > std::chrono::milliseconds(PATHFINDING_DELAY_MS))
 		{
 			auto info = m_activePath->GetDestinationInfo();
@@ -1460,6 +1595,13 @@ std::shared_ptr<DestinationInfo> MQ2NavigationPlugin::ParseDestinationInternal(s
 		return result;
 	}
 
+	// parse /nav nearest <spawn <search>|door [name]|item [name]|waypoint [name]> [click]
+	if (!_stricmp(buffer, "nearest"))
+	{
+		ParseNearestDestination(buffer, mutableLine, idx, *result);
+		return result;
+	}
+
 	// parse /nav door [click [once]]
 	if (!_stricmp(buffer, "door") || !_stricmp(buffer, "item"))
 	{
@@ -1603,6 +1745,196 @@ std::shared_ptr<DestinationInfo> MQ2NavigationPlugin::ParseDestinationInternal(s
 	return result;
 }
 
+void MQ2NavigationPlugin::ParseNearestDestination(char* buffer, char* mutableLine, int& idx,
+	DestinationInfo& result)
+{
+	GetArg(buffer, mutableLine, idx++);
+	std::string type = buffer;
+
+	// Everything that matches is a candidate, and the one with the shortest path wins.
+	std::vector<DestinationInfo> candidates;
+
+	if (!_stricmp(type.c_str(), "spawn"))
+	{
+		MQSpawnSearch sSpawn;
+		ClearSearchSpawn(&sSpawn);
+
+		// the rest of the line is the spawn search, up to the options
+		PCHAR text = GetNextArg(mutableLine, idx - 1);
+
+		std::string_view tempView{ text };
+		size_t pos = tempView.find_last_of("|");
+		if (pos != std::string_view::npos)
+		{
+			tempView = tempView.substr(0, pos);
+		}
+
+		CHAR szSpawnSearch[MAX_STRING];
+		strncpy_s(szSpawnSearch, tempView.data(), tempView.length());
+
+		ParseSearchSpawn(szSpawnSearch, &sSpawn);
+
+		for (PSPAWNINFO pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->GetNext())
+		{
+			if (pSpawn != pControlledPlayer && SpawnMatchesSearch(&sSpawn, pControlledPlayer, pSpawn))
+			{
+				DestinationInfo& candidate = candidates.emplace_back();
+				candidate.type = DestinationType::Spawn;
+				candidate.pSpawn = pSpawn;
+				candidate.eqDestinationPos = GetSpawnPosition(pSpawn);
+			}
+		}
+	}
+	else
+	{
+		// optional name to match the start of, and then optional click
+		GetArg(buffer, mutableLine, idx++);
+		std::string name;
+		if (buffer[0] && _stricmp(buffer, "click") != 0 && !strchr(buffer, '='))
+		{
+			name = buffer;
+			GetArg(buffer, mutableLine, idx++);
+		}
+
+		if (!_stricmp(buffer, "click"))
+		{
+			result.clickType = ClickType::Once;
+		}
+		else
+		{
+			// not ours, leave it for the options
+			--idx;
+		}
+
+		auto matches = [&name](const char* text)
+		{
+			return name.empty() || !_strnicmp(text, name.c_str(), name.length());
+		};
+
+		if (!_stricmp(type.c_str(), "door") || !_stricmp(type.c_str(), "switch"))
+		{
+			for (int i = 0; pSwitchMgr && i < pSwitchMgr->NumEntries; i++)
+			{
+				EQSwitch* theSwitch = pSwitchMgr->GetSwitch(i);
+				if (matches(theSwitch->Name))
+				{
+					DestinationInfo& candidate = candidates.emplace_back();
+					candidate.type = DestinationType::Door;
+					candidate.pSwitch = theSwitch;
+					candidate.eqDestinationPos = { theSwitch->X, theSwitch->Y, theSwitch->Z };
+				}
+			}
+		}
+		else if (!_stricmp(type.c_str(), "item"))
+		{
+			for (EQGroundItem* pItem = pItemList->Top; pItem; pItem = pItem->pNext)
+			{
+				MQGroundSpawn groundItem{ pItem };
+				if (matches(groundItem.DisplayName().c_str()))
+				{
+					CVector3 position = groundItem.Position();
+
+					DestinationInfo& candidate = candidates.emplace_back();
+					candidate.type = DestinationType::GroundItem;
+					candidate.groundItem = groundItem;
+					candidate.eqDestinationPos = { position.X, position.Y, position.Z };
+				}
+			}
+		}
+		else if (!_stricmp(type.c_str(), "waypoint") || !_stricmp(type.c_str(), "wp"))
+		{
+			for (const nav::Waypoint& wp : nav::g_waypoints)
+			{
+				if (matches(wp.name.c_str()))
+				{
+					DestinationInfo& candidate = candidates.emplace_back();
+					candidate.type = DestinationType::Waypoint;
+					candidate.waypoint = wp.name;
+					candidate.eqDestinationPos = { wp.location.x, wp.location.y, wp.location.z };
+				}
+			}
+		}
+		else
+		{
+			SPDLOG_ERROR("Invalid nearest destination: {}. Expected spawn, door, item or waypoint", type);
+			return;
+		}
+	}
+
+	if (candidates.empty())
+	{
+		SPDLOG_ERROR("Could not find any {} matching '{}'", type, result.command);
+		return;
+	}
+
+	// Only the ones closest in a straight line are searched, a crowded zone can
+	// have hundreds of matches.
+	if (static_cast<int>(candidates.size()) > MAX_NEAREST_CANDIDATES)
+	{
+		glm::vec3 myPos = GetMyPosition();
+		auto closer = [&myPos](const DestinationInfo& a, const DestinationInfo& b)
+		{
+			return glm::distance2(a.eqDestinationPos, myPos) < glm::distance2(b.eqDestinationPos, myPos);
+		};
+
+		std::partial_sort(candidates.begin(), candidates.begin() + MAX_NEAREST_CANDIDATES,
+			candidates.end(), closer);
+		candidates.resize(MAX_NEAREST_CANDIDATES);
+	}
+
+	std::vector<glm::vec3> positions;
+	positions.reserve(candidates.size());
+	for (const DestinationInfo& candidate : candidates)
+	{
+		positions.push_back(candidate.eqDestinationPos);
+	}
+
+	std::vector<float> lengths = PlanPathLengths(positions);
+
+	int best = -1;
+	for (int i = 0; i < static_cast<int>(lengths.size()); ++i)
+	{
+		if (lengths[i] >= 0.f && (best == -1 || lengths[i] < lengths[best]))
+		{
+			best = i;
+		}
+	}
+
+	if (best == -1)
+	{
+		SPDLOG_ERROR("Could not find a path to any of the {} matching {}", candidates.size(), type);
+		return;
+	}
+
+	DestinationInfo& nearest = candidates[best];
+	result.type = nearest.type;
+	result.eqDestinationPos = nearest.eqDestinationPos;
+	result.pSpawn = nearest.pSpawn;
+	result.pSwitch = nearest.pSwitch;
+	result.groundItem = nearest.groundItem;
+	result.waypoint = nearest.waypoint;
+	result.valid = true;
+
+	switch (result.type)
+	{
+	case DestinationType::Spawn:
+		SPDLOG_INFO("Navigating to nearest spawn: {} ({}), path length {:.2f}",
+			result.pSpawn->Name, result.pSpawn->SpawnID, lengths[best]);
+		break;
+	case DestinationType::Door:
+		SPDLOG_INFO("Navigating to nearest switch: {}, path length {:.2f}", result.pSwitch->Name, lengths[best]);
+		break;
+	case DestinationType::GroundItem:
+		SPDLOG_INFO("Navigating to nearest ground item: {} ({}), path length {:.2f}",
+			result.groundItem.DisplayName(), result.groundItem.ID(), lengths[best]);
+		break;
+	case DestinationType::Waypoint:
+		SPDLOG_INFO("Navigating to nearest waypoint: {}, path length {:.2f}", result.waypoint, lengths[best]);
+		break;
+	default: break;
+	}
+}
+
 static bool to_bool(std::string str)
 {
 	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
@@ -1696,12 +2028,73 @@ void MQ2NavigationPlugin::ParseOptions(std::string_view line, int idx, Navigatio
 	}
 }
 
-float MQ2NavigationPlugin::GetNavigationPathLength(const std::shared_ptr<DestinationInfo>& info)
+const StraightPath* MQ2NavigationPlugin::PlanPathTo(const DestinationInfo& info)
 {
-	NavigationPath path(info);
+	if (!info.valid || !m_queryPlanner.GetNavMesh())
+		return nullptr;
+
+	PSPAWNINFO me = GetCharInfo()->pSpawn;
+	if (me == nullptr)
+		return nullptr;
+
+	// convert positions to mesh coordinates
+	glm::vec3 startPos{ me->X, me->FloorHeight, me->Y };
+	glm::vec3 endPos = info.eqDestinationPos;
+	std::swap(endPos.y, endPos.z);
 
-	if (path.FindPath())
-		return path.GetPathTraversalDistance();
+	NavigationPath::ApplySettings(m_queryPlanner);
+
+	PathResult result = m_queryPlanner.FindPath(startPos, endPos, m_queryPath);
+	if (result != PathResult::Success)
+	{
+		NavigationPath::ReportPathResult(result, startPos, endPos);
+		return nullptr;
+	}
+
+	return &m_queryPath;
+}
+
+std::vector<float> MQ2NavigationPlugin::PlanPathLengths(const std::vector<glm::vec3>& eqPositions)
+{
+	std::vector<float> lengths(eqPositions.size(), -1.f);
+
+	if (eqPositions.empty() || !m_queryPlanner.GetNavMesh())
+		return lengths;
+
+	PSPAWNINFO me = GetCharInfo()->pSpawn;
+	if (me == nullptr)
+		return lengths;
+
+	// convert positions to mesh coordinates
+	glm::vec3 startPos{ me->X, me->FloorHeight, me->Y };
+	std::vector<glm::vec3> endPositions;
+	endPositions.reserve(eqPositions.size());
+
+	for (const glm::vec3& pos : eqPositions)
+	{
+		endPositions.emplace_back(pos.x, pos.z, pos.y);
+	}
+
+	NavigationPath::ApplySettings(m_queryPlanner);
+
+	PathResult result = m_queryPlanner.FindPathLengths(startPos, endPositions.data(),
+		static_cast<int>(endPositions.size()), lengths.data());
+	if (result != PathResult::Success)
+	{
+		// name the first target that couldn't be resolved
+		auto iter = std::find(lengths.begin(), lengths.end(), -1.f);
+		size_t index = iter != lengths.end() ? std::distance(lengths.begin(), iter) : 0;
+
+		NavigationPath::ReportPathResult(result, startPos, endPositions[index]);
+	}
+
+	return lengths;
+}
+
+float MQ2NavigationPlugin::GetNavigationPathLength(const std::shared_ptr<DestinationInfo>& info)
+{
+	if (const StraightPath* path = PlanPathTo(*info))
+		return path->GetLength();
 
 	return -1;
 }
@@ -1722,6 +2115,35 @@ float MQ2NavigationPlugin::GetNavigationPathLength(std::string_view line)
 	return result;
 }
 
+std::vector<float> MQ2NavigationPlugin::GetNavigationPathLengths(const std::vector<std::string_view>& lines)
+{
+	std::vector<float> result(lines.size(), -1.f);
+
+	// destinations that don't parse are left out of the search
+	std::vector<glm::vec3> positions;
+	std::vector<size_t> indices;
+	positions.reserve(lines.size());
+	indices.reserve(lines.size());
+
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		auto dest = ParseDestination(lines[i], spdlog::level::off);
+		if (dest->valid)
+		{
+			positions.push_back(dest->eqDestinationPos);
+			indices.push_back(i);
+		}
+	}
+
+	std::vector<float> lengths = PlanPathLengths(positions);
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		result[indices[i]] = lengths[i];
+	}
+
+	return result;
+}
+
 bool MQ2NavigationPlugin::CanNavigateToPoint(std::string_view line)
 {
 	bool result = false;
@@ -1730,11 +2152,9 @@ bool MQ2NavigationPlugin::CanNavigateToPoint(std::string_view line)
 	{
 		ScopedLogLevel level{ *m_chatSink, dest->options.logLevel };
 
-		NavigationPath path(dest);
-
-		if (path.FindPath())
+		if (const StraightPath* path = PlanPathTo(*dest))
 		{
-			result = path.GetPathSize() > 0;
+			result = path->length > 0;
 		}
 	}
 
@@ -5,6 +5,8 @@
 #pragma once
 
 #include "common/NavModule.h"
+#include "common/PathCache.h"
+#include "common/PathPlanner.h"
 #include "plugin/MapAPI.h"
 #include "../PluginAPI.h"
 
@@ -14,8 +16,10 @@
 
 #include <memory>
 #include <chrono>
+#include <string>
 #include <typeinfo>
 #include <unordered_map>
+#include <vector>
 
 #ifndef GLM_FORCE_RADIANS
 #define GLM_FORCE_RADIANS
@@ -202,6 +206,10 @@ public:
 	// how often to update the path (in milliseconds)
 	static const int PATHFINDING_DELAY_MS = 200;
 
+	// most targets that are compared by path length for /nav nearest. The ones closest
+	// in a straight line are kept.
+	static const int MAX_NEAREST_CANDIDATES = 50;
+
 	//----------------------------------------------------------------------------
 
 	bool IsActive() const { return m_isActive; }
@@ -214,6 +222,9 @@ public:
 	// Check how far away a point is (given a coordinate string)
 	float GetNavigationPathLength(std::string_view line);
 
+	// Check how far away several points are, with a single search
+	std::vector<float> GetNavigationPathLengths(const std::vector<std::string_view>& lines);
+
 	// Parse a destination command from string
 	std::shared_ptr<DestinationInfo> ParseDestination(std::string_view line,
 		spdlog::level::level_enum logLevel = spdlog::level::err);
@@ -228,11 +239,22 @@ public:
 
 	std::shared_ptr<NavigationPath> GetActivePath() const { return m_activePath; }
 
+	// searches done for path length and reachability queries
+	PathCache& GetPathCache() { return m_pathCache; }
+
 	std::shared_ptr<NavigationLine> GetGameLine() const { return m_gameLine; }
 
 	nav::NavCommandState* GetCurrentCommandState() { return m_isActive ? m_currentCommandState.get() : nullptr; }
 
+	// start loading the navmesh for a zone before we get there
+	void PrefetchZone(int zoneId);
+
+	// pass the waypoints that are marked for flow fields on to the navmesh. Needs to be
+	// called when they change.
+	void UpdateFlowFieldTargets();
+
 private:
+	int GetCharacterZoneId() const;
 	void UpdateCurrentZone();
 	void SetCurrentZone(int zoneId);
 
@@ -241,11 +263,20 @@ private:
 	void RenderPathList();
 
 	std::shared_ptr<DestinationInfo> ParseDestinationInternal(std::string_view line, int& argIndex);
+	void ParseNearestDestination(char* buffer, char* mutableLine, int& argIndex, DestinationInfo& result);
 
 	//----------------------------------------------------------------------------
 
 	float GetNavigationPathLength(const std::shared_ptr<DestinationInfo>& pos);
 
+	// plan a path from the player to a destination without navigating there.
+	// Returns nullptr if there is no path. The result is only valid until the next call.
+	const StraightPath* PlanPathTo(const DestinationInfo& info);
+
+	// lengths of the paths from the player to each of the positions (in eq coordinates),
+	// with a single search. Lengths are -1 for positions that can't be reached.
+	std::vector<float> PlanPathLengths(const std::vector<glm::vec3>& eqPositions);
+
 	void AttemptClick();
 
 	void StuckCheck();
@@ -272,6 +303,15 @@ private:
 private:
 	std::shared_ptr<NavigationPath> m_activePath;
 
+	// reused by path length and reachability queries, so that macros checking them
+	// every frame don't allocate.
+	PathPlanner m_queryPlanner;
+	StraightPath m_queryPath;
+	mq::Signal<>::ScopedConnection m_navMeshConn;
+
+	// the same few destinations tend to be asked about over and over
+	PathCache m_pathCache;
+
 	// todo: factor out the navpath rendering and map line into
 	//       modules based on active path.
 	std::shared_ptr<NavigationMapLine> m_mapLine;
@@ -312,6 +352,9 @@ private:
 
 	std::unique_ptr<nav::NavCommandState> m_currentCommandState;
 	int m_renderCallbacks = -1;
+
+	// navigation commands waiting for the navmesh to finish loading
+	std::vector<std::string> m_queuedCommands;
 };
 
 extern MQ2NavigationPlugin* g_mq2Nav;
@@ -0,0 +1,145 @@
+//
+// NavMeshCache.cpp
+//
+
+#include "pch.h"
+#include "NavMeshCache.h"
+
+#include "common/NavMesh.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+//============================================================================
+
+static bool GetFileWriteTime(const std::string& filename, FILETIME& fileTime)
+{
+	HANDLE hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool result = GetFileTime(hFile, NULL, NULL, &fileTime) != FALSE;
+	CloseHandle(hFile);
+
+	return result;
+}
+
+//============================================================================
+
+NavMeshCache::NavMeshCache()
+{
+}
+
+NavMeshCache::~NavMeshCache()
+{
+}
+
+void NavMeshCache::SetMemoryLimit(size_t memoryLimit)
+{
+	if (m_memoryLimit != memoryLimit)
+	{
+		m_memoryLimit = memoryLimit;
+		Evict();
+	}
+}
+
+void NavMeshCache::Insert(std::unique_ptr<NavMesh> navMesh, const FILETIME& fileTime)
+{
+	if (m_memoryLimit == 0 || !navMesh)
+		return;
+
+	// replace an older copy of the same zone
+	auto iter = Find(navMesh->GetZoneName());
+	if (iter != m_entries.end())
+	{
+		Remove(iter);
+	}
+
+	size_t memoryUsage = navMesh->GetMemoryUsage();
+	if (memoryUsage > m_memoryLimit)
+	{
+		SPDLOG_DEBUG("Navmesh for {} is too large to cache ({} bytes)", navMesh->GetZoneName(), memoryUsage);
+		return;
+	}
+
+	SPDLOG_DEBUG("Caching navmesh for {} ({} bytes)", navMesh->GetZoneName(), memoryUsage);
+
+	m_entries.push_front(Entry{ std::move(navMesh), fileTime, memoryUsage });
+	m_memoryUsage += memoryUsage;
+
+	Evict();
+}
+
+std::unique_ptr<NavMesh> NavMeshCache::Take(const std::string& zoneShortName)
+{
+	auto iter = Find(zoneShortName);
+	if (iter == m_entries.end())
+		return nullptr;
+
+	std::unique_ptr<NavMesh> navMesh = std::move(iter->navMesh);
+	Remove(iter);
+
+	return navMesh;
+}
+
+bool NavMeshCache::Contains(const std::string& zoneShortName)
+{
+	return Find(zoneShortName) != m_entries.end();
+}
+
+void NavMeshCache::Clear()
+{
+	m_entries.clear();
+	m_memoryUsage = 0;
+}
+
+NavMeshCache::EntryList::iterator NavMeshCache::Find(const std::string& zoneShortName)
+{
+	auto iter = std::find_if(m_entries.begin(), m_entries.end(),
+		[&](const Entry& entry) { return entry.navMesh->GetZoneName() == zoneShortName; });
+	if (iter == m_entries.end())
+		return iter;
+
+	// drop the entry if the file has been modified since it was loaded.
+	FILETIME fileTime;
+	if (!GetFileWriteTime(iter->navMesh->GetDataFileName(), fileTime))
+	{
+		Remove(iter);
+		return m_entries.end();
+	}
+
+	if (CompareFileTime(&fileTime, &iter->fileTime) != 0)
+	{
+		// the file might have just been copied over with the same data.
+		uint64_t contentHash = NavMesh::ReadContentHash(iter->navMesh->GetDataFileName());
+		if (contentHash == 0 || contentHash != iter->navMesh->GetContentHash())
+		{
+			SPDLOG_DEBUG("Cached navmesh for {} is out of date", zoneShortName);
+
+			Remove(iter);
+			return m_entries.end();
+		}
+
+		iter->fileTime = fileTime;
+	}
+
+	return iter;
+}
+
+void NavMeshCache::Remove(EntryList::iterator iter)
+{
+	m_memoryUsage -= iter->memoryUsage;
+	m_entries.erase(iter);
+}
+
+void NavMeshCache::Evict()
+{
+	while (!m_entries.empty() && m_memoryUsage > m_memoryLimit)
+	{
+		SPDLOG_DEBUG("Evicting cached navmesh for {}", m_entries.back().navMesh->GetZoneName());
+
+		Remove(std::prev(m_entries.end()));
+	}
+}
@@ -0,0 +1,65 @@
+//
+// NavMeshCache.h
+//
+
+#pragma once
+
+#include <mq/Plugin.h>
+
+#include <list>
+#include <memory>
+#include <string>
+
+class NavMesh;
+
+// Keeps navmeshes for recently visited zones around after leaving them, so that
+// going back to one of them doesn't need to load it from disk again. The least
+// recently used navmeshes are discarded once the memory limit is reached.
+class NavMeshCache
+{
+public:
+	NavMeshCache();
+	~NavMeshCache();
+
+	NavMeshCache(const NavMeshCache&) = delete;
+	NavMeshCache& operator=(const NavMeshCache&) = delete;
+
+	// maximum amount of memory used by cached navmeshes. A limit of zero
+	// disables the cache.
+	void SetMemoryLimit(size_t memoryLimit);
+	size_t GetMemoryLimit() const { return m_memoryLimit; }
+
+	size_t GetMemoryUsage() const { return m_memoryUsage; }
+	size_t GetCount() const { return m_entries.size(); }
+
+	// Stores a navmesh that was loaded from its file while the file had the given
+	// write time. Takes ownership of the navmesh.
+	void Insert(std::unique_ptr<NavMesh> navMesh, const FILETIME& fileTime);
+
+	// Removes the navmesh for a zone from the cache and returns it. Returns nullptr if
+	// there isn't one, or if the file on disk has changed since it was loaded. A file
+	// with a newer write time but the same content hash still counts as unchanged.
+	std::unique_ptr<NavMesh> Take(const std::string& zoneShortName);
+
+	// returns true if a navmesh for the zone is cached and still up to date.
+	bool Contains(const std::string& zoneShortName);
+
+	void Clear();
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<NavMesh> navMesh;
+		FILETIME fileTime;
+		size_t memoryUsage;
+	};
+	using EntryList = std::list<Entry>;
+
+	EntryList::iterator Find(const std::string& zoneShortName);
+	void Remove(EntryList::iterator iter);
+	void Evict();
+
+	EntryList m_entries; // most recently used first
+	size_t m_memoryLimit = 0;
+	size_t m_memoryUsage = 0;
+};
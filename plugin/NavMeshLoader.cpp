@@ -6,12 +6,39 @@
 #include "NavMeshLoader.h"
 
 #include "plugin/MQ2Navigation.h"
+#include "plugin/PluginSettings.h"
 #include "plugin/Utilities.h"
 
 #include <DetourNavMesh.h>
 #include <DetourCommon.h>
 #include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <thread>
+
+//============================================================================
+
+// A navmesh being loaded on a background thread. The navmesh is loaded into its own
+// instance, along with its flow fields, which is swapped into the real one once it is
+// complete.
+struct NavMeshLoader::LoadRequest
+{
+	int zoneId = -1;
+	std::unique_ptr<NavMesh> navMesh;
+	std::vector<FlowFieldTarget> flowFieldTargets;
+	NavMesh::LoadResult result = NavMesh::LoadResult::None;
+	bool reportResult = false;
+	std::atomic<bool> complete = false;
+	std::thread thread;
+
+	~LoadRequest()
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+};
 
 //============================================================================
 
@@ -20,6 +47,20 @@ NavMeshLoader::NavMeshLoader(NavMesh* mesh)
 {
 }
 
+NavMeshLoader::~NavMeshLoader()
+{
+}
+
+void NavMeshLoader::Shutdown()
+{
+	// wait for any loads that are still running
+	m_loadRequest.reset();
+	m_prefetchRequest.reset();
+	m_cancelledLoads.clear();
+
+	m_cache.Clear();
+}
+
 //----------------------------------------------------------------------------
 
 void NavMeshLoader::SetZoneId(int zoneId)
@@ -29,6 +70,20 @@ void NavMeshLoader::SetZoneId(int zoneId)
 
 	m_zoneId = zoneId;
 
+	CancelLoad();
+	CacheCurrentMesh();
+
+	// pick up the navmesh if it was already loaded for this zone.
+	std::unique_ptr<LoadRequest> prefetched;
+	if (m_prefetchRequest && m_prefetchRequest->zoneId == zoneId && m_autoLoad)
+	{
+		prefetched = std::move(m_prefetchRequest);
+	}
+	else if (m_prefetchRequest)
+	{
+		m_cancelledLoads.push_back(std::move(m_prefetchRequest));
+	}
+
 	if (m_zoneId != -1)
 	{
 		// set or clear zone name
@@ -48,7 +103,27 @@ void NavMeshLoader::SetZoneId(int zoneId)
 
 			if (m_autoLoad)
 			{
-				m_navMesh->LoadNavMeshFile();
+				if (std::unique_ptr<NavMesh> cached = m_cache.Take(m_zoneShortName))
+				{
+					SPDLOG_DEBUG("Using cached navmesh for: {}", m_zoneShortName);
+					m_navMesh->TakeLoadedMesh(*cached);
+
+					UpdateFileTime(m_navMesh->GetDataFileName());
+				}
+				else if (prefetched)
+				{
+					SPDLOG_DEBUG("Using prefetched navmesh for: {}", m_zoneShortName);
+					m_loadRequest = std::move(prefetched);
+
+					if (m_loadRequest->complete)
+					{
+						FinishLoad();
+					}
+				}
+				else
+				{
+					StartLoad(false);
+				}
 			}
 		}
 	}
@@ -56,6 +131,12 @@ void NavMeshLoader::SetZoneId(int zoneId)
 	{
 		m_navMesh->ResetNavMesh();
 	}
+
+	// the prefetch wasn't needed after all
+	if (prefetched)
+	{
+		m_cancelledLoads.push_back(std::move(prefetched));
+	}
 }
 
 void NavMeshLoader::SetAutoLoad(bool autoLoad)
@@ -63,12 +144,211 @@ void NavMeshLoader::SetAutoLoad(bool autoLoad)
 	m_autoLoad = autoLoad;
 }
 
-bool NavMeshLoader::LoadNavMesh()
+void NavMeshLoader::ApplyLoadSettings(NavMesh& navMesh)
+{
+	navMesh.SetLoadThreadCount(nav::GetSettings().mesh_load_threads);
+	navMesh.SetPolyGridEnabled(nav::GetSettings().use_poly_grid);
+
+	float radius = nav::GetSettings().mesh_load_radius;
+
+	PCHARINFO pChar = GetCharInfo();
+	if (radius > 0.0f && pChar && pChar->pSpawn)
+	{
+		navMesh.SetLoadFocus(glm::vec3{ pChar->pSpawn->X, pChar->pSpawn->FloorHeight, pChar->pSpawn->Y }, radius);
+	}
+	else
+	{
+		navMesh.ClearLoadFocus();
+	}
+}
+
+void NavMeshLoader::LoadNavMesh()
+{
+	StartLoad(true);
+}
+
+void NavMeshLoader::StartLoad(bool reportResult)
+{
+	CancelLoad();
+
+	if (m_zoneId == -1 || m_zoneShortName.empty())
+		return;
+
+	m_loadRequest = CreateLoadRequest(m_zoneId, m_zoneShortName);
+	m_loadRequest->reportResult = reportResult;
+}
+
+void NavMeshLoader::PrefetchZone(int zoneId)
+{
+	if (!m_autoLoad || zoneId == -1 || zoneId == m_zoneId)
+		return;
+
+	if (m_prefetchRequest)
+	{
+		if (m_prefetchRequest->zoneId == zoneId)
+			return;
+
+		m_cancelledLoads.push_back(std::move(m_prefetchRequest));
+	}
+
+	const char* zoneName = GetShortZone(zoneId);
+	if (!zoneName || !strcmp(zoneName, "UNKNOWN_ZONE"))
+		return;
+
+	if (m_cache.Contains(zoneName))
+		return;
+
+	SPDLOG_DEBUG("Prefetching navmesh for: {}", zoneName);
+
+	m_prefetchRequest = CreateLoadRequest(zoneId, zoneName);
+}
+
+std::unique_ptr<NavMeshLoader::LoadRequest> NavMeshLoader::CreateLoadRequest(int zoneId,
+	const std::string& zoneShortName, bool allowPartialReload)
+{
+	auto request = std::make_unique<LoadRequest>();
+	request->zoneId = zoneId;
+	request->navMesh = std::make_unique<NavMesh>(m_navMesh->GetNavMeshDirectory(), zoneShortName);
+	ApplyLoadSettings(*request->navMesh);
+
+	if (zoneId != m_zoneId)
+	{
+		// we don't know where we'll be in a zone we haven't entered yet.
+		request->navMesh->ClearLoadFocus();
+	}
+	else
+	{
+		if (allowPartialReload)
+		{
+			// when reloading the current zone, only read the tiles that changed.
+			request->navMesh->SetReloadBase(*m_navMesh);
+		}
+
+		request->flowFieldTargets = m_navMesh->GetFlowFieldTargets();
+	}
+
+	LoadRequest* pRequest = request.get();
+	request->thread = std::thread([pRequest]()
+	{
+		pRequest->result = pRequest->navMesh->LoadNavMeshFile();
+
+		// the flow fields come along with the navmesh, so they aren't built on the game thread
+		if (pRequest->result == NavMesh::LoadResult::Success)
+		{
+			pRequest->navMesh->BuildFlowFields(pRequest->flowFieldTargets);
+		}
+
+		pRequest->complete = true;
+	});
+
+	return request;
+}
+
+void NavMeshLoader::StartFlowFieldBuild(std::unique_ptr<LoadRequest> request)
 {
-	NavMesh::LoadResult result = m_navMesh->LoadNavMeshFile();
-	std::string meshFile = m_navMesh->GetDataFileName();
-	bool success = false;
+	request->flowFieldTargets = m_navMesh->GetFlowFieldTargets();
+	request->complete = false;
 
+	LoadRequest* pRequest = request.get();
+	request->thread = std::thread([pRequest]()
+	{
+		pRequest->navMesh->BuildFlowFields(pRequest->flowFieldTargets);
+		pRequest->complete = true;
+	});
+
+	m_loadRequest = std::move(request);
+}
+
+void NavMeshLoader::CancelLoad()
+{
+	// The load can't be interrupted, so let it finish in the background and throw
+	// away the result.
+	if (m_loadRequest)
+	{
+		m_cancelledLoads.push_back(std::move(m_loadRequest));
+	}
+}
+
+void NavMeshLoader::FinishLoad()
+{
+	std::unique_ptr<LoadRequest> request = std::move(m_loadRequest);
+	request->thread.join();
+
+	std::string meshFile = request->navMesh->GetDataFileName();
+
+	// Keep the current navmesh if loading failed, it might just be a partially
+	// written file.
+	if (request->result == NavMesh::LoadResult::Success)
+	{
+		if (!request->navMesh->IsPartialLoad())
+		{
+			// The waypoints of a zone are only known once we are in it, which is usually
+			// after the load started. Their fields are built before the navmesh is used.
+			if (request->navMesh->GetFlowFieldTargets() != m_navMesh->GetFlowFieldTargets())
+			{
+				StartFlowFieldBuild(std::move(request));
+				return;
+			}
+
+			m_navMesh->TakeLoadedMesh(*request->navMesh);
+		}
+		else if (!m_navMesh->MergeChangedTiles(*request->navMesh))
+		{
+			// the navmesh changed while we were loading, so the changed tiles don't
+			// apply to it anymore. Load the whole thing instead.
+			SPDLOG_DEBUG("Navmesh changed during a partial reload, loading all tiles");
+
+			m_loadRequest = CreateLoadRequest(m_zoneId, m_zoneShortName, false);
+			m_loadRequest->reportResult = request->reportResult;
+			return;
+		}
+	}
+
+	UpdateFileTime(meshFile);
+
+	if (request->reportResult)
+	{
+		ReportLoadResult(request->result, meshFile);
+	}
+}
+
+void NavMeshLoader::UpdateFileTime(const std::string& meshFile)
+{
+	m_fileWatcher.Watch(meshFile);
+
+	HANDLE hFile = CreateFile(meshFile.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		GetFileTime(hFile, NULL, NULL, &m_fileTime);
+		CloseHandle(hFile);
+	}
+}
+
+void NavMeshLoader::UpdateCacheLimit()
+{
+	int cacheSize = std::max(nav::GetSettings().mesh_cache_size, 0);
+
+	m_cache.SetMemoryLimit(static_cast<size_t>(cacheSize) * 1024 * 1024);
+}
+
+void NavMeshLoader::CacheCurrentMesh()
+{
+	UpdateCacheLimit();
+
+	// only keep navmeshes that match what is on disk, so that they can be checked
+	// against the file when they are used again.
+	if (m_cache.GetMemoryLimit() == 0 || !m_navMesh->IsNavMeshLoadedFromDisk())
+		return;
+
+	auto navMesh = std::make_unique<NavMesh>(m_navMesh->GetNavMeshDirectory(), m_navMesh->GetZoneName());
+	navMesh->TakeLoadedMesh(*m_navMesh);
+
+	m_cache.Insert(std::move(navMesh), m_fileTime);
+}
+
+void NavMeshLoader::ReportLoadResult(NavMesh::LoadResult result, const std::string& meshFile)
+{
 	switch (result)
 	{
 	default:
@@ -78,18 +358,6 @@ bool NavMeshLoader::LoadNavMesh()
 
 	case NavMesh::LoadResult::Success:
 		SPDLOG_INFO("\agSuccessfully loaded mesh for \am{}\ax", m_zoneShortName);
-		{
-			// Get filetime
-			HANDLE hFile = CreateFile(meshFile.c_str(), GENERIC_READ, FILE_SHARE_READ,
-				NULL, OPEN_EXISTING, 0, NULL);
-			if (hFile != INVALID_HANDLE_VALUE)
-			{
-				GetFileTime(hFile, NULL, NULL, &m_fileTime);
-			}
-			CloseHandle(hFile);
-		}
-
-		success = true;
 		break;
 
 	case NavMesh::LoadResult::MissingFile:
@@ -112,44 +380,71 @@ bool NavMeshLoader::LoadNavMesh()
 		SPDLOG_ERROR("Couldn't load mesh file. Ran out of memory!");
 		break;
 	}
-
-	return success;
 }
 
 void NavMeshLoader::OnPulse()
 {
-	if (m_autoReload)
+	// publish the navmesh once it has finished loading
+	if (m_loadRequest && m_loadRequest->complete)
 	{
-		clock::time_point now = clock::now();
-		if (now - m_lastUpdate > std::chrono::seconds(1))
-		{
-			m_lastUpdate = now;
+		FinishLoad();
+	}
 
-			if (m_navMesh->IsNavMeshLoadedFromDisk())
-			{
-				std::string filename = m_navMesh->GetDataFileName();
+	if (!m_cancelledLoads.empty())
+	{
+		m_cancelledLoads.erase(
+			std::remove_if(m_cancelledLoads.begin(), m_cancelledLoads.end(),
+				[](const std::unique_ptr<LoadRequest>& request) { return request->complete.load(); }),
+			m_cancelledLoads.end());
+	}
 
-				// Get the current filetime
-				FILETIME currentFileTime;
+	UpdateCacheLimit();
 
-				HANDLE hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
-					NULL, OPEN_EXISTING, 0, NULL);
-				if (hFile != INVALID_HANDLE_VALUE)
-				{
-					GetFileTime(hFile, NULL, NULL, &currentFileTime);
+	// fill in any tiles that were deferred by the last load
+	if (m_navMesh->HasPendingTiles())
+	{
+		m_navMesh->LoadPendingTiles(PENDING_TILES_BUDGET);
+	}
 
-					// Reload file *if* it is 5 seconds old AND newer than existing
-					if (CompareFileTime(&currentFileTime, &m_fileTime))
-					{
-						SPDLOG_DEBUG("Current file time is newer than old file time, refreshing");
-						LoadNavMesh();
-					}
-				}
+	// changes that happen while loading are picked up once the load is done.
+	if (m_autoReload && !IsLoading() && m_fileWatcher.Poll())
+	{
+		CheckForFileChanges();
+	}
+}
 
-				CloseHandle(hFile);
-			}
-		}
+void NavMeshLoader::CheckForFileChanges()
+{
+	if (!m_navMesh->IsNavMeshLoadedFromDisk())
+		return;
+
+	std::string filename = m_navMesh->GetDataFileName();
+
+	// Get the current filetime
+	FILETIME currentFileTime;
+
+	HANDLE hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	GetFileTime(hFile, NULL, NULL, &currentFileTime);
+	CloseHandle(hFile);
+
+	if (!CompareFileTime(&currentFileTime, &m_fileTime))
+		return;
+
+	// Touching the file or copying the same file over it doesn't need a reload.
+	uint64_t contentHash = NavMesh::ReadContentHash(filename);
+	if (contentHash != 0 && contentHash == m_navMesh->GetContentHash())
+	{
+		SPDLOG_DEBUG("Navmesh file was modified, but its contents are unchanged");
+		m_fileTime = currentFileTime;
+		return;
 	}
+
+	SPDLOG_DEBUG("Current file time is newer than old file time, refreshing");
+	LoadNavMesh();
 }
 
 void NavMeshLoader::SetGameState(int GameState)
@@ -159,6 +454,14 @@ void NavMeshLoader::SetGameState(int GameState)
 		// into the same zone (succor), so no use unload the mesh until
 		// after loading completes.
 		if (GameState != GAMESTATE_ZONING && GameState != GAMESTATE_LOGGINGIN) {
+			CancelLoad();
+			CacheCurrentMesh();
+
+			if (m_prefetchRequest)
+			{
+				m_cancelledLoads.push_back(std::move(m_prefetchRequest));
+			}
+
 			m_navMesh->ResetNavMesh();
 		}
 	}
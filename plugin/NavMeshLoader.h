@@ -5,13 +5,16 @@
 #pragma once
 
 #include "common/NavMesh.h"
+#include "common/FileWatcher.h"
 #include "common/NavModule.h"
+#include "plugin/NavMeshCache.h"
 
 #include <mq/Plugin.h>
 
 #include <chrono>
 #include <string>
 #include <memory>
+#include <vector>
 
 class dtNavMesh;
 class MQ2NavigationPlugin;
@@ -20,9 +23,10 @@ class NavMeshLoader : public NavModule
 {
 public:
 	NavMeshLoader(NavMesh* mesh);
+	~NavMeshLoader();
 
 	virtual void Initialize() override {}
-	virtual void Shutdown() override {}
+	virtual void Shutdown() override;
 
 	// will do actions on specific intervals
 	virtual void OnPulse() override;
@@ -43,11 +47,38 @@ public:
 	void SetAutoReload(bool autoReload);
 	bool GetAutoReload() const { return m_autoReload; }
 
-	// try to reload the navmesh for the current zone. Returns true if the
-	// navmesh successfully loads
-	bool LoadNavMesh();
+	// Starts reloading the navmesh for the current zone in the background. The
+	// current navmesh stays in place until the new one is ready, and is replaced
+	// on a later pulse.
+	void LoadNavMesh();
+
+	// returns true while a navmesh is being loaded in the background.
+	bool IsLoading() const { return m_loadRequest != nullptr; }
+
+	// Starts loading the navmesh for a zone that we are about to enter. The current
+	// navmesh is left alone, and the prefetched one is used once SetZoneId is called
+	// with the same zone.
+	void PrefetchZone(int zoneId);
+
+	// navmeshes of recently visited zones
+	const NavMeshCache& GetCache() const { return m_cache; }
 
 private:
+	struct LoadRequest;
+
+	std::unique_ptr<LoadRequest> CreateLoadRequest(int zoneId, const std::string& zoneShortName,
+		bool allowPartialReload = true);
+	void StartLoad(bool reportResult);
+	void StartFlowFieldBuild(std::unique_ptr<LoadRequest> request);
+	void ApplyLoadSettings(NavMesh& navMesh);
+	void CancelLoad();
+	void FinishLoad();
+	void ReportLoadResult(NavMesh::LoadResult result, const std::string& meshFile);
+	void UpdateFileTime(const std::string& meshFile);
+	void CheckForFileChanges();
+	void CacheCurrentMesh();
+	void UpdateCacheLimit();
+
 	NavMesh* m_navMesh = nullptr;
 
 	std::string m_zoneShortName;
@@ -58,7 +89,15 @@ private:
 	// auto reloading
 	bool m_autoReload = true;
 	FILETIME m_fileTime = { 0, 0 };
+	FileWatcher m_fileWatcher;
+
+	// time spent loading deferred tiles each pulse
+	static constexpr std::chrono::microseconds PENDING_TILES_BUDGET{ 2000 };
+
+	// background loading
+	std::unique_ptr<LoadRequest> m_loadRequest;
+	std::unique_ptr<LoadRequest> m_prefetchRequest;
+	std::vector<std::unique_ptr<LoadRequest>> m_cancelledLoads;
 
-	using clock = std::chrono::high_resolution_clock;
-	clock::time_point m_lastUpdate = clock::now();
+	NavMeshCache m_cache;
 };
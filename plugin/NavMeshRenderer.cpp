@@ -68,6 +68,11 @@ void NavMeshRenderer::Initialize()
 	m_meshConn = m_navMesh->OnNavMeshChanged.Connect(
 		[this]() { UpdateNavMesh(); });
 
+	// the geometry is built from the navmesh on another thread, which needs to stop
+	// before tiles are replaced.
+	m_meshChangingConn = m_navMesh->OnNavMeshChanging.Connect(
+		[this]() { StopLoad(); });
+
 	g_renderHandler->AddRenderable(this);
 
 	m_initialized = true;
@@ -59,6 +59,7 @@ private:
 
 	std::unique_ptr<RenderGroup> m_primGroup;
 	mq::Signal<>::ScopedConnection m_meshConn;
+	mq::Signal<>::ScopedConnection m_meshChangingConn;
 
 	std::unique_ptr<ConfigurableRenderState> m_state;
 	bool m_useStateEditor = false;
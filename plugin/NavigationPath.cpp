@@ -8,6 +8,7 @@
 #include "common/Logging.h"
 #include "common/NavMesh.h"
 #include "common/NavMeshData.h"
+#include "common/PathWorker.h"
 #include "common/Utilities.h"
 #include "plugin/DebugDrawDX.h"
 #include "plugin/EmbedResources.h"
@@ -23,60 +24,35 @@
 #include <spdlog/spdlog.h>
 #include <dxsdk-d3dx/d3dx9.h>
 
+#include <limits>
 
-//----------------------------------------------------------------------------
-// constants
-
-const int MAX_STRAIGHT_PATH_LENGTH = 16384;
-
-const float NODE_POOL_GROWTH_FACTOR = 1.5f;
-const int NODE_POOL_MAX_SIZE = 1024 * 1024; // the zone is insanely large if this gets hit
-
-NavigationLine::LineStyle gNavigationLineStyle;
+// a background search is only replaced if the destination moves further than this,
+// otherwise a target that keeps moving would never get a path.
+const float SEARCH_SUPERSEDE_DISTANCE = 10.0f;
 
 //----------------------------------------------------------------------------
 
-void StraightPath::Reset(int size_)
-{
-	cursor = 0;
-	length = 0;
-
-	if (alloc == size_)
-		return;
-
-	alloc = size_;
-
-	if (alloc == 0)
-	{
-		verts.reset();
-		flags.reset();
-		polys.reset();
-	}
-	else
-	{
-		verts = std::make_unique<glm::vec3[]>(alloc);
-		flags = std::make_unique<uint8_t[]>(alloc);
-		polys = std::make_unique<dtPolyRef[]>(alloc);
-	}
-}
+NavigationLine::LineStyle gNavigationLineStyle;
 
 //----------------------------------------------------------------------------
 
 NavigationPath::NavigationPath(const std::shared_ptr<DestinationInfo>& dest)
 	: m_currentPath(std::make_unique<StraightPath>())
+	, m_nextPath(std::make_unique<StraightPath>())
 {
 	auto* mesh = g_mq2Nav->Get<NavMesh>();
 	m_navMeshConn = mesh->OnNavMeshChanged.Connect(
-		[this, mesh]() { SetNavMesh(mesh->GetNavMesh()); });
+		[this, mesh]() { SetNavMesh(mesh); });
 
 	m_renderPaths = nav::GetSettings().show_nav_path;
 
-	SetNavMesh(mesh->GetNavMesh(), false);
+	SetNavMesh(mesh, false);
 	SetDestination(dest);
 }
 
 NavigationPath::~NavigationPath()
 {
+	CancelSearch();
 	SetShowNavigationPaths(false);
 }
 
@@ -121,14 +97,14 @@ void NavigationPath::SetDestination(const std::shared_ptr<DestinationInfo>& info
 
 bool NavigationPath::FindPath()
 {
-	if (!m_navMesh)
+	if (!m_planner.GetNavMesh())
 		return false;
 
 	if (!m_destinationInfo || !m_destinationInfo->valid)
 		return false;
 
 	// Reset the path in case of failure
-	m_currentPath->Reset(0);
+	m_currentPath->Clear();
 
 	UpdatePath(true);
 
@@ -144,7 +120,8 @@ void NavigationPath::Increment()
 
 bool NavigationPath::CanSeeDestination() const
 {
-	if (!m_query)
+	dtNavMeshQuery* query = m_planner.GetNavMeshQuery();
+	if (!query)
 	{
 		return false;
 	}
@@ -162,11 +139,11 @@ bool NavigationPath::CanSeeDestination() const
 	dtRaycastHit hit;
 	std::memset(&hit, 0, sizeof(hit));
 
-	dtStatus result = m_query->raycast(
+	dtStatus result = query->raycast(
 		std::get<dtPolyRef>(curr),
 		glm::value_ptr(std::get<glm::vec3>(curr)),
 		glm::value_ptr(std::get<glm::vec3>(last)),
-		&m_filter,
+		&m_planner.GetFilter(),
 		0,
 		&hit);
 
@@ -174,22 +151,11 @@ bool NavigationPath::CanSeeDestination() const
 	return dtStatusSucceed(result) && hit.t == FLT_MAX;
 }
 
-void NavigationPath::SetNavMesh(const std::shared_ptr<dtNavMesh>& navMesh,
-	bool updatePath)
+void NavigationPath::SetNavMesh(NavMesh* navMesh, bool updatePath)
 {
-	m_navMesh = navMesh;
-
-	m_query.reset();
-
-	m_filter = dtQueryFilter{};
-	m_filter.setIncludeFlags(+PolyFlags::All);
-	m_filter.setExcludeFlags(+PolyFlags::Disabled);
-	if (auto* mesh = g_mq2Nav->Get<NavMesh>())
-	{
-		mesh->FillFilterAreaCosts(m_filter);
-	}
+	m_planner.SetNavMesh(navMesh);
 
-	if (updatePath && m_navMesh)
+	if (updatePath && m_planner.GetNavMesh())
 	{
 		UpdatePath();
 	}
@@ -197,9 +163,11 @@ void NavigationPath::SetNavMesh(const std::shared_ptr<dtNavMesh>& navMesh,
 
 void NavigationPath::UpdatePath(bool force, bool incremental)
 {
-	if (m_navMesh == nullptr || m_destinationInfo == nullptr)
+	if (m_planner.GetNavMesh() == nullptr || m_destinationInfo == nullptr)
 		return;
 
+	m_planner.Trim();
+
 	// don't perform incremental update if updates are disabled
 	if (incremental && !nav::GetSettings().poll_navigation_path)
 		return;
@@ -208,14 +176,6 @@ void NavigationPath::UpdatePath(bool force, bool incremental)
 	if (incremental && m_followingLink)
 		return;
 
-	if (m_query == nullptr)
-	{
-		m_query = deleting_unique_ptr<dtNavMeshQuery>(dtAllocNavMeshQuery(),
-			[](dtNavMeshQuery* ptr) { dtFreeNavMeshQuery(ptr); });
-
-		m_query->init(m_navMesh.get(), NAVMESH_QUERY_MAX_NODES);
-	}
-
 	PSPAWNINFO me = GetCharInfo()->pSpawn;
 	if (me == nullptr)
 		return;
@@ -233,21 +193,54 @@ void NavigationPath::UpdatePath(bool force, bool incremental)
 	glm::vec3 dest = m_destination;
 	std::swap(dest.y, dest.z);
 
-	std::unique_ptr<StraightPath> newPath = RecomputePath(thisPos, dest, force, incremental);
 	bool changed = false;
 
-	if (newPath)
+	if (RecomputePath(thisPos, dest, incremental, *m_nextPath))
 	{
-		m_currentPath = std::move(newPath);
+		std::swap(m_currentPath, m_nextPath);
 		changed = true;
 	}
 	else if (!incremental)
 	{
 		// not an incremental update, and no new path, so make sure there is no current path.
-		m_currentPath->Reset(0);
+		m_currentPath->Clear();
 		changed = true;
 	}
 
+	RefreshPath(changed);
+}
+
+void NavigationPath::ContinueSearch()
+{
+	if (!m_planner.IsPathInProgress())
+		return;
+
+	// if slicing was turned off in the meantime, just finish the search.
+	int iterations = nav::GetSettings().path_slice_iterations;
+	if (iterations <= 0)
+		iterations = std::numeric_limits<int>::max();
+
+	PathResult result = m_planner.ContinuePath(iterations, *m_nextPath);
+	if (result == PathResult::InProgress)
+		return;
+
+	// This replaces an incremental update, so a failure just leaves the current
+	// path in place.
+	if (result != PathResult::Success)
+	{
+		m_failed = true;
+		return;
+	}
+
+	if (m_nextPath->length > 1)
+		m_nextPath->cursor = 1;
+
+	std::swap(m_currentPath, m_nextPath);
+	RefreshPath(true);
+}
+
+void NavigationPath::RefreshPath(bool changed)
+{
 	UpdatePathProperties();
 
 	if (changed)
@@ -257,16 +250,14 @@ void NavigationPath::UpdatePath(bool force, bool incremental)
 
 	// Update render path
 	int renderSize = 1 + m_currentPath->length - m_currentPath->cursor;
-	std::vector<int> renderPath;
-	renderPath.resize(renderSize);
+	m_renderPath.resize(renderSize);
 
-	renderPath[0] = -1;
+	m_renderPath[0] = -1;
 	if (renderSize > 1)
 	{
 		for (int i = 0, node = m_currentPath->cursor; node != m_currentPath->length; ++node, ++i)
-			renderPath[i + 1] = node;
+			m_renderPath[i + 1] = node;
 	}
-	m_renderPath = renderPath;
 
 	if (m_renderPaths && !m_debugDrawGrp && gpD3D9Device)
 	{
@@ -286,7 +277,7 @@ void NavigationPath::UpdatePath(bool force, bool incremental)
 			DebugDrawDX dd(m_debugDrawGrp.get());
 
 			// draw current position
-			duDebugDrawCross(&dd, me->X, me->FloorHeight, me->Y, 0.5, DXColor(51, 255, 255), 1);
+			duDebugDrawCross(&dd, m_lastPos.x, m_lastPos.y, m_lastPos.z, 0.5, DXColor(51, 255, 255), 1);
 
 			// Draw the waypoints. Green is next point
 			for (int i = 0; i < m_currentPath->length; ++i)
@@ -315,175 +306,157 @@ void NavigationPath::UpdatePath(bool force, bool incremental)
 	}
 }
 
-std::unique_ptr<StraightPath> NavigationPath::RecomputePath(
-	const glm::vec3& startPos, const glm::vec3& endPos, bool force, bool incremental)
+void NavigationPath::ApplySettings(PathPlanner& planner)
 {
 	auto& settings = nav::GetSettings();
 
-	glm::vec3 extents = m_extents;
+	glm::vec3 extents = { 5, 10, 5 }; // note: X, Z, Y
 	if (settings.use_find_polygon_extents)
 	{
 		extents = settings.find_polygon_extents;
 	}
 
-	dtPolyRef startRef;
-	glm::vec3 spos;
-
-	// TODO: Cache the last known valid starting position to detect when moving off the mesh
-
-	m_query->findNearestPoly(
-		glm::value_ptr(startPos),
-		glm::value_ptr(extents),
-		&m_filter, &startRef, glm::value_ptr(spos));
+	planner.SetExtents(extents);
+	planner.SetSliceIterations(std::max(settings.path_slice_iterations, 0));
+	planner.SetShrinkDelay(std::chrono::seconds(std::max(settings.node_pool_shrink_delay, 0)));
+}
 
-	if (!startRef)
+void NavigationPath::ReportPathResult(PathResult result, const glm::vec3& startPos, const glm::vec3& endPos)
+{
+	switch (result)
 	{
-		if (!incremental)
-		{
-			SPDLOG_ERROR("Could not locate starting point on navmesh: {}", startPos.zxy());
-		}
-
-		m_failed = true;
-		return {};
-	}
+	case PathResult::NoStartPoly:
+		SPDLOG_ERROR("Could not locate starting point on navmesh: {}", startPos.zxy());
+		break;
 
-	glm::vec3 epos;
-	dtPolyRef endRef;
+	case PathResult::NoEndPoly:
+		SPDLOG_ERROR("Could not locate destination on navmesh: {}", endPos.zxy());
+		break;
 
-	m_query->findNearestPoly(
-		glm::value_ptr(endPos),
-		glm::value_ptr(extents),
-		&m_filter, &endRef, glm::value_ptr(epos));
+	case PathResult::Incomplete:
+		SPDLOG_ERROR("Could not reach destination (too far away): {}", endPos.zxy());
+		break;
 
-	if (!endRef)
-	{
-		if (!incremental)
-		{
-			SPDLOG_ERROR("Could not locate destination on navmesh: {}", endPos.zxy());
-		}
+	case PathResult::Partial:
+		SPDLOG_ERROR("Could not find path to destination: {}", endPos.zxy());
+		break;
 
-		m_failed = true;
-		return {};
+	default: break;
 	}
+}
 
-	int polysSize = MAX_STRAIGHT_PATH_LENGTH;
-	std::unique_ptr<dtPolyRef[]> polys = std::make_unique<dtPolyRef[]>(polysSize);
-	int numPolys = 0;
-	int iters = 0;
-	dtStatus status = 0;
+bool NavigationPath::RecomputePath(
+	const glm::vec3& startPos, const glm::vec3& endPos, bool incremental, StraightPath& path)
+{
+	ApplySettings(m_planner);
 
-	while (iters < 100)
+	PathWorker* worker = nullptr;
+	if (incremental && nav::GetSettings().background_path_search)
 	{
-		status = m_query->findPath(
-			startRef, endRef,
-			glm::value_ptr(spos),
-			glm::value_ptr(epos), &m_filter, polys.get(), &numPolys, polysSize);
+		worker = g_mq2Nav->Get<PathWorker>();
+	}
 
-		bool retry = false;
+	m_planner.SetDeferSearches(worker && worker->IsRunning());
 
-		if (dtStatusDetail(status, DT_OUT_OF_NODES))
-		{
-			// need to expand the node pool size
-			uint32_t maxNodes = (uint32_t)m_query->getNodePool()->getMaxNodes();
-			uint32_t newMaxNodes = std::min<uint32_t>(maxNodes * NODE_POOL_GROWTH_FACTOR, std::min<uint32_t>(DT_NULL_IDX, 1 << DT_NODE_PARENT_BITS) - 1);
-			if (maxNodes != newMaxNodes && newMaxNodes < NODE_POOL_MAX_SIZE)
-			{
-				SPDLOG_DEBUG("Growing node pool: {}", newMaxNodes);
+	// Incremental updates move along the corridor of the current path, and only search
+	// again if it can't be repaired.
+	PathResult result = incremental
+		? m_planner.UpdatePath(startPos, endPos, path)
+		: m_planner.FindPath(startPos, endPos, path);
 
-				m_query->init(m_query->getAttachedNavMesh(), newMaxNodes);
-				retry = true;
-			}
-			else
-			{
-				SPDLOG_WARN("Couldn't increase size of node pool. existing: {}, attempted: {}", maxNodes, newMaxNodes);
-			}
-		}
+	if (result == PathResult::Deferred)
+	{
+		if (SubmitSearch(worker, startPos, endPos))
+			return false;
 
-		if (dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
-		{
-			// need to expand polys buffer
-			int newPolysSize = polysSize *= NODE_POOL_GROWTH_FACTOR;
-			if (newPolysSize < NODE_POOL_MAX_SIZE)
-			{
-				SPDLOG_DEBUG("Growing polys buffer: {}", newPolysSize);
+		// the worker is backed up, so search here instead
+		result = m_planner.FindPath(startPos, endPos, path);
+	}
 
-				polysSize = newPolysSize;
-				polys = std::make_unique<dtPolyRef[]>(polysSize);
-				retry = true;
-			}
-			else
-			{
-				SPDLOG_WARN("Couldn't increase size of polys buffer. size: {}", newPolysSize);
-			}
-		}
+	// anything the worker is still doing for us is out of date now
+	CancelSearch();
+
+	// still following the current path, or waiting for ContinueSearch to find a new one
+	if (result == PathResult::Unchanged || result == PathResult::InProgress)
+		return false;
 
-		if (!retry)
+	if (result != PathResult::Success)
+	{
+		if (!incremental)
 		{
-			break;
+			ReportPathResult(result, startPos, endPos);
 		}
 
-		iters++;
+		m_failed = true;
+		return false;
 	}
 
-	if (dtStatusFailed(status))
-	{
-		SPDLOG_DEBUG("findPath from {} to {} failed.", startPos, endPos);
+	// The 0th index is the starting point. Begin by trying to reach the
+	// 2nd point...
+	if (path.length > 1)
+		path.cursor = 1;
 
-		m_failed = true;
-		return {};
-	}
+	return true;
+}
 
-	if (dtStatusDetail(status, DT_OUT_OF_NODES)
-		|| dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+bool NavigationPath::SubmitSearch(PathWorker* worker, const glm::vec3& startPos, const glm::vec3& endPos)
+{
+	if (m_searchRequest
+		&& glm::distance(m_searchRequest->endPos, endPos) < SEARCH_SUPERSEDE_DISTANCE)
 	{
-		SPDLOG_DEBUG("findPath from {} to {} failed: incomplete result ({0:#x})",
-			startPos, endPos, (status & DT_STATUS_DETAIL_MASK));
+		return true;
+	}
 
-		if (!incremental)
-		{
-			SPDLOG_ERROR("Could not reach destination (too far away): {}", endPos.zxy());
-		}
+	CancelSearch();
 
-		m_failed = true;
-		return {};
-	}
+	auto request = std::make_shared<PathRequest>();
+	request->startPos = startPos;
+	request->endPos = endPos;
+	request->extents = m_planner.GetExtents();
+	request->onComplete = [this](PathRequest& finished) { OnSearchComplete(finished); };
 
-	if ((numPolys > 0 && (polys[numPolys - 1] != endRef))
-		|| dtStatusDetail(status, DT_PARTIAL_RESULT))
+	if (!worker->Submit(request))
+		return false;
+
+	m_searchRequest = std::move(request);
+	return true;
+}
+
+void NavigationPath::CancelSearch()
+{
+	if (m_searchRequest)
 	{
-		// Partial path, did not find path to target
-		SPDLOG_DEBUG("findPath from {} to {} returned a partial result.", startPos, endPos);
+		m_searchRequest->Cancel();
+		m_searchRequest.reset();
+	}
+}
 
-		if (!incremental)
-		{
-			SPDLOG_ERROR("Could not find path to destination: {}", endPos.zxy());
-		}
+void NavigationPath::OnSearchComplete(PathRequest& request)
+{
+	m_searchRequest.reset();
 
+	// This replaces an incremental update, so a failure just leaves the current
+	// path in place.
+	if (request.result != PathResult::Success)
+	{
 		m_failed = true;
-		return {};
+		return;
 	}
 
-	auto path = std::make_unique<StraightPath>(MAX_STRAIGHT_PATH_LENGTH);
+	if (!m_planner.GetNavMesh())
+		return;
 
-	if (numPolys > 0)
-	{
-		m_query->findStraightPath(
-			glm::value_ptr(spos),
-			glm::value_ptr(epos), polys.get(), numPolys,
-			glm::value_ptr(path->verts[0]),
-			path->flags.get(),
-			path->polys.get(),
-			&path->length,
-			MAX_STRAIGHT_PATH_LENGTH,
-			DT_STRAIGHTPATH_AREA_CROSSINGS);
+	// the corridor is checked against the navmesh on the next update, in case it
+	// changed while the search was running.
+	m_planner.SetCorridor(request.corridor.data(), static_cast<int>(request.corridor.size()),
+		request.meshStartPos, request.meshEndPos, request.endPos);
 
-		// The 0th index is the starting point. Begin by trying to reach the
-		// 2nd point...
-		if (path->length > 1)
-			path->cursor = 1;
-	}
+	std::swap(*m_nextPath, request.path);
+	if (m_nextPath->length > 1)
+		m_nextPath->cursor = 1;
 
-	return std::move(path);
+	std::swap(m_currentPath, m_nextPath);
+	RefreshPath(true);
 }
 
 void NavigationPath::UpdatePathProperties()
@@ -504,21 +477,10 @@ void NavigationPath::UpdatePathProperties()
 
 float NavigationPath::GetPathTraversalDistance() const
 {
-	float result = 0.f;
-
 	if (!m_destinationInfo || !m_destinationInfo->valid)
 		return -1.f;
 
-	for (int i = 0; i < m_currentPath->length - 1; ++i)
-	{
-		const float* first = GetRawPosition(i);
-		const float* second = GetRawPosition(i + 1);
-
-		// accumulate the distance
-		result += dtVdist(first, second);
-	}
-
-	return result;
+	return m_currentPath->GetLength();
 }
 
 glm::vec3 NavigationPath::GetDestination() const
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "common/PathPlanner.h"
+#include "common/PathWorker.h"
 #include "common/Utilities.h"
 #include "plugin/MQ2Navigation.h"
 #include "plugin/Renderable.h"
@@ -29,34 +31,6 @@ class NavigationLine;
 struct DestinationInfo;
 struct ID3DXEffect;
 
-struct StraightPath
-{
-	StraightPath() = default;
-	StraightPath(int size) { Reset(size); }
-
-	std::unique_ptr<glm::vec3[]> verts;
-	std::unique_ptr<uint8_t[]> flags;
-	std::unique_ptr<dtPolyRef[]> polys;
-	int length = 0;
-	int cursor = 0;
-
-	void Reset(int size);
-	int GetAllocatedSize() { return alloc; }
-
-	using Node = std::tuple<glm::vec3, uint8_t, dtPolyRef>;
-
-	inline Node GetNode(int pos) const
-	{
-		if (pos >= length)
-			return { {}, 0, 0 };
-
-		return { verts[pos], flags[pos], polys[pos] };
-	}
-
-private:
-	int alloc = 0;
-};
-
 class NavigationPath
 {
 	friend class NavigationLine;
@@ -75,6 +49,11 @@ public:
 	// has been changed.
 	void UpdatePath(bool force = false, bool incremental = false);
 
+	// Run some more of a sliced search started by an incremental update. This should be
+	// called every frame. The current path is kept until the search finishes.
+	void ContinueSearch();
+	bool IsSearching() const { return m_planner.IsPathInProgress() || m_searchRequest != nullptr; }
+
 	void SetShowNavigationPaths(bool renderPaths);
 
 	//----------------------------------------------------------------------------
@@ -133,24 +112,35 @@ public:
 
 	bool CanSeeDestination() const;
 
-	dtNavMesh* GetNavMesh() const { return m_navMesh.get(); }
-	dtNavMeshQuery* GetNavMeshQuery() const { return m_query.get(); }
+	dtNavMesh* GetNavMesh() const { return m_planner.GetNavMesh(); }
+	dtNavMeshQuery* GetNavMeshQuery() const { return m_planner.GetNavMeshQuery(); }
 
 	bool IsFailed() const { return m_failed; }
 
+	// apply the polygon search extents and slicing from the settings to a planner
+	static void ApplySettings(PathPlanner& planner);
+
+	// tell the user why a path couldn't be found
+	static void ReportPathResult(PathResult result, const glm::vec3& startPos, const glm::vec3& endPos);
+
 	mq::Signal<> PathUpdated;
 	mq::Signal<> RenderPathUpdated;
 
 private:
-	void SetNavMesh(const std::shared_ptr<dtNavMesh>& navMesh,
-		bool updatePath = true);
+	void SetNavMesh(NavMesh* navMesh, bool updatePath = true);
 
-	std::unique_ptr<StraightPath> RecomputePath(
+	bool RecomputePath(
 		const glm::vec3& startPos,
 		const glm::vec3& endPos,
-		bool force,
-		bool incremental);
+		bool incremental,
+		StraightPath& path);
 	void UpdatePathProperties();
+	void RefreshPath(bool changed);
+
+	// hand a search for the current path to the background worker
+	bool SubmitSearch(PathWorker* worker, const glm::vec3& startPos, const glm::vec3& endPos);
+	void CancelSearch();
+	void OnSearchComplete(PathRequest& request);
 
 private:
 	std::shared_ptr<DestinationInfo> m_destinationInfo;
@@ -161,14 +151,18 @@ private:
 
 	bool m_failed = false;
 
-	// the plugin owns the mesh
-	std::shared_ptr<dtNavMesh> m_navMesh;
-
-	// we own the query
-	deleting_unique_ptr<dtNavMeshQuery> m_query;
+	// does the actual path finding. the plugin owns the mesh.
+	PathPlanner m_planner;
 
 	std::unique_ptr<StraightPath> m_currentPath;
 
+	// paths are planned into this and swapped with the current path on success, so
+	// the path buffers are reused between updates.
+	std::unique_ptr<StraightPath> m_nextPath;
+
+	// search running on the background worker, if any
+	std::shared_ptr<PathRequest> m_searchRequest;
+
 	bool m_renderPaths;
 	std::shared_ptr<NavigationLine> m_line;
 
@@ -176,9 +170,6 @@ private:
 	std::vector<int> m_renderPath;
 	bool m_followingLink = false;
 
-	dtQueryFilter m_filter;
-	glm::vec3 m_extents = { 5, 10, 5 }; // note: X, Z, Y
-
 	mq::Signal<>::ScopedConnection m_navMeshConn;
 };
 
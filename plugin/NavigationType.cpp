@@ -24,6 +24,7 @@ MQ2NavigationType::MQ2NavigationType()
 	TypeMember(PathLength);
 	TypeMember(Setting);
 	TypeMember(Velocity);
+	TypeMember(PathLengths);
 }
 
 MQ2NavigationType::~MQ2NavigationType()
@@ -73,6 +74,32 @@ bool MQ2NavigationType::GetMember(MQVarPtr VarPtr, const char* Member, PCHAR Ind
 		Dest.Int = static_cast<int>(glm::round(GetMyVelocity()));
 		return true;
 	}
+
+	case PathLengths: {
+		// destinations are separated by ; and the lengths are returned in the same
+		// order, separated by commas.
+		std::vector<std::string_view> destinations;
+		std::string_view index{ Index };
+		while (!index.empty())
+		{
+			size_t pos = index.find(';');
+			destinations.push_back(index.substr(0, pos));
+			index = pos == std::string_view::npos ? std::string_view{} : index.substr(pos + 1);
+		}
+
+		std::string lengths;
+		for (float length : m_nav->GetNavigationPathLengths(destinations))
+		{
+			if (!lengths.empty())
+				lengths += ',';
+			lengths += fmt::format("{:.2f}", length);
+		}
+
+		Dest.Type = mq::datatypes::pStringType;
+		strncpy_s(&DataTypeTemp[0], DataTypeTemp.size(), lengths.c_str(), _TRUNCATE);
+		Dest.Ptr = &DataTypeTemp[0];
+		return true;
+	}
 	}
 
 	strcpy_s(DataTypeTemp, "NULL");
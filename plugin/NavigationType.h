@@ -36,6 +36,7 @@ public:
 
 		Setting = 8,
 		Velocity = 9,
+		PathLengths = 10,
 	};
 
 	MQ2NavigationType();
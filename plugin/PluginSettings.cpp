@@ -75,6 +75,9 @@ void LoadSettings(bool showMessage/* = true*/)
 	settings.autobreak = LoadBoolSetting("AutoBreak", defaults.autobreak);
 	settings.autopause = LoadBoolSetting("AutoPause", defaults.autopause);
 	settings.autoreload = LoadBoolSetting("AutoReload", defaults.autoreload);
+	settings.mesh_load_radius = LoadNumberSetting<float>("MeshLoadRadius", defaults.mesh_load_radius);
+	settings.mesh_load_threads = LoadNumberSetting<int>("MeshLoadThreads", defaults.mesh_load_threads);
+	settings.mesh_cache_size = LoadNumberSetting<int>("MeshCacheSize", defaults.mesh_cache_size);
 	settings.render_doortarget = LoadBoolSetting("RenderDoorTarget", defaults.render_doortarget);
 	settings.show_ui = LoadBoolSetting("ShowUI", defaults.show_ui);
 	settings.show_nav_path = LoadBoolSetting("ShowNavPath", defaults.show_nav_path);
@@ -83,6 +86,12 @@ void LoadSettings(bool showMessage/* = true*/)
 
 	settings.use_find_polygon_extents = LoadBoolSetting("UseFindPolygonExtents", defaults.use_find_polygon_extents);
 	settings.find_polygon_extents = LoadVec3Setting("FindPolygonExtents", defaults.find_polygon_extents);
+	settings.path_slice_iterations = LoadNumberSetting<int>("PathSliceIterations", defaults.path_slice_iterations);
+	settings.background_path_search = LoadBoolSetting("BackgroundPathSearch", defaults.background_path_search);
+	settings.node_pool_shrink_delay = LoadNumberSetting<int>("NodePoolShrinkDelay", defaults.node_pool_shrink_delay);
+	settings.path_cache_size = LoadNumberSetting<int>("PathCacheSize", defaults.path_cache_size);
+	settings.waypoint_flow_fields = LoadBoolSetting("WaypointFlowFields", defaults.waypoint_flow_fields);
+	settings.use_poly_grid = LoadBoolSetting("UsePolyGrid", defaults.use_poly_grid);
 
 	settings.map_line_enabled = LoadBoolSetting("MapLineEnabled", defaults.map_line_enabled);
 	settings.map_line_color = LoadNumberSetting("MapLineColor", defaults.map_line_color);
@@ -117,6 +126,9 @@ void SaveSettings(bool showMessage/* = true*/)
 	SaveBoolSetting("AutoBreak", g_settings.autobreak);
 	SaveBoolSetting("AutoPause", g_settings.autopause);
 	SaveBoolSetting("AutoReload", g_settings.autoreload);
+	SaveNumberSetting<float>("MeshLoadRadius", g_settings.mesh_load_radius);
+	SaveNumberSetting<int>("MeshLoadThreads", g_settings.mesh_load_threads);
+	SaveNumberSetting<int>("MeshCacheSize", g_settings.mesh_cache_size);
 	SaveBoolSetting("ShowUI", g_settings.show_ui);
 	SaveBoolSetting("ShowNavPath", g_settings.show_nav_path);
 	SaveBoolSetting("AttemptUnstuck", g_settings.attempt_unstuck);
@@ -124,6 +136,12 @@ void SaveSettings(bool showMessage/* = true*/)
 
 	SaveBoolSetting("UseFindPolygonExtents", g_settings.use_find_polygon_extents);
 	SaveVec3Setting("FindPolygonExtents", g_settings.find_polygon_extents);
+	SaveNumberSetting<int>("PathSliceIterations", g_settings.path_slice_iterations);
+	SaveBoolSetting("BackgroundPathSearch", g_settings.background_path_search);
+	SaveNumberSetting<int>("NodePoolShrinkDelay", g_settings.node_pool_shrink_delay);
+	SaveNumberSetting<int>("PathCacheSize", g_settings.path_cache_size);
+	SaveBoolSetting("WaypointFlowFields", g_settings.waypoint_flow_fields);
+	SaveBoolSetting("UsePolyGrid", g_settings.use_poly_grid);
 
 	SaveBoolSetting("OpenDoors", g_settings.open_doors);
 	SaveBoolSetting("IgnoreScriptedDoors", g_settings.ignore_scripted_doors);
@@ -19,6 +19,18 @@ struct SettingsData
 	// auto reload navmesh if file changes
 	bool autoreload = true;
 
+	// when loading a navmesh, load tiles within this distance of the player first
+	// and fill in the rest over the following frames. 0 loads everything at once.
+	float mesh_load_radius = 500.0f;
+
+	// number of threads used to decompress navmesh tiles while loading
+	int mesh_load_threads = 2;
+
+	// keep navmeshes for recently visited zones in memory, up to this many
+	// megabytes, so that returning to them doesn't need to load the file again.
+	// 0 disables the cache.
+	int mesh_cache_size = 0;
+
 	// render targeted door objects
 	bool render_doortarget = true;
 
@@ -49,6 +61,30 @@ struct SettingsData
 	// nav path settings
 	bool poll_navigation_path = true;
 
+	// when the path being followed needs to be searched for again, search this many
+	// nodes per frame and keep following the old path until it is done. 0 does the
+	// whole search at once.
+	int path_slice_iterations = 2048;
+
+	// search for the path being followed on a background thread instead. Takes
+	// priority over path_slice_iterations.
+	bool background_path_search = true;
+
+	// node pools that grew during a big search are shrunk back after this many seconds
+	// without another big search.
+	int node_pool_shrink_delay = 30;
+
+	// number of searches remembered for path length and reachability queries
+	int path_cache_size = 128;
+
+	// work out the paths to waypoints that are marked for it ahead of time, and keep
+	// them in a file next to the navmesh.
+	bool waypoint_flow_fields = true;
+
+	// keep a grid of the navmesh polygons for finding the heights at a position, instead
+	// of searching the tiles each time. Off by default, it is only faster on some meshes.
+	bool use_poly_grid = false;
+
 	// open doors while navigation
 	bool open_doors = true;
 
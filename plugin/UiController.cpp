@@ -7,6 +7,7 @@
 
 #include "plugin/ModelLoader.h"
 #include "plugin/MQ2Navigation.h"
+#include "plugin/NavMeshLoader.h"
 #include "plugin/NavigationPath.h"
 #include "plugin/PluginSettings.h"
 #include "plugin/SwitchHandler.h"
@@ -182,6 +183,22 @@ void UiController::DrawSettingsUI(bool fromSettingsPanel)
 		ImGuiEx::CenteredSeparator();
 
 		ImGui::Checkbox("Periodic path updates enabled", &settings.poll_navigation_path);
+
+		if (ImGui::SliderInt("Path search iterations per frame", &settings.path_slice_iterations, 0, 16384))
+			changed = true;
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("When the current path needs to be searched for again, spread the search over\n"
+				"several frames and keep following the old path until it is done. 0 searches all at once.");
+		}
+
+		if (ImGui::Checkbox("Search for paths in the background", &settings.background_path_search))
+			changed = true;
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("When the current path needs to be searched for again, search on another thread\n"
+				"and keep following the old path until it is done.");
+		}
 	};
 
 	auto DrawMeshSettings = [&]()
@@ -196,6 +213,59 @@ void UiController::DrawSettingsUI(bool fromSettingsPanel)
 		if (ImGui::IsItemHovered())
 			ImGui::SetTooltip("Automatically reload the navmesh when it is modified");
 
+		if (ImGui::DragFloat("Initial load radius", &settings.mesh_load_radius, 10.0f, 0.0f, 10000.0f, "%.0f"))
+			changed = true;
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Load the part of the navmesh within this distance of the player first,\n"
+				"and load the rest over the next few frames. 0 loads everything at once.\n"
+				"Only applies to navmeshes saved with compressed tiles.");
+		}
+
+		if (ImGui::SliderInt("Load threads", &settings.mesh_load_threads, 1, 16))
+			changed = true;
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Number of threads used to decompress the navmesh while loading.\n"
+				"Only applies to navmeshes saved with compressed tiles.");
+		}
+
+		if (ImGui::SliderInt("Cache size (MB)", &settings.mesh_cache_size, 0, 2048))
+			changed = true;
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Keep navmeshes for recently visited zones in memory, up to this size,\n"
+				"so that going back to them doesn't need to load the file again. 0 disables the cache.");
+		}
+
+		const NavMeshCache& cache = g_mq2Nav->Get<NavMeshLoader>()->GetCache();
+		ImGui::TextDisabled("%d cached (%.1f MB)", static_cast<int>(cache.GetCount()),
+			cache.GetMemoryUsage() / (1024.0f * 1024.0f));
+
+		if (ImGui::Checkbox("Precompute paths to waypoints", &settings.waypoint_flow_fields))
+		{
+			g_mq2Nav->UpdateFlowFieldTargets();
+			changed = true;
+		}
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Work out the paths to waypoints that are marked for it when the navmesh loads,\n"
+				"so that navigating to them doesn't need a search. They are kept in a file next\n"
+				"to the navmesh, and only worked out again when the navmesh changes.");
+		}
+
+		if (ImGui::Checkbox("Polygon grid", &settings.use_poly_grid))
+		{
+			g_mq2Nav->Get<NavMesh>()->SetPolyGridEnabled(settings.use_poly_grid);
+			changed = true;
+		}
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Keep a grid of the navmesh polygons, so that finding the heights of the\n"
+				"navmesh at a position is a lookup instead of a search of the tiles. Uses a little more\n"
+				"memory, and is only faster on some navmeshes. MeshTool bench-grid compares the two.");
+		}
+
 		//============================================================================
 		// Advanced - Mesh Options
 		//============================================================================
@@ -456,5 +526,25 @@ void UiController::PerformUpdateTab(TabPage page)
 			ImGui::LabelText("Pathfind Timer", "%d", g_mq2Nav->m_pathfindTimer.time_since_epoch() / 1000000);
 			ImGui::LabelText("Velocity", "%d", static_cast<int>(glm::round(GetMyVelocity())));
 		}
+
+		if (ImGui::CollapsingHeader("Path Cache"))
+		{
+			PathCache& cache = g_mq2Nav->GetPathCache();
+			const PathCache::Stats& stats = cache.GetStats();
+			uint64_t lookups = stats.hits + stats.misses;
+
+			ImGui::LabelText("Entries", "%d / %d", static_cast<int>(cache.GetSize()), static_cast<int>(cache.GetCapacity()));
+			ImGui::LabelText("Hits", "%llu", stats.hits);
+			ImGui::LabelText("Misses", "%llu", stats.misses);
+			ImGui::LabelText("Hit Rate", "%.1f%%", lookups ? 100.0 * stats.hits / lookups : 0.0);
+			ImGui::LabelText("Evictions", "%llu", stats.evictions);
+			ImGui::LabelText("Invalidations", "%llu", stats.invalidations);
+
+			if (ImGui::Button("Clear"))
+				cache.Clear();
+			ImGui::SameLine();
+			if (ImGui::Button("Reset Stats"))
+				cache.ResetStats();
+		}
 	}
 }
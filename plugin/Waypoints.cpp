@@ -22,6 +22,13 @@ int g_currentZone = 0;
 
 bool DeleteWaypoint(const std::string& name);
 
+// waypoints marked for flow fields are listed in their own section, so that the
+// waypoint entries keep their format.
+static std::string GetFlowFieldSection()
+{
+	return g_shortZone + ".FlowFields";
+}
+
 std::string Waypoint::Serialize() const
 {
 	std::ostringstream ostr;
@@ -117,6 +124,20 @@ void LoadWaypoints(int zoneId)
 		}
 	}
 
+	if (::GetPrivateProfileStringA(GetFlowFieldSection().c_str(), NULL, "", pchKeys, MAX_STRING * 10, INIFileName))
+	{
+		for (PCHAR pKeys = pchKeys; pKeys[0]; pKeys += strlen(pKeys) + 1)
+		{
+			auto iter = std::find_if(g_waypoints.begin(), g_waypoints.end(),
+				[pKeys](const Waypoint& wp) { return wp.name == pKeys; });
+
+			if (iter != g_waypoints.end())
+			{
+				iter->flowField = true;
+			}
+		}
+	}
+
 	std::sort(g_waypoints.begin(), g_waypoints.end(),
 		[](const Waypoint& a, const Waypoint& b)
 	{
@@ -129,6 +150,9 @@ void SaveWaypoint(const Waypoint& wp)
 	std::string& serialized = wp.Serialize();
 
 	WritePrivateProfileString(g_shortZone, wp.name, serialized, INIFileName);
+
+	::WritePrivateProfileStringA(GetFlowFieldSection().c_str(), wp.name.c_str(),
+		wp.flowField ? "1" : nullptr, INIFileName);
 }
 
 bool GetWaypoint(const std::string& name, Waypoint& wp)
@@ -150,15 +174,24 @@ bool DeleteWaypoint(const std::string& name)
 	if (iter == g_waypoints.end())
 		return false;
 
+	bool flowField = iter->flowField;
 	g_waypoints.erase(iter);
 
 	::WritePrivateProfileStringA(g_shortZone.c_str(), name.c_str(), "", INIFileName);
+	::WritePrivateProfileStringA(GetFlowFieldSection().c_str(), name.c_str(), nullptr, INIFileName);
+
+	if (flowField)
+	{
+		g_mq2Nav->UpdateFlowFieldTargets();
+	}
+
 	return true;
 }
 
 bool AddWaypoint(const Waypoint& waypoint)
 {
 	bool exists = false;
+	bool flowField = waypoint.flowField;
 
 	auto iter = std::find_if(g_waypoints.begin(), g_waypoints.end(),
 		[&waypoint](const Waypoint& wp) { return wp.name == waypoint.name; });
@@ -170,6 +203,7 @@ bool AddWaypoint(const Waypoint& waypoint)
 	}
 	else
 	{
+		flowField |= iter->flowField;
 		*iter = std::move(waypoint);
 		exists = true;
 	}
@@ -183,6 +217,11 @@ bool AddWaypoint(const Waypoint& waypoint)
 	// save data
 	SaveWaypoint(waypoint);
 
+	if (flowField)
+	{
+		g_mq2Nav->UpdateFlowFieldTargets();
+	}
+
 	return exists;
 }
 
@@ -334,6 +373,13 @@ void RenderWaypointsUI()
 		}
 		ImGui::PopItemWidth();
 
+		ImGui::Checkbox("Precompute paths to this waypoint", &editWaypoint.flowField);
+		if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("Work out the path to this waypoint from everywhere on the navmesh ahead of time,\n"
+				"so that navigating to it doesn't need a search. Takes effect when saved.");
+		}
+
 		if (ImGui::Button("Navigate to Waypoint"))
 		{
 			if (editWaypoint.name.length() > 0)
@@ -30,6 +30,9 @@ public:
 	glm::vec3 location = { 0, 0, 0 };
 	std::string name;
 	std::string description;
+
+	// paths to this waypoint are worked out ahead of time
+	bool flowField = false;
 };
 
 // Load/Save waypoints from .ini file
@@ -0,0 +1,134 @@
+//
+// CodecTests.cpp
+//
+// Saving and loading the tiles of a navmesh file with each codec.
+//
+
+#include "TestMesh.h"
+
+#include "common/Compression.h"
+#include "common/NavMeshData.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+static const NavMeshCodec AllCodecs[] = {
+	NavMeshCodec::None,
+	NavMeshCodec::Zlib,
+	NavMeshCodec::Zstd,
+	NavMeshCodec::LZ4,
+};
+
+class CodecTest : public ::testing::TestWithParam<NavMeshCodec>
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+	}
+
+	// saves the test mesh with the codec, next to the file that it was loaded from
+	std::string SaveWithCodec(NavMeshCodec codec)
+	{
+		std::string fileName = m_mesh.GetFileName() + "." + GetCodecName(codec);
+
+		NavMesh& navMesh = m_mesh.GetNavMesh();
+		navMesh.SetTileCodec(codec);
+		EXPECT_TRUE(navMesh.SaveNavMeshFile(fileName, NavMeshHeaderVersion::Latest));
+
+		return fileName;
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	dtQueryFilter m_filter;
+};
+
+TEST_P(CodecTest, TilesSurviveRoundTrip)
+{
+	const NavMeshCodec codec = GetParam();
+	std::string fileName = SaveWithCodec(codec);
+
+	NavMesh loaded;
+	ASSERT_EQ(loaded.LoadNavMeshFile(fileName), NavMesh::LoadResult::Success);
+	EXPECT_EQ(loaded.GetTileCodec(), codec);
+
+	// the tile hashes are taken from the decoded data, so they only match if every tile
+	// decoded to the bytes that were saved
+	const NavMesh& original = m_mesh.GetNavMesh();
+	EXPECT_EQ(loaded.GetTileHashes(), original.GetTileHashes());
+
+	const dtNavMesh& expectedMesh = *original.GetNavMesh();
+	const dtNavMesh& actualMesh = *loaded.GetNavMesh();
+	ASSERT_EQ(actualMesh.getMaxTiles(), expectedMesh.getMaxTiles());
+
+	for (int i = 0; i < expectedMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* expected = expectedMesh.getTile(i);
+		const dtMeshTile* actual = actualMesh.getTile(i);
+		if (!expected->header)
+		{
+			EXPECT_EQ(actual->header, nullptr);
+			continue;
+		}
+
+		ASSERT_NE(actual->header, nullptr);
+		ASSERT_EQ(actual->dataSize, expected->dataSize);
+		ASSERT_EQ(actual->header->vertCount, expected->header->vertCount);
+		ASSERT_EQ(actual->header->polyCount, expected->header->polyCount);
+		EXPECT_EQ(0, std::memcmp(actual->verts, expected->verts, sizeof(float) * 3 * expected->header->vertCount));
+		EXPECT_EQ(actualMesh.getTileRef(actual), expectedMesh.getTileRef(expected));
+	}
+
+	// and paths are found the same way over the loaded tiles
+	DetourPath expectedPath = FindDetourPath(expectedMesh, m_filter, TestScene::GetFloorStart(), TestScene::GetFloorEnd());
+	DetourPath actualPath = FindDetourPath(actualMesh, m_filter, TestScene::GetFloorStart(), TestScene::GetFloorEnd());
+	ASSERT_TRUE(expectedPath.IsComplete());
+	EXPECT_EQ(actualPath.status, expectedPath.status);
+	EXPECT_EQ(actualPath.polys, expectedPath.polys);
+	EXPECT_EQ(actualPath.points, expectedPath.points);
+}
+
+TEST_P(CodecTest, CompressedFilesAreSmaller)
+{
+	const NavMeshCodec codec = GetParam();
+	if (codec == NavMeshCodec::None)
+		GTEST_SKIP() << "uncompressed";
+
+	const auto uncompressedSize = std::filesystem::file_size(SaveWithCodec(NavMeshCodec::None));
+	const auto compressedSize = std::filesystem::file_size(SaveWithCodec(codec));
+	EXPECT_LT(compressedSize, uncompressedSize);
+}
+
+TEST_P(CodecTest, UnknownCodecIsRejected)
+{
+	// A file from a newer version that uses a codec we don't know about can't be read,
+	// even if the rest of its header looks fine.
+	const NavMeshCodec codec = GetParam();
+	std::string fileName = SaveWithCodec(codec);
+
+	{
+		std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+		ASSERT_TRUE(file.is_open());
+
+		MeshFileHeaderV6 header;
+		ASSERT_TRUE(file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+
+		header.flags = header.flags | NavMeshFileFlags::COMPRESSED;
+		header.codec = static_cast<NavMeshCodec>(static_cast<uint32_t>(NavMeshCodec::Last) + 1);
+
+		file.seekp(0);
+		ASSERT_TRUE(file.write(reinterpret_cast<const char*>(&header), sizeof(header)));
+	}
+
+	NavMesh loaded;
+	EXPECT_EQ(loaded.LoadNavMeshFile(fileName), NavMesh::LoadResult::VersionMismatch);
+	EXPECT_FALSE(loaded.IsNavMeshLoaded());
+}
+
+INSTANTIATE_TEST_SUITE_P(Codecs, CodecTest, ::testing::ValuesIn(AllCodecs),
+	[](const ::testing::TestParamInfo<NavMeshCodec>& info) { return std::string(GetCodecName(info.param)); });
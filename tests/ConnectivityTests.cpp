@@ -0,0 +1,153 @@
+//
+// ConnectivityTests.cpp
+//
+// PolyConnectivity against findPath, with and without one-way off-mesh connections.
+//
+
+#include "TestMesh.h"
+
+#include "common/NavMeshData.h"
+#include "common/PathPlanner.h"
+#include "common/PolyConnectivity.h"
+
+#include <gtest/gtest.h>
+
+class ConnectivityTest : public ::testing::Test
+{
+protected:
+	// one-way connection between the top of the block and the floor next to it
+	static constexpr float BlockEdgeZ = 100.f;
+
+	void AddConnection(const glm::vec3& start, const glm::vec3& end, bool bidirectional)
+	{
+		auto connection = std::make_unique<OffMeshConnection>();
+		connection->start = start;
+		connection->end = end;
+		connection->bidirectional = bidirectional;
+
+		m_mesh.GetNavMesh().AddConnection(std::move(connection));
+	}
+
+	void Build()
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_planner.SetNavMesh(&m_mesh.GetNavMesh());
+		m_navMesh = m_mesh.GetNavMesh().GetNavMesh();
+		m_connectivity = m_mesh.GetNavMesh().GetPolyConnectivity();
+		ASSERT_NE(m_connectivity, nullptr);
+	}
+
+	bool MayBeConnected(const glm::vec3& from, const glm::vec3& to) const
+	{
+		dtPolyRef fromRef = FindPolyRef(*m_navMesh, m_planner.GetFilter(), from);
+		dtPolyRef toRef = FindPolyRef(*m_navMesh, m_planner.GetFilter(), to);
+		EXPECT_NE(fromRef, 0u);
+		EXPECT_NE(toRef, 0u);
+
+		return m_connectivity->MayBeConnected(*m_navMesh, fromRef, toRef);
+	}
+
+	bool IsReachable(const glm::vec3& from, const glm::vec3& to) const
+	{
+		return FindDetourPath(*m_navMesh, m_planner.GetFilter(), from, to).IsComplete();
+	}
+
+	// Every pair that findPath can join must be in the same component.
+	void ExpectNoMissedPaths(const std::vector<glm::vec3>& points) const
+	{
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			for (size_t j = 0; j < points.size(); ++j)
+			{
+				if (!MayBeConnected(points[i], points[j]))
+				{
+					EXPECT_FALSE(IsReachable(points[i], points[j])) << "points " << i << " and " << j;
+				}
+			}
+		}
+	}
+
+	std::vector<glm::vec3> GetTestPoints() const
+	{
+		std::vector<glm::vec3> points = GetRandomPoints(*m_navMesh, 12, 4);
+		points.push_back(TestScene::GetFloorStart());
+		points.push_back(TestScene::GetRoomCenter());
+		points.push_back(TestScene::GetBlockTop());
+		points.push_back(TestScene::GetBlockBase());
+		return points;
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	PathPlanner m_planner;
+	std::shared_ptr<dtNavMesh> m_navMesh;
+	std::shared_ptr<const PolyConnectivity> m_connectivity;
+};
+
+TEST_F(ConnectivityTest, SeparatesUnreachableRegions)
+{
+	Build();
+
+	EXPECT_TRUE(MayBeConnected(TestScene::GetFloorStart(), TestScene::GetFloorEnd()));
+	EXPECT_FALSE(MayBeConnected(TestScene::GetFloorStart(), TestScene::GetRoomCenter()));
+	EXPECT_FALSE(MayBeConnected(TestScene::GetBlockBase(), TestScene::GetBlockTop()));
+	EXPECT_FALSE(MayBeConnected(TestScene::GetBlockTop(), TestScene::GetBlockBase()));
+
+	ExpectNoMissedPaths(GetTestPoints());
+}
+
+TEST_F(ConnectivityTest, OneWayDownJoinsComponents)
+{
+	// The floor is flooded before the block top, so the flood from the top crosses the
+	// connection into a component that is already done, and the two have to be merged.
+	AddConnection({ 112.f, TestScene::BlockHeight, BlockEdgeZ + 6.f }, { 112.f, 0.f, BlockEdgeZ - 6.f }, false);
+	Build();
+
+	ASSERT_TRUE(IsReachable(TestScene::GetBlockTop(), TestScene::GetBlockBase()));
+	ASSERT_FALSE(IsReachable(TestScene::GetBlockBase(), TestScene::GetBlockTop()));
+
+	EXPECT_TRUE(MayBeConnected(TestScene::GetBlockTop(), TestScene::GetBlockBase()));
+	EXPECT_TRUE(MayBeConnected(TestScene::GetBlockTop(), TestScene::GetFloorEnd()));
+	EXPECT_FALSE(MayBeConnected(TestScene::GetBlockTop(), TestScene::GetRoomCenter()));
+
+	StraightPath path;
+	EXPECT_EQ(m_planner.FindPath(TestScene::GetBlockTop(), TestScene::GetFloorEnd(), path), PathResult::Success);
+
+	ExpectNoMissedPaths(GetTestPoints());
+}
+
+TEST_F(ConnectivityTest, OneWayUpJoinsComponents)
+{
+	// here the flood from the floor crosses the connection first
+	AddConnection({ 112.f, 0.f, BlockEdgeZ - 6.f }, { 112.f, TestScene::BlockHeight, BlockEdgeZ + 6.f }, false);
+	Build();
+
+	ASSERT_TRUE(IsReachable(TestScene::GetBlockBase(), TestScene::GetBlockTop()));
+	ASSERT_FALSE(IsReachable(TestScene::GetBlockTop(), TestScene::GetBlockBase()));
+
+	EXPECT_TRUE(MayBeConnected(TestScene::GetFloorStart(), TestScene::GetBlockTop()));
+	EXPECT_FALSE(MayBeConnected(TestScene::GetBlockTop(), TestScene::GetRoomCenter()));
+
+	StraightPath path;
+	EXPECT_EQ(m_planner.FindPath(TestScene::GetFloorStart(), TestScene::GetBlockTop(), path), PathResult::Success);
+
+	ExpectNoMissedPaths(GetTestPoints());
+}
+
+TEST_F(ConnectivityTest, ConnectionRemovesOneComponent)
+{
+	Build();
+	const uint32_t separate = m_connectivity->GetComponentCount();
+
+	TestMesh joined;
+	auto connection = std::make_unique<OffMeshConnection>();
+	connection->start = { 112.f, TestScene::BlockHeight, BlockEdgeZ + 6.f };
+	connection->end = { 112.f, 0.f, BlockEdgeZ - 6.f };
+	connection->bidirectional = false;
+	joined.GetNavMesh().AddConnection(std::move(connection));
+	ASSERT_TRUE(joined.Build(m_scene.geometry));
+
+	ASSERT_NE(joined.GetNavMesh().GetPolyConnectivity(), nullptr);
+	EXPECT_EQ(joined.GetNavMesh().GetPolyConnectivity()->GetComponentCount(), separate - 1);
+}
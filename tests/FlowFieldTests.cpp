@@ -0,0 +1,132 @@
+//
+// FlowFieldTests.cpp
+//
+// Building the flow fields of a navmesh off the calling thread.
+//
+
+#include "TestMesh.h"
+
+#include "common/FlowField.h"
+#include "common/PathPlanner.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+class FlowFieldTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_changedConn = m_mesh.GetNavMesh().OnNavMeshChanged.Connect([this]() { ++m_changes; });
+	}
+
+	// the field to the target leads there from the other side of the floor
+	void ExpectFieldLeadsToTarget(NavMesh& navMesh)
+	{
+		ASSERT_NE(navMesh.GetFlowFields(), nullptr);
+
+		PathPlanner planner;
+		planner.SetNavMesh(&navMesh);
+
+		const dtNavMesh& mesh = *navMesh.GetNavMesh();
+		dtPolyRef startRef = FindPolyRef(mesh, planner.GetFilter(), TestScene::GetFloorStart());
+		dtPolyRef targetRef = FindPolyRef(mesh, planner.GetFilter(), m_target.pos);
+		ASSERT_NE(startRef, 0u);
+		ASSERT_NE(targetRef, 0u);
+
+		const FlowField* field = navMesh.GetFlowFields()->FindByTargetRef(targetRef);
+		ASSERT_NE(field, nullptr);
+		EXPECT_EQ(field->GetTarget(), m_target);
+
+		dtPolyRef polys[1024];
+		int numPolys = field->GetCorridor(mesh, startRef, polys, 1024);
+		ASSERT_GT(numPolys, 1);
+		EXPECT_EQ(polys[0], startRef);
+		EXPECT_EQ(polys[numPolys - 1], targetRef);
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	FlowFieldTarget m_target{ "end", TestScene::GetFloorEnd() };
+
+	int m_changes = 0;
+	mq::Signal<>::ScopedConnection m_changedConn;
+};
+
+TEST_F(FlowFieldTest, TargetsAreBuiltInBackground)
+{
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+	navMesh.SetFlowFieldTargets({ m_target });
+
+	// nothing changes until the build is picked up
+	EXPECT_TRUE(navMesh.IsBuildingFlowFields());
+	EXPECT_EQ(navMesh.GetFlowFields(), nullptr);
+	EXPECT_EQ(m_changes, 0);
+
+	auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	while (navMesh.IsBuildingFlowFields() && std::chrono::steady_clock::now() < timeout)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		navMesh.OnPulse();
+	}
+
+	ASSERT_FALSE(navMesh.IsBuildingFlowFields());
+	EXPECT_EQ(m_changes, 1);
+	ExpectFieldLeadsToTarget(navMesh);
+
+	// the same targets don't need another build
+	navMesh.SetFlowFieldTargets({ m_target });
+	EXPECT_FALSE(navMesh.IsBuildingFlowFields());
+}
+
+TEST_F(FlowFieldTest, ClearingTargetsDropsFields)
+{
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+	navMesh.SetFlowFieldTargets({ m_target });
+	navMesh.WaitForFlowFields();
+	ASSERT_NE(navMesh.GetFlowFields(), nullptr);
+
+	navMesh.SetFlowFieldTargets({});
+	EXPECT_FALSE(navMesh.IsBuildingFlowFields());
+	EXPECT_EQ(navMesh.GetFlowFields(), nullptr);
+	EXPECT_EQ(m_changes, 2);
+}
+
+TEST_F(FlowFieldTest, ReloadStartsBuildAgain)
+{
+	// the build that is under way is for the tiles that are being replaced
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+	navMesh.SetFlowFieldTargets({ m_target });
+	ASSERT_EQ(navMesh.LoadNavMeshFile(m_mesh.GetFileName()), NavMesh::LoadResult::Success);
+
+	EXPECT_TRUE(navMesh.IsBuildingFlowFields());
+	EXPECT_EQ(navMesh.GetFlowFields(), nullptr);
+
+	navMesh.WaitForFlowFields();
+	ExpectFieldLeadsToTarget(navMesh);
+}
+
+TEST_F(FlowFieldTest, LoadedFieldsComeWithMesh)
+{
+	// the way the loader builds them on its own thread, before the navmesh is swapped in
+	NavMesh loaded;
+	ASSERT_EQ(loaded.LoadNavMeshFile(m_mesh.GetFileName()), NavMesh::LoadResult::Success);
+	loaded.BuildFlowFields({ m_target });
+
+	EXPECT_FALSE(loaded.IsBuildingFlowFields());
+	std::shared_ptr<const FlowFieldSet> fields = loaded.GetFlowFields();
+	ASSERT_NE(fields, nullptr);
+
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+	navMesh.TakeLoadedMesh(loaded);
+
+	EXPECT_FALSE(navMesh.IsBuildingFlowFields());
+	EXPECT_EQ(navMesh.GetFlowFields(), fields);
+	EXPECT_EQ(navMesh.GetFlowFieldTargets(), std::vector<FlowFieldTarget>{ m_target });
+	EXPECT_TRUE(loaded.GetFlowFieldTargets().empty());
+	ExpectFieldLeadsToTarget(navMesh);
+}
@@ -0,0 +1,268 @@
+//
+// LandmarkTests.cpp
+//
+// The landmark heuristic against the costs of detour's own searches.
+//
+
+#include "TestMesh.h"
+
+#include "common/LandmarkTable.h"
+#include "common/NavMeshData.h"
+#include "common/PathPlanner.h"
+
+#include <DetourNode.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cfloat>
+
+// The middle of the edge between two linked polygons, where detour's search puts the
+// node of the second one.
+static glm::vec3 GetEdgeMidPoint(const dtNavMesh& navMesh, dtPolyRef from, dtPolyRef to)
+{
+	const dtMeshTile* fromTile = nullptr;
+	const dtPoly* fromPoly = nullptr;
+	const dtMeshTile* toTile = nullptr;
+	const dtPoly* toPoly = nullptr;
+	navMesh.getTileAndPolyByRefUnsafe(from, &fromTile, &fromPoly);
+	navMesh.getTileAndPolyByRefUnsafe(to, &toTile, &toPoly);
+
+	for (auto i = fromPoly->firstLink; i != DT_NULL_LINK; i = fromTile->links[i].next)
+	{
+		const dtLink& link = fromTile->links[i];
+		if (link.ref != to)
+			continue;
+
+		if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+			return glm::make_vec3(&fromTile->verts[fromPoly->verts[link.edge] * 3]);
+
+		if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+		{
+			for (auto j = toPoly->firstLink; j != DT_NULL_LINK; j = toTile->links[j].next)
+			{
+				if (toTile->links[j].ref == from)
+					return glm::make_vec3(&toTile->verts[toPoly->verts[toTile->links[j].edge] * 3]);
+			}
+		}
+
+		glm::vec3 v0 = glm::make_vec3(&fromTile->verts[fromPoly->verts[link.edge] * 3]);
+		glm::vec3 v1 = glm::make_vec3(&fromTile->verts[fromPoly->verts[(link.edge + 1) % fromPoly->vertCount] * 3]);
+		if (link.side != 0xff && (link.bmin != 0 || link.bmax != 255))
+			return glm::mix(v0, v1, (link.bmin + link.bmax) / 510.f);
+
+		return (v0 + v1) * 0.5f;
+	}
+
+	return glm::vec3(0.f);
+}
+
+// The cost of a corridor the way findPath adds it up, through the middle of each edge.
+static float GetCorridorCost(const dtNavMesh& navMesh, const dtQueryFilter& filter, const glm::vec3& startPos,
+	const glm::vec3& endPos, const std::vector<dtPolyRef>& polys)
+{
+	float cost = 0.f;
+	glm::vec3 pos = startPos;
+
+	for (size_t i = 0; i < polys.size(); ++i)
+	{
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		navMesh.getTileAndPolyByRefUnsafe(polys[i], &tile, &poly);
+
+		glm::vec3 next = i + 1 < polys.size() ? GetEdgeMidPoint(navMesh, polys[i], polys[i + 1]) : endPos;
+		cost += glm::distance(pos, next) * filter.getAreaCost(poly->getArea());
+		pos = next;
+	}
+
+	return cost;
+}
+
+class LandmarkTest : public ::testing::Test
+{
+protected:
+	static constexpr int LandmarkCount = 8;
+
+	void SetUp() override
+	{
+		// a one-way drop from the block, so that the costs from and to the landmarks differ
+		auto connection = std::make_unique<OffMeshConnection>();
+		connection->start = { 112.f, TestScene::BlockHeight, 106.f };
+		connection->end = { 112.f, 0.f, 94.f };
+		connection->bidirectional = false;
+		m_mesh.GetNavMesh().AddConnection(std::move(connection));
+
+		m_mesh.GetNavMesh().GetNavMeshConfig().landmarkCount = LandmarkCount;
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_planner.SetNavMesh(&m_mesh.GetNavMesh());
+		m_navMesh = m_mesh.GetNavMesh().GetNavMesh();
+		m_table = m_mesh.GetNavMesh().GetLandmarkTable();
+		ASSERT_NE(m_table, nullptr);
+
+		m_heuristic.SetTable(m_navMesh.get(), m_table);
+		ASSERT_TRUE(dtStatusSucceed(m_query.init(m_navMesh.get(), 65535)));
+	}
+
+	std::vector<dtPolyRef> GetAllPolys() const
+	{
+		const dtNavMesh& navMesh = *m_navMesh;
+		std::vector<dtPolyRef> polys;
+
+		for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = navMesh.getTile(i);
+			if (!tile->header) continue;
+
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				polys.push_back(navMesh.getPolyRefBase(tile) | (dtPolyRef)j);
+			}
+		}
+
+		return polys;
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	PathPlanner m_planner;
+	std::shared_ptr<dtNavMesh> m_navMesh;
+	std::shared_ptr<const LandmarkTable> m_table;
+	LandmarkHeuristic m_heuristic;
+	dtNavMeshQuery m_query;
+};
+
+TEST_F(LandmarkTest, TableIsSavedWithMesh)
+{
+	EXPECT_EQ(m_table->GetLandmarkCount(), LandmarkCount);
+	EXPECT_TRUE(m_table->IsValidFor(m_planner.GetFilter()));
+
+	const int ground = static_cast<int>(PolyArea::Ground);
+
+	// costs that are lower than the ones the table was built with would make it overestimate
+	dtQueryFilter cheaper = m_planner.GetFilter();
+	cheaper.setAreaCost(ground, cheaper.getAreaCost(ground) * 0.5f);
+	EXPECT_FALSE(m_table->IsValidFor(cheaper));
+
+	dtQueryFilter costlier = m_planner.GetFilter();
+	costlier.setAreaCost(ground, costlier.getAreaCost(ground) * 2.f);
+	EXPECT_TRUE(m_table->IsValidFor(costlier));
+
+	// as would polygons that it left out
+	dtQueryFilter everything = m_planner.GetFilter();
+	everything.setExcludeFlags(0);
+	EXPECT_FALSE(m_table->IsValidFor(everything));
+}
+
+TEST_F(LandmarkTest, BoundNeverOverestimates)
+{
+	// From where a polygon is entered, a search without a heuristic finds the cost to every
+	// other polygon. The bound can't be more than any of them.
+	const dtQueryFilter& filter = m_planner.GetFilter();
+	std::vector<dtPolyRef> polys = GetAllPolys();
+	std::vector<float> costs(polys.size());
+
+	int checked = 0, overestimates = 0, useful = 0;
+
+	for (size_t i = 0; i < polys.size(); i += polys.size() / 60)
+	{
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		m_navMesh->getTileAndPolyByRefUnsafe(polys[i], &tile, &poly);
+		if (poly->getType() != DT_POLYTYPE_GROUND || poly->firstLink == DT_NULL_LINK)
+			continue;
+
+		LandmarkTable::PolyCosts startCosts;
+		ASSERT_TRUE(m_table->GetCosts(*m_navMesh, polys[i], startCosts));
+
+		glm::vec3 startPos = GetEdgeMidPoint(*m_navMesh, tile->links[poly->firstLink].ref, polys[i]);
+		m_query.findCostsToPolys(polys[i], glm::value_ptr(startPos), polys.data(), static_cast<int>(polys.size()),
+			FLT_MAX, &filter, costs.data());
+
+		for (size_t j = 0; j < polys.size(); ++j)
+		{
+			LandmarkTable::PolyCosts endCosts;
+			if (costs[j] < 0.f || !m_table->GetCosts(*m_navMesh, polys[j], endCosts))
+				continue;
+
+			float bound = m_table->GetLowerBound(startCosts, endCosts);
+			if (bound > costs[j] + 0.001f)
+			{
+				ADD_FAILURE() << "bound of " << bound << " for a cost of " << costs[j];
+				if (++overestimates > 10)
+					return;
+			}
+
+			const dtMeshTile* endTile = nullptr;
+			const dtPoly* endPoly = nullptr;
+			m_navMesh->getTileAndPolyByRefUnsafe(polys[j], &endTile, &endPoly);
+			if (bound > glm::distance(startPos, glm::make_vec3(&endTile->verts[endPoly->verts[0] * 3])) + 10.f)
+				++useful;
+
+			++checked;
+		}
+	}
+
+	EXPECT_GT(checked, 5000);
+
+	// and it should be better than the straight line often enough to be worth having
+	EXPECT_GT(useful, checked / 10);
+}
+
+TEST_F(LandmarkTest, PathsCostNoMoreThanWithout)
+{
+	const dtQueryFilter& filter = m_planner.GetFilter();
+	const float extents[3] = { 5.f, 10.f, 5.f };
+	std::vector<glm::vec3> points = GetRandomPoints(*m_navMesh, 1000, 7);
+
+	double plainCost = 0., landmarkCost = 0.;
+	int plainNodes = 0, landmarkNodes = 0, found = 0;
+
+	for (size_t i = 0; i + 1 < points.size(); i += 2)
+	{
+		dtPolyRef startRef = 0, endRef = 0;
+		glm::vec3 spos, epos;
+		m_query.findNearestPoly(glm::value_ptr(points[i]), extents, &filter, &startRef, glm::value_ptr(spos));
+		m_query.findNearestPoly(glm::value_ptr(points[i + 1]), extents, &filter, &endRef, glm::value_ptr(epos));
+		ASSERT_NE(startRef, 0u);
+		ASSERT_NE(endRef, 0u);
+
+		float cost[2] = { 0.f, 0.f };
+		bool complete[2] = { false, false };
+
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			m_query.setHeuristic(pass == 0 ? nullptr : &m_heuristic);
+
+			std::vector<dtPolyRef> polys(4096);
+			int numPolys = 0;
+			dtStatus status = m_query.findPath(startRef, endRef, glm::value_ptr(spos), glm::value_ptr(epos), &filter,
+				polys.data(), &numPolys, static_cast<int>(polys.size()));
+			polys.resize(numPolys);
+
+			complete[pass] = dtStatusSucceed(status) && !dtStatusDetail(status, DT_PARTIAL_RESULT);
+			cost[pass] = GetCorridorCost(*m_navMesh, filter, spos, epos, polys);
+			(pass == 0 ? plainNodes : landmarkNodes) += m_query.getNodePool()->getNodeCount();
+		}
+
+		m_query.setHeuristic(nullptr);
+
+		ASSERT_EQ(complete[0], complete[1]);
+		if (!complete[0])
+			continue;
+
+		// findPath keeps the position a polygon was first reached at, so a different order
+		// of search can give a path that costs a little more or less either way.
+		EXPECT_LE(cost[1], cost[0] * 1.05f) << "from " << i << " to " << i + 1;
+
+		plainCost += cost[0];
+		landmarkCost += cost[1];
+		++found;
+	}
+
+	ASSERT_GT(found, 200);
+
+	// but an overestimate would make them cost more overall
+	EXPECT_LE(landmarkCost, plainCost);
+	EXPECT_LT(landmarkNodes, plainNodes);
+}
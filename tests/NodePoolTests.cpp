@@ -0,0 +1,177 @@
+//
+// NodePoolTests.cpp
+//
+// Growing and shrinking the detour node pool, including when memory runs out.
+//
+
+#include "TestMesh.h"
+
+#include <DetourAlloc.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourNode.h>
+#include <gtest/gtest.h>
+
+#include <cfloat>
+#include <cstdlib>
+
+static bool s_failAllocs = false;
+
+static void* TestAlloc(size_t size, dtAllocHint)
+{
+	return s_failAllocs ? nullptr : malloc(size);
+}
+
+static void TestFree(void* ptr)
+{
+	free(ptr);
+}
+
+class NodePoolTest : public ::testing::Test
+{
+protected:
+	static constexpr int InitialNodes = 32;
+	static constexpr int NodeLimit = 8192;
+	static constexpr int MaxPath = 1024;
+
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		dtAllocSetCustom(TestAlloc, TestFree);
+
+		m_navMesh = m_mesh.GetNavMesh().GetNavMesh();
+		ASSERT_TRUE(dtStatusSucceed(m_query.init(m_navMesh.get(), InitialNodes)));
+		m_query.setNodePoolLimit(NodeLimit);
+
+		const float extents[3] = { 5, 10, 5 };
+		glm::vec3 start = TestScene::GetFloorStart();
+		glm::vec3 end = TestScene::GetFloorEnd();
+		m_query.findNearestPoly(&start[0], extents, &m_filter, &m_startRef, &m_startPos[0]);
+		m_query.findNearestPoly(&end[0], extents, &m_filter, &m_endRef, &m_endPos[0]);
+		ASSERT_NE(m_startRef, 0u);
+		ASSERT_NE(m_endRef, 0u);
+	}
+
+	void TearDown() override
+	{
+		s_failAllocs = false;
+		dtAllocSetCustom(nullptr, nullptr);
+	}
+
+	dtStatus FindPath(int& pathCount)
+	{
+		return m_query.findPath(m_startRef, m_endRef, &m_startPos[0], &m_endPos[0], &m_filter,
+			m_path, &pathCount, MaxPath);
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	std::shared_ptr<dtNavMesh> m_navMesh;
+	dtNavMeshQuery m_query;
+	dtQueryFilter m_filter;
+	dtPolyRef m_startRef = 0, m_endRef = 0;
+	glm::vec3 m_startPos, m_endPos;
+	dtPolyRef m_path[MaxPath];
+};
+
+TEST_F(NodePoolTest, FindPathGrowsPool)
+{
+	int pathCount = 0;
+	dtStatus status = FindPath(pathCount);
+
+	EXPECT_TRUE(dtStatusSucceed(status));
+	EXPECT_FALSE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+	EXPECT_FALSE(dtStatusDetail(status, DT_OUT_OF_NODES));
+	EXPECT_GT(m_query.getNodePool()->getMaxNodes(), InitialNodes);
+	ASSERT_GT(pathCount, 0);
+	EXPECT_EQ(m_path[pathCount - 1], m_endRef);
+}
+
+TEST_F(NodePoolTest, FindPathStopsWhenGrowthFails)
+{
+	s_failAllocs = true;
+
+	int pathCount = 0;
+	dtStatus status = FindPath(pathCount);
+
+	s_failAllocs = false;
+
+	EXPECT_TRUE(dtStatusSucceed(status));
+	EXPECT_TRUE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+	EXPECT_TRUE(dtStatusDetail(status, DT_OUT_OF_NODES));
+	EXPECT_EQ(m_query.getNodePool()->getMaxNodes(), InitialNodes);
+	ASSERT_GT(pathCount, 0);
+	EXPECT_NE(m_path[pathCount - 1], m_endRef);
+}
+
+TEST_F(NodePoolTest, SlicedFindPathStopsWhenGrowthFails)
+{
+	ASSERT_TRUE(dtStatusInProgress(m_query.initSlicedFindPath(m_startRef, m_endRef, &m_startPos[0],
+		&m_endPos[0], &m_filter)));
+
+	s_failAllocs = true;
+
+	dtStatus status = m_query.updateSlicedFindPath(100000, nullptr);
+
+	s_failAllocs = false;
+
+	EXPECT_TRUE(dtStatusSucceed(status));
+	EXPECT_TRUE(dtStatusDetail(status, DT_OUT_OF_NODES));
+
+	int pathCount = 0;
+	status = m_query.finalizeSlicedFindPath(m_path, &pathCount, MaxPath);
+
+	EXPECT_TRUE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+	EXPECT_TRUE(dtStatusDetail(status, DT_OUT_OF_NODES));
+}
+
+TEST_F(NodePoolTest, FindCostsStopsWhenGrowthFails)
+{
+	float cost = 0.f;
+
+	s_failAllocs = true;
+
+	dtStatus status = m_query.findCostsToPolys(m_startRef, &m_startPos[0], &m_endRef, 1, FLT_MAX,
+		&m_filter, &cost);
+
+	s_failAllocs = false;
+
+	EXPECT_TRUE(dtStatusSucceed(status));
+	EXPECT_TRUE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+	EXPECT_TRUE(dtStatusDetail(status, DT_OUT_OF_NODES));
+	EXPECT_EQ(cost, -1.f);
+
+	// and reaches it once there is memory again
+	status = m_query.findCostsToPolys(m_startRef, &m_startPos[0], &m_endRef, 1, FLT_MAX, &m_filter, &cost);
+
+	EXPECT_FALSE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+	EXPECT_GT(cost, 0.f);
+}
+
+TEST_F(NodePoolTest, ShrinkKeepsPoolWhenOutOfMemory)
+{
+	int pathCount = 0;
+	ASSERT_TRUE(dtStatusSucceed(FindPath(pathCount)));
+
+	const int grownNodes = m_query.getNodePool()->getMaxNodes();
+	ASSERT_GT(grownNodes, InitialNodes);
+
+	s_failAllocs = true;
+
+	dtStatus status = m_query.shrinkNodePool(InitialNodes);
+
+	s_failAllocs = false;
+
+	EXPECT_TRUE(dtStatusFailed(status));
+	EXPECT_TRUE(dtStatusDetail(status, DT_OUT_OF_MEMORY));
+	EXPECT_EQ(m_query.getNodePool()->getMaxNodes(), grownNodes);
+
+	// the query still works
+	status = FindPath(pathCount);
+	EXPECT_TRUE(dtStatusSucceed(status));
+	EXPECT_FALSE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+
+	// and shrinks once there is memory again
+	EXPECT_TRUE(dtStatusSucceed(m_query.shrinkNodePool(InitialNodes)));
+	EXPECT_EQ(m_query.getNodePool()->getMaxNodes(), InitialNodes);
+}
@@ -0,0 +1,156 @@
+//
+// PartialReloadTests.cpp
+//
+// Reloading only the tiles of a navmesh file that changed.
+//
+
+#include "TestMesh.h"
+
+#include "common/NavMeshData.h"
+
+#include <gtest/gtest.h>
+
+static int GetTileCount(const dtNavMesh& navMesh)
+{
+	int count = 0;
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (tile->header && tile->dataSize)
+			++count;
+	}
+
+	return count;
+}
+
+class PartialReloadTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		NavMesh& base = m_mesh.GetNavMesh();
+		ASSERT_FALSE(base.HasPendingTiles());
+		ASSERT_FALSE(base.GetTileHashes().empty());
+
+		const dtNavMesh& navMesh = *base.GetNavMesh();
+		m_changedRef = FindPolyRef(navMesh, m_filter, TestScene::GetFloorEnd());
+		m_unchangedRef = FindPolyRef(navMesh, m_filter, TestScene::GetFloorStart());
+		ASSERT_NE(m_changedRef, 0u);
+		ASSERT_NE(m_unchangedRef, 0u);
+		ASSERT_NE(navMesh.decodePolyIdTile(m_changedRef), navMesh.decodePolyIdTile(m_unchangedRef));
+
+		// the same file with one polygon disabled, the way an edit in the mesh generator
+		// changes one tile
+		m_changedFile = m_mesh.GetFileName() + ".changed";
+
+		NavMesh edited;
+		ASSERT_EQ(edited.LoadNavMeshFile(m_mesh.GetFileName()), NavMesh::LoadResult::Success);
+		ASSERT_FALSE(edited.HasPendingTiles());
+
+		unsigned short flags = 0;
+		ASSERT_TRUE(dtStatusSucceed(edited.GetNavMesh()->getPolyFlags(m_changedRef, &flags)));
+		edited.GetNavMesh()->setPolyFlags(m_changedRef, flags | +PolyFlags::Disabled);
+		ASSERT_TRUE(edited.SaveNavMeshFile(m_changedFile, NavMeshHeaderVersion::Latest));
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	dtQueryFilter m_filter;
+	dtPolyRef m_changedRef = 0;
+	dtPolyRef m_unchangedRef = 0;
+	std::string m_changedFile;
+};
+
+TEST_F(PartialReloadTest, OnlyChangedTileIsReplaced)
+{
+	NavMesh& base = m_mesh.GetNavMesh();
+	std::shared_ptr<dtNavMesh> navMesh = base.GetNavMesh();
+	const int tileCount = GetTileCount(*navMesh);
+
+	const dtMeshTile* unchangedTile = nullptr;
+	const dtPoly* poly = nullptr;
+	ASSERT_TRUE(dtStatusSucceed(navMesh->getTileAndPolyByRef(m_unchangedRef, &unchangedTile, &poly)));
+	const unsigned char* unchangedData = unchangedTile->data;
+
+	NavMesh loaded;
+	loaded.SetReloadBase(base);
+	ASSERT_EQ(loaded.LoadNavMeshFile(m_changedFile), NavMesh::LoadResult::Success);
+	ASSERT_TRUE(loaded.IsPartialLoad());
+	EXPECT_EQ(GetTileCount(*loaded.GetNavMesh()), 1);
+
+	const uint32_t generation = base.GetGeneration();
+	ASSERT_TRUE(base.MergeChangedTiles(loaded));
+	EXPECT_GT(base.GetGeneration(), generation);
+
+	// the same navmesh, with the tile of the disabled polygon swapped out
+	EXPECT_EQ(base.GetNavMesh(), navMesh);
+	EXPECT_EQ(GetTileCount(*navMesh), tileCount);
+
+	// and it matches the new file, so it can be reloaded against again
+	NavMesh full;
+	ASSERT_EQ(full.LoadNavMeshFile(m_changedFile), NavMesh::LoadResult::Success);
+	EXPECT_EQ(base.GetTileHashes(), full.GetTileHashes());
+
+	unsigned short flags = 0;
+	ASSERT_TRUE(dtStatusSucceed(navMesh->getPolyFlags(m_changedRef, &flags)));
+	EXPECT_TRUE(flags & +PolyFlags::Disabled);
+
+	// refs and tiles that didn't change are still there
+	const dtMeshTile* tile = nullptr;
+	ASSERT_TRUE(dtStatusSucceed(navMesh->getTileAndPolyByRef(m_unchangedRef, &tile, &poly)));
+	EXPECT_EQ(tile, unchangedTile);
+	EXPECT_EQ(tile->data, unchangedData);
+	ASSERT_TRUE(dtStatusSucceed(navMesh->getPolyFlags(m_unchangedRef, &flags)));
+	EXPECT_FALSE(flags & +PolyFlags::Disabled);
+
+	EXPECT_FALSE(loaded.IsNavMeshLoaded());
+}
+
+TEST_F(PartialReloadTest, ChangedBaseIsLeftAlone)
+{
+	// The base is reloaded while the changed tiles are being read, so they were picked
+	// against tiles that it doesn't have anymore. The loader loads all tiles instead.
+	NavMesh& base = m_mesh.GetNavMesh();
+	const NavMesh::TileHashMap baseHashes = base.GetTileHashes();
+
+	NavMesh loaded;
+	loaded.SetReloadBase(base);
+	ASSERT_EQ(loaded.LoadNavMeshFile(m_changedFile), NavMesh::LoadResult::Success);
+	ASSERT_TRUE(loaded.IsPartialLoad());
+
+	ASSERT_EQ(base.LoadNavMeshFile(m_changedFile), NavMesh::LoadResult::Success);
+	ASSERT_NE(base.GetTileHashes(), baseHashes);
+
+	std::shared_ptr<dtNavMesh> navMesh = base.GetNavMesh();
+	const NavMesh::TileHashMap hashes = base.GetTileHashes();
+	const uint32_t generation = base.GetGeneration();
+
+	EXPECT_FALSE(base.MergeChangedTiles(loaded));
+	EXPECT_EQ(base.GetNavMesh(), navMesh);
+	EXPECT_EQ(base.GetTileHashes(), hashes);
+	EXPECT_EQ(base.GetGeneration(), generation);
+	EXPECT_TRUE(loaded.IsNavMeshLoaded());
+
+	// without a base, every tile is loaded
+	NavMesh reloaded;
+	ASSERT_EQ(reloaded.LoadNavMeshFile(m_changedFile), NavMesh::LoadResult::Success);
+	EXPECT_FALSE(reloaded.IsPartialLoad());
+	EXPECT_EQ(GetTileCount(*reloaded.GetNavMesh()), GetTileCount(*navMesh));
+}
+
+TEST_F(PartialReloadTest, DifferentParamsLoadAllTiles)
+{
+	// a base with different navmesh params can't take the tiles of the file
+	TestMesh otherMesh;
+	TestGeometry geometry;
+	geometry.AddFloor(0.f, 0.f, 50.f, 50.f);
+	ASSERT_TRUE(otherMesh.Build(geometry));
+
+	NavMesh loaded;
+	loaded.SetReloadBase(otherMesh.GetNavMesh());
+	ASSERT_EQ(loaded.LoadNavMeshFile(m_changedFile), NavMesh::LoadResult::Success);
+	EXPECT_FALSE(loaded.IsPartialLoad());
+	EXPECT_FALSE(otherMesh.GetNavMesh().MergeChangedTiles(loaded));
+}
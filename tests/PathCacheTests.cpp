@@ -0,0 +1,166 @@
+//
+// PathCacheTests.cpp
+//
+
+#include "TestMesh.h"
+
+#include "common/PathCache.h"
+#include "common/PathPlanner.h"
+
+#include <gtest/gtest.h>
+
+static void ExpectSamePath(const StraightPath& a, const StraightPath& b)
+{
+	ASSERT_EQ(a.length, b.length);
+
+	for (int i = 0; i < a.length; ++i)
+	{
+		EXPECT_EQ(a.verts[i], b.verts[i]);
+		EXPECT_EQ(a.polys[i], b.polys[i]);
+	}
+}
+
+class PathCacheTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_cached.SetPathCache(&m_cache);
+		m_cached.SetNavMesh(&m_mesh.GetNavMesh());
+		m_uncached.SetNavMesh(&m_mesh.GetNavMesh());
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	PathCache m_cache;
+	PathPlanner m_cached;
+	PathPlanner m_uncached;
+};
+
+TEST_F(PathCacheTest, HitGivesSamePath)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	StraightPath expected, first, second;
+	ASSERT_EQ(m_uncached.FindPath(start, end, expected), PathResult::Success);
+	ASSERT_EQ(m_cached.FindPath(start, end, first), PathResult::Success);
+	ASSERT_EQ(m_cached.FindPath(start, end, second), PathResult::Success);
+
+	EXPECT_EQ(m_cache.GetStats().misses, 1u);
+	EXPECT_EQ(m_cache.GetStats().hits, 1u);
+
+	ExpectSamePath(first, expected);
+	ExpectSamePath(second, expected);
+}
+
+TEST_F(PathCacheTest, HitIsRebuiltForNewPositions)
+{
+	// a bit further along, but on the same polygons
+	glm::vec3 start = TestScene::GetFloorStart();
+	glm::vec3 end = TestScene::GetFloorEnd();
+	glm::vec3 offset(0.2f, 0.f, 0.2f);
+
+	StraightPath path, expected;
+	ASSERT_EQ(m_cached.FindPath(start, end, path), PathResult::Success);
+	ASSERT_EQ(m_cached.FindPath(start + offset, end + offset, path), PathResult::Success);
+	ASSERT_EQ(m_cache.GetStats().hits, 1u);
+
+	ASSERT_EQ(m_uncached.FindPath(start + offset, end + offset, expected), PathResult::Success);
+	ExpectSamePath(path, expected);
+}
+
+TEST_F(PathCacheTest, NavMeshChangeMissesCache)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	StraightPath before;
+	ASSERT_EQ(m_cached.FindPath(start, end, before), PathResult::Success);
+
+	// Same tiles, but with a pillar in the way of the first path. The cache isn't
+	// cleared, so only the generation keeps the old corridor from being used.
+	TestScene changed;
+	changed.geometry.AddBox({ 70.f, 0.f, 80.f }, { 80.f, 20.f, 100.f });
+
+	TestMesh changedMesh;
+	ASSERT_TRUE(changedMesh.Build(changed.geometry));
+
+	uint32_t generation = m_mesh.GetNavMesh().GetGeneration();
+	ASSERT_EQ(m_mesh.GetNavMesh().LoadNavMeshFile(changedMesh.GetFileName()), NavMesh::LoadResult::Success);
+	ASSERT_NE(m_mesh.GetNavMesh().GetGeneration(), generation);
+
+	m_cached.SetNavMesh(&m_mesh.GetNavMesh());
+	m_uncached.SetNavMesh(&m_mesh.GetNavMesh());
+
+	StraightPath after, expected;
+	ASSERT_EQ(m_cached.FindPath(start, end, after), PathResult::Success);
+	ASSERT_EQ(m_uncached.FindPath(start, end, expected), PathResult::Success);
+
+	EXPECT_EQ(m_cache.GetStats().hits, 0u);
+	EXPECT_EQ(m_cache.GetStats().misses, 2u);
+	EXPECT_GT(expected.GetLength(), before.GetLength());
+	ExpectSamePath(after, expected);
+}
+
+TEST_F(PathCacheTest, ClearedWhenNavMeshChanges)
+{
+	// the plugin clears its cache when the navmesh changes
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+	auto conn = navMesh.OnNavMeshChanged.Connect([&]()
+	{
+		m_cache.Clear();
+		m_cached.SetNavMesh(&navMesh);
+	});
+
+	StraightPath path;
+	ASSERT_EQ(m_cached.FindPath(TestScene::GetFloorStart(), TestScene::GetFloorEnd(), path), PathResult::Success);
+	ASSERT_EQ(m_cache.GetSize(), 1u);
+
+	ASSERT_EQ(navMesh.LoadNavMeshFile(m_mesh.GetFileName()), NavMesh::LoadResult::Success);
+
+	EXPECT_EQ(m_cache.GetSize(), 0u);
+	EXPECT_EQ(m_cache.GetStats().invalidations, 1u);
+}
+
+TEST(PathCache, KeysIncludeFilterAndGeneration)
+{
+	PathCache cache;
+	const dtPolyRef polys[] = { 1, 2, 3 };
+
+	dtQueryFilter filter;
+	dtQueryFilter costly;
+	costly.setAreaCost(1, 10.f);
+
+	ASSERT_NE(PathCache::HashFilter(filter), PathCache::HashFilter(costly));
+
+	PathCache::Key key{ 1, 3, PathCache::HashFilter(filter), 7 };
+	cache.Insert(key, PathResult::Success, polys, 3);
+
+	EXPECT_NE(cache.Find(key), nullptr);
+	EXPECT_EQ(cache.Find({ 1, 3, PathCache::HashFilter(costly), 7 }), nullptr);
+	EXPECT_EQ(cache.Find({ 1, 3, PathCache::HashFilter(filter), 8 }), nullptr);
+	EXPECT_EQ(cache.Find({ 3, 1, PathCache::HashFilter(filter), 7 }), nullptr);
+}
+
+TEST(PathCache, EvictsLeastRecentlyUsed)
+{
+	PathCache cache(2);
+	const dtPolyRef polys[] = { 1, 2 };
+
+	cache.Insert({ 1, 2, 0, 0 }, PathResult::Success, polys, 2);
+	cache.Insert({ 2, 1, 0, 0 }, PathResult::Success, polys, 2);
+
+	// use the first, so that the second is the oldest
+	EXPECT_NE(cache.Find({ 1, 2, 0, 0 }), nullptr);
+
+	cache.Insert({ 3, 1, 0, 0 }, PathResult::Success, polys, 2);
+
+	EXPECT_EQ(cache.GetSize(), 2u);
+	EXPECT_EQ(cache.GetStats().evictions, 1u);
+	EXPECT_NE(cache.Find({ 1, 2, 0, 0 }), nullptr);
+	EXPECT_EQ(cache.Find({ 2, 1, 0, 0 }), nullptr);
+	EXPECT_NE(cache.Find({ 3, 1, 0, 0 }), nullptr);
+}
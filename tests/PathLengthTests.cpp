@@ -0,0 +1,183 @@
+//
+// PathLengthTests.cpp
+//
+// FindPathLengths and findCostsToPolys against a findPath per target.
+//
+
+#include "TestMesh.h"
+
+#include "common/PathPlanner.h"
+
+#include <DetourNavMesh.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+class PathLengthTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_planner.SetNavMesh(&m_mesh.GetNavMesh());
+		m_navMesh = m_mesh.GetNavMesh().GetNavMesh();
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	PathPlanner m_planner;
+	std::shared_ptr<dtNavMesh> m_navMesh;
+};
+
+TEST_F(PathLengthTest, LengthsMatchSeparateSearches)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+
+	std::vector<glm::vec3> targets = GetRandomPoints(*m_navMesh, 100, 1);
+	targets.push_back(TestScene::GetRoomCenter());
+	targets.push_back(TestScene::GetBlockTop());
+	targets.push_back(TestScene::GetOffMesh());
+
+	std::vector<float> lengths(targets.size());
+	ASSERT_EQ(m_planner.FindPathLengths(start, targets.data(), static_cast<int>(targets.size()), lengths.data()),
+		PathResult::Success);
+
+	int reached = 0;
+	float totalDifference = 0.f;
+
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		SCOPED_TRACE(testing::Message() << "target " << i);
+
+		DetourPath expected = FindDetourPath(*m_navMesh, m_planner.GetFilter(), start, targets[i]);
+		if (!expected.IsComplete())
+		{
+			EXPECT_EQ(lengths[i], -1.f);
+			continue;
+		}
+
+		ASSERT_GE(lengths[i], 0.f);
+
+		// Both searches fix a polygon's position at the middle of the edge it is first
+		// reached through. findPath reaches polygons in order of cost plus distance to the
+		// end, the single search in order of cost, so where a polygon has long edges they
+		// can take slightly different corridors. Neither is always the shorter one.
+		float difference = (lengths[i] - expected.GetLength()) / std::max(expected.GetLength(), 1.f);
+		EXPECT_LT(std::abs(difference), 0.2f) << lengths[i] << " vs " << expected.GetLength();
+
+		totalDifference += std::abs(difference);
+		++reached;
+	}
+
+	EXPECT_GT(reached, 50);
+	EXPECT_LT(totalDifference / reached, 0.02f);
+	EXPECT_EQ(lengths[targets.size() - 3], -1.f);
+	EXPECT_EQ(lengths[targets.size() - 2], -1.f);
+	EXPECT_EQ(lengths[targets.size() - 1], -1.f);
+}
+
+TEST_F(PathLengthTest, MaxCostLeavesFarTargets)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+	std::vector<glm::vec3> targets = GetRandomPoints(*m_navMesh, 50, 2);
+
+	std::vector<float> all(targets.size());
+	ASSERT_EQ(m_planner.FindPathLengths(start, targets.data(), static_cast<int>(targets.size()), all.data()),
+		PathResult::Success);
+
+	const float maxCost = 150.f;
+	std::vector<float> near(targets.size());
+	ASSERT_EQ(m_planner.FindPathLengths(start, targets.data(), static_cast<int>(targets.size()), near.data(),
+		maxCost), PathResult::Success);
+
+	int left = 0;
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		if (near[i] < 0.f)
+		{
+			++left;
+			continue;
+		}
+
+		// the ones that are reached get the same length either way
+		EXPECT_FLOAT_EQ(near[i], all[i]);
+	}
+
+	EXPECT_GT(left, 0);
+	EXPECT_LT(left, static_cast<int>(targets.size()));
+}
+
+TEST_F(PathLengthTest, NoStartPoly)
+{
+	glm::vec3 target = TestScene::GetFloorEnd();
+	float length = 0.f;
+
+	EXPECT_EQ(m_planner.FindPathLengths(TestScene::GetOffMesh(), &target, 1, &length), PathResult::NoStartPoly);
+	EXPECT_EQ(length, -1.f);
+}
+
+TEST_F(PathLengthTest, CostsAndCorridorsMatchFindPath)
+{
+	dtNavMeshQuery query;
+	ASSERT_TRUE(dtStatusSucceed(query.init(m_navMesh.get(), 65535)));
+
+	const dtQueryFilter& filter = m_planner.GetFilter();
+	const float extents[3] = { 5.f, 10.f, 5.f };
+
+	glm::vec3 start = TestScene::GetFloorStart();
+	dtPolyRef startRef = 0;
+	glm::vec3 spos;
+	query.findNearestPoly(&start[0], extents, &filter, &startRef, &spos[0]);
+	ASSERT_NE(startRef, 0u);
+
+	std::vector<glm::vec3> targets = GetRandomPoints(*m_navMesh, 50, 3);
+	targets.push_back(TestScene::GetRoomCenter());
+
+	std::vector<dtPolyRef> targetRefs(targets.size());
+	std::vector<float> costs(targets.size());
+	for (size_t i = 0; i < targets.size(); ++i)
+		query.findNearestPoly(&targets[i][0], extents, &filter, &targetRefs[i], nullptr);
+
+	dtStatus status = query.findCostsToPolys(startRef, &spos[0], targetRefs.data(),
+		static_cast<int>(targets.size()), FLT_MAX, &filter, costs.data());
+	ASSERT_TRUE(dtStatusSucceed(status));
+
+	// the room can't be reached
+	EXPECT_TRUE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+	EXPECT_EQ(costs.back(), -1.f);
+
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		SCOPED_TRACE(testing::Message() << "target " << i);
+
+		DetourPath expected = FindDetourPath(*m_navMesh, filter, start, targets[i]);
+		ASSERT_EQ(costs[i] >= 0.f, expected.IsComplete());
+
+		if (costs[i] < 0.f)
+			continue;
+
+		// the corridor leads from the start to the target along links between polygons
+		dtPolyRef corridor[1024];
+		int numPolys = 0;
+		ASSERT_TRUE(dtStatusSucceed(query.getPathFromDijkstraSearch(targetRefs[i], corridor, &numPolys, 1024)));
+		ASSERT_GT(numPolys, 0);
+		EXPECT_EQ(corridor[0], startRef);
+		EXPECT_EQ(corridor[numPolys - 1], targetRefs[i]);
+
+		for (int j = 1; j < numPolys; ++j)
+		{
+			const dtMeshTile* tile = nullptr;
+			const dtPoly* poly = nullptr;
+			m_navMesh->getTileAndPolyByRefUnsafe(corridor[j - 1], &tile, &poly);
+
+			bool linked = false;
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+				linked |= tile->links[k].ref == corridor[j];
+
+			EXPECT_TRUE(linked) << "polygons " << j - 1 << " and " << j;
+		}
+	}
+}
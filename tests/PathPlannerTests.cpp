@@ -0,0 +1,346 @@
+//
+// PathPlannerTests.cpp
+//
+
+#include "TestMesh.h"
+
+#include "common/NavMeshData.h"
+#include "common/PathPlanner.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+class PathPlannerTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_planner.SetNavMesh(&m_mesh.GetNavMesh());
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	PathPlanner m_planner;
+};
+
+TEST_F(PathPlannerTest, FindPathSucceeds)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	StraightPath path;
+	ASSERT_EQ(m_planner.FindPath(start, end, path), PathResult::Success);
+	ASSERT_GE(path.length, 2);
+
+	EXPECT_LT(glm::distance(path.verts[0], start), 1.f);
+	EXPECT_LT(glm::distance(path.verts[path.length - 1], end), 1.f);
+
+	// the walls are in the way, so it has to wind around them
+	EXPECT_GT(path.GetLength(), glm::distance(start, end) * 1.5f);
+}
+
+TEST_F(PathPlannerTest, FindPathToClosedRoomIsPartial)
+{
+	StraightPath path;
+	EXPECT_EQ(m_planner.FindPath(TestScene::GetFloorStart(), TestScene::GetRoomCenter(), path),
+		PathResult::Partial);
+}
+
+TEST_F(PathPlannerTest, FindPathToUnreachableBlockIsPartial)
+{
+	StraightPath path;
+	EXPECT_EQ(m_planner.FindPath(TestScene::GetBlockBase(), TestScene::GetBlockTop(), path),
+		PathResult::Partial);
+}
+
+TEST_F(PathPlannerTest, FindPathWithoutStartPoly)
+{
+	StraightPath path;
+	EXPECT_EQ(m_planner.FindPath(TestScene::GetOffMesh(), TestScene::GetFloorEnd(), path),
+		PathResult::NoStartPoly);
+}
+
+TEST_F(PathPlannerTest, FindPathWithoutEndPoly)
+{
+	StraightPath path;
+	EXPECT_EQ(m_planner.FindPath(TestScene::GetFloorStart(), TestScene::GetOffMesh(), path),
+		PathResult::NoEndPoly);
+}
+
+TEST_F(PathPlannerTest, UpdatePathFollowsCorridor)
+{
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	StraightPath path;
+	ASSERT_EQ(m_planner.FindPath(TestScene::GetFloorStart(), end, path), PathResult::Success);
+	ASSERT_GE(path.length, 3);
+
+	// Walking towards the first corner only trims the front of the corridor, so the path
+	// stays the same. Shortcuts that the corridor finds on the way change it.
+	glm::vec3 pos = path.verts[0];
+	const glm::vec3 corner = path.verts[1];
+	int unchanged = 0, changed = 0;
+
+	while (glm::distance(pos, corner) > 3.f)
+	{
+		pos += glm::normalize(corner - pos);
+
+		const glm::vec3 first = path.verts[0];
+		PathResult result = m_planner.UpdatePath(pos, end, path);
+
+		if (result == PathResult::Unchanged)
+		{
+			EXPECT_EQ(path.verts[0], first);
+			++unchanged;
+		}
+		else
+		{
+			ASSERT_EQ(result, PathResult::Success);
+			EXPECT_LT(glm::distance(path.verts[0], pos), 1.f);
+			EXPECT_LT(glm::distance(path.verts[path.length - 1], end), 1.f);
+			++changed;
+		}
+	}
+
+	EXPECT_GT(unchanged, 50);
+	EXPECT_GT(unchanged, changed * 5);
+
+	// the same spot again is unchanged, once the corridor has settled
+	m_planner.UpdatePath(pos, end, path);
+	EXPECT_EQ(m_planner.UpdatePath(pos, end, path), PathResult::Unchanged);
+
+	// moving the end moves the target of the corridor
+	end += glm::vec3(-5.f, 0.f, 5.f);
+	ASSERT_EQ(m_planner.UpdatePath(pos, end, path), PathResult::Success);
+	EXPECT_LT(glm::distance(path.verts[path.length - 1], end), 1.f);
+}
+
+TEST_F(PathPlannerTest, UpdatePathReplansOffCorridor)
+{
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	StraightPath path;
+	ASSERT_EQ(m_planner.FindPath(TestScene::GetFloorStart(), end, path), PathResult::Success);
+
+	// across two walls from the start, where the corridor can't follow along the surface
+	const glm::vec3 teleport{ 70.f, 0.f, 100.f };
+	ASSERT_EQ(m_planner.UpdatePath(teleport, end, path), PathResult::Success);
+	EXPECT_LT(glm::distance(path.verts[0], teleport), 1.f);
+	EXPECT_LT(glm::distance(path.verts[path.length - 1], end), 1.f);
+
+	const dtNavMesh& navMesh = *m_planner.GetNavMesh();
+	ASSERT_GT(m_planner.GetCorridorPathCount(), 0);
+	EXPECT_EQ(m_planner.GetCorridorPath()[0], FindPolyRef(navMesh, m_planner.GetFilter(), teleport));
+
+	m_planner.UpdatePath(teleport, end, path);
+	EXPECT_EQ(m_planner.UpdatePath(teleport, end, path), PathResult::Unchanged);
+}
+
+TEST_F(PathPlannerTest, UpdatePathReplansInvalidCorridor)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	StraightPath path;
+	ASSERT_EQ(m_planner.FindPath(start, end, path), PathResult::Success);
+	m_planner.UpdatePath(start, end, path);
+	ASSERT_EQ(m_planner.UpdatePath(start, end, path), PathResult::Unchanged);
+
+	// disabling a polygon a little way along the corridor makes it invalid
+	ASSERT_GT(m_planner.GetCorridorPathCount(), 10);
+	dtPolyRef disabled = m_planner.GetCorridorPath()[6];
+
+	dtNavMesh& navMesh = *m_planner.GetNavMesh();
+	unsigned short flags = 0;
+	ASSERT_TRUE(dtStatusSucceed(navMesh.getPolyFlags(disabled, &flags)));
+	navMesh.setPolyFlags(disabled, flags | +PolyFlags::Disabled);
+
+	ASSERT_EQ(m_planner.UpdatePath(start, end, path), PathResult::Success);
+	EXPECT_LT(glm::distance(path.verts[path.length - 1], end), 1.f);
+
+	const dtPolyRef* polys = m_planner.GetCorridorPath();
+	const int numPolys = m_planner.GetCorridorPathCount();
+	EXPECT_EQ(std::find(polys, polys + numPolys, disabled), polys + numPolys);
+}
+
+// Runs a sliced search to the end a few iterations at a time, the way the plugin does.
+static PathResult FinishSlicedPath(PathPlanner& planner, int iterations, StraightPath& path, int& calls)
+{
+	PathResult result = PathResult::InProgress;
+	for (calls = 0; result == PathResult::InProgress && calls < 100000; ++calls)
+	{
+		result = planner.ContinuePath(iterations, path);
+	}
+
+	return result;
+}
+
+static std::vector<dtPolyRef> GetCorridor(const PathPlanner& planner)
+{
+	return { planner.GetCorridorPath(), planner.GetCorridorPath() + planner.GetCorridorPathCount() };
+}
+
+TEST_F(PathPlannerTest, SlicedPathMatchesFindPath)
+{
+	const dtNavMesh& navMesh = *m_mesh.GetNavMesh().GetNavMesh();
+
+	// Around the first wall, which is searched directly because the ends are only a few
+	// tiles apart, and from one corner to the other, which follows the tile graph.
+	const std::pair<glm::vec3, glm::vec3> paths[] = {
+		{ TestScene::GetFloorStart(), { 70.f, 0.f, 120.f } },
+		{ TestScene::GetFloorStart(), TestScene::GetFloorEnd() },
+	};
+
+	for (const auto& [start, end] : paths)
+	{
+		SCOPED_TRACE(testing::Message() << "to " << end.x << ", " << end.z);
+
+		int startX, startZ, endX, endZ;
+		navMesh.calcTileLoc(&start.x, &startX, &startZ);
+		navMesh.calcTileLoc(&end.x, &endX, &endZ);
+		const bool route = std::max(std::abs(startX - endX), std::abs(startZ - endZ)) >= 6;
+		EXPECT_EQ(route, &end == &paths[1].second);
+
+		StraightPath expected;
+		ASSERT_EQ(m_planner.FindPath(start, end, expected), PathResult::Success);
+		const std::vector<dtPolyRef> expectedPolys = GetCorridor(m_planner);
+
+		// the whole search in one call, or one call per window of the route
+		PathPlanner whole;
+		whole.SetNavMesh(&m_mesh.GetNavMesh());
+		ASSERT_EQ(whole.BeginPath(start, end), PathResult::InProgress);
+
+		int wholeCalls = 0;
+		StraightPath wholePath;
+		ASSERT_EQ(FinishSlicedPath(whole, 1 << 20, wholePath, wholeCalls), PathResult::Success);
+		if (route)
+			EXPECT_GT(wholeCalls, 1);
+		else
+			EXPECT_EQ(wholeCalls, 1);
+		const std::vector<dtPolyRef> wholePolys = GetCorridor(whole);
+
+		// Detour's sliced search keeps one node per polygon, where findPath keeps one for
+		// each side of a tile it is entered from, so they can settle ties differently. The
+		// path is as long, between the same polygons.
+		ASSERT_FALSE(wholePolys.empty());
+		EXPECT_EQ(wholePolys.front(), expectedPolys.front());
+		EXPECT_EQ(wholePolys.back(), expectedPolys.back());
+		EXPECT_NEAR(wholePath.GetLength(), expected.GetLength(), expected.GetLength() * 0.01f);
+		EXPECT_EQ(wholePath.verts[wholePath.length - 1], expected.verts[expected.length - 1]);
+
+		auto expectSameAsWhole = [&](const PathPlanner& planner, const StraightPath& path)
+		{
+			EXPECT_EQ(GetCorridor(planner), wholePolys);
+
+			ASSERT_EQ(path.length, wholePath.length);
+			for (int i = 0; i < path.length; ++i)
+			{
+				EXPECT_EQ(path.verts[i], wholePath.verts[i]);
+			}
+		};
+
+		// a few iterations at a time gets to the same path
+		PathPlanner sliced;
+		sliced.SetNavMesh(&m_mesh.GetNavMesh());
+		ASSERT_EQ(sliced.BeginPath(start, end), PathResult::InProgress);
+		EXPECT_TRUE(sliced.IsPathInProgress());
+
+		int calls = 0;
+		StraightPath path;
+		ASSERT_EQ(FinishSlicedPath(sliced, 4, path, calls), PathResult::Success);
+		EXPECT_GT(calls, wholeCalls * 2);
+		EXPECT_FALSE(sliced.IsPathInProgress());
+		expectSameAsWhole(sliced, path);
+
+		// UpdatePath starts the same search when there is no path to follow yet, and
+		// returns InProgress until it is done
+		PathPlanner updated;
+		updated.SetNavMesh(&m_mesh.GetNavMesh());
+		updated.SetSliceIterations(4);
+
+		StraightPath updatedPath;
+		ASSERT_EQ(updated.UpdatePath(start, end, updatedPath), PathResult::InProgress);
+		EXPECT_EQ(updated.UpdatePath(start, end, updatedPath), PathResult::InProgress);
+		ASSERT_EQ(FinishSlicedPath(updated, 4, updatedPath, calls), PathResult::Success);
+		expectSameAsWhole(updated, updatedPath);
+
+		// and then follows it
+		EXPECT_EQ(updated.UpdatePath(start, end, updatedPath), PathResult::Unchanged);
+	}
+}
+
+TEST_F(PathPlannerTest, SlicedPathToUnreachableEndIsPartial)
+{
+	// the same as FindPath, before any searching is done
+	EXPECT_EQ(m_planner.BeginPath(TestScene::GetFloorStart(), TestScene::GetRoomCenter()), PathResult::Partial);
+	EXPECT_FALSE(m_planner.IsPathInProgress());
+
+	EXPECT_EQ(m_planner.BeginPath(TestScene::GetOffMesh(), TestScene::GetFloorEnd()), PathResult::NoStartPoly);
+	EXPECT_EQ(m_planner.BeginPath(TestScene::GetFloorStart(), TestScene::GetOffMesh()), PathResult::NoEndPoly);
+}
+
+// A slab over the floor, low enough that both are within the search extents of a
+// position between them.
+class StackedFloorsTest : public ::testing::Test
+{
+protected:
+	static constexpr float SlabHeight = 9.f;
+
+	void SetUp() override
+	{
+		TestGeometry geometry;
+		geometry.AddFloor(0.f, 0.f, 160.f, 160.f);
+		geometry.AddBox({ 20.f, SlabHeight - 2.f, 20.f }, { 140.f, SlabHeight, 140.f });
+
+		ASSERT_TRUE(m_mesh.Build(geometry));
+		m_planner.SetNavMesh(&m_mesh.GetNavMesh());
+	}
+
+	TestMesh m_mesh;
+	PathPlanner m_planner;
+};
+
+TEST_F(StackedFloorsTest, StartPolyStaysOnWalkedLevel)
+{
+	// Under the slab, a position half way up is nearer to the slab than to the floor,
+	// the way it can be while jumping.
+	const glm::vec3 underSlab{ 60.f, 5.f, 80.f };
+
+	glm::vec3 nearest;
+	ASSERT_NE(m_planner.FindNearestPoly(underSlab, &nearest), 0u);
+	ASSERT_NEAR(nearest.y, SlabHeight, 1.f);
+
+	// walking in from the side keeps to the floor
+	glm::vec3 pos{ 10.f, 0.f, 80.f };
+	ASSERT_NE(m_planner.FindStartPoly(pos, &nearest), 0u);
+	EXPECT_NEAR(nearest.y, 0.f, 1.f);
+
+	for (; pos.x < 130.f; pos.x += 2.f)
+	{
+		pos.y = pos.x > 25.f ? underSlab.y : 0.f;
+
+		dtPolyRef ref = m_planner.FindStartPoly(pos, &nearest);
+		ASSERT_NE(ref, 0u);
+		EXPECT_NEAR(nearest.y, 0.f, 1.f) << "at " << pos.x;
+		EXPECT_LT(glm::distance(glm::vec2(nearest.x, nearest.z), glm::vec2(pos.x, pos.z)), 0.1f);
+
+		float height = 0.f;
+		m_planner.GetNavMeshQuery()->getPolyHeight(ref, glm::value_ptr(pos), &height);
+		EXPECT_NEAR(height, 0.f, 1.f) << "at " << pos.x;
+	}
+
+	// Moving more than 50 units at once is taken as a teleport, even along the floor, and
+	// the extents are searched again.
+	ASSERT_NE(m_planner.FindStartPoly(underSlab, &nearest), 0u);
+	EXPECT_NEAR(nearest.y, SlabHeight, 1.f);
+
+	// which then keeps to the slab
+	for (pos = underSlab; pos.x < 120.f; pos.x += 2.f)
+	{
+		ASSERT_NE(m_planner.FindStartPoly(pos, &nearest), 0u);
+		EXPECT_NEAR(nearest.y, SlabHeight, 1.f) << "at " << pos.x;
+	}
+}
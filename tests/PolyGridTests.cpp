@@ -0,0 +1,183 @@
+//
+// PolyGridTests.cpp
+//
+// Heights from the polygon grid against the tile searches of detour.
+//
+
+#include "TestMesh.h"
+
+#include "common/PolyGrid.h"
+
+#include <DetourNavMeshQuery.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+// Heights the way NavMesh::GetHeights finds them without the grid.
+static std::vector<float> GetDetourHeights(const dtNavMeshQuery& query, const glm::vec3& pos, const float* extents)
+{
+	dtQueryFilter filter;
+	dtPolyRef polys[128];
+	int polyCount = 0;
+	query.queryPolygons(glm::value_ptr(pos), extents, &filter, polys, &polyCount, 128);
+
+	// the first polygon of a tile can be found twice, by the unused nodes of its tree
+	std::sort(polys, polys + polyCount);
+	polyCount = static_cast<int>(std::unique(polys, polys + polyCount) - polys);
+
+	std::vector<float> heights;
+	for (int i = 0; i < polyCount; ++i)
+	{
+		float height;
+		if (dtStatusSucceed(query.getPolyHeight(polys[i], glm::value_ptr(pos), &height)))
+			heights.push_back(height);
+	}
+
+	std::sort(heights.begin(), heights.end());
+	return heights;
+}
+
+// Floors at three levels over each other, so that a position has up to three heights,
+// and the ones far above or below it are out of reach.
+class PolyGridTest : public ::testing::Test
+{
+protected:
+	static constexpr float MiddleHeight = 30.f;
+	static constexpr float TopHeight = 100.f;
+
+	void SetUp() override
+	{
+		TestGeometry geometry;
+		geometry.AddFloor(0.f, 0.f, 60.f, 60.f);
+		geometry.AddFloor(10.f, 10.f, 50.f, 50.f, MiddleHeight);
+		geometry.AddFloor(20.f, 20.f, 40.f, 40.f, TopHeight);
+
+		ASSERT_TRUE(m_mesh.Build(geometry));
+	}
+
+	// positions across the floors and around them, at heights from below the bottom
+	// floor to above the top one
+	std::vector<glm::vec3> GetPositions() const
+	{
+		std::vector<glm::vec3> positions;
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> offset(0.f, 1.f);
+
+		for (float x = -2.f; x <= 62.f; x += 1.3f)
+		{
+			for (float z = -2.f; z <= 62.f; z += 1.7f)
+			{
+				for (float y : { -150.f, -90.f, -20.f, 0.f, 15.f, 30.f, 65.f, 100.f, 130.f, 150.f, 250.f })
+				{
+					positions.push_back({ x + offset(random), y, z + offset(random) });
+				}
+			}
+		}
+
+		return positions;
+	}
+
+	TestMesh m_mesh;
+};
+
+TEST_F(PolyGridTest, HeightsMatchWithGridOff)
+{
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+	ASSERT_FALSE(navMesh.IsPolyGridEnabled());
+
+	std::vector<glm::vec3> positions = GetPositions();
+	std::vector<std::vector<float>> expected;
+	for (const glm::vec3& pos : positions)
+		expected.push_back(navMesh.GetHeights(pos));
+
+	navMesh.SetPolyGridEnabled(true);
+	ASSERT_NE(navMesh.GetPolyGrid(), nullptr);
+
+	int stacked = 0;
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		EXPECT_EQ(navMesh.GetHeights(positions[i]), expected[i])
+			<< "at " << positions[i].x << ", " << positions[i].y << ", " << positions[i].z;
+
+		if (expected[i].size() == 3)
+			++stacked;
+	}
+
+	EXPECT_GT(stacked, 100);
+}
+
+TEST_F(PolyGridTest, FarHeightsAreLeftOut)
+{
+	// Heights are found within the height of the navmesh above and below the position,
+	// which is a bit more than the distance from the bottom floor to the top one.
+	NavMesh& navMesh = m_mesh.GetNavMesh();
+
+	for (bool grid : { false, true })
+	{
+		SCOPED_TRACE(grid ? "with grid" : "without grid");
+		navMesh.SetPolyGridEnabled(grid);
+
+		std::vector<float> heights = navMesh.GetHeights({ 30.f, 50.f, 30.f });
+		ASSERT_EQ(heights.size(), 3u);
+		EXPECT_NEAR(heights[0], 0.f, 1.f);
+		EXPECT_NEAR(heights[1], MiddleHeight, 1.f);
+		EXPECT_NEAR(heights[2], TopHeight, 1.f);
+
+		heights = navMesh.GetHeights({ 30.f, 150.f, 30.f });
+		ASSERT_EQ(heights.size(), 1u);
+		EXPECT_NEAR(heights[0], TopHeight, 1.f);
+
+		heights = navMesh.GetHeights({ 30.f, -90.f, 30.f });
+		ASSERT_EQ(heights.size(), 1u);
+		EXPECT_NEAR(heights[0], 0.f, 1.f);
+	}
+}
+
+TEST(PolyGrid, HeightsMatchQueryPolygons)
+{
+	TestScene scene;
+	TestMesh mesh;
+	ASSERT_TRUE(mesh.Build(scene.geometry));
+
+	const dtNavMesh& navMesh = *mesh.GetNavMesh().GetNavMesh();
+	dtNavMeshQuery query;
+	ASSERT_TRUE(dtStatusSucceed(query.init(&navMesh, 2048)));
+
+	std::vector<glm::vec3> positions = GetRandomPoints(navMesh, 500, 11);
+	for (size_t i = 0; i < 500; ++i)
+	{
+		positions.push_back({ (i % 25) * 8.3f, (i % 7) * 10.f - 20.f, (i / 25) * 10.1f });
+	}
+
+	// with cells smaller and larger than the polygons, and a short box that leaves out
+	// the top of the block
+	const float extentsList[2][3] = { { 1.f, 50.f, 1.f }, { 2.f, 10.f, 2.f } };
+
+	for (float cellSize : { 0.f, 3.f, 50.f })
+	{
+		PolyGrid grid;
+		grid.Build(navMesh, cellSize);
+		ASSERT_FALSE(grid.IsEmpty());
+
+		for (const float* extents : extentsList)
+		{
+			int found = 0;
+			for (const glm::vec3& pos : positions)
+			{
+				std::vector<float> heights;
+				dtQueryFilter filter;
+				grid.GetHeights(query, glm::value_ptr(pos), extents, filter, heights);
+				std::sort(heights.begin(), heights.end());
+
+				EXPECT_EQ(heights, GetDetourHeights(query, pos, extents))
+					<< "cell size " << cellSize << " at " << pos.x << ", " << pos.y << ", " << pos.z;
+
+				found += heights.empty() ? 0 : 1;
+			}
+
+			EXPECT_GT(found, 500);
+		}
+	}
+}
@@ -0,0 +1,411 @@
+//
+// TestMesh.cpp
+//
+
+#include "TestMesh.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshBuilder.h>
+#include <Recast.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace fs = std::filesystem;
+
+//----------------------------------------------------------------------------
+
+int TestGeometry::AddVertex(float x, float y, float z)
+{
+	verts.push_back(x);
+	verts.push_back(y);
+	verts.push_back(z);
+
+	return static_cast<int>(verts.size() / 3) - 1;
+}
+
+void TestGeometry::AddFloor(float minX, float minZ, float maxX, float maxZ, float y)
+{
+	int a = AddVertex(minX, y, minZ);
+	int b = AddVertex(maxX, y, minZ);
+	int c = AddVertex(maxX, y, maxZ);
+	int d = AddVertex(minX, y, maxZ);
+
+	// wound so that the normal points up
+	tris.insert(tris.end(), { a, d, c, a, c, b });
+}
+
+void TestGeometry::AddBox(const glm::vec3& min, const glm::vec3& max)
+{
+	int v[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		v[i] = AddVertex((i & 1) ? max.x : min.x, (i & 4) ? max.y : min.y, (i & 2) ? max.z : min.z);
+	}
+
+	auto quad = [this](int a, int b, int c, int d)
+	{
+		tris.insert(tris.end(), { a, b, c, a, c, d });
+	};
+
+	quad(v[4], v[6], v[7], v[5]); // top
+	quad(v[0], v[1], v[3], v[2]); // bottom
+	quad(v[0], v[4], v[5], v[1]); // -z
+	quad(v[2], v[3], v[7], v[6]); // +z
+	quad(v[0], v[2], v[6], v[4]); // -x
+	quad(v[1], v[5], v[7], v[3]); // +x
+}
+
+glm::vec3 TestGeometry::GetBoundsMin() const
+{
+	glm::vec3 result(std::numeric_limits<float>::max());
+
+	for (size_t i = 0; i + 2 < verts.size(); i += 3)
+		result = glm::min(result, glm::vec3(verts[i], verts[i + 1], verts[i + 2]));
+
+	return result;
+}
+
+glm::vec3 TestGeometry::GetBoundsMax() const
+{
+	glm::vec3 result(std::numeric_limits<float>::lowest());
+
+	for (size_t i = 0; i + 2 < verts.size(); i += 3)
+		result = glm::max(result, glm::vec3(verts[i], verts[i + 1], verts[i + 2]));
+
+	return result;
+}
+
+//----------------------------------------------------------------------------
+
+TestScene::TestScene()
+{
+	geometry.AddFloor(0.f, 0.f, Size, Size);
+
+	bool openAtStart = true;
+	for (float x = 50.f; x < Size; x += 40.f)
+	{
+		if (openAtStart)
+			geometry.AddBox({ x, 0.f, 30.f }, { x + 4.f, 20.f, Size });
+		else
+			geometry.AddBox({ x, 0.f, 0.f }, { x + 4.f, 20.f, Size - 30.f });
+
+		openAtStart = !openAtStart;
+	}
+
+	geometry.AddBox({ 2.f, 0.f, 2.f }, { 36.f, 20.f, 4.f });
+	geometry.AddBox({ 2.f, 0.f, 30.f }, { 36.f, 20.f, 32.f });
+	geometry.AddBox({ 2.f, 0.f, 2.f }, { 4.f, 20.f, 32.f });
+	geometry.AddBox({ 34.f, 0.f, 2.f }, { 36.f, 20.f, 32.f });
+
+	geometry.AddBox({ 102.f, 0.f, 100.f }, { 122.f, BlockHeight, 130.f });
+}
+
+//----------------------------------------------------------------------------
+
+TestMesh::TestMesh()
+{
+	std::random_device rd;
+	fs::path folder = fs::temp_directory_path() / ("mq2nav-test-" + std::to_string(rd()) + std::to_string(rd()));
+	fs::create_directories(folder);
+
+	m_folder = folder.string();
+	m_fileName = (folder / (std::string("testzone") + NAVMESH_FILE_EXTENSION)).string();
+	m_navMesh = std::make_unique<NavMesh>(m_folder, "testzone");
+	m_navMesh->GetNavMeshConfig().tileSize = 32;
+}
+
+TestMesh::~TestMesh()
+{
+	// the tiles can be mapped from the file
+	m_navMesh.reset();
+
+	std::error_code ec;
+	fs::remove_all(m_folder, ec);
+}
+
+bool TestMesh::Build(const TestGeometry& geometry)
+{
+	const NavMeshConfig& config = m_navMesh->GetNavMeshConfig();
+
+	glm::vec3 boundsMin = geometry.GetBoundsMin() - glm::vec3(0.f, 5.f, 0.f);
+	glm::vec3 boundsMax = geometry.GetBoundsMax() + glm::vec3(0.f, 5.f, 0.f);
+	m_navMesh->SetNavMeshBounds(boundsMin, boundsMax);
+
+	int gridWidth = 0, gridHeight = 0;
+	rcCalcGridSize(glm::value_ptr(boundsMin), glm::value_ptr(boundsMax), config.cellSize,
+		&gridWidth, &gridHeight);
+
+	const int tileSize = static_cast<int>(config.tileSize);
+	const int tilesWidth = (gridWidth + tileSize - 1) / tileSize;
+	const int tilesHeight = (gridHeight + tileSize - 1) / tileSize;
+	const float tileWidth = config.tileSize * config.cellSize;
+
+	std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
+		[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+
+	dtNavMeshParams params;
+	rcVcopy(params.orig, glm::value_ptr(boundsMin));
+	params.tileWidth = tileWidth;
+	params.tileHeight = tileWidth;
+	params.maxTiles = tilesWidth * tilesHeight;
+	params.maxPolys = (1 << DT_POLY_BITS);
+
+	if (dtStatusFailed(navMesh->init(&params)))
+		return false;
+
+	auto offMeshConnections = m_navMesh->CreateOffMeshConnectionBuffer();
+
+	for (int ty = 0; ty < tilesHeight; ++ty)
+	{
+		for (int tx = 0; tx < tilesWidth; ++tx)
+		{
+			glm::vec3 tileMin(boundsMin.x + tx * tileWidth, boundsMin.y, boundsMin.z + ty * tileWidth);
+			glm::vec3 tileMax(boundsMin.x + (tx + 1) * tileWidth, boundsMax.y, boundsMin.z + (ty + 1) * tileWidth);
+
+			int dataSize = 0;
+			unsigned char* data = BuildTile(geometry, tx, ty, glm::value_ptr(tileMin),
+				glm::value_ptr(tileMax), *offMeshConnections, dataSize);
+
+			if (data && dtStatusFailed(navMesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)))
+				dtFree(data);
+		}
+	}
+
+	m_navMesh->SetNavMesh(navMesh, false);
+
+	if (!m_navMesh->SaveNavMeshFile(m_fileName, NavMeshHeaderVersion::Latest))
+		return false;
+
+	return m_navMesh->LoadNavMeshFile(m_fileName) == NavMesh::LoadResult::Success;
+}
+
+unsigned char* TestMesh::BuildTile(const TestGeometry& geometry, int tx, int ty, const float* tileMin,
+	const float* tileMax, OffMeshConnectionBuffer& connections, int& dataSize)
+{
+	const NavMeshConfig& config = m_navMesh->GetNavMeshConfig();
+
+	rcConfig cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = config.cellSize;
+	cfg.ch = config.cellHeight;
+	cfg.walkableSlopeAngle = config.agentMaxSlope;
+	cfg.walkableHeight = static_cast<int>(ceilf(config.agentHeight / cfg.ch));
+	cfg.walkableClimb = static_cast<int>(floorf(config.agentMaxClimb / cfg.ch));
+	cfg.walkableRadius = static_cast<int>(ceilf(config.agentRadius / cfg.cs));
+	cfg.maxEdgeLen = static_cast<int>(config.edgeMaxLen / config.cellSize);
+	cfg.maxSimplificationError = config.edgeMaxError;
+	cfg.minRegionArea = static_cast<int>(rcSqr(config.regionMinSize));
+	cfg.mergeRegionArea = static_cast<int>(rcSqr(config.regionMergeSize));
+	cfg.maxVertsPerPoly = static_cast<int>(config.vertsPerPoly);
+	cfg.tileSize = static_cast<int>(config.tileSize);
+	cfg.borderSize = cfg.walkableRadius + 3;
+	cfg.width = cfg.tileSize + cfg.borderSize * 2;
+	cfg.height = cfg.tileSize + cfg.borderSize * 2;
+	cfg.detailSampleDist = config.detailSampleDist < 0.9f ? 0 : config.cellSize * config.detailSampleDist;
+	cfg.detailSampleMaxError = config.cellHeight * config.detailSampleMaxError;
+
+	rcVcopy(cfg.bmin, tileMin);
+	rcVcopy(cfg.bmax, tileMax);
+	cfg.bmin[0] -= cfg.borderSize * cfg.cs;
+	cfg.bmin[2] -= cfg.borderSize * cfg.cs;
+	cfg.bmax[0] += cfg.borderSize * cfg.cs;
+	cfg.bmax[2] += cfg.borderSize * cfg.cs;
+
+	rcContext ctx(false);
+
+	const int numVerts = static_cast<int>(geometry.verts.size() / 3);
+	const int numTris = static_cast<int>(geometry.tris.size() / 3);
+	std::vector<unsigned char> triAreas(numTris, 0);
+
+	rcHeightfield* solid = rcAllocHeightfield();
+	rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+	rcContourSet* cset = rcAllocContourSet();
+	rcPolyMesh* pmesh = rcAllocPolyMesh();
+	rcPolyMeshDetail* dmesh = rcAllocPolyMeshDetail();
+	unsigned char* navData = nullptr;
+
+	auto cleanup = [&]()
+	{
+		rcFreeHeightField(solid);
+		rcFreeCompactHeightfield(chf);
+		rcFreeContourSet(cset);
+		rcFreePolyMesh(pmesh);
+		rcFreePolyMeshDetail(dmesh);
+	};
+
+	if (!rcCreateHeightfield(&ctx, *solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+	{
+		cleanup();
+		return nullptr;
+	}
+
+	rcMarkWalkableTriangles(&ctx, cfg.walkableSlopeAngle, geometry.verts.data(), numVerts,
+		geometry.tris.data(), numTris, triAreas.data());
+	rcRasterizeTriangles(&ctx, geometry.verts.data(), numVerts, geometry.tris.data(),
+		triAreas.data(), numTris, *solid, cfg.walkableClimb);
+
+	rcFilterLowHangingWalkableObstacles(&ctx, cfg.walkableClimb, *solid);
+	rcFilterLedgeSpans(&ctx, cfg.walkableHeight, cfg.walkableClimb, *solid);
+	rcFilterWalkableLowHeightSpans(&ctx, cfg.walkableHeight, *solid);
+
+	if (!rcBuildCompactHeightfield(&ctx, cfg.walkableHeight, cfg.walkableClimb, *solid, *chf)
+		|| !rcErodeWalkableArea(&ctx, cfg.walkableRadius, *chf)
+		|| !rcBuildDistanceField(&ctx, *chf)
+		|| !rcBuildRegions(&ctx, *chf, cfg.borderSize, cfg.minRegionArea, cfg.mergeRegionArea)
+		|| !rcBuildContours(&ctx, *chf, cfg.maxSimplificationError, cfg.maxEdgeLen, *cset)
+		|| cset->nconts == 0
+		|| !rcBuildPolyMesh(&ctx, *cset, cfg.maxVertsPerPoly, *pmesh)
+		|| !rcBuildPolyMeshDetail(&ctx, *pmesh, *chf, cfg.detailSampleDist, cfg.detailSampleMaxError, *dmesh)
+		|| pmesh->npolys == 0)
+	{
+		cleanup();
+		return nullptr;
+	}
+
+	for (int i = 0; i < pmesh->npolys; ++i)
+	{
+		if (pmesh->areas[i] >= RC_WALKABLE_AREA)
+			pmesh->areas[i] = static_cast<uint8_t>(PolyArea::Ground);
+
+		pmesh->flags[i] = m_navMesh->GetPolyArea(pmesh->areas[i]).flags;
+	}
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = pmesh->verts;
+	params.vertCount = pmesh->nverts;
+	params.polys = pmesh->polys;
+	params.polyAreas = pmesh->areas;
+	params.polyFlags = pmesh->flags;
+	params.polyCount = pmesh->npolys;
+	params.nvp = pmesh->nvp;
+	params.detailMeshes = dmesh->meshes;
+	params.detailVerts = dmesh->verts;
+	params.detailVertsCount = dmesh->nverts;
+	params.detailTris = dmesh->tris;
+	params.detailTriCount = dmesh->ntris;
+	connections.UpdateNavMeshCreateParams(params);
+	params.walkableHeight = config.agentHeight;
+	params.walkableRadius = config.agentRadius;
+	params.walkableClimb = config.agentMaxClimb;
+	params.tileX = tx;
+	params.tileY = ty;
+	params.tileLayer = 0;
+	rcVcopy(params.bmin, pmesh->bmin);
+	rcVcopy(params.bmax, pmesh->bmax);
+	params.cs = cfg.cs;
+	params.ch = cfg.ch;
+	params.buildBvTree = true;
+
+	if (!dtCreateNavMeshData(&params, &navData, &dataSize))
+		navData = nullptr;
+
+	cleanup();
+	return navData;
+}
+
+//----------------------------------------------------------------------------
+
+static const float SEARCH_EXTENTS[3] = { 5.f, 10.f, 5.f };
+static const int MAX_SEARCH_NODES = 65535;
+static const int MAX_PATH = 4096;
+
+float DetourPath::GetLength() const
+{
+	float length = 0.f;
+
+	for (size_t i = 1; i < points.size(); ++i)
+		length += glm::distance(points[i - 1], points[i]);
+
+	return length;
+}
+
+dtPolyRef FindPolyRef(const dtNavMesh& navMesh, const dtQueryFilter& filter, const glm::vec3& pos)
+{
+	dtNavMeshQuery query;
+	if (dtStatusFailed(query.init(&navMesh, 16)))
+		return 0;
+
+	dtPolyRef ref = 0;
+	query.findNearestPoly(glm::value_ptr(pos), SEARCH_EXTENTS, &filter, &ref, nullptr);
+
+	return ref;
+}
+
+DetourPath FindDetourPath(const dtNavMesh& navMesh, const dtQueryFilter& filter, const glm::vec3& start,
+	const glm::vec3& end)
+{
+	DetourPath result;
+
+	dtNavMeshQuery query;
+	if (dtStatusFailed(query.init(&navMesh, MAX_SEARCH_NODES)))
+		return result;
+
+	dtPolyRef startRef = 0, endRef = 0;
+	glm::vec3 spos, epos;
+	query.findNearestPoly(glm::value_ptr(start), SEARCH_EXTENTS, &filter, &startRef, glm::value_ptr(spos));
+	query.findNearestPoly(glm::value_ptr(end), SEARCH_EXTENTS, &filter, &endRef, glm::value_ptr(epos));
+	if (!startRef || !endRef)
+		return result;
+
+	result.polys.resize(MAX_PATH);
+
+	int numPolys = 0;
+	result.status = query.findPath(startRef, endRef, glm::value_ptr(spos), glm::value_ptr(epos), &filter,
+		result.polys.data(), &numPolys, MAX_PATH);
+	result.polys.resize(numPolys);
+
+	if (dtStatusFailed(result.status) || numPolys == 0)
+		return result;
+
+	// a partial path ends at the closest point it got to
+	if (result.polys.back() != endRef)
+		query.closestPointOnPoly(result.polys.back(), glm::value_ptr(end), glm::value_ptr(epos), nullptr);
+
+	result.points.resize(MAX_PATH);
+
+	int numPoints = 0;
+	query.findStraightPath(glm::value_ptr(spos), glm::value_ptr(epos), result.polys.data(), numPolys,
+		glm::value_ptr(result.points[0]), nullptr, nullptr, &numPoints, MAX_PATH);
+	result.points.resize(numPoints);
+
+	return result;
+}
+
+static std::mt19937 s_randomPointEngine;
+
+static float RandomPointFloat()
+{
+	return std::uniform_real_distribution<float>(0.f, 1.f)(s_randomPointEngine);
+}
+
+std::vector<glm::vec3> GetRandomPoints(const dtNavMesh& navMesh, int count, unsigned int seed)
+{
+	std::vector<glm::vec3> points;
+
+	dtNavMeshQuery query;
+	if (dtStatusFailed(query.init(&navMesh, MAX_SEARCH_NODES)))
+		return points;
+
+	s_randomPointEngine.seed(seed);
+
+	dtQueryFilter filter;
+	points.reserve(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		dtPolyRef ref = 0;
+		glm::vec3 pos;
+		if (dtStatusSucceed(query.findRandomPoint(&filter, RandomPointFloat, &ref, glm::value_ptr(pos))))
+			points.push_back(pos);
+	}
+
+	return points;
+}
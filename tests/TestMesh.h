@@ -0,0 +1,112 @@
+//
+// TestMesh.h
+//
+// Small navmeshes for the tests, built with recast the same way the mesh
+// generator builds them.
+//
+
+#pragma once
+
+#include "common/NavMesh.h"
+
+#include <DetourNavMeshQuery.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Triangles that a test navmesh is built from.
+struct TestGeometry
+{
+	std::vector<float> verts;
+	std::vector<int> tris;
+
+	// flat walkable floor at height y
+	void AddFloor(float minX, float minZ, float maxX, float maxZ, float y = 0.f);
+
+	// solid box. The top is walkable if it is big enough to stand on.
+	void AddBox(const glm::vec3& min, const glm::vec3& max);
+
+	glm::vec3 GetBoundsMin() const;
+	glm::vec3 GetBoundsMax() const;
+
+private:
+	int AddVertex(float x, float y, float z);
+};
+
+// The scene that most of the tests use. It is a 200 x 200 floor with:
+//   - walls across it every 40 units, with a gap at alternating ends, so that paths
+//     from one side to the other have to wind back and forth;
+//   - a room in the corner that is closed off from the rest;
+//   - a tall block whose top can't be reached from the floor.
+struct TestScene
+{
+	TestScene();
+
+	TestGeometry geometry;
+
+	static constexpr float Size = 200.f;
+	static constexpr float BlockHeight = 40.f;
+
+	// spots on the navmesh
+	static glm::vec3 GetFloorStart() { return { 20.f, 0.f, 190.f }; }
+	static glm::vec3 GetFloorEnd() { return { 190.f, 0.f, 20.f }; }
+	static glm::vec3 GetRoomCenter() { return { 19.f, 0.f, 17.f }; }
+	static glm::vec3 GetBlockTop() { return { 112.f, BlockHeight, 115.f }; }
+	static glm::vec3 GetBlockBase() { return { 112.f, 0.f, 140.f }; }
+
+	// a spot that is nowhere near the navmesh
+	static glm::vec3 GetOffMesh() { return { -100.f, 0.f, -100.f }; }
+};
+
+// A navmesh built from test geometry. It is saved to a file and loaded from it again,
+// so that it is set up the same way as a navmesh loaded in game, including the
+// connected regions and tile graph. The file is deleted along with the mesh.
+class TestMesh
+{
+public:
+	TestMesh();
+	~TestMesh();
+
+	TestMesh(const TestMesh&) = delete;
+	TestMesh& operator=(const TestMesh&) = delete;
+
+	// Settings and connections that are set on the navmesh before building are built
+	// into it. The config starts out with tiles that are 32 cells across, so that
+	// the small scenes still cover plenty of tiles.
+	bool Build(const TestGeometry& geometry);
+
+	NavMesh& GetNavMesh() { return *m_navMesh; }
+	const std::string& GetFileName() const { return m_fileName; }
+
+private:
+	unsigned char* BuildTile(const TestGeometry& geometry, int tx, int ty, const float* tileMin,
+		const float* tileMax, OffMeshConnectionBuffer& connections, int& dataSize);
+
+	std::string m_folder;
+	std::string m_fileName;
+	std::unique_ptr<NavMesh> m_navMesh;
+};
+
+// A path found with a plain detour search, to check the results of the planner against.
+struct DetourPath
+{
+	dtStatus status = DT_FAILURE;
+	std::vector<dtPolyRef> polys;
+	std::vector<glm::vec3> points;
+
+	// the search reached the end polygon
+	bool IsComplete() const { return dtStatusSucceed(status) && !dtStatusDetail(status, DT_PARTIAL_RESULT); }
+	float GetLength() const;
+};
+
+// The polygon nearest to pos, with the same search extents as FindDetourPath. 0 if there isn't one.
+dtPolyRef FindPolyRef(const dtNavMesh& navMesh, const dtQueryFilter& filter, const glm::vec3& pos);
+
+// Searches with findPath and findStraightPath, the way paths were found before the planner.
+DetourPath FindDetourPath(const dtNavMesh& navMesh, const dtQueryFilter& filter, const glm::vec3& start,
+	const glm::vec3& end);
+
+// Random points on the navmesh. The same seed gives the same points.
+std::vector<glm::vec3> GetRandomPoints(const dtNavMesh& navMesh, int count, unsigned int seed);
@@ -0,0 +1,147 @@
+//
+// TileGraphTests.cpp
+//
+// Routes through the tile graph, and the paths the planner follows along them,
+// against findPath.
+//
+
+#include "TestMesh.h"
+
+#include "common/PathPlanner.h"
+#include "common/TileGraph.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+class TileGraphTest : public ::testing::Test
+{
+protected:
+	// the planner only routes through the graph when the ends are this many tiles apart
+	static constexpr int MinRouteTiles = 6;
+
+	void SetUp() override
+	{
+		ASSERT_TRUE(m_mesh.Build(m_scene.geometry));
+
+		m_planner.SetNavMesh(&m_mesh.GetNavMesh());
+		m_navMesh = m_mesh.GetNavMesh().GetNavMesh();
+		m_graph = m_mesh.GetNavMesh().GetTileGraph();
+		ASSERT_NE(m_graph, nullptr);
+		ASSERT_FALSE(m_graph->IsEmpty());
+	}
+
+	const dtMeshHeader* GetTileHeader(dtPolyRef ref) const
+	{
+		const dtMeshTile* tile = nullptr;
+		const dtPoly* poly = nullptr;
+		m_navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		return tile->header;
+	}
+
+	int GetTileDistance(dtPolyRef a, dtPolyRef b) const
+	{
+		const dtMeshHeader* tileA = GetTileHeader(a);
+		const dtMeshHeader* tileB = GetTileHeader(b);
+		return std::max(std::abs(tileA->x - tileB->x), std::abs(tileA->y - tileB->y));
+	}
+
+	bool FindRoute(const glm::vec3& start, const glm::vec3& end, std::vector<uint32_t>& route)
+	{
+		dtPolyRef startRef = FindPolyRef(*m_navMesh, m_planner.GetFilter(), start);
+		dtPolyRef endRef = FindPolyRef(*m_navMesh, m_planner.GetFilter(), end);
+		EXPECT_NE(startRef, 0u);
+		EXPECT_NE(endRef, 0u);
+
+		return m_search.FindRoute(*m_graph, *m_navMesh, m_planner.GetFilter(), startRef, endRef, end, route);
+	}
+
+	TestScene m_scene;
+	TestMesh m_mesh;
+	PathPlanner m_planner;
+	TileGraphSearch m_search;
+	std::shared_ptr<dtNavMesh> m_navMesh;
+	std::shared_ptr<const TileGraph> m_graph;
+};
+
+TEST_F(TileGraphTest, RouteCrossesNeighbouringTiles)
+{
+	glm::vec3 start = TestScene::GetFloorStart();
+	glm::vec3 end = TestScene::GetFloorEnd();
+
+	std::vector<uint32_t> route;
+	ASSERT_TRUE(FindRoute(start, end, route));
+	ASSERT_FALSE(route.empty());
+
+	const std::vector<TileGraph::Portal>& portals = m_graph->GetPortals();
+	dtPolyRef previous = FindPolyRef(*m_navMesh, m_planner.GetFilter(), start);
+
+	for (uint32_t index : route)
+	{
+		ASSERT_LT(index, portals.size());
+		ASSERT_TRUE(m_graph->IsPortalValid(*m_navMesh, index));
+
+		dtPolyRef ref = portals[index].tileRef | static_cast<dtPolyRef>(portals[index].poly);
+		EXPECT_LE(GetTileDistance(previous, ref), 1);
+		previous = ref;
+	}
+
+	EXPECT_LE(GetTileDistance(previous, FindPolyRef(*m_navMesh, m_planner.GetFilter(), end)), 1);
+}
+
+TEST_F(TileGraphTest, NoRouteToUnreachableRegions)
+{
+	std::vector<uint32_t> route;
+	EXPECT_FALSE(FindRoute(TestScene::GetFloorEnd(), TestScene::GetRoomCenter(), route));
+	EXPECT_FALSE(FindRoute(TestScene::GetFloorStart(), TestScene::GetBlockTop(), route));
+}
+
+TEST_F(TileGraphTest, PathsMatchFindPath)
+{
+	std::vector<glm::vec3> points = GetRandomPoints(*m_navMesh, 400, 5);
+	points.push_back(TestScene::GetFloorStart());
+	points.push_back(TestScene::GetFloorEnd());
+
+	int routed = 0;
+	float totalDifference = 0.f;
+
+	for (size_t i = 0; i + 1 < points.size(); i += 2)
+	{
+		const glm::vec3& start = points[i];
+		const glm::vec3& end = points[i + 1];
+		SCOPED_TRACE(testing::Message() << "from " << i << " to " << i + 1);
+
+		dtPolyRef startRef = FindPolyRef(*m_navMesh, m_planner.GetFilter(), start);
+		dtPolyRef endRef = FindPolyRef(*m_navMesh, m_planner.GetFilter(), end);
+		if (GetTileDistance(startRef, endRef) < MinRouteTiles)
+			continue;
+
+		DetourPath expected = FindDetourPath(*m_navMesh, m_planner.GetFilter(), start, end);
+
+		StraightPath path;
+		PathResult result = m_planner.FindPath(start, end, path);
+		ASSERT_EQ(result == PathResult::Success, expected.IsComplete());
+
+		if (!expected.IsComplete())
+			continue;
+
+		std::vector<uint32_t> route;
+		EXPECT_TRUE(FindRoute(start, end, route));
+
+		ASSERT_GE(path.length, 2);
+		EXPECT_LT(glm::distance(path.verts[path.length - 1], expected.points.back()), 0.1f);
+
+		// The windows of the route end at polygon centres, so the corridor can differ a
+		// little from the one findPath picks, but the path shouldn't be much longer.
+		float difference = (path.GetLength() - expected.GetLength()) / std::max(expected.GetLength(), 1.f);
+		EXPECT_LT(std::abs(difference), 0.1f) << path.GetLength() << " vs " << expected.GetLength();
+
+		totalDifference += std::abs(difference);
+		++routed;
+	}
+
+	EXPECT_GT(routed, 50);
+	EXPECT_LT(totalDifference / routed, 0.02f);
+}